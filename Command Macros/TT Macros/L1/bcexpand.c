@@ -0,0 +1,194 @@
+/*
+ * bcexpand.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Ground tool for the compressed data files (DATA_COMPRESS in the flight software).
+ *
+ *  bcexpand <compressed file> <out file>
+ *		expand the blocks in an EVT or CPS file, or in the data bytes of a downlink put
+ *		back together. Whatever comes before the first block (the file headers) and after
+ *		the last one (the footer) is copied across as it is. Anything between two blocks
+ *		that is not a block is a piece missing from the downlink; it is skipped and counted
+ *		and the expanding goes on from the next good block.
+ *  bcexpand -b <file> [file ...]
+ *		benchmark every codec on the files, a cluster at a time like the instrument does:
+ *		compression ratio, and the average and worst time per byte on this machine
+ *
+ * Build with the flight code for the codecs:
+ *  gcc -O2 -o bcexpand bcexpand.c ../../../lunah_FSW_01_src/src/BlockCompress.c -I../../../lunah_FSW_01_src/src
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BlockCompress.h"
+
+#define BLOCK_SIZE		16384	//EVT_DATA_BUFF_SIZE/CPS_BLOCK_SIZE, the most the instrument puts in one block
+
+/*
+ * Read a whole file into memory.
+ */
+static unsigned char * ReadFile( const char * name, long * size )
+{
+	FILE * file = fopen(name, "rb");
+	unsigned char * data = NULL;
+
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	data = malloc(*size + 1);
+	if(data != NULL && fread(data, 1, *size, file) != (size_t)*size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+static double Seconds( void )
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static int Expand( const char * in_name, const char * out_name )
+{
+	long size = 0;
+	long pos = 0;
+	long tail = 0;			//where the last good block ended
+	long skipped = 0;		//bytes between blocks which were not a block
+	long gap = 0;
+	unsigned long blocks = 0;
+	unsigned long raw_total = 0;
+	unsigned int block_bytes = 0;
+	unsigned int raw_bytes = 0;
+	unsigned char raw[BC_MAX_BLOCK];
+	unsigned char * data = ReadFile(in_name, &size);
+	FILE * out = NULL;
+
+	if(data == NULL)
+	{
+		printf("can't read %s\n", in_name);
+		return 1;
+	}
+	out = fopen(out_name, "wb");
+	if(out == NULL)
+	{
+		printf("can't write %s\n", out_name);
+		return 1;
+	}
+
+	tail = -1;
+	while(pos < size)
+	{
+		block_bytes = bcExpand(&data[pos], size - pos, raw, sizeof(raw), &raw_bytes);
+		if(block_bytes == 0)
+		{
+			pos++;
+			continue;
+		}
+		if(tail < 0)
+			fwrite(data, 1, pos, out);	//the file headers
+		else
+		{
+			gap = pos - tail;
+			skipped += gap;
+			if(gap != 0)
+				printf("%ld bytes missing at %ld\n", gap, tail);
+		}
+		fwrite(raw, 1, raw_bytes, out);
+		raw_total += raw_bytes;
+		blocks++;
+		pos += block_bytes;
+		tail = pos;
+	}
+	if(tail < 0)
+	{
+		printf("no compressed blocks in %s\n", in_name);
+		fclose(out);
+		return 1;
+	}
+	fwrite(&data[tail], 1, size - tail, out);	//the footer
+	fclose(out);
+
+	printf("%lu blocks, %lu bytes from %ld, ratio %.2f, %ld bytes skipped\n", blocks, raw_total, size, size ? (double)raw_total / size : 0.0, skipped);
+	free(data);
+	return 0;
+}
+
+static int Benchmark( int num_files, char ** names )
+{
+	int codec = 0;
+	int file = 0;
+	long size = 0;
+	long pos = 0;
+	unsigned int chunk = 0;
+	unsigned int block_bytes = 0;
+	unsigned int raw_bytes = 0;
+	unsigned long in_total = 0;
+	unsigned long out_total = 0;
+	double start = 0;
+	double took = 0;
+	double total = 0;
+	double worst = 0;
+	unsigned char block[BC_BOUND(BLOCK_SIZE)];
+	unsigned char check[BLOCK_SIZE];
+	unsigned char * data = NULL;
+
+	for(codec = 0; codec < BC_NUM_CODECS; codec++)
+	{
+		in_total = 0;
+		out_total = 0;
+		total = 0;
+		worst = 0;
+		for(file = 0; file < num_files; file++)
+		{
+			data = ReadFile(names[file], &size);
+			if(data == NULL)
+			{
+				printf("can't read %s\n", names[file]);
+				return 1;
+			}
+			for(pos = 0; pos < size; pos += chunk)
+			{
+				chunk = size - pos > BLOCK_SIZE ? BLOCK_SIZE : (unsigned int)(size - pos);
+				start = Seconds();
+				block_bytes = bcCompress(codec, &data[pos], chunk, block, sizeof(block));
+				took = Seconds() - start;
+				total += took;
+				if(took / chunk > worst)
+					worst = took / chunk;
+				if(bcExpand(block, block_bytes, check, sizeof(check), &raw_bytes) != block_bytes || raw_bytes != chunk || memcmp(check, &data[pos], chunk) != 0)
+				{
+					printf("%s: block at %ld of %s did not expand back\n", bcCodecName(codec), pos, names[file]);
+					return 1;
+				}
+				in_total += chunk;
+				out_total += block_bytes;
+			}
+			free(data);
+		}
+		printf("%-6s %lu bytes to %lu, ratio %.2f, %.1f MB/s, %.2f ns/byte, worst block %.2f ns/byte\n", bcCodecName(codec), in_total, out_total,
+				out_total ? (double)in_total / out_total : 0.0, total > 0 ? in_total / total / 1e6 : 0.0,
+				in_total ? total * 1e9 / in_total : 0.0, worst * 1e9);
+	}
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	if(argc >= 3 && strcmp(argv[1], "-b") == 0)
+		return Benchmark(argc - 2, &argv[2]);
+	if(argc == 3)
+		return Expand(argv[1], argv[2]);
+	printf("usage: bcexpand <compressed in> <out>\n       bcexpand -b <file> [file ...]\n");
+	return 1;
+}
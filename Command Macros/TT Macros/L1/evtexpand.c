@@ -0,0 +1,230 @@
+/*
+ * evtexpand.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Ground tool for the compact EVT format (EVT_COMPACT_FORMAT in the flight software).
+ *
+ *  evtexpand <compact evt_Sxxxx.bin> <legacy out.bin>
+ *		expand a compact EVT file back into the legacy 8 byte records
+ *  evtexpand -c <legacy evt_Sxxxx.bin> <compact out.bin>
+ *		pack a legacy EVT file the way the instrument would, to see what the format saves on
+ *		recorded data; the result is expanded again and checked against the original
+ *
+ * Both print the compression ratio, -c also prints the encode time per event on this machine.
+ * The file headers and footer are copied across as they are.
+ *
+ * Build with the flight code for the format itself:
+ *  gcc -O2 -o evtexpand evtexpand.c ../../../lunah_FSW_01_src/src/EVTCompact.c -I../../../lunah_FSW_01_src/src
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "EVTCompact.h"
+
+#define EVT_FILE_HEADERS	212		//DATA_FILE_HEADER_TYPE + DATA_FILE_SECONDARY_HEADER_TYPE
+#define EVT_FILE_FOOTER		32		//DATA_FILE_FOOTER_TYPE
+#define EVT_FILE_BLANK		186		//what the space up to the first cluster is filled with on a new set file
+#define EVT_CLUSTER_SIZE	16384	//EVT_DATA_BUFF_SIZE, blocks never cross one
+
+/*
+ * Read a whole file into memory.
+ */
+static unsigned char * ReadFile( const char * name, long * size )
+{
+	FILE * file = fopen(name, "rb");
+	unsigned char * data = NULL;
+
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	data = malloc(*size + 1);
+	if(data != NULL && fread(data, 1, *size, file) != (size_t)*size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+/*
+ * Find where the events start, past the headers and any blank space to the first cluster.
+ * The padding is only skipped for the compact format, a legacy record may start with 0x00.
+ */
+static long FindEvents( const unsigned char * data, long size, int compact )
+{
+	long pos = EVT_FILE_HEADERS;
+
+	while(pos < size && pos < EVT_CLUSTER_SIZE && (data[pos] == EVT_FILE_BLANK || (compact && data[pos] == EVT_COMPACT_PAD)))
+		pos++;
+	return pos;
+}
+
+/*
+ * Expand the compact blocks starting at pos. Stops at the first thing that is not a block
+ *  or padding, the footer.
+ *
+ * @return	Where the blocks and their padding ended
+ */
+static long ExpandBlocks( const unsigned char * data, long size, long pos, unsigned char * records, unsigned long * num_records )
+{
+	unsigned int block_bytes = 0;
+	unsigned int block_records = 0;
+
+	*num_records = 0;
+	while(pos < size)
+	{
+		if(data[pos] == EVT_COMPACT_PAD)
+		{
+			pos++;
+			continue;
+		}
+		block_bytes = evtCompactExpand(&data[pos], size - pos, &records[*num_records * EVT_RECORD_SIZE], EVT_COMPACT_MAX_BLOCK, &block_records);
+		if(block_bytes == 0)
+			break;
+		pos += block_bytes;
+		*num_records += block_records;
+	}
+	return pos;
+}
+
+static int Expand( const char * in_name, const char * out_name )
+{
+	long size = 0;
+	long start = 0;
+	long end = 0;
+	unsigned long num_records = 0;
+	unsigned char * data = ReadFile(in_name, &size);
+	unsigned char * records = NULL;
+	FILE * out = NULL;
+
+	if(data == NULL)
+	{
+		printf("can't read %s\n", in_name);
+		return 1;
+	}
+	start = FindEvents(data, size, 1);
+	if(start >= size || data[start] != EVT_COMPACT_MARKER)
+	{
+		printf("%s is not a compact EVT file\n", in_name);
+		return 1;
+	}
+	//no record is smaller than 4 bytes, the header aside
+	records = malloc((size / 4 + EVT_COMPACT_MAX_BLOCK) * EVT_RECORD_SIZE);
+	end = ExpandBlocks(data, size, start, records, &num_records);
+
+	out = fopen(out_name, "wb");
+	if(out == NULL)
+	{
+		printf("can't write %s\n", out_name);
+		return 1;
+	}
+	fwrite(data, 1, start, out);
+	fwrite(records, EVT_RECORD_SIZE, num_records, out);
+	fwrite(&data[end], 1, size - end, out);
+	fclose(out);
+
+	printf("%lu events, %ld compact bytes, %lu legacy bytes, ratio %.2f, %.2f bytes/event\n", num_records, end - start,
+			num_records * EVT_RECORD_SIZE, end > start ? (double)(num_records * EVT_RECORD_SIZE) / (end - start) : 0.0,
+			num_records ? (double)(end - start) / num_records : 0.0);
+	free(records);
+	free(data);
+	return 0;
+}
+
+static int Compact( const char * in_name, const char * out_name )
+{
+	long size = 0;
+	long start = 0;
+	long end = 0;
+	long pos = 0;
+	unsigned long iter = 0;
+	unsigned long num_records = 0;
+	unsigned long check_records = 0;
+	unsigned int block_records = 0;
+	unsigned int block_bytes = 0;
+	unsigned int cluster_bytes = 0;
+	double seconds = 0;
+	struct timespec t_start;
+	struct timespec t_end;
+	unsigned char * data = ReadFile(in_name, &size);
+	unsigned char * packed = NULL;
+	unsigned char * check = NULL;
+	FILE * out = NULL;
+
+	if(data == NULL)
+	{
+		printf("can't read %s\n", in_name);
+		return 1;
+	}
+	start = FindEvents(data, size, 0);
+	end = size - EVT_FILE_FOOTER;
+	if(end < start || data[start] == EVT_COMPACT_MARKER)
+	{
+		printf("%s is not a legacy EVT file\n", in_name);
+		return 1;
+	}
+	num_records = (end - start) / EVT_RECORD_SIZE;
+	end = start + num_records * EVT_RECORD_SIZE;
+	packed = malloc(num_records * EVT_COMPACT_MAX_RECORD + EVT_CLUSTER_SIZE * 2);
+	check = malloc(num_records * EVT_RECORD_SIZE + EVT_COMPACT_MAX_BLOCK * EVT_RECORD_SIZE);
+
+	//same as WriteEVTBuffer(), the blocks fill each cluster and the rest of it is padded
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for(iter = 0; iter < num_records; iter += block_records)
+	{
+		block_records = evtCompactEncode(&data[start + iter * EVT_RECORD_SIZE], num_records - iter, &packed[pos + cluster_bytes], EVT_CLUSTER_SIZE - cluster_bytes, &block_bytes);
+		cluster_bytes += block_bytes;
+		if(block_records == 0 || iter + block_records < num_records)
+		{
+			memset(&packed[pos + cluster_bytes], EVT_COMPACT_PAD, EVT_CLUSTER_SIZE - cluster_bytes);
+			pos += EVT_CLUSTER_SIZE;
+			cluster_bytes = 0;
+		}
+	}
+	pos += cluster_bytes;
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+
+	ExpandBlocks(packed, pos, 0, check, &check_records);
+	if(check_records != num_records || memcmp(check, &data[start], num_records * EVT_RECORD_SIZE) != 0)
+	{
+		printf("expanding the packed events did not give the original back\n");
+		return 1;
+	}
+
+	out = fopen(out_name, "wb");
+	if(out == NULL)
+	{
+		printf("can't write %s\n", out_name);
+		return 1;
+	}
+	fwrite(data, 1, start, out);
+	fwrite(packed, 1, pos, out);
+	fwrite(&data[end], 1, size - end, out);
+	fclose(out);
+
+	printf("%lu events, %lu legacy bytes, %ld compact bytes, ratio %.2f, %.2f bytes/event, encode %.1f ns/event\n", num_records,
+			num_records * EVT_RECORD_SIZE, pos, pos ? (double)(num_records * EVT_RECORD_SIZE) / pos : 0.0,
+			num_records ? (double)pos / num_records : 0.0, num_records ? seconds * 1e9 / num_records : 0.0);
+	free(check);
+	free(packed);
+	free(data);
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	if(argc == 4 && strcmp(argv[1], "-c") == 0)
+		return Compact(argv[2], argv[3]);
+	if(argc == 3)
+		return Expand(argv[1], argv[2]);
+	printf("usage: evtexpand <compact in> <legacy out>\n       evtexpand -c <legacy in> <compact out>\n");
+	return 1;
+}
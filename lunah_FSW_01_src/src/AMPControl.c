@@ -0,0 +1,139 @@
+/*
+ * AMPControl.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "AMPControl.h"
+
+#if AMP_MODE
+#include "xil_io.h"
+#include "xil_mmu.h"
+#include "xtime_l.h"
+#endif
+
+#if AMP_MODE
+/*
+ * Getter function for the block in OCM which both cores share.
+ */
+AMP_SHARED_TYPE * AMPGetShared( void )
+{
+	return (AMP_SHARED_TYPE *)AMP_SHARED_BASE;
+}
+
+/*
+ * Map the shared regions non-cacheable, each core has its own L1 so neither may cache
+ *  anything the other one writes. Both cores call this before touching the shared block.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void AMPSharedInit( void )
+{
+	Xil_SetTlbAttributes(AMP_SHARED_BASE, STRONG_ORDERED);
+	Xil_SetTlbAttributes(AMP_BLOCK_POOL_ADDR, NORM_NONCACHE);
+	return;
+}
+
+/*
+ * Wait for CPU1 to acknowledge the last run command, bounded by AMP_TIMEOUT_US.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int AMPWaitForAck( void )
+{
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+	XTime wait_start;
+	XTime wait_now;
+
+	XTime_GetTime(&wait_start);
+	while(shared->run_ack_seq != shared->run_cmd_seq)
+	{
+		XTime_GetTime(&wait_now);
+		if((wait_now - wait_start) > (XTime)AMP_TIMEOUT_US * (COUNTS_PER_SECOND / 1000000))
+			return CMD_FAILURE;
+	}
+	return CMD_SUCCESS;
+}
+
+/*
+ * CPU0 only. Clear the shared block, then release CPU1 from the boot ROM by writing its
+ *  entry point where the ROM is waiting for it and sending an event.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if CPU1 did not come up
+ */
+int AMPStartCPU1( void )
+{
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+	XTime wait_start;
+	XTime wait_now;
+
+	AMPSharedInit();
+	shared->magic = 0;
+	shared->run_cmd = AMP_RUN_STOP;
+	shared->run_cmd_seq = 0;
+	shared->run_ack_seq = 0;
+	shared->neutron_total = 0;
+	shared->buffers_processed = 0;
+	shared->dma_errors = 0;
+	BlockQueueInit(&(shared->data_q), AMP_BLOCK_POOL_ADDR, AMP_BLOCK_SIZE, AMP_QUEUE_DEPTH);
+	BlockQueueInit(&(shared->cps_q), (unsigned int)shared->cps_pool, AMP_CPS_BLOCK_SIZE, AMP_CPS_QUEUE_DEPTH);
+
+	Xil_Out32(AMP_CPU1_START_ADDR, AMP_CPU1_ENTRY_ADDR);
+	dsb();
+	__asm__ __volatile__("sev");
+
+	XTime_GetTime(&wait_start);
+	while(shared->magic != AMP_MAGIC)
+	{
+		XTime_GetTime(&wait_now);
+		if((wait_now - wait_start) > (XTime)AMP_TIMEOUT_US * (COUNTS_PER_SECOND / 1000000))
+			return CMD_FAILURE;
+	}
+	return CMD_SUCCESS;
+}
+
+/*
+ * CPU0 only. Tell CPU1 to start or stop a run and wait for it to pick up the command.
+ * For AMP_RUN_START the caller fills in the shared config first.
+ *
+ * @param	(unsigned int) AMP_RUN_START/AMP_RUN_STOP
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if CPU1 did not answer
+ */
+int AMPSendRunCommand( unsigned int command )
+{
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+
+	shared->run_cmd = command;
+	BLOCK_QUEUE_BARRIER();	//command (and config) before the sequence number which announces it
+	shared->run_cmd_seq = shared->run_cmd_seq + 1;
+	return AMPWaitForAck();
+}
+
+/*
+ * CPU1 only. Non-blocking check for a new run command from CPU0.
+ *
+ * @param	(unsigned int *) Set to the command if there is one
+ *
+ * @return	1 if there was a new command, 0 if not
+ */
+int AMPCheckRunCommand( unsigned int * command )
+{
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+	unsigned int cmd_seq = shared->run_cmd_seq;
+
+	if(cmd_seq == shared->run_ack_seq)
+		return 0;
+	BLOCK_QUEUE_BARRIER();
+	*command = shared->run_cmd;
+	shared->run_ack_seq = cmd_seq;
+	return 1;
+}
+#endif
@@ -0,0 +1,85 @@
+/*
+ * AMPControl.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Asymmetric multiprocessing split of the Mini-NS software.
+ * With AMP_MODE set to 1, this source tree is built twice, once against a BSP for each core:
+ *  CPU0 (XPAR_CPU_ID 0) keeps the UART, SOH, I2C, and FatFs. It starts CPU1 at boot, and
+ *   during DAQ it only drains the data queue and writes the blocks to the SD card.
+ *  CPU1 (XPAR_CPU_ID 1) owns the DMA and the FPGA handshake and runs ProcessData(). It
+ *   hands finished EVT/CPS/2DH blocks to CPU0 through the data queue.
+ * The CPU1 application must be linked at AMP_CPU1_ENTRY_ADDR, outside of the CPU0 image
+ *  and the DMA/block regions, and its BSP built with -DUSE_AMP=1 so it leaves the
+ *  shared peripherals (SCU, L2 cache, GIC distributor) to CPU0.
+ * That is the lunah_FSW_02_cpu1 project: it builds this src folder (linked, not copied)
+ *  with AMP_MODE=1 against standalone_bsp_1, and links it with its own lscript.ld. The
+ *  BSP sources for ps7_cortexa9_1 are generated by the SDK from standalone_bsp_1/system.mss.
+ *  The CPU0 build (lunah_FSW_01_src) needs AMP_MODE=1 added to its symbols as well, and
+ *  its image has to stay below DMA_TARGET_ADDR. lunah_FSW_02_cpu1/bootimage has the boot
+ *  image with both applications.
+ *
+ * The blocks go over in two BlockQueues, CPU1 producing and CPU0 consuming: data_q carries
+ *  the events buffers (which CPU1 fills in place), the 2DHs and the end of run block,
+ *  and cps_q carries the CPS events, which come out while an events buffer is being filled.
+ * The control block and queue indices are in the top 64 KiB of OCM, the events buffer
+ *  payloads are in DDR. Both regions are mapped non-cacheable on both cores by AMPSharedInit().
+ */
+
+#ifndef SRC_AMPCONTROL_H_
+#define SRC_AMPCONTROL_H_
+
+#include "xparameters.h"
+#include "lunah_defines.h"
+#include "BlockQueue.h"
+
+#ifndef AMP_MODE
+#define AMP_MODE			0
+#endif
+#define AMP_CPU0_BUILD		(AMP_MODE && (XPAR_CPU_ID == 0))
+#define AMP_CPU1_BUILD		(AMP_MODE && (XPAR_CPU_ID == 1))
+
+//Shared memory layout
+#define AMP_SHARED_BASE		0xFFFF0000	//top 64 KiB of OCM, mapped here for both cores
+#define AMP_CPU1_START_ADDR	0xFFFFFFF0	//CPU1 waits in the boot ROM until this holds its entry point
+#ifndef AMP_CPU1_ENTRY_ADDR
+#define AMP_CPU1_ENTRY_ADDR	0x18000000	//where the CPU1 application is linked
+#endif
+#define AMP_BLOCK_POOL_ADDR	0x0B000000	//block payloads, above the DMA slots/ring
+#define AMP_BLOCK_SIZE		EVT_DATA_BUFF_SIZE	//room for a full events buffer or one 2DH
+#define AMP_QUEUE_DEPTH		16			//must be a power of 2
+#define AMP_CPS_BLOCK_SIZE	16			//one CPS event, rounded up
+#define AMP_CPS_QUEUE_DEPTH	16
+#define AMP_MAGIC			0x414D5031	//"AMP1", CPU1 writes this once it is listening
+#define AMP_TIMEOUT_US		500000		//how long CPU0 waits on CPU1 to answer
+#define AMP_CONFIG_WORDS	48			//room for a CONFIG_STRUCT_TYPE (43 4-byte values)
+
+//Run commands, CPU0 to CPU1
+#define AMP_RUN_STOP		0
+#define AMP_RUN_START		1
+
+typedef struct {
+	volatile unsigned int magic;			//CPU1 is up
+	volatile unsigned int run_cmd;			//AMP_RUN_START/STOP, written by CPU0
+	volatile unsigned int run_cmd_seq;		//CPU0 bumps this with each command
+	volatile unsigned int run_ack_seq;		//CPU1 copies run_cmd_seq once it has acted on it
+	volatile unsigned int neutron_total;	//running total from CPU1, for SOH
+	volatile unsigned int buffers_processed;
+	volatile unsigned int dma_errors;
+	unsigned int config[AMP_CONFIG_WORDS];	//CPU0's CONFIG_STRUCT_TYPE at the start of the run
+	BLOCK_QUEUE_TYPE data_q;				//CPU1 to CPU0, events buffers, 2DHs, end of run
+	BLOCK_QUEUE_TYPE cps_q;					//CPU1 to CPU0, CPS events
+	unsigned char cps_pool[AMP_CPS_QUEUE_DEPTH * AMP_CPS_BLOCK_SIZE];
+} AMP_SHARED_TYPE;
+
+//function prototypes
+#if AMP_MODE
+AMP_SHARED_TYPE * AMPGetShared( void );
+void AMPSharedInit( void );
+int AMPStartCPU1( void );
+int AMPSendRunCommand( unsigned int command );
+int AMPCheckRunCommand( unsigned int * command );
+#endif
+
+#endif /* SRC_AMPCONTROL_H_ */
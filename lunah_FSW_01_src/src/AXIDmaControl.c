@@ -0,0 +1,453 @@
+/*
+ * AXIDmaControl.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * The interrupt handler and the acquisition loops share the sequence numbers below.
+ *  The handler is the only writer of m_done_seq/m_done_err_bits, the loops are the
+ *  only writers of m_issued_seq. Each is a single aligned 32-bit value, so no locking
+ *  is needed on the single core. Nothing outside the handler ever sets m_done_seq, not
+ *  even a reset; the loops catch m_issued_seq up to it instead, so an interrupt taken
+ *  part way through a reset is counted and never undone.
+ */
+
+#include "AXIDmaControl.h"
+
+//File Scope Variables
+static volatile unsigned int m_done_seq;		//incremented by the ISR each time a transfer completes
+static volatile unsigned int m_done_err_bits;	//error bits from the status register at the last interrupt
+static unsigned int m_issued_seq;				//incremented each time we start a transfer
+static int m_xfer_in_flight;					//1 while a transfer has been started and not checked off
+static unsigned int m_last_err_bits;			//error bits reported for the most recent transfer
+static unsigned int m_error_count;				//transfers which completed with an error
+static unsigned int m_timeout_count;			//transfers which never completed
+static XTime m_xfer_start;						//when the transfer in flight was started
+#if DMA_SG_MODE
+static XAxiDma m_axi_dma;						//driver instance, only used for the descriptor ring
+static u8 m_bd_space[DMA_SG_RING_DEPTH * XAXIDMA_BD_MINIMUM_ALIGNMENT] __attribute__ ((aligned (XAXIDMA_BD_MINIMUM_ALIGNMENT)));
+static XAxiDma_Bd *m_sg_bd;						//the descriptor the CPU is holding, NULL if none
+static XAxiDma_Bd *m_sg_done_first;				//oldest filled descriptor taken back from the DMA and not yet handed out
+static int m_sg_done_count;						//filled descriptors taken back from the DMA and not yet handed out
+static int m_ring_stalled;						//1 while the FPGA has a buffer ready and the ring has no room for it
+static unsigned int m_ring_full_stalls;			//times the FPGA had a buffer ready with every descriptor waiting on the CPU
+static unsigned int m_ring_high_water;			//most filled descriptors we have seen waiting on the CPU
+#endif
+
+/*
+ * Start the S2MM channel with the IOC and error interrupts enabled.
+ * Any interrupt the handler has already counted belongs to no transfer of ours, so the
+ *  issued count is caught up to it before the interrupts can come in again.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void DMAInit( void )
+{
+	u32 tmpVal = 0;
+
+	m_xfer_in_flight = 0;
+	m_issued_seq = m_done_seq;
+
+	tmpVal = Xil_In32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET);
+	tmpVal |= DMA_CR_IRQ_ENABLE | DMA_CR_RUNSTOP;
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET, tmpVal);
+	return;
+}
+
+/*
+ * Soft reset the DMA and restart the channel. Once the DMA flags an error it halts
+ *  and will not accept another transfer until it is reset, so this is how we recover
+ *  from an error or a time out.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void DMAReset( void )
+{
+	int tries = 0;
+
+	//mask the interrupts and clear any the DMA is still holding, so the transfer being
+	// abandoned cannot complete into the next one once DMAInit() turns them back on
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET, Xil_In32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET) & ~DMA_CR_IRQ_ENABLE);
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_SR_OFFSET, DMA_SR_IRQ_IOC | DMA_SR_IRQ_ERR);
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET, DMA_CR_RESET);
+	while((Xil_In32(DMA_BASEADDR + DMA_S2MM_CR_OFFSET) & DMA_CR_RESET) && tries < DMA_RESET_TRIES)
+		tries++;
+
+	DMAInit();
+	return;
+}
+
+/*
+ * Called from the interrupt handler when the DMA raises an interrupt.
+ * Records the error bits, acknowledges the interrupt, then publishes the new
+ *  sequence number. The sequence number is written last so that a poller which
+ *  sees it change will also see the error bits for that transfer.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void DMACompletionISR( void )
+{
+	u32 tmpValue = 0;
+
+	tmpValue = Xil_In32(DMA_BASEADDR + DMA_S2MM_SR_OFFSET);	//Read the DMA status register
+	//bits 12, 14 are write-to-clear, this acknowledges the IOC/error interrupts
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_SR_OFFSET, tmpValue | DMA_SR_IRQ_IOC | DMA_SR_IRQ_ERR);
+
+	m_done_err_bits = tmpValue & DMA_SR_ERR_ALL;
+	m_done_seq++;
+	return;
+}
+
+/*
+ * Start an S2MM transfer. The caller is responsible for the MUX which connects
+ *  the FPGA buffers to the DMA.
+ *
+ * @param	(unsigned int) Address in DRAM to transfer into
+ * @param	(unsigned int) Number of bytes to request
+ *
+ * @return	None
+ */
+void DMAStartTransfer( unsigned int dest_addr, unsigned int length )
+{
+	m_issued_seq = m_done_seq + 1;	//the next interrupt belongs to this transfer
+	m_xfer_in_flight = 1;
+	CacheDMARecvPrepare(dest_addr, length);	//no dirty lines may land on top of the new data
+	XTime_GetTime(&m_xfer_start);
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_DA_OFFSET, dest_addr);
+	Xil_Out32(DMA_BASEADDR + DMA_S2MM_LENGTH_OFFSET, length);
+	return;
+}
+
+/*
+ * Non-blocking check on the transfer which is in flight. Once this returns something
+ *  other than DMA_XFER_BUSY the transfer is finished with and the next call will
+ *  return DMA_XFER_IDLE until another transfer is started.
+ *
+ * @param	None
+ *
+ * @return	DMA_XFER_IDLE/BUSY/DONE/ERROR/TIMEOUT
+ */
+int DMACheckTransfer( void )
+{
+	int state = DMA_XFER_BUSY;
+	XTime m_current_time;
+
+	if(m_xfer_in_flight == 0)
+		return DMA_XFER_IDLE;
+
+	//a stray interrupt can take m_done_seq past the one this transfer is waiting for
+	if((int)(m_done_seq - m_issued_seq) >= 0)
+	{
+		m_last_err_bits = m_done_err_bits;
+		if(m_last_err_bits == 0)
+			state = DMA_XFER_DONE;
+		else
+		{
+			m_error_count++;
+			state = DMA_XFER_ERROR;
+		}
+	}
+	else
+	{
+		XTime_GetTime(&m_current_time);
+		if((m_current_time - m_xfer_start) >= ((XTime)DMA_TIMEOUT_US * COUNTS_PER_SECOND / 1000000))
+		{
+			//the interrupt never came, see if the DMA recorded why
+			m_last_err_bits = Xil_In32(DMA_BASEADDR + DMA_S2MM_SR_OFFSET) & DMA_SR_ERR_ALL;
+			m_timeout_count++;
+			state = DMA_XFER_TIMEOUT;
+		}
+	}
+
+	if(state != DMA_XFER_BUSY)
+		m_xfer_in_flight = 0;	//nothing in flight anymore
+
+	return state;
+}
+
+/*
+ * Blocking version of DMACheckTransfer() for callers which have nothing else to do.
+ * This is bounded by DMA_TIMEOUT_US.
+ *
+ * @param	None
+ *
+ * @return	DMA_XFER_IDLE/DONE/ERROR/TIMEOUT
+ */
+int DMAWaitTransfer( void )
+{
+	int state = DMA_XFER_BUSY;
+
+	while(state == DMA_XFER_BUSY)
+		state = DMACheckTransfer();
+
+	return state;
+}
+
+/*
+ * Getter functions for the DMA health counters
+ */
+unsigned int DMAGetLastErrorBits( void )
+{
+	return m_last_err_bits;
+}
+
+unsigned int DMAGetErrorCount( void )
+{
+	return m_error_count;
+}
+
+unsigned int DMAGetTimeoutCount( void )
+{
+	return m_timeout_count;
+}
+
+#if DMA_SG_MODE
+/*
+ * Set up the driver and the S2MM descriptor ring, point each descriptor at its own
+ *  buffer, then post all of them to the DMA and start the channel.
+ * This resets the DMA, so it is also how we recover after the DMA reports an error.
+ *
+ * @param	None
+ *
+ * @return	XST_SUCCESS/XST_FAILURE
+ */
+int DMASGInit( void )
+{
+	int status = XST_SUCCESS;
+	int iter = 0;
+	XAxiDma_Config *Config;
+	XAxiDma_BdRing *RxRing;
+	XAxiDma_Bd BdTemplate;
+	XAxiDma_Bd *BdPtr;
+	XAxiDma_Bd *BdCurPtr;
+
+	Config = XAxiDma_LookupConfig(XPAR_AXI_DMA_0_DEVICE_ID);
+	if(Config == NULL)
+		return XST_FAILURE;
+	status = XAxiDma_CfgInitialize(&m_axi_dma, Config);
+	if(status != XST_SUCCESS || m_axi_dma.HasSg == 0)
+		return XST_FAILURE;
+
+	RxRing = XAxiDma_GetRxRing(&m_axi_dma);
+	XAxiDma_BdRingIntDisable(RxRing, XAXIDMA_IRQ_ALL_MASK);
+
+	status = XAxiDma_BdRingCreate(RxRing, (UINTPTR)m_bd_space, (UINTPTR)m_bd_space, XAXIDMA_BD_MINIMUM_ALIGNMENT, DMA_SG_RING_DEPTH);
+	if(status != XST_SUCCESS)
+		return XST_FAILURE;
+	XAxiDma_BdClear(&BdTemplate);
+	status = XAxiDma_BdRingClone(RxRing, &BdTemplate);
+	if(status != XST_SUCCESS)
+		return XST_FAILURE;
+
+	status = XAxiDma_BdRingAlloc(RxRing, DMA_SG_RING_DEPTH, &BdPtr);
+	if(status != XST_SUCCESS)
+		return XST_FAILURE;
+	BdCurPtr = BdPtr;
+	for(iter = 0; iter < DMA_SG_RING_DEPTH; iter++)
+	{
+		CacheDMARecvPrepare(DMA_SG_BUFFER_ADDR(iter), DMA_SG_BUFFER_SIZE);
+		XAxiDma_BdSetBufAddr(BdCurPtr, DMA_SG_BUFFER_ADDR(iter));
+		XAxiDma_BdSetLength(BdCurPtr, DMA_SG_BUFFER_SIZE, RxRing->MaxTransferLen);
+		XAxiDma_BdSetCtrl(BdCurPtr, 0);
+		BdCurPtr = (XAxiDma_Bd *)XAxiDma_BdRingNext(RxRing, BdCurPtr);
+	}
+	status = XAxiDma_BdRingToHw(RxRing, DMA_SG_RING_DEPTH, BdPtr);
+	if(status != XST_SUCCESS)
+		return XST_FAILURE;
+
+	//the interrupt handler still acknowledges these, we poll the ring for completions
+	XAxiDma_BdRingIntEnable(RxRing, XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK);
+	status = XAxiDma_BdRingStart(RxRing);
+	if(status != XST_SUCCESS)
+		return XST_FAILURE;
+
+	m_sg_bd = NULL;
+	m_sg_done_first = NULL;
+	m_sg_done_count = 0;
+	m_ring_stalled = 0;
+	m_xfer_in_flight = 0;
+	return XST_SUCCESS;
+}
+
+/*
+ * Start taking the next buffer from the FPGA into the ring. The descriptors are already
+ *  posted, so there is nothing to tell the DMA; this only checks one of them is free for
+ *  the buffer and starts the time out. The caller then connects the FPGA to the DMA.
+ * When every descriptor is waiting on the CPU the FPGA has to hold on to its buffer, this
+ *  is counted once each time it happens rather than once per call.
+ *
+ * @param	None
+ *
+ * @return	XST_SUCCESS if the transfer was started, XST_FAILURE if the ring has no room
+ */
+int DMASGStartTransfer( void )
+{
+	XAxiDma_BdRing *RxRing = XAxiDma_GetRxRing(&m_axi_dma);
+
+	if(RxRing->HwCnt == 0)
+	{
+		if(m_ring_stalled == 0)
+		{
+			m_ring_full_stalls++;
+			m_ring_stalled = 1;
+		}
+		return XST_FAILURE;
+	}
+	m_ring_stalled = 0;
+	m_xfer_in_flight = 1;
+	XTime_GetTime(&m_xfer_start);
+	return XST_SUCCESS;
+}
+
+/*
+ * Non-blocking check on the buffer the FPGA is sending into the ring, the SG version of
+ *  DMACheckTransfer(). Each descriptor the DMA has finished is taken back from it here, as
+ *  soon as it is done, and queued for DMASGGetBuffer(); the caller can then tell the FPGA
+ *  it is done with the buffer while the CPU gets to it in its own time.
+ * The DMA halts on an error, DMASGInit() starts it again.
+ *
+ * @param	None
+ *
+ * @return	DMA_XFER_IDLE/BUSY/DONE/ERROR/TIMEOUT
+ */
+int DMASGCheckTransfer( void )
+{
+	int state = DMA_XFER_BUSY;
+	int num_bds = 0;
+	u32 status = 0;
+	XAxiDma_Bd *BdPtr;
+	XAxiDma_BdRing *RxRing = XAxiDma_GetRxRing(&m_axi_dma);
+	XTime m_current_time;
+
+	if(m_xfer_in_flight == 0)
+		return DMA_XFER_IDLE;
+
+	num_bds = XAxiDma_BdRingFromHw(RxRing, XAXIDMA_ALL_BDS, &BdPtr);
+	if(num_bds > 0)
+	{
+		if(m_sg_done_count == 0)
+			m_sg_done_first = BdPtr;
+		m_sg_done_count += num_bds;
+		if((unsigned int)RxRing->PostCnt > m_ring_high_water)
+			m_ring_high_water = RxRing->PostCnt;
+	}
+
+	status = Xil_In32(DMA_BASEADDR + DMA_S2MM_SR_OFFSET);
+	if(status & DMA_SR_ERR_ALL)
+	{
+		m_last_err_bits = status & DMA_SR_ERR_ALL;
+		m_error_count++;
+		state = DMA_XFER_ERROR;
+	}
+	else if(num_bds > 0)
+		state = DMA_XFER_DONE;
+	else
+	{
+		XTime_GetTime(&m_current_time);
+		if((m_current_time - m_xfer_start) >= ((XTime)DMA_TIMEOUT_US * COUNTS_PER_SECOND / 1000000))
+		{
+			m_last_err_bits = 0;
+			m_timeout_count++;
+			state = DMA_XFER_TIMEOUT;
+		}
+	}
+
+	if(state != DMA_XFER_BUSY)
+		m_xfer_in_flight = 0;
+
+	return state;
+}
+
+/*
+ * Non-blocking check for the next buffer the DMA has filled, oldest first, from those
+ *  DMASGCheckTransfer() has taken back from the DMA. When this returns DMA_XFER_DONE or
+ *  DMA_XFER_ERROR the caller owns the buffer and must give it back with
+ *  DMASGReleaseBuffer() before asking for another one.
+ *
+ * @param	(unsigned int **) Set to the filled buffer
+ *
+ * @return	DMA_XFER_BUSY if nothing is ready, DMA_XFER_DONE/ERROR otherwise
+ */
+int DMASGGetBuffer( unsigned int ** buffer )
+{
+	XAxiDma_BdRing *RxRing = XAxiDma_GetRxRing(&m_axi_dma);
+
+	if(m_sg_bd != NULL || m_sg_done_count == 0)
+		return DMA_XFER_BUSY;	//still holding the last one, or nothing filled
+
+	m_sg_bd = m_sg_done_first;
+	m_sg_done_count--;
+	m_sg_done_first = (m_sg_done_count != 0) ? (XAxiDma_Bd *)XAxiDma_BdRingNext(RxRing, m_sg_bd) : NULL;
+
+	*buffer = (unsigned int *)XAxiDma_BdGetBufAddr(m_sg_bd);
+	//the error was counted when the descriptor came back
+	if(XAxiDma_BdGetSts(m_sg_bd) & XAXIDMA_BD_STS_ALL_ERR_MASK)
+		return DMA_XFER_ERROR;
+	return DMA_XFER_DONE;
+}
+
+/*
+ * Give the buffer we are holding back to the ring. The descriptor is freed and the
+ *  next free descriptor is pointed at the same buffer and posted to the DMA, so the
+ *  ring always has every buffer either in the DMA or with the CPU.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void DMASGReleaseBuffer( void )
+{
+	UINTPTR buf_addr = 0;
+	XAxiDma_Bd *BdPtr;
+	XAxiDma_BdRing *RxRing = XAxiDma_GetRxRing(&m_axi_dma);
+
+	if(m_sg_bd == NULL)
+		return;
+
+	buf_addr = XAxiDma_BdGetBufAddr(m_sg_bd);
+	XAxiDma_BdRingFree(RxRing, 1, m_sg_bd);
+	m_sg_bd = NULL;
+
+	if(XAxiDma_BdRingAlloc(RxRing, 1, &BdPtr) != XST_SUCCESS)
+		return;
+	CacheDMARecvPrepare(buf_addr, DMA_SG_BUFFER_SIZE);
+	XAxiDma_BdSetBufAddr(BdPtr, buf_addr);
+	XAxiDma_BdSetLength(BdPtr, DMA_SG_BUFFER_SIZE, RxRing->MaxTransferLen);
+	XAxiDma_BdSetCtrl(BdPtr, 0);
+	XAxiDma_BdRingToHw(RxRing, 1, BdPtr);
+
+	return;
+}
+
+/*
+ * How many filled buffers are still to be handed out by DMASGGetBuffer(), the one the CPU is
+ *  holding included. Only the descriptors DMASGCheckTransfer() has taken back are counted.
+ *
+ * @param	None
+ *
+ * @return	The number of buffers
+ */
+int DMASGGetFilledCount( void )
+{
+	return m_sg_done_count + (m_sg_bd != NULL);
+}
+
+/*
+ * Getter functions for the descriptor ring counters
+ */
+unsigned int DMAGetRingFullStalls( void )
+{
+	return m_ring_full_stalls;
+}
+
+unsigned int DMAGetRingHighWater( void )
+{
+	return m_ring_high_water;
+}
+#endif
@@ -0,0 +1,104 @@
+/*
+ * AXIDmaControl.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Completion tracking for the AXI DMA S2MM channel which moves the FPGA buffers
+ *  into DRAM. The interrupt handler publishes a sequence number and the error bits
+ *  from the status register, the acquisition loops poll those instead of sleeping.
+ */
+
+#ifndef SRC_AXIDMACONTROL_H_
+#define SRC_AXIDMACONTROL_H_
+
+#include <xil_io.h>
+#include "xparameters.h"
+#include "xtime_l.h"
+#include "xaxidma.h"
+#include "lunah_defines.h"
+#include "CacheControl.h"
+
+//The register block may be pointed somewhere else (ie. a simulated block of memory)
+// by defining DMA_BASEADDR before this header is included
+#ifndef DMA_BASEADDR
+#define DMA_BASEADDR		XPAR_AXI_DMA_0_BASEADDR
+#endif
+
+//S2MM register offsets, see PG021
+#define DMA_S2MM_CR_OFFSET		0x30	//control register
+#define DMA_S2MM_SR_OFFSET		0x34	//status register
+#define DMA_S2MM_DA_OFFSET		0x48	//destination address
+#define DMA_S2MM_LENGTH_OFFSET	0x58	//buffer length, writing this starts the transfer
+
+//S2MM control/status bits
+#define DMA_CR_RUNSTOP		0x00000001
+#define DMA_CR_RESET		0x00000004
+#define DMA_CR_IRQ_ENABLE	0x00005000	//IOC and error interrupts
+#define DMA_SR_HALTED		0x00000001
+#define DMA_SR_ERR_ALL		0x00000770	//internal, slave, decode, and SG errors
+#define DMA_SR_IRQ_IOC		0x00001000
+#define DMA_SR_IRQ_ERR		0x00004000
+
+#define DMA_TARGET_ADDR		0xA000000	//where the FPGA buffers land in DRAM
+#define DMA_TRANSFER_LENGTH	65536		//max bytes requested, FPGA ends the stream after one buffer
+#define DMA_NUM_SLOTS		4			//DRAM slots the transfers rotate through
+#define DMA_SLOT_SIZE		DMA_TRANSFER_LENGTH	//room for a full transfer, keeps every slot cache line aligned
+#define DMA_SLOT_ADDR(n)	(DMA_TARGET_ADDR + (n) * DMA_SLOT_SIZE)
+#define DMA_TIMEOUT_US		1000		//a 16 KiB buffer takes ~54us, give it plenty of room
+#define DMA_RESET_TRIES		1000
+
+/*
+ * Scatter-gather acquisition mode.
+ * Instead of one simple mode transfer at a time, a ring of DMA_SG_RING_DEPTH descriptors
+ *  is kept posted to the DMA, each pointing at its own 16 KiB buffer. The DMA fills them
+ *  in order while the CPU is processing or writing to the SD card, and the CPU hands each
+ *  one back to the ring once it has been processed.
+ * The FPGA is still handed over one buffer at a time, as in simple mode: it is connected
+ *  to the DMA only when it has a valid buffer and a descriptor is free for it, and told it
+ *  is done with the buffer as soon as the descriptor completes, not when the CPU gets to it.
+ * This needs the AXI DMA in the hardware design to be built with the SG engine
+ *  (XPAR_AXI_DMA_0_INCLUDE_SG), the current bitstream uses direct register mode.
+ */
+#ifndef DMA_SG_MODE
+#define DMA_SG_MODE			0
+#endif
+#ifndef DMA_SG_RING_DEPTH
+#define DMA_SG_RING_DEPTH	8			//number of descriptors/buffers in the ring
+#endif
+#define DMA_SG_BUFFER_SIZE	(DATA_BUFFER_SIZE * 4)	//one FPGA buffer, in bytes
+#define DMA_SG_BUFFER_ADDR(n)	(DMA_TARGET_ADDR + (n) * DMA_SG_BUFFER_SIZE)
+
+#if DMA_SG_MODE && !XPAR_AXI_DMA_0_INCLUDE_SG
+#error "DMA_SG_MODE needs the AXI DMA built with the scatter-gather engine"
+#endif
+
+//Transfer states
+#define DMA_XFER_IDLE		0	//nothing in flight
+#define DMA_XFER_BUSY		1	//waiting on the interrupt
+#define DMA_XFER_DONE		2	//completed without errors
+#define DMA_XFER_ERROR		3	//completed, but the DMA reported an error
+#define DMA_XFER_TIMEOUT	4	//no interrupt within the timeout
+
+//function prototypes
+void DMAInit( void );
+void DMAReset( void );
+void DMACompletionISR( void );
+void DMAStartTransfer( unsigned int dest_addr, unsigned int length );
+int DMACheckTransfer( void );
+int DMAWaitTransfer( void );
+unsigned int DMAGetLastErrorBits( void );
+unsigned int DMAGetErrorCount( void );
+unsigned int DMAGetTimeoutCount( void );
+#if DMA_SG_MODE
+int DMASGInit( void );
+int DMASGStartTransfer( void );
+int DMASGCheckTransfer( void );
+int DMASGGetBuffer( unsigned int ** buffer );
+void DMASGReleaseBuffer( void );
+int DMASGGetFilledCount( void );
+unsigned int DMAGetRingFullStalls( void );
+unsigned int DMAGetRingHighWater( void );
+#endif
+
+#endif /* SRC_AXIDMACONTROL_H_ */
@@ -0,0 +1,182 @@
+/*
+ * AsyncSDWrite.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "AsyncSDWrite.h"
+
+static XSdPs_Adma2Descriptor m_descriptors[ASYNC_SD_DESCRIPTORS] __attribute__((aligned(32)));	//the controller reads these, not the driver's table
+static UINTPTR m_base_address;					//the controller of the card set up by AsyncSDInit(), 0 for none
+static u32 m_card_detect;						//whether the controller has a card detect line
+static u8 m_cache_coherent;						//whether the buffers need flushing before the DMA reads them
+static int m_write_pending;						//a write has been started and not yet seen to finish
+static int m_write_result = CMD_SUCCESS;		//how the last one ended, until AsyncSDPoll() reports it
+
+/*
+ * Look at the transfer started by AsyncSDStart(), if there is one. The transfer complete bit
+ *  is only set once the card has programmed the data and let go of the busy line.
+ *
+ * @param	(int) 1 to wait for it to finish, 0 to just look
+ *
+ * @return	None, the write has finished unless m_write_pending is still set
+ */
+static void CheckPendingWrite( int wait )
+{
+	u16 status_reg = 0;
+
+	while(m_write_pending != 0)
+	{
+		status_reg = XSdPs_ReadReg16(m_base_address, XSDPS_NORM_INTR_STS_OFFSET);
+		if((status_reg & XSDPS_INTR_ERR_MASK) != 0)
+		{
+			XSdPs_WriteReg16(m_base_address, XSDPS_ERR_INTR_STS_OFFSET, XSDPS_ERROR_INTR_ALL_MASK);
+			m_write_result = CMD_FAILURE;
+			m_write_pending = 0;
+		}
+		else if((status_reg & XSDPS_INTR_TC_MASK) != 0)
+		{
+			XSdPs_WriteReg16(m_base_address, XSDPS_NORM_INTR_STS_OFFSET, XSDPS_INTR_TC_MASK);
+			m_write_pending = 0;
+		}
+		else if(wait == 0)
+			break;
+	}
+	return;
+}
+
+/*
+ * Set up the writes to one card, which FatFs has already mounted.
+ * Waits for a write which is still going first.
+ *
+ * @param	(BYTE) The drive number, which is also the SD controller's device ID, see diskio.c
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if there is no such controller or the card may be byte addressed
+ */
+int AsyncSDInit( BYTE pdrv )
+{
+	XSdPs_Config * config = NULL;
+	DWORD sector_count = 0;
+
+	CheckPendingWrite(1);
+	m_base_address = 0;
+	config = XSdPs_LookupConfig((u16)pdrv);
+	if(config == NULL)
+		return CMD_FAILURE;
+	if(disk_ioctl(pdrv, GET_SECTOR_COUNT, &sector_count) != RES_OK || sector_count <= ASYNC_SD_MIN_SECTORS)
+		return CMD_FAILURE;
+	m_base_address = config->BaseAddress;
+	m_card_detect = config->CardDetect;
+	m_cache_coherent = config->IsCacheCoherent;
+	return CMD_SUCCESS;
+}
+
+/*
+ * Start writing sectors to the card and return once the card has taken the command, without
+ *  waiting for the data. Waits for a write which is still going first.
+ * The steps are XSdPs_WritePolled()'s and XSdPs_CmdTransfer()'s, up to the command complete.
+ *
+ * @param	(const BYTE *) The data, which must be left alone until the write has finished
+ * @param	(DWORD) The first sector
+ * @param	(UINT) How many sectors, up to ASYNC_SD_MAX_SECTORS
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if the write could not be started, nothing is pending then
+ */
+int AsyncSDStart( const BYTE * buff, DWORD sector, UINT count )
+{
+	u32 present_state = 0;
+	u32 bytes = count * XSDPS_BLK_SIZE_512_MASK;
+	u32 desc_bytes = 0;
+	u32 command = 0;
+	u16 status_reg = 0;
+	int desc = 0;
+
+	CheckPendingWrite(1);
+	if(m_base_address == 0 || count == 0 || count > ASYNC_SD_MAX_SECTORS)
+		return CMD_FAILURE;
+	present_state = XSdPs_ReadReg(m_base_address, XSDPS_PRES_STATE_OFFSET);
+	if(m_card_detect != 0 && (present_state & XSDPS_PSR_CARD_INSRT_MASK) == 0)
+		return CMD_FAILURE;
+	if((present_state & (XSDPS_PSR_INHIBIT_CMD_MASK | XSDPS_PSR_INHIBIT_DAT_MASK)) != 0)
+		return CMD_FAILURE;
+	//the disk layer sets the block size on its first transfer, and setting it here would take a command of our own
+	if((XSdPs_ReadReg16(m_base_address, XSDPS_BLK_SIZE_OFFSET) & XSDPS_BLK_SIZE_MASK) != XSDPS_BLK_SIZE_512_MASK)
+		return CMD_FAILURE;
+
+	//one descriptor for each 64 KiB, a length of 0 is 64 KiB
+	for(desc = 0; bytes != 0; desc++)
+	{
+		desc_bytes = (bytes > XSDPS_DESC_MAX_LENGTH) ? XSDPS_DESC_MAX_LENGTH : bytes;
+		m_descriptors[desc].Address = (u32)(UINTPTR)(buff + desc * XSDPS_DESC_MAX_LENGTH);
+		m_descriptors[desc].Length = (u16)desc_bytes;
+		m_descriptors[desc].Attribute = XSDPS_DESC_TRAN | XSDPS_DESC_VALID;
+		bytes -= desc_bytes;
+	}
+	m_descriptors[desc - 1].Attribute |= XSDPS_DESC_END;
+	if(m_cache_coherent == 0)
+	{
+		Xil_DCacheFlushRange((INTPTR)buff, count * XSDPS_BLK_SIZE_512_MASK);
+		Xil_DCacheFlushRange((INTPTR)m_descriptors, sizeof(m_descriptors));
+	}
+	XSdPs_WriteReg(m_base_address, XSDPS_ADMA_SAR_OFFSET, (u32)(UINTPTR)m_descriptors);
+
+	XSdPs_WriteReg16(m_base_address, XSDPS_BLK_CNT_OFFSET, (u16)count);
+	XSdPs_WriteReg8(m_base_address, XSDPS_TIMEOUT_CTRL_OFFSET, 0xEU);
+	XSdPs_WriteReg(m_base_address, XSDPS_ARGMT_OFFSET, (u32)sector);
+	XSdPs_WriteReg16(m_base_address, XSDPS_NORM_INTR_STS_OFFSET, XSDPS_NORM_INTR_ALL_MASK);
+	XSdPs_WriteReg16(m_base_address, XSDPS_ERR_INTR_STS_OFFSET, XSDPS_ERROR_INTR_ALL_MASK);
+	//what XSdPs_FrameCmd() gives for CMD25, in the top half of the transfer mode register
+	command = ((u32)CMD25 | RESP_R1 | (u32)XSDPS_DAT_PRESENT_SEL_MASK) & 0x3FFFU;
+	XSdPs_WriteReg(m_base_address, XSDPS_XFER_MODE_OFFSET, (command << 16) | XSDPS_TM_AUTO_CMD12_EN_MASK |
+			XSDPS_TM_BLK_CNT_EN_MASK | XSDPS_TM_MUL_SIN_BLK_SEL_MASK | XSDPS_TM_DMA_EN_MASK);
+
+	do
+	{
+		status_reg = XSdPs_ReadReg16(m_base_address, XSDPS_NORM_INTR_STS_OFFSET);
+		if((status_reg & XSDPS_INTR_ERR_MASK) != 0)
+		{
+			XSdPs_WriteReg16(m_base_address, XSDPS_ERR_INTR_STS_OFFSET, XSDPS_ERROR_INTR_ALL_MASK);
+			return CMD_FAILURE;
+		}
+	} while((status_reg & XSDPS_INTR_CC_MASK) == 0);
+	XSdPs_WriteReg16(m_base_address, XSDPS_NORM_INTR_STS_OFFSET, XSDPS_INTR_CC_MASK);
+
+	m_write_pending = 1;
+	return CMD_SUCCESS;
+}
+
+/*
+ * See whether the write started by AsyncSDStart() has finished.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS if it has, or there was none, ASYNC_SD_BUSY if it is still going, CMD_FAILURE
+ * 			if it failed; a failure is reported once, to the first poll after it ended, even if
+ * 			AsyncSDWait() waited it out
+ */
+int AsyncSDPoll( void )
+{
+	int result = CMD_SUCCESS;
+
+	CheckPendingWrite(0);
+	if(m_write_pending != 0)
+		return ASYNC_SD_BUSY;
+	result = m_write_result;
+	m_write_result = CMD_SUCCESS;
+	return result;
+}
+
+/*
+ * Wait for the write started by AsyncSDStart() to finish, before anything else uses the card.
+ *  How it ended is left for AsyncSDPoll().
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void AsyncSDWait( void )
+{
+	CheckPendingWrite(1);
+	return;
+}
@@ -0,0 +1,46 @@
+/*
+ * AsyncSDWrite.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * SD card writes which are started and left to the card, so the CPU can go on while the data
+ *  goes over the bus and the card programs it. Used for the EVT clusters, see EVT_ASYNC_WRITE.
+ *
+ * The write is the ADMA2 multi-block write (CMD25 with auto CMD12) XSdPs_WritePolled() does,
+ *  set up on the controller registers from xsdps_hw.h, with the wait for transfer complete
+ *  left to AsyncSDPoll(). The driver instance belongs to the FatFs disk layer, so nothing here
+ *  resets or reconfigures the controller: the card must already be mounted and have been
+ *  written through FatFs, which leaves the block size at 512.
+ *
+ * The disk layer does not know about these writes. While one is going, any FatFs call on the
+ *  same card must be preceded by AsyncSDWait(), which lets it finish and keeps the result for
+ *  the next AsyncSDPoll(). The buffer must not be changed until the write has finished.
+ *
+ * Only one card, and only a block addressed (SDHC/SDXC) card: a card of ASYNC_SD_MIN_SECTORS
+ *  or fewer may be byte addressed, which the disk layer does not say, so AsyncSDInit() turns
+ *  it down and the caller writes through FatFs.
+ */
+
+#ifndef SRC_ASYNCSDWRITE_H_
+#define SRC_ASYNCSDWRITE_H_
+
+#include "xil_types.h"
+#include "xil_cache.h"
+#include "xsdps.h"
+#include "ff.h"
+#include "diskio.h"
+#include "lunah_defines.h"
+
+#define ASYNC_SD_BUSY			2			//AsyncSDPoll(), the write is still going
+#define ASYNC_SD_DESCRIPTORS	4			//ADMA2 descriptors, XSDPS_DESC_MAX_LENGTH bytes each
+#define ASYNC_SD_MAX_SECTORS	(ASYNC_SD_DESCRIPTORS * XSDPS_DESC_MAX_LENGTH / XSDPS_BLK_SIZE_512_MASK)
+#define ASYNC_SD_MIN_SECTORS	0x800000	//4 GiB, an SDSC card is at most 2 GB but some were made at 4
+
+//function prototypes
+int AsyncSDInit( BYTE pdrv );
+int AsyncSDStart( const BYTE * buff, DWORD sector, UINT count );
+int AsyncSDPoll( void );
+void AsyncSDWait( void );
+
+#endif /* SRC_ASYNCSDWRITE_H_ */
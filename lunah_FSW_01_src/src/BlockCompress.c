@@ -0,0 +1,452 @@
+/*
+ * BlockCompress.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "BlockCompress.h"
+
+#define LZ_MIN_MATCH		4
+#define LZ_LAST_LITERALS	5		//the last bytes of a block are always literals, so the unpacking ends on them
+#define LZ_HASH_BITS		12
+#define RICE_STRIDE			8		//bytes in an EVT record, each byte is taken from the same byte of the record before
+#define RICE_MAX_QUOTIENT	16		//longer than this and the byte goes in as it is, so no byte takes more than 24 bits
+
+typedef struct {
+	const char * name;
+	unsigned int (*pack)( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size );	//0 if it does not fit
+	unsigned int (*unpack)( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size );	//bytes out, 0 for bad data
+} BC_CODEC_TYPE;
+
+static unsigned short m_lz_table[1 << LZ_HASH_BITS];	//where each hash of 4 bytes was last seen in the block
+
+static unsigned int StorePack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	if(in_size > out_size)
+		return 0;
+	memcpy(out, in, in_size);
+	return in_size;
+}
+
+static unsigned int StoreUnpack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	return StorePack(in, in_size, out, out_size);
+}
+
+static unsigned int LZHash( const unsigned char * in )
+{
+	unsigned int value = in[0] | ((unsigned int)in[1] << 8) | ((unsigned int)in[2] << 16) | ((unsigned int)in[3] << 24);
+
+	return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/*
+ * Put the part of a length which does not fit in the token, 255 at a time.
+ */
+static unsigned int LZPutLength( unsigned char * out, unsigned int length )
+{
+	unsigned int bytes = 0;
+
+	while(length >= 255)
+	{
+		out[bytes++] = 255;
+		length -= 255;
+	}
+	out[bytes++] = (unsigned char)length;
+	return bytes;
+}
+
+/*
+ * Put one sequence: the token, the literals, and the match unless this is the last one.
+ *
+ * @return	Bytes put, 0 if they would not fit
+ */
+static unsigned int LZPutSequence( unsigned char * out, unsigned int out_size, const unsigned char * literals, unsigned int num_literals, unsigned int offset, unsigned int match )
+{
+	unsigned int bytes = 1;
+
+	//worst case for the lengths, then the literals and the offset
+	if(1 + num_literals / 255 + 1 + num_literals + 2 + match / 255 + 1 > out_size)
+		return 0;
+	out[0] = (unsigned char)((num_literals >= 15 ? 15 : num_literals) << 4);
+	if(num_literals >= 15)
+		bytes += LZPutLength(&out[bytes], num_literals - 15);
+	memcpy(&out[bytes], literals, num_literals);
+	bytes += num_literals;
+	if(match == 0)
+		return bytes;
+
+	match -= LZ_MIN_MATCH;
+	out[0] |= (unsigned char)(match >= 15 ? 15 : match);
+	out[bytes++] = (unsigned char)offset;
+	out[bytes++] = (unsigned char)(offset >> 8);
+	if(match >= 15)
+		bytes += LZPutLength(&out[bytes], match - 15);
+	return bytes;
+}
+
+static unsigned int LZPack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	unsigned int pos = 0;
+	unsigned int anchor = 0;		//first byte not yet put out
+	unsigned int used = 0;
+	unsigned int bytes = 0;
+	unsigned int hash = 0;
+	unsigned int ref = 0;
+	unsigned int match = 0;
+	unsigned int limit = in_size > LZ_LAST_LITERALS ? in_size - LZ_LAST_LITERALS : 0;	//no match runs past here
+
+	memset(m_lz_table, 0, sizeof(m_lz_table));
+	while(pos + LZ_MIN_MATCH <= limit)
+	{
+		hash = LZHash(&in[pos]);
+		ref = m_lz_table[hash];
+		m_lz_table[hash] = (unsigned short)pos;
+		if(ref >= pos || in[ref] != in[pos] || in[ref + 1] != in[pos + 1] || in[ref + 2] != in[pos + 2] || in[ref + 3] != in[pos + 3])
+		{
+			pos++;
+			continue;
+		}
+
+		match = LZ_MIN_MATCH;
+		while(pos + match < limit && in[ref + match] == in[pos + match])
+			match++;
+		bytes = LZPutSequence(&out[used], out_size - used, &in[anchor], pos - anchor, pos - ref, match);
+		if(bytes == 0)
+			return 0;
+		used += bytes;
+		pos += match;
+		anchor = pos;
+	}
+
+	bytes = LZPutSequence(&out[used], out_size - used, &in[anchor], in_size - anchor, 0, 0);
+	if(bytes == 0)
+		return 0;
+	return used + bytes;
+}
+
+/*
+ * Read the rest of a length which did not fit in the token.
+ *
+ * @return	Bytes read, 0 if it ran past the end
+ */
+static unsigned int LZGetLength( const unsigned char * in, unsigned int in_size, unsigned int * length )
+{
+	unsigned int bytes = 0;
+
+	while(bytes < in_size)
+	{
+		*length += in[bytes];
+		if(in[bytes++] != 255)
+			return bytes;
+	}
+	return 0;
+}
+
+static unsigned int LZUnpack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	unsigned int pos = 0;
+	unsigned int used = 0;
+	unsigned int bytes = 0;
+	unsigned int length = 0;
+	unsigned int offset = 0;
+	unsigned char token = 0;
+
+	while(pos < in_size)
+	{
+		token = in[pos++];
+		length = token >> 4;
+		if(length == 15)
+		{
+			bytes = LZGetLength(&in[pos], in_size - pos, &length);
+			if(bytes == 0)
+				return 0;
+			pos += bytes;
+		}
+		if(length > in_size - pos || length > out_size - used)
+			return 0;
+		memcpy(&out[used], &in[pos], length);
+		pos += length;
+		used += length;
+		if(pos == in_size)
+			return used;	//the last sequence has no match
+
+		if(in_size - pos < 2)
+			return 0;
+		offset = in[pos] | ((unsigned int)in[pos + 1] << 8);
+		pos += 2;
+		length = token & 0x0F;
+		if(length == 15)
+		{
+			bytes = LZGetLength(&in[pos], in_size - pos, &length);
+			if(bytes == 0)
+				return 0;
+			pos += bytes;
+		}
+		length += LZ_MIN_MATCH;
+		if(offset == 0 || offset > used || length > out_size - used)
+			return 0;
+		while(length-- != 0)	//the match may overlap what it is copying
+		{
+			out[used] = out[used - offset];
+			used++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Bit writer/reader for the Rice codec, low bits first.
+ */
+typedef struct {
+	unsigned char * out;
+	unsigned int size;
+	unsigned int used;
+	unsigned int bits;			//waiting to be put out
+	unsigned int num_bits;
+} RICE_WRITER_TYPE;
+
+typedef struct {
+	const unsigned char * in;
+	unsigned int size;
+	unsigned int used;
+	unsigned int bits;
+	unsigned int num_bits;
+} RICE_READER_TYPE;
+
+static int RicePut( RICE_WRITER_TYPE * writer, unsigned int value, unsigned int num_bits )
+{
+	writer->bits |= value << writer->num_bits;
+	writer->num_bits += num_bits;
+	while(writer->num_bits >= 8)
+	{
+		if(writer->used >= writer->size)
+			return 0;
+		writer->out[writer->used++] = (unsigned char)writer->bits;
+		writer->bits >>= 8;
+		writer->num_bits -= 8;
+	}
+	return 1;
+}
+
+static int RiceGet( RICE_READER_TYPE * reader, unsigned int num_bits, unsigned int * value )
+{
+	while(reader->num_bits < num_bits)
+	{
+		if(reader->used >= reader->size)
+			return 0;
+		reader->bits |= (unsigned int)reader->in[reader->used++] << reader->num_bits;
+		reader->num_bits += 8;
+	}
+	*value = reader->bits & ((1u << num_bits) - 1);
+	reader->bits >>= num_bits;
+	reader->num_bits -= num_bits;
+	return 1;
+}
+
+/*
+ * Difference of each byte from the one RICE_STRIDE before it, folded so that small steps
+ *  either way are small numbers: 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+ */
+static unsigned int RiceDelta( const unsigned char * in, unsigned int pos )
+{
+	signed char delta = (signed char)(in[pos] - (pos >= RICE_STRIDE ? in[pos - RICE_STRIDE] : 0));
+
+	return delta >= 0 ? (unsigned int)delta << 1 : ((unsigned int)(-(delta + 1)) << 1) | 1;
+}
+
+static unsigned int RicePack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	unsigned int pos = 0;
+	unsigned int column = 0;
+	unsigned int value = 0;
+	unsigned int quotient = 0;
+	unsigned int sum[RICE_STRIDE] = {0};
+	unsigned int count[RICE_STRIDE] = {0};
+	unsigned int k[RICE_STRIDE] = {0};
+	RICE_WRITER_TYPE writer = { out, out_size, 0, 0, 0 };
+
+	//a k for each column, 2^k near the mean size of the deltas
+	for(pos = 0; pos < in_size; pos++)
+	{
+		sum[pos % RICE_STRIDE] += RiceDelta(in, pos);
+		count[pos % RICE_STRIDE]++;
+	}
+	for(column = 0; column < RICE_STRIDE; column++)
+	{
+		while(k[column] < 7 && (count[column] << (k[column] + 1)) <= sum[column])
+			k[column]++;
+		if(RicePut(&writer, k[column], 4) == 0)
+			return 0;
+	}
+
+	for(pos = 0; pos < in_size; pos++)
+	{
+		column = pos % RICE_STRIDE;
+		value = RiceDelta(in, pos);
+		quotient = value >> k[column];
+		if(quotient < RICE_MAX_QUOTIENT)
+		{
+			//unary quotient, then the low k bits
+			if(RicePut(&writer, (1u << quotient) - 1, quotient + 1) == 0 || RicePut(&writer, value & ((1u << k[column]) - 1), k[column]) == 0)
+				return 0;
+		}
+		else if(RicePut(&writer, (1u << RICE_MAX_QUOTIENT) - 1, RICE_MAX_QUOTIENT) == 0 || RicePut(&writer, value, 8) == 0)
+			return 0;	//the escape, the value as it is
+	}
+	if(writer.num_bits != 0 && RicePut(&writer, 0, 8 - writer.num_bits) == 0)
+		return 0;
+	return writer.used;
+}
+
+static unsigned int RiceUnpack( const unsigned char * in, unsigned int in_size, unsigned char * out, unsigned int out_size )
+{
+	unsigned int pos = 0;
+	unsigned int column = 0;
+	unsigned int value = 0;
+	unsigned int bit = 0;
+	unsigned int quotient = 0;
+	unsigned int k[RICE_STRIDE] = {0};
+	RICE_READER_TYPE reader = { in, in_size, 0, 0, 0 };
+
+	for(column = 0; column < RICE_STRIDE; column++)
+	{
+		if(RiceGet(&reader, 4, &k[column]) == 0 || k[column] > 7)
+			return 0;
+	}
+	for(pos = 0; pos < out_size; pos++)
+	{
+		column = pos % RICE_STRIDE;
+		quotient = 0;
+		do
+		{
+			if(RiceGet(&reader, 1, &bit) == 0)
+				return 0;
+			quotient += bit;
+		}while(bit == 1 && quotient < RICE_MAX_QUOTIENT);
+
+		if(quotient < RICE_MAX_QUOTIENT)
+		{
+			if(RiceGet(&reader, k[column], &value) == 0)
+				return 0;
+			value |= quotient << k[column];
+		}
+		else if(RiceGet(&reader, 8, &value) == 0)
+			return 0;
+		if(value > 255)
+			return 0;
+		value = (value & 1) ? ~(value >> 1) : (value >> 1);	//unfold
+		out[pos] = (unsigned char)(value + (pos >= RICE_STRIDE ? out[pos - RICE_STRIDE] : 0));
+	}
+	if(reader.used != in_size)
+		return 0;
+	return out_size;
+}
+
+static const BC_CODEC_TYPE m_codecs[BC_NUM_CODECS] = {
+	{ "store",	StorePack,	StoreUnpack },	//BC_CODEC_STORE
+	{ "lz",		LZPack,		LZUnpack },		//BC_CODEC_LZ
+	{ "rice",	RicePack,	RiceUnpack },	//BC_CODEC_RICE
+};
+
+/*
+ * Fletcher style check over the header, leaving out the check byte itself.
+ */
+static unsigned char HeaderCheck( const unsigned char * block )
+{
+	unsigned char sum1 = 0;
+	unsigned char sum2 = 0;
+	int iter = 0;
+
+	for(iter = 0; iter < BC_HEADER_SIZE; iter++)
+	{
+		if(iter == 3)
+			continue;
+		sum1 += block[iter];
+		sum2 += sum1;
+	}
+	return (unsigned char)(sum1 ^ sum2);
+}
+
+/*
+ * Pack a block of data behind a block header. Falls back to storing the bytes as they are
+ *  if the codec does not make them any smaller.
+ *
+ * @param	(int) The codec, BC_CODEC_*
+ * @param	(const unsigned char *) The data
+ * @param	(unsigned int) Bytes of data, up to BC_MAX_BLOCK
+ * @param	(unsigned char *) Where to put the block
+ * @param	(unsigned int) Room for the block, at least BC_BOUND() of the data
+ *
+ * @return	Bytes in the block, header included, 0 if there was not room for it
+ */
+unsigned int bcCompress( int codec, const unsigned char * in, unsigned int in_size, unsigned char * block, unsigned int block_size )
+{
+	unsigned int packed = 0;
+
+	if(in_size > BC_MAX_BLOCK || block_size < BC_BOUND(in_size))
+		return 0;
+	if(codec < 0 || codec >= BC_NUM_CODECS)
+		codec = BC_CODEC_STORE;
+	if(codec != BC_CODEC_STORE && in_size > 1)
+		packed = m_codecs[codec].pack(in, in_size, &block[BC_HEADER_SIZE], in_size - 1);
+	if(packed == 0)
+	{
+		codec = BC_CODEC_STORE;
+		packed = StorePack(in, in_size, &block[BC_HEADER_SIZE], in_size);
+	}
+
+	block[0] = BC_MARKER_0;
+	block[1] = BC_MARKER_1;
+	block[2] = (unsigned char)codec;
+	block[4] = (unsigned char)in_size;
+	block[5] = (unsigned char)(in_size >> 8);
+	block[6] = (unsigned char)packed;
+	block[7] = (unsigned char)(packed >> 8);
+	block[3] = HeaderCheck(block);
+	return BC_HEADER_SIZE + packed;
+}
+
+/*
+ * Unpack one block.
+ *
+ * @param	(const unsigned char *) The block, starting at its header
+ * @param	(unsigned int) Bytes available from the start of the block
+ * @param	(unsigned char *) Where to put the data
+ * @param	(unsigned int) Room for the data
+ * @param	(unsigned int *) Set to the number of bytes of data
+ *
+ * @return	Bytes in the block, header included, 0 if it is not a good block or the data does not fit
+ */
+unsigned int bcExpand( const unsigned char * block, unsigned int block_size, unsigned char * out, unsigned int out_size, unsigned int * out_bytes )
+{
+	unsigned int raw = 0;
+	unsigned int packed = 0;
+
+	*out_bytes = 0;
+	if(block_size < BC_HEADER_SIZE || block[0] != BC_MARKER_0 || block[1] != BC_MARKER_1 || block[2] >= BC_NUM_CODECS || block[3] != HeaderCheck(block))
+		return 0;
+	raw = block[4] | ((unsigned int)block[5] << 8);
+	packed = block[6] | ((unsigned int)block[7] << 8);
+	if(packed > block_size - BC_HEADER_SIZE || raw > out_size)
+		return 0;
+	if(m_codecs[block[2]].unpack(&block[BC_HEADER_SIZE], packed, out, raw) != raw)
+		return 0;
+	*out_bytes = raw;
+	return BC_HEADER_SIZE + packed;
+}
+
+/*
+ * Getter function for the name of a codec, for the reports.
+ *
+ * @param	(int) The codec, BC_CODEC_*
+ *
+ * @return	(const char *) The name, "?" for a bad codec number
+ */
+const char * bcCodecName( int codec )
+{
+	if(codec < 0 || codec >= BC_NUM_CODECS)
+		return "?";
+	return m_codecs[codec].name;
+}
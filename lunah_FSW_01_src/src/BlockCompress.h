@@ -0,0 +1,68 @@
+/*
+ * BlockCompress.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Lossless compression of the data files one block at a time, see DATA_COMPRESS.
+ * The writers hand over a block of at most a cluster and get back a header and the packed
+ *  bytes. Each block stands on its own, so a file or a downlink with pieces missing can still
+ *  be expanded from the next good block on.
+ *
+ * Block header, BC_HEADER_SIZE bytes:
+ *  bytes 0-1	BC_MARKER_0, BC_MARKER_1
+ *  byte 2		codec, BC_CODEC_*
+ *  byte 3		Fletcher-8 check of bytes 0-2 and 4-7, so a marker in the data is not taken for a block
+ *  bytes 4-5	bytes in the block before it was packed
+ *  bytes 6-7	bytes after the header
+ *  all little endian.
+ *
+ * The codecs sit in a table, adding one means a pack/unpack pair and a BC_CODEC_* number.
+ *  BC_CODEC_STORE	the bytes as they are
+ *  BC_CODEC_LZ		LZ4 style: a token with the literal and match lengths, the literals, a 2 byte
+ *					 offset back to the match; one hash probe per input byte, so the time taken
+ *					 grows with the block size and never with what is in it
+ *  BC_CODEC_RICE	each byte less the byte 8 before it, the same byte of the previous EVT record,
+ *					 Rice coded with a k for each of the 8 bytes of the record worked out per block;
+ *					 a byte never takes more than 24 bits or a fixed number of steps
+ * A block which does not get smaller is stored instead, a block is never more than
+ *  BC_HEADER_SIZE bytes longer than it started.
+ *
+ * There are no Xilinx headers in here so the same code builds into the ground tools.
+ */
+
+#ifndef SRC_BLOCKCOMPRESS_H_
+#define SRC_BLOCKCOMPRESS_H_
+
+#include <string.h>
+
+//Set to 1 to compress the EVT and CPS files on the way to the SD card
+#ifndef DATA_COMPRESS
+#define DATA_COMPRESS		0
+#endif
+
+//The codecs used when DATA_COMPRESS is on, the EVT records suit the Rice codec and the CPS events the LZ one
+#ifndef EVT_COMPRESS_CODEC
+#define EVT_COMPRESS_CODEC	BC_CODEC_RICE
+#endif
+#ifndef CPS_COMPRESS_CODEC
+#define CPS_COMPRESS_CODEC	BC_CODEC_LZ
+#endif
+
+#define BC_MARKER_0			0xBC
+#define BC_MARKER_1			0x5A
+#define BC_HEADER_SIZE		8
+#define BC_MAX_BLOCK		0xFFFF						//what the header can hold
+#define BC_BOUND(size)		((size) + BC_HEADER_SIZE)	//room needed for a packed block
+
+#define BC_CODEC_STORE		0
+#define BC_CODEC_LZ			1
+#define BC_CODEC_RICE		2
+#define BC_NUM_CODECS		3
+
+//function prototypes
+unsigned int bcCompress( int codec, const unsigned char * in, unsigned int in_size, unsigned char * block, unsigned int block_size );
+unsigned int bcExpand( const unsigned char * block, unsigned int block_size, unsigned char * out, unsigned int out_size, unsigned int * out_bytes );
+const char * bcCodecName( int codec );
+
+#endif /* SRC_BLOCKCOMPRESS_H_ */
@@ -0,0 +1,162 @@
+/*
+ * BlockQueue.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "BlockQueue.h"
+
+/*
+ * Set a queue up empty. Only call this while neither side is using the queue.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ * @param	(unsigned int) Address of depth payloads of block_size bytes each
+ * @param	(unsigned int) Bytes per payload
+ * @param	(unsigned int) Number of blocks, a power of 2 up to BLOCK_QUEUE_MAX_DEPTH
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if the depth is not usable
+ */
+int BlockQueueInit( BLOCK_QUEUE_TYPE * queue, unsigned int pool_addr, unsigned int block_size, unsigned int depth )
+{
+	if(depth == 0 || depth > BLOCK_QUEUE_MAX_DEPTH || (depth & (depth - 1)) != 0)
+		return CMD_FAILURE;
+
+	queue->head = 0;
+	queue->tail = 0;
+	queue->depth = depth;
+	queue->block_size = block_size;
+	queue->pool_addr = pool_addr;
+	queue->full_stalls = 0;
+	queue->high_water = 0;
+	memset(queue->desc, 0, sizeof(queue->desc));
+	return CMD_SUCCESS;
+}
+
+/*
+ * Producer side. Get the payload of the next free block so it can be filled in place.
+ * The block is not visible to the consumer until BlockQueuePublish() is called, and
+ *  until then every call returns the same block.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ *
+ * @return	Pointer to block_size bytes, NULL if the queue is full
+ */
+void * BlockQueueReserve( BLOCK_QUEUE_TYPE * queue )
+{
+	unsigned int head = queue->head;
+
+	if(head - queue->tail >= queue->depth)
+		return NULL;
+	return (void *)(queue->pool_addr + (head & (queue->depth - 1)) * queue->block_size);
+}
+
+/*
+ * Producer side. Hand the block returned by BlockQueueReserve() to the consumer.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ * @param	(unsigned int) Block type, BLOCK_*
+ * @param	(unsigned int) Number of bytes used in the payload
+ * @param	(unsigned int) Extra value for the consumer, depends on the type
+ *
+ * @return	None
+ */
+void BlockQueuePublish( BLOCK_QUEUE_TYPE * queue, unsigned int type, unsigned int length, unsigned int aux )
+{
+	unsigned int head = queue->head;
+	BLOCK_DESC_TYPE * desc = &(queue->desc[head & (queue->depth - 1)]);
+
+	desc->type = type;
+	desc->length = length;
+	desc->aux = aux;
+	desc->seq = head;
+	BLOCK_QUEUE_BARRIER();	//release: payload and descriptor must be out before the new head
+	queue->head = head + 1;
+	if(head + 1 - queue->tail > queue->high_water)
+		queue->high_water = head + 1 - queue->tail;
+	return;
+}
+
+/*
+ * Producer side. Copy a block into the queue, waiting for room if the consumer is behind.
+ * Only use this when the consumer runs on the other core.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ * @param	(unsigned int) Block type, BLOCK_*
+ * @param	(void *) Data to copy, may be NULL for blocks without a payload
+ * @param	(unsigned int) Number of bytes to copy, at most block_size
+ * @param	(unsigned int) Extra value for the consumer, depends on the type
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+int BlockQueueSend( BLOCK_QUEUE_TYPE * queue, unsigned int type, const void * data, unsigned int length, unsigned int aux )
+{
+	void * payload = NULL;
+
+	if(length > queue->block_size)
+		return CMD_FAILURE;
+
+	payload = BlockQueueReserve(queue);
+	if(payload == NULL)
+	{
+		queue->full_stalls++;
+		while(payload == NULL)
+			payload = BlockQueueReserve(queue);
+	}
+	if(data != NULL && length != 0)
+		memcpy(payload, data, length);
+	BlockQueuePublish(queue, type, length, aux);
+	return CMD_SUCCESS;
+}
+
+/*
+ * Consumer side. Look at the oldest block without removing it.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ * @param	(void **) Set to the payload of the block
+ *
+ * @return	The descriptor of the block, NULL if the queue is empty
+ */
+BLOCK_DESC_TYPE * BlockQueuePeek( BLOCK_QUEUE_TYPE * queue, void ** payload )
+{
+	unsigned int tail = queue->tail;
+
+	if(tail == queue->head)
+		return NULL;
+	BLOCK_QUEUE_BARRIER();	//acquire: don't read the block until we have seen the head which published it
+	*payload = (void *)(queue->pool_addr + (tail & (queue->depth - 1)) * queue->block_size);
+	return &(queue->desc[tail & (queue->depth - 1)]);
+}
+
+/*
+ * Consumer side. Give the oldest block back to the producer once we are done with it.
+ *
+ * @param	(BLOCK_QUEUE_TYPE *) The queue
+ *
+ * @return	None
+ */
+void BlockQueueRelease( BLOCK_QUEUE_TYPE * queue )
+{
+	BLOCK_QUEUE_BARRIER();	//finish with the block before the producer can reuse it
+	queue->tail = queue->tail + 1;
+	return;
+}
+
+/*
+ * Getter functions for the queue statistics.
+ * Count is the number of blocks waiting to be consumed right now.
+ */
+unsigned int BlockQueueCount( BLOCK_QUEUE_TYPE * queue )
+{
+	return queue->head - queue->tail;
+}
+
+unsigned int BlockQueueHighWater( BLOCK_QUEUE_TYPE * queue )
+{
+	return queue->high_water;
+}
+
+unsigned int BlockQueueFullStalls( BLOCK_QUEUE_TYPE * queue )
+{
+	return queue->full_stalls;
+}
@@ -0,0 +1,63 @@
+/*
+ * BlockQueue.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Bounded single producer, single consumer queue of fixed size blocks.
+ * The payloads live in a pool the owner hands over, blocks are filled and read in place.
+ * Lock-free: the producer only ever writes head and the consumer only ever writes tail.
+ *  Publishing a block is a release (barrier, then head) and looking at one is an acquire
+ *  (head, then barrier), so the queue also works between the two cores (see AMPControl.h).
+ *
+ * Used for the DAQ pipeline:
+ *  DMA slot --(raw buffer queue)--> ProcessData() --(EVT block queue)--> SD writer
+ */
+
+#ifndef SRC_BLOCKQUEUE_H_
+#define SRC_BLOCKQUEUE_H_
+
+#include <string.h>
+#include "xpseudo_asm.h"
+#include "lunah_defines.h"
+
+#define BLOCK_QUEUE_MAX_DEPTH	16		//depth must be a power of 2 no larger than this
+#define BLOCK_QUEUE_BARRIER()	dmb()
+
+//Block types used by the DAQ queues
+#define BLOCK_RAW			0	//a buffer from the FPGA
+#define BLOCK_EVT			1	//an events buffer, aux holds the first event time
+#define BLOCK_CPS			2	//one CPS event
+#define BLOCK_2DH			3	//one 2DH, aux holds the PMT ID
+#define BLOCK_END			4	//the producer has stopped, nothing follows for this run
+
+typedef struct {
+	unsigned int type;
+	unsigned int length;		//bytes used in the payload
+	unsigned int aux;			//depends on the type
+	unsigned int seq;			//queue index this block was published at
+} BLOCK_DESC_TYPE;
+
+typedef struct {
+	volatile unsigned int head;		//next block to publish, written by the producer only
+	volatile unsigned int tail;		//next block to consume, written by the consumer only
+	unsigned int depth;				//number of blocks, a power of 2
+	unsigned int block_size;		//bytes per payload
+	unsigned int pool_addr;			//where the payloads are
+	unsigned int full_stalls;		//times the producer had a block ready and found the queue full
+	unsigned int high_water;		//most blocks ever waiting
+	BLOCK_DESC_TYPE desc[BLOCK_QUEUE_MAX_DEPTH];
+} BLOCK_QUEUE_TYPE;
+
+//function prototypes
+int BlockQueueInit( BLOCK_QUEUE_TYPE * queue, unsigned int pool_addr, unsigned int block_size, unsigned int depth );
+void * BlockQueueReserve( BLOCK_QUEUE_TYPE * queue );
+void BlockQueuePublish( BLOCK_QUEUE_TYPE * queue, unsigned int type, unsigned int length, unsigned int aux );
+int BlockQueueSend( BLOCK_QUEUE_TYPE * queue, unsigned int type, const void * data, unsigned int length, unsigned int aux );
+BLOCK_DESC_TYPE * BlockQueuePeek( BLOCK_QUEUE_TYPE * queue, void ** payload );
+void BlockQueueRelease( BLOCK_QUEUE_TYPE * queue );
+unsigned int BlockQueueCount( BLOCK_QUEUE_TYPE * queue );
+unsigned int BlockQueueHighWater( BLOCK_QUEUE_TYPE * queue );
+unsigned int BlockQueueFullStalls( BLOCK_QUEUE_TYPE * queue );
+
+#endif /* SRC_BLOCKQUEUE_H_ */
@@ -17,6 +17,25 @@ static unsigned short m_neutrons_ellipse1;		//neutrons with PSD
 static unsigned short m_neutrons_ellipse2;		//neutrons wide cut
 static unsigned short m_events_noPSD;			//all events within an energy range, no PSD cut applied
 static unsigned short m_events_over_threshold;	//count all events which trigger the system
+static float m_cut_params[CPS_CUT_MODULES][CPS_CUT_ELLIPSES][4] = {	//scaleE, scaleP, offsetE, offsetP as set by the user
+		{{1.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f}},
+		{{1.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f}},
+		{{1.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f}},
+		{{1.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f}}
+};
+static float m_ecal_slope = 1.0f;				//energy calibration, keV = slope * energy + intercept
+static float m_ecal_intercept = 0.0f;
+static CPS_CUT_TYPE m_cuts[CPS_CUT_MODULES][CPS_CUT_ELLIPSES];	//compiled from the above, see CompileCut()
+static int m_cuts_compiled;						//0 until the defaults have been compiled
+static unsigned char m_cps_block[CPS_BLOCK_SIZE + CPS_EVENT_SIZE];	//CPS events waiting to be written to the SD card, a cluster and the event which crosses its end
+static unsigned int m_cps_block_bytes;			//bytes in m_cps_block
+static unsigned int m_cps_buffered_total;		//events buffered since CPSInit()
+static unsigned int m_cps_dropped;				//events lost because the block was full
+static unsigned int m_cps_flushes;				//writes to the SD card since CPSInit()
+static XTime m_cps_flush_ticks;					//time spent in those writes
+#if DATA_COMPRESS
+static unsigned char m_cps_packed[BC_BOUND(CPS_BLOCK_SIZE)];	//a block of m_cps_block once it has been compressed
+#endif
 
 //Functions
 /*
@@ -35,6 +54,11 @@ void CPSInit()
 	m_neutrons_ellipse2 = 0;
 	m_events_noPSD = 0;
 	m_events_over_threshold = 0;
+	m_cps_block_bytes = 0;
+	m_cps_buffered_total = 0;
+	m_cps_dropped = 0;
+	m_cps_flushes = 0;
+	m_cps_flush_ticks = 0;
 }
 
 void cpsSetFirstEventTime( unsigned int time )
@@ -91,38 +115,324 @@ bool cpsCheckTime( unsigned int time )
 }
 
 /*
- * Getter function for retrieving the most recent CPS "event". This function
- *  returns a pointer to the struct after updating it with the most up-to-date
- *  information regarding the DAQ run.
+ * Close out a 1 second interval and get its CPS "event". The counters are put in the event,
+ *  then start over for the next interval.
+ * The events are processed a buffer at a time, by which point cpsCheckTime() may have moved
+ *  on past this interval, so the interval start time is passed in rather than read here.
  *
- * @param	None
+ * @param	(unsigned int) The FPGA time the interval started at
  *
  * @return	Pointer to a CPS Event held in a struct
  */
-CPS_EVENT_STRUCT_TYPE * cpsGetEvent( void )
+CPS_EVENT_STRUCT_TYPE * cpsGetEvent( unsigned int interval_time )
 {
 	cpsEvent.event_id = 0xAA;
-	cpsEvent.time_MSB = (unsigned char)(m_previous_1sec_interval_time >> 24);
-	cpsEvent.time_LSB1 = (unsigned char)(m_previous_1sec_interval_time >> 16);
-	cpsEvent.time_LSB2 = (unsigned char)(m_previous_1sec_interval_time >> 8);
-	cpsEvent.time_LSB3 = (unsigned char)(m_previous_1sec_interval_time);
+	cpsEvent.n_wPSD_MSB = (unsigned char)(m_neutrons_ellipse1 >> 8);
+	cpsEvent.n_wPSD_LSB = (unsigned char)(m_neutrons_ellipse1);
+	cpsEvent.n_2cut_MSB = (unsigned char)(m_neutrons_ellipse2 >> 8);
+	cpsEvent.n_2cut_LSB = (unsigned char)(m_neutrons_ellipse2);
+	cpsEvent.n_noPSD_MSB = (unsigned char)(m_events_noPSD >> 8);
+	cpsEvent.n_noPSD_LSB = (unsigned char)(m_events_noPSD);
+	cpsEvent.n_bigE_MSB = (unsigned char)(m_events_over_threshold >> 8);
+	cpsEvent.n_bigE_LSB = (unsigned char)(m_events_over_threshold);
+	cpsEvent.time_MSB = (unsigned char)(interval_time >> 24);
+	cpsEvent.time_LSB1 = (unsigned char)(interval_time >> 16);
+	cpsEvent.time_LSB2 = (unsigned char)(interval_time >> 8);
+	cpsEvent.time_LSB3 = (unsigned char)(interval_time);
 	cpsEvent.modu_temp = (unsigned char)GetModuTemp();
 
+	m_neutrons_ellipse1 = 0;
+	m_neutrons_ellipse2 = 0;
+	m_events_noPSD = 0;
+	m_events_over_threshold = 0;
+
 	return &cpsEvent;
 }
 
+/*
+ * Work out the compiled form of one ellipse from its gates and the energy calibration.
+ * The offsets are the centroid of the ellipse, in calibrated energy and PSD ratio, and the
+ *  scale factors are its half widths in 2DH bins, so the gates can be read off a 2DH.
+ * A scale factor or calibration slope of 0 or less turns the ellipse off.
+ *
+ * @param	(int) Module, 0-3
+ * @param	(int) Ellipse, 0-1
+ *
+ * @return	None
+ */
+static void CompileCut( int module, int ellipse )
+{
+	float * params = m_cut_params[module][ellipse];
+	float e_axis = params[0] * CPS_CUT_E_UNIT;
+	float psd_axis = params[1] * CPS_CUT_PSD_UNIT;
+	CPS_CUT_TYPE * cut = &m_cuts[module][ellipse];
 
-void CPSUpdateTallies(double energy, double psd)
+	if(e_axis <= 0.0f || psd_axis <= 0.0f || m_ecal_slope <= 0.0f)
+	{
+		//u is always 2, so nothing is ever inside
+		cut->e_gain = 0.0f;
+		cut->e_offset = 2.0f;
+		cut->psd_gain = 0.0f;
+		cut->psd_offset = 0.0f;
+		return;
+	}
+	//the centroid is taken back through the calibration to the energy the events have
+	cut->e_gain = 1.0f / e_axis;
+	cut->e_offset = (m_ecal_intercept - params[2]) / (m_ecal_slope * e_axis);
+	cut->psd_gain = 1.0f / psd_axis;
+	cut->psd_offset = -params[3] / psd_axis;
+	return;
+}
+
+static void CompileAllCuts( void )
 {
-	//This will be where to place the neutron cutting algorithm. This function call will increment the
-	// values above which are static. They keep track of the events which are within the neutron cuts.
-	//this will check the current event and see if it passes any of the cuts
-	/*
-	 * unsigned short m_neutrons_ellipse1;		//neutrons with PSD
-	 * unsigned short m_neutrons_ellipse2;		//neutrons wide cut
-	 * unsigned short m_events_noPSD;			//all events within an energy range, no PSD cut applied
-	 * unsigned short m_events_over_threshold;	//count all events which trigger the system
-	 */
+	int module = 0;
+	int ellipse = 0;
 
+	for(module = 0; module < CPS_CUT_MODULES; module++)
+		for(ellipse = 0; ellipse < CPS_CUT_ELLIPSES; ellipse++)
+			CompileCut(module, ellipse);
+	m_cuts_compiled = 1;
 	return;
 }
+
+/*
+ * Set and compile the neutron cut for one module and ellipse, see SetNeutronCutGates().
+ *
+ * @param	(int) Module, 1-4
+ * @param	(int) Ellipse, 1-2
+ * @param	(float) Energy and PSD half widths, in 2DH bins
+ * @param	(float) Energy and PSD centroid, in calibrated energy and PSD ratio
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE for a bad module or ellipse
+ */
+int cpsSetCut( int moduleID, int ellipseNum, float scaleE, float scaleP, float offsetE, float offsetP )
+{
+	float * params = NULL;
+
+	if(moduleID < 1 || moduleID > CPS_CUT_MODULES || ellipseNum < 1 || ellipseNum > CPS_CUT_ELLIPSES)
+		return CMD_FAILURE;
+	if(m_cuts_compiled == 0)
+		CompileAllCuts();
+	params = m_cut_params[moduleID - 1][ellipseNum - 1];
+	params[0] = scaleE;
+	params[1] = scaleP;
+	params[2] = offsetE;
+	params[3] = offsetP;
+	CompileCut(moduleID - 1, ellipseNum - 1);
+	return CMD_SUCCESS;
+}
+
+/*
+ * Set the energy calibration the cuts are applied in and compile every cut again.
+ *
+ * @param	(float) Slope
+ * @param	(float) Intercept
+ *
+ * @return	None
+ */
+void cpsSetEnergyCal( float slope, float intercept )
+{
+	m_ecal_slope = slope;
+	m_ecal_intercept = intercept;
+	CompileAllCuts();
+	return;
+}
+
+/*
+ * Find which CPS counters an event belongs in.
+ * The PSD is passed as a fraction so that there is no division here; with the PSD at
+ *  psd_num / psd_den the ellipse test u^2 + v^2 <= 1 becomes
+ *  (u * psd_den)^2 + (psd_gain * psd_num + psd_offset * psd_den)^2 <= psd_den^2.
+ * Events with more than one PMT are only counted as over threshold.
+ *
+ * @param	(float) The energy of the event, before calibration
+ * @param	(float) PSD ratio numerator
+ * @param	(float) PSD ratio denominator, 0 if the PSD was no good
+ * @param	(unsigned int) The PMT ID bits from the event
+ *
+ * @return	CPS_CUT_* bits
+ */
+unsigned int cpsCutEvent( float energy, float psd_num, float psd_den, unsigned int pmt_ID )
+{
+	unsigned int cut_bits = CPS_CUT_THRESHOLD;
+	int module = 0;
+	int ellipse = 0;
+	float u = 0.0f;
+	float v = 0.0f;
+	float den_sq = psd_den * psd_den;
+	const CPS_CUT_TYPE * cut = NULL;
+
+	switch(pmt_ID)
+	{
+	case 1: module = 0; break;
+	case 2: module = 1; break;
+	case 4: module = 2; break;
+	case 8: module = 3; break;
+	default: return cut_bits;
+	}
+	if(m_cuts_compiled == 0)
+		CompileAllCuts();
+
+	cut = m_cuts[module];
+	u = cut[0].e_gain * energy + cut[0].e_offset;
+	if(u * u <= 1.0f)
+		cut_bits |= CPS_CUT_NO_PSD;
+	if(psd_den > 0.0f)
+	{
+		for(ellipse = 0; ellipse < CPS_CUT_ELLIPSES; ellipse++)
+		{
+			u = cut[ellipse].e_gain * energy + cut[ellipse].e_offset;
+			v = cut[ellipse].psd_gain * psd_num + cut[ellipse].psd_offset * psd_den;
+			if(u * u * den_sq + v * v <= den_sq)
+				cut_bits |= CPS_CUT_ELLIPSE_1 << ellipse;
+		}
+	}
+	return cut_bits;
+}
+
+/*
+ * Count an event in the current 1 second interval. The counters stop at their largest value.
+ *
+ * @param	(unsigned int) CPS_CUT_* bits from cpsCutEvent()
+ *
+ * @return	None
+ */
+void CPSUpdateTallies( unsigned int cut_bits )
+{
+	if((cut_bits & CPS_CUT_ELLIPSE_1) && m_neutrons_ellipse1 != 0xFFFF)
+		m_neutrons_ellipse1++;
+	if((cut_bits & CPS_CUT_ELLIPSE_2) && m_neutrons_ellipse2 != 0xFFFF)
+		m_neutrons_ellipse2++;
+	if((cut_bits & CPS_CUT_NO_PSD) && m_events_noPSD != 0xFFFF)
+		m_events_noPSD++;
+	if((cut_bits & CPS_CUT_THRESHOLD) && m_events_over_threshold != 0xFFFF)
+		m_events_over_threshold++;
+	return;
+}
+
+/*
+ * Add a CPS event to the block in RAM instead of writing it to the SD card right away, so
+ *  that the event processing never waits on the card. The writer empties the block every
+ *  CPS_FLUSH_PERIOD_US with cpsFlushBuffer().
+ *
+ * @param	(CPS_EVENT_STRUCT_TYPE *) The event to copy in
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if the block was full and the event was dropped
+ */
+int cpsBufferEvent( const CPS_EVENT_STRUCT_TYPE * event )
+{
+	if(m_cps_block_bytes + CPS_EVENT_SIZE > sizeof(m_cps_block))
+	{
+		m_cps_dropped++;
+		return CMD_FAILURE;
+	}
+	memcpy(&(m_cps_block[m_cps_block_bytes]), event, CPS_EVENT_SIZE);
+	m_cps_block_bytes += CPS_EVENT_SIZE;
+	m_cps_buffered_total++;
+	return CMD_SUCCESS;
+}
+
+/*
+ * Write the first num_bytes of the CPS block to the CPS file with one write and one sync,
+ *  then move what is left to the front of the block.
+ * The bytes are taken out of the block even if the write fails, so that one bad write can't stop the buffering.
+ * With DATA_COMPRESS the bytes are compressed first, the time for that is in the flush ticks.
+ * The write and sync go through the SD mirror, see SDMirror.h.
+ *
+ * @param	(FIL *) The CPS file
+ *
+ * @param	(unsigned int) How many bytes to write, no more than CPS_BLOCK_SIZE
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int CPSWriteBlock( FIL * cps_file, unsigned int num_bytes )
+{
+	int status = CMD_SUCCESS;
+	unsigned int num_bytes_written = 0;
+	unsigned int num_bytes_out = num_bytes;
+	FRESULT f_res = FR_OK;
+	XTime m_flush_start;
+	XTime m_flush_end;
+
+	XTime_GetTime(&m_flush_start);
+#if DATA_COMPRESS
+	//each write is one block, so the CPS file may be expanded from any block on
+	num_bytes_out = bcCompress(CPS_COMPRESS_CODEC, m_cps_block, num_bytes, m_cps_packed, sizeof(m_cps_packed));
+	f_res = SDMirrorWrite(SD_MIRROR_CPS, cps_file, m_cps_packed, num_bytes_out, &num_bytes_written);
+#else
+	f_res = SDMirrorWrite(SD_MIRROR_CPS, cps_file, (char *)m_cps_block, num_bytes_out, &num_bytes_written);
+#endif
+	if(f_res != FR_OK || num_bytes_written != num_bytes_out)
+	{
+		//TODO:handle error with writing
+		xil_printf("error writing 4\n");
+		status = CMD_FAILURE;
+	}
+	f_res = SDMirrorSync(SD_MIRROR_CPS, cps_file);
+	if(f_res != FR_OK)
+	{
+		//TODO:handle error with writing
+		xil_printf("error writing 5\n");
+		status = CMD_FAILURE;
+	}
+	m_cps_block_bytes -= num_bytes;
+	memmove(m_cps_block, &(m_cps_block[num_bytes]), m_cps_block_bytes);
+	XTime_GetTime(&m_flush_end);
+	m_cps_flush_ticks += m_flush_end - m_flush_start;
+	m_cps_flushes++;
+
+	return status;
+}
+
+/*
+ * Write all of the buffered CPS events to the CPS file and sync it. Called every
+ *  CPS_FLUSH_PERIOD_US during the run, which bounds what a reset can lose, and at the end of
+ *  the run or before the file is closed.
+ * No write crosses a cluster edge: when the events run past the next one, they are written up
+ *  to it first, then the rest. With DATA_COMPRESS a write is no more than CPS_BLOCK_SIZE instead.
+ *
+ * @param	(FIL *) The CPS file
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+int cpsFlushBuffer( FIL * cps_file )
+{
+	int status = CMD_SUCCESS;
+	unsigned int first_bytes = CPS_BLOCK_SIZE;
+
+	if(m_cps_block_bytes == 0)
+		return CMD_SUCCESS;
+	if(cps_file == NULL)
+		return CMD_FAILURE;
+
+#if !DATA_COMPRESS
+	first_bytes -= (unsigned int)(f_tell(cps_file) % CPS_BLOCK_SIZE);
+#endif
+	if(m_cps_block_bytes > first_bytes && CPSWriteBlock(cps_file, first_bytes) != CMD_SUCCESS)
+		status = CMD_FAILURE;
+	if(m_cps_block_bytes != 0 && CPSWriteBlock(cps_file, m_cps_block_bytes) != CMD_SUCCESS)
+		status = CMD_FAILURE;
+
+	return status;
+}
+
+unsigned int cpsGetBufferedEvents( void )
+{
+	return m_cps_buffered_total;
+}
+
+unsigned int cpsGetDroppedEvents( void )
+{
+	return m_cps_dropped;
+}
+
+unsigned int cpsGetFlushCount( void )
+{
+	return m_cps_flushes;
+}
+
+XTime cpsGetFlushTicks( void )
+{
+	return m_cps_flush_ticks;
+}
@@ -10,8 +10,45 @@
 
 #include <stdbool.h>
 #include "lunah_utils.h"	//access to module temp
+#include "BlockCompress.h"
 
 #define CPS_EVENT_SIZE	14
+#define CPS_BLOCK_SIZE	16384							//the CPS events are held in RAM, up to a cluster of them
+#define CPS_BLOCK_EVENTS	(CPS_BLOCK_SIZE / CPS_EVENT_SIZE)	//1170, about 19 minutes of CPS
+
+//How often the buffered CPS events are written and synced, see cpsFlushBuffer(); at 1 event a second
+// a reset loses at most this much of the CPS file
+#ifndef CPS_FLUSH_PERIOD_US
+#define CPS_FLUSH_PERIOD_US	10000000
+#endif
+#if CPS_FLUSH_PERIOD_US > 600000000
+#error "CPS_FLUSH_PERIOD_US must be well under the time it takes to fill the CPS block"
+#endif
+
+//Neutron cuts, see cpsCutEvent()
+#define CPS_CUT_MODULES		4
+#define CPS_CUT_ELLIPSES	2			//1 sigma and 2 sigma, as set by the user
+#define CPS_CUT_E_UNIT		((float)TWODH_ENERGY_MAX / (float)TWODH_X_BINS)	//the energy scale factor is the half width in 2DH bins
+#define CPS_CUT_PSD_UNIT	((float)TWODH_PSD_MAX / (float)TWODH_Y_BINS)	//and the PSD one too
+
+//Which CPS counters an event goes in
+#define CPS_CUT_THRESHOLD	0x01	//every event which triggers the system
+#define CPS_CUT_NO_PSD		0x02	//within the energy range of the 1 sigma ellipse, no PSD cut
+#define CPS_CUT_ELLIPSE_1	0x04	//inside the 1 sigma ellipse
+#define CPS_CUT_ELLIPSE_2	0x08	//inside the 2 sigma ellipse
+
+/*
+ * One neutron ellipse compiled for the event loop. With
+ *  u = e_gain * energy + e_offset and v = psd_gain * psd + psd_offset
+ *  an event is inside the ellipse when u^2 + v^2 <= 1; the energy calibration, centroid,
+ *  and axes are all folded into the four numbers.
+ */
+typedef struct {
+	float e_gain;
+	float e_offset;
+	float psd_gain;
+	float psd_offset;
+} CPS_CUT_TYPE;
 
 typedef struct {
 	unsigned char event_id;
@@ -37,6 +74,15 @@ void cpsSetRecordedTime( unsigned int m_recorded_time );
 unsigned int cpsGetCurrentTime( void );
 float convertToSeconds( unsigned int time );
 bool cpsCheckTime( unsigned int time );
-CPS_EVENT_STRUCT_TYPE * cpsGetEvent( void );
-void CPSUpdateTallies(double energy, double psd);
+CPS_EVENT_STRUCT_TYPE * cpsGetEvent( unsigned int interval_time );
+int cpsSetCut( int moduleID, int ellipseNum, float scaleE, float scaleP, float offsetE, float offsetP );
+void cpsSetEnergyCal( float slope, float intercept );
+unsigned int cpsCutEvent( float energy, float psd_num, float psd_den, unsigned int pmt_ID );
+void CPSUpdateTallies( unsigned int cut_bits );
+int cpsBufferEvent( const CPS_EVENT_STRUCT_TYPE * event );
+int cpsFlushBuffer( FIL * cps_file );
+unsigned int cpsGetBufferedEvents( void );
+unsigned int cpsGetDroppedEvents( void );
+unsigned int cpsGetFlushCount( void );
+XTime cpsGetFlushTicks( void );
 #endif /* SRC_CPSDATAPRODUCT_H_ */
@@ -0,0 +1,38 @@
+/*
+ * CacheControl.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "CacheControl.h"
+
+/*
+ * Put the L1/L2 data caches in the state chosen at build time. This replaces the
+ *  bare Xil_DCacheDisable() call which main() used to make at boot.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void CacheInit( void )
+{
+#if DCACHE_ENABLE
+	Xil_DCacheEnable();
+#else
+	Xil_DCacheDisable();	// Disable the L1/L2 data caches
+#endif
+	return;
+}
+
+/*
+ * Lets the timing reports say which cache mode the numbers were taken in.
+ *
+ * @param	None
+ *
+ * @return	1 if the data caches are on, 0 if not
+ */
+int CacheIsEnabled( void )
+{
+	return DCACHE_ENABLE;
+}
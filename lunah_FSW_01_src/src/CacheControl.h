@@ -0,0 +1,46 @@
+/*
+ * CacheControl.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Cache maintenance for the buffers which hardware writes into behind the CPU's back.
+ * With DCACHE_ENABLE set to 0 (the default) the L1/L2 data caches are turned off at boot
+ *  and these calls compile away. With it set to 1 the caches stay on and only the DMA
+ *  windows are invalidated, at the points below:
+ *
+ *  CacheDMARecvPrepare()	before a buffer is handed to the DMA, so no dirty line in the
+ *  						 window can be evicted on top of the data the DMA writes
+ *  CacheDMARecvComplete()	after the DMA reports the buffer is done, so the CPU does not
+ *  						 read stale (or speculatively fetched) lines
+ *  CacheDMASendPrepare()	before hardware reads a buffer the CPU filled (ie. an SD write)
+ *
+ * The SD driver (XSdPs_ReadPolled/XSdPs_WritePolled) already does its own maintenance
+ *  on the FatFs sector buffers and the ADMA2 descriptor table.
+ */
+
+#ifndef SRC_CACHECONTROL_H_
+#define SRC_CACHECONTROL_H_
+
+#include "xil_types.h"
+#include "xil_cache.h"
+
+#ifndef DCACHE_ENABLE
+#define DCACHE_ENABLE	0
+#endif
+
+//function prototypes
+void CacheInit( void );
+int CacheIsEnabled( void );
+
+#if DCACHE_ENABLE
+#define CacheDMARecvPrepare(addr, len)	Xil_DCacheInvalidateRange((INTPTR)(addr), (u32)(len))
+#define CacheDMARecvComplete(addr, len)	Xil_DCacheInvalidateRange((INTPTR)(addr), (u32)(len))
+#define CacheDMASendPrepare(addr, len)	Xil_DCacheFlushRange((INTPTR)(addr), (u32)(len))
+#else
+#define CacheDMARecvPrepare(addr, len)
+#define CacheDMARecvComplete(addr, len)
+#define CacheDMASendPrepare(addr, len)
+#endif
+
+#endif /* SRC_CACHECONTROL_H_ */
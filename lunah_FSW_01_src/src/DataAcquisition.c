@@ -24,8 +24,63 @@ static FIL m_EVT_file;
 static FIL m_CPS_file;
 static FIL m_2DH_file;
 
-//Data buffer which can hold 4096*4 integers, each buffer holds 512 8-integer events, x4 for four buffers
-static unsigned int data_array[DATA_BUFFER_SIZE * 4];
+//Buffer statistics, the FPGA buffers are processed where the DMA puts them rather than copied out first
+static unsigned int m_buffers_processed;		//buffers processed this run
+static XTime m_copy_ticks_per_buffer;			//what the old word-by-word copy out of DRAM cost per buffer
+static XTime m_process_ticks;					//total time spent in ProcessData() this run
+static XTime m_sd_write_ticks;					//total time spent writing/syncing the EVT buffers this run
+static unsigned int m_sd_bytes_written;			//EVT bytes handed to f_write() this run
+static unsigned int m_evt_record_bytes;			//EVT bytes before they were packed, see EVT_COMPACT_FORMAT
+static XTime m_evt_encode_ticks;				//total time spent packing the EVT records this run
+#if DATA_COMPRESS
+static unsigned char m_evt_packed[BC_BOUND(EVT_DATA_BUFF_SIZE)];	//m_evt_cluster once it has been compressed
+static unsigned int m_compress_bytes;			//EVT bytes handed to the compressor this run
+static XTime m_compress_ticks;					//total time spent compressing the EVT clusters this run
+static unsigned int m_compress_worst;			//the most cycles/byte any one cluster took
+#endif
+
+//EVT file state for the run, kept here so that the events may be written from the single core loop or from the AMP queue
+static int m_write_header;						//write a file header the first time we use a file
+static int m_buffers_written;					//keep track of how many buffers are written, but not synced
+#if EVT_ASYNC_WRITE
+static GENERAL_EVENT_TYPE m_evt_write_blocks[2][EVENT_BUFFER_SIZE] __attribute__((aligned(32)));	//the SD DMA reads these, one is filled while the other is written
+static GENERAL_EVENT_TYPE *m_evt_cluster;		//the one being filled
+#elif SD_MIRROR
+static GENERAL_EVENT_TYPE m_evt_spare_block[EVENT_BUFFER_SIZE];	//filled instead when every mirror block is waiting for the other card
+static GENERAL_EVENT_TYPE *m_evt_cluster;		//the mirror block being filled, see SDMirrorReserve(), or the spare
+#else
+static GENERAL_EVENT_TYPE m_evt_cluster[EVENT_BUFFER_SIZE];	//events waiting to fill a cluster of the EVT file
+#endif
+static unsigned int m_evt_cluster_bytes;		//bytes in m_evt_cluster
+static unsigned int m_evt_first_event_time;		//first event time of the run, for the secondary header
+static char m_write_blank_space_buff[16384];	//padding out to the cluster edge when rolling over
+#if EVT_SET_PREALLOCATE
+static unsigned int m_evt_sets_allocated;		//EVT set files given their clusters up front this run
+static unsigned int m_evt_sets_fragmented;		//of those, the ones whose clusters did not come out in one run
+#endif
+#if EVT_ASYNC_WRITE
+static DWORD m_evt_file_sector;					//first sector of the set file if its clusters are one run, else 0 to write through FatFs
+static DWORD m_evt_async_offset;				//where the DMA writes have got to in the set file, FatFs's file pointer is left behind
+static int m_evt_write_pending;					//a DMA write has been started and not yet seen to finish
+static XTime m_evt_write_started;				//when it was started
+static unsigned int m_async_writes;				//DMA writes finished this run
+static XTime m_async_latency_ticks;				//total time from starting them to seeing them finish
+static XTime m_async_wait_ticks;				//total time spent waiting for one to finish
+#endif
+
+//DAQ pipeline, DMA slot --(m_raw_q)--> ProcessData() --(m_evt_q)--> SD writer
+static int m_dma_state;							//state of the DMA transfer from the FPGA to DRAM
+static int m_raw_q_stalled;						//every DMA slot is waiting to be processed
+static BLOCK_QUEUE_TYPE m_raw_q;				//filled DMA slots waiting to be processed
+static BLOCK_QUEUE_TYPE m_evt_q;				//full EVT blocks waiting to be written
+static BLOCK_QUEUE_TYPE *m_evt_q_ptr;			//where the EVT blocks go, m_evt_q or the queue to CPU0
+static GENERAL_EVENT_TYPE *m_evt_block;			//the EVT block being filled, NULL if none
+static GENERAL_EVENT_TYPE m_evt_pool[DAQ_EVT_QUEUE_DEPTH][EVENT_BUFFER_SIZE];	//payloads for m_evt_q
+#if DAQ_EVENT_GEN && !AMP_CPU0_BUILD
+static XTime m_gen_start;						//when the generator started this run
+static XTime m_gen_end;							//and when it stopped
+static unsigned int m_gen_first_time;			//FPGA time of the first generated event
+#endif
 
 static DATA_FILE_HEADER_TYPE file_header_to_write;	//not declaring this above so we can make it static
 static DATA_FILE_FOOTER_TYPE file_footer_to_write;
@@ -184,8 +239,8 @@ int SetFileName( int ID_number, int run_number, int set_number )
 	daq_run_run_number = run_number;
 	daq_run_set_number = set_number;
 
-	//create a folder for the run //0:/I0000_R0001/
-	bytes_written = snprintf(current_run_folder, 100, "0:/I%04d_R%04d", ID_number, run_number);
+	//create a folder for the run //0:/I0000_R0001/, on SD1 if SD0 has been taken out of use
+	bytes_written = snprintf(current_run_folder, 100, "%d:/I%04d_R%04d", SDMirrorGetActiveCard(), ID_number, run_number);
 	if(bytes_written == 0 || bytes_written != ROOT_DIR_NAME_SIZE + FOLDER_NAME_SIZE)
 		status = CMD_FAILURE;
 
@@ -243,6 +298,96 @@ int DoesFileExist( void )
 	return status;
 }
 
+#if EVT_SET_PREALLOCATE
+/*
+ * Give the EVT set file which was just opened all of its clusters, EVT_SET_FILE_SIZE, and leave
+ *  the file pointer at the top for the headers.
+ * This FatFs has no f_expand(); seeking past the end in write mode stretches the chain instead,
+ *  which only writes the FAT, not the data. As the card is filled front to back the clusters it
+ *  takes are one run; the chain is walked a cluster at a time to check that, and a set file
+ *  whose clusters did not come out in one run is counted and still used.
+ * The FAT and the directory entry are synced here so the writes during the run only touch data.
+ *  The file is cut back to what was written when the footer goes in; a set file left open by a
+ *  reset keeps the full size, with whatever was on the card past the last sync.
+ * A card formatted with clusters other than EVT_DATA_BUFF_SIZE is left to grow as it is
+ *  written, as without EVT_SET_PREALLOCATE, since the writes could not be kept on cluster edges.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if the clusters are the wrong size, the card is full, or the allocation failed
+ */
+static int PreallocateEVTFile( void )
+{
+	DWORD cluster_bytes = (DWORD)m_EVT_file.fs->csize * _MAX_SS;
+	DWORD cluster = 0;
+	int contiguous = 1;
+	FRESULT f_res = FR_OK;
+
+#if EVT_ASYNC_WRITE
+	m_evt_file_sector = 0;
+	m_evt_async_offset = 0;
+#endif
+	if(cluster_bytes != EVT_DATA_BUFF_SIZE)
+		return CMD_FAILURE;
+	//drop any chain the file already had, so the clusters are all taken now
+	f_res = f_lseek(&m_EVT_file, 0);
+	if(f_res == FR_OK)
+		f_res = f_truncate(&m_EVT_file);
+	if(f_res == FR_OK)
+		f_res = f_lseek(&m_EVT_file, EVT_SET_FILE_SIZE);
+	//a full card stops the chain short rather than failing the seek
+	if(f_res == FR_OK && f_tell(&m_EVT_file) != EVT_SET_FILE_SIZE)
+		f_res = FR_DENIED;
+	if(f_res == FR_OK)
+		f_res = f_sync(&m_EVT_file);
+	if(f_res == FR_OK)
+		f_res = f_lseek(&m_EVT_file, 0);
+	for(cluster = 0; f_res == FR_OK && cluster < EVT_SET_FILE_SIZE / EVT_DATA_BUFF_SIZE; cluster++)
+	{
+		//a seek to the end of a cluster leaves clust on it; going forward it follows one link each time
+		f_res = f_lseek(&m_EVT_file, (cluster + 1) * EVT_DATA_BUFF_SIZE);
+		if(m_EVT_file.clust != m_EVT_file.sclust + cluster)
+			contiguous = 0;
+	}
+	if(f_res != FR_OK)
+	{
+		if(f_lseek(&m_EVT_file, 0) == FR_OK)
+			f_truncate(&m_EVT_file);
+		return CMD_FAILURE;
+	}
+	m_evt_sets_allocated++;
+	if(contiguous == 0)
+		m_evt_sets_fragmented++;
+#if EVT_ASYNC_WRITE
+	else if(AsyncSDInit(m_EVT_file.fs->drv) == CMD_SUCCESS)
+		m_evt_file_sector = m_EVT_file.fs->database + (m_EVT_file.sclust - 2) * m_EVT_file.fs->csize;
+#endif
+	f_res = f_lseek(&m_EVT_file, 0);
+	if(f_res != FR_OK)
+		return CMD_FAILURE;
+	return CMD_SUCCESS;
+}
+#endif
+
+/*
+ * Open one of the run's files in the run folder, through the SD mirror so that the other
+ *  card gets a copy.
+ *
+ * @param	(int) SD_MIRROR_*
+ * @param	(FIL *) The file to open
+ * @param	(char *) The file name, one of current_filename_*
+ *
+ * @return	What f_open() returned
+ */
+static FRESULT OpenDAQFile( int stream, FIL * fp, const char * filename )
+{
+	char path[SD_MIRROR_PATH_SIZE];
+
+	//the mirror puts the drive on, the folder is the same on both cards
+	snprintf(path, sizeof(path), "%s/%s", &current_run_folder[2], filename);
+	return SDMirrorOpen(stream, fp, path, FA_OPEN_ALWAYS | FA_WRITE | FA_READ);
+}
+
 /* Creates the data acquisition files for the run requested by the DAQ command.
  * Uses the filenames which are created from the ID number sent with the DAQ
  *  command to open and write the header into the files.
@@ -265,12 +410,18 @@ int CreateDAQFiles( void )
 	int iter = 0;
 	int status = CMD_SUCCESS;
 	uint NumBytesWr;
+	int stream = SD_MIRROR_EVT;
 	FIL *DAQ_file = NULL;
 	FRESULT ffs_res;
 
 	//a blank struct to write into the CPS file //reserves space for later
 	DATA_FILE_SECONDARY_HEADER_TYPE blank_file_secondary_header_to_write = {};
 
+#if EVT_SET_PREALLOCATE
+	m_evt_sets_allocated = 0;
+	m_evt_sets_fragmented = 0;
+#endif
+
 	//gather the header information
 	file_header_to_write.configBuff = *GetConfigBuffer();		//dereference to copy the struct into our local struct
 	//	TODO: check the return was not NULL?
@@ -302,32 +453,44 @@ int CreateDAQFiles( void )
 		case 0:
 			file_to_open = current_filename_EVT;
 			file_header_to_write.FileTypeAPID = 0x77;
+			file_header_to_write.DataFormat = EVT_DATA_FORMAT;
 			DAQ_file = &m_EVT_file;
+			stream = SD_MIRROR_EVT;
 			break;
 		case 1:
 			file_to_open = current_filename_CPS;
 			file_header_to_write.FileTypeAPID = 0x55;
+			file_header_to_write.DataFormat = CPS_DATA_FORMAT;
 			DAQ_file = &m_CPS_file;
+			stream = SD_MIRROR_CPS;
 			break;
 		case 2:
 			file_to_open = current_filename_2DH_1;
 			file_header_to_write.FileTypeAPID = 0x88;
+			file_header_to_write.DataFormat = DATA_FORMAT_RAW;
 			DAQ_file = &m_2DH_file;
+			stream = SD_MIRROR_2DH;
 			break;
 		case 3:
 			file_to_open = current_filename_2DH_2;
 			file_header_to_write.FileTypeAPID = 0x88;
+			file_header_to_write.DataFormat = DATA_FORMAT_RAW;
 			DAQ_file = &m_2DH_file;
+			stream = SD_MIRROR_2DH;
 			break;
 		case 4:
 			file_to_open = current_filename_2DH_3;
 			file_header_to_write.FileTypeAPID = 0x88;
+			file_header_to_write.DataFormat = DATA_FORMAT_RAW;
 			DAQ_file = &m_2DH_file;
+			stream = SD_MIRROR_2DH;
 			break;
 		case 5:
 			file_to_open = current_filename_2DH_4;
 			file_header_to_write.FileTypeAPID = 0x88;
+			file_header_to_write.DataFormat = DATA_FORMAT_RAW;
 			DAQ_file = &m_2DH_file;
+			stream = SD_MIRROR_2DH;
 			break;
 		default:
 			status = CMD_FAILURE;
@@ -335,18 +498,22 @@ int CreateDAQFiles( void )
 		}
 
 		//TODO: do we need to check to see if any of the FILs are NULL? //they should be automatically created when the program starts, but...good practice to check them
-		ffs_res = f_open(DAQ_file, file_to_open, FA_OPEN_ALWAYS | FA_WRITE | FA_READ);
+		ffs_res = OpenDAQFile(stream, DAQ_file, file_to_open);
 		if(ffs_res == FR_OK)
 		{
+#if EVT_SET_PREALLOCATE
+			if(iter == 0 && PreallocateEVTFile() != CMD_SUCCESS)
+				xil_printf("18 error allocating EVT DAQ\n");	//the file still grows as it is written
+#endif
 			ffs_res = f_lseek(DAQ_file, 0);
 			if(ffs_res == FR_OK)
 			{
-				ffs_res = f_write(DAQ_file, &file_header_to_write, sizeof(file_header_to_write), &NumBytesWr);
+				ffs_res = SDMirrorWrite(stream, DAQ_file, &file_header_to_write, sizeof(file_header_to_write), &NumBytesWr);
 				if(ffs_res == FR_OK && NumBytesWr == sizeof(file_header_to_write))
 				{
 					if(iter == 1)	//this is for CPS files only
 					{
-						ffs_res = f_write(DAQ_file, &blank_file_secondary_header_to_write, sizeof(blank_file_secondary_header_to_write), &NumBytesWr);
+						ffs_res = SDMirrorWrite(stream, DAQ_file, &blank_file_secondary_header_to_write, sizeof(blank_file_secondary_header_to_write), &NumBytesWr);
 						if(ffs_res == FR_OK)
 							status = CMD_SUCCESS;
 						else
@@ -354,7 +521,7 @@ int CreateDAQFiles( void )
 					}
 					if(iter < 2)	//sync the EVT, CPS files
 					{
-						ffs_res = f_sync(DAQ_file);
+						ffs_res = SDMirrorSync(stream, DAQ_file);
 						if(ffs_res == FR_OK)
 							status = CMD_SUCCESS;
 						else
@@ -362,7 +529,7 @@ int CreateDAQFiles( void )
 					}
 					else
 					{
-						f_close(DAQ_file);
+						SDMirrorClose(stream, DAQ_file);
 						status = CMD_SUCCESS;
 					}
 				}
@@ -440,11 +607,1197 @@ void ClearBRAMBuffers( void )
 	Xil_Out32(XPAR_AXI_GPIO_9_BASEADDR,0);
 }
 
+#if !AMP_CPU0_BUILD
+/*
+ * Time how long the old path took to pull one buffer out of DRAM word-by-word
+ *  with Xil_In32() before processing it. Buffers are now processed in place, so
+ *  this cost is what we save per buffer. Uses two of the (empty) DMA slots.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void MeasureCopyCost( void )
+{
+	unsigned int *copy_to = (unsigned int *)DMA_SLOT_ADDR(1);
+	unsigned int dram_addr = DMA_SLOT_ADDR(0);
+	int array_index = 0;
+	XTime m_copy_start;
+	XTime m_copy_end;
+
+	XTime_GetTime(&m_copy_start);
+	for(array_index = 0; array_index < DATA_BUFFER_SIZE; array_index++)
+	{
+		copy_to[array_index] = Xil_In32(dram_addr);
+		dram_addr += 4;
+	}
+	XTime_GetTime(&m_copy_end);
+	m_copy_ticks_per_buffer = m_copy_end - m_copy_start;
+
+	return;
+}
+#endif
+
+/*
+ * Getter functions for the buffer statistics from the most recent DAQ run.
+ * Times are in XTime counts, COUNTS_PER_SECOND converts them.
+ *
+ * GetDAQCopyTicksSaved() is the copy cost measured at the start of the run times the
+ *  number of buffers processed, ie. the CPU time not spent copying buffers.
+ */
+unsigned int GetDAQBuffersProcessed( void )
+{
+	return m_buffers_processed;
+}
+
+XTime GetDAQProcessTicks( void )
+{
+	return m_process_ticks;
+}
+
+XTime GetDAQCopyTicksPerBuffer( void )
+{
+	return m_copy_ticks_per_buffer;
+}
+
+XTime GetDAQCopyTicksSaved( void )
+{
+	return m_copy_ticks_per_buffer * m_buffers_processed;
+}
+
+XTime GetDAQSDWriteTicks( void )
+{
+	return m_sd_write_ticks;
+}
+
+unsigned int GetDAQSDBytesWritten( void )
+{
+	return m_sd_bytes_written;
+}
+
+/*
+ * Getter function for the queues between the DAQ pipeline stages, so that their depth,
+ *  high-water mark, and stalls can be reported (see BlockQueue.h).
+ * In the AMP build the EVT queue is the one to CPU0.
+ *
+ * @param	(integer) DAQ_QUEUE_RAW or DAQ_QUEUE_EVT
+ *
+ * @return	Pointer to the queue, NULL if there is no such queue
+ */
+BLOCK_QUEUE_TYPE * GetDAQQueue( int queue_ID )
+{
+	switch(queue_ID)
+	{
+	case DAQ_QUEUE_RAW:
+		return &m_raw_q;
+	case DAQ_QUEUE_EVT:
+#if AMP_CPU0_BUILD
+		return &(AMPGetShared()->data_q);
+#else
+		return &m_evt_q;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Send the DAQ diagnostic packet (APID_DIAG). The fields are laid out like the SOH packet's,
+ *  see PutPacketField(), in this order:
+ *  local time (s),
+ *  raw queue depth, high-water mark, and full stalls,
+ *  EVT queue depth, high-water mark, and full stalls,
+ *  DMA descriptor ring high-water mark and overruns (0 without DAQ_DMA_RING),
+ *  CPS events dropped because the CPS block was full, see cpsBufferEvent().
+ * The high-water marks, stalls, and drops are for the run so far.
+ * In the AMP build the EVT queue is the one from CPU1, and the raw queue and ring are CPU1's
+ *  and read 0 here.
+ *
+ * @param	(XUartPs) UART instance to send on
+ *
+ * @return	CMD_SUCCESS
+ */
+int reportDAQDiag( XUartPs Uart_PS )
+{
+	unsigned char report_buff[DIAG_PACKET_LENGTH + CCSDS_HEADER_FULL] = "";
+	BLOCK_QUEUE_TYPE * raw_q = GetDAQQueue(DAQ_QUEUE_RAW);
+	BLOCK_QUEUE_TYPE * evt_q = GetDAQQueue(DAQ_QUEUE_EVT);
+	int index = CCSDS_HEADER_FULL;
+	int sent = 0;
+
+	index = PutPacketField(report_buff, index, (unsigned int)GetLocalTime());
+	index = PutPacketField(report_buff, index, BlockQueueCount(raw_q));
+	index = PutPacketField(report_buff, index, BlockQueueHighWater(raw_q));
+	index = PutPacketField(report_buff, index, BlockQueueFullStalls(raw_q));
+	index = PutPacketField(report_buff, index, BlockQueueCount(evt_q));
+	index = PutPacketField(report_buff, index, BlockQueueHighWater(evt_q));
+	index = PutPacketField(report_buff, index, BlockQueueFullStalls(evt_q));
+#if DAQ_DMA_RING
+	index = PutPacketField(report_buff, index, DMAGetRingHighWater());
+	index = PutPacketField(report_buff, index, DMAGetRingFullStalls());
+#else
+	index = PutPacketField(report_buff, index, 0);
+	index = PutPacketField(report_buff, index, 0);
+#endif
+	index = PutPacketField(report_buff, index, cpsGetDroppedEvents());
+	report_buff[index - 1] = NEWLINE_CHAR_CODE;	//the last field ends the line
+
+	PutCCSDSHeader(report_buff, APID_DIAG, GF_UNSEG_PACKET, 1, DIAG_PACKET_LENGTH);
+	CalculateChecksums(report_buff);
+
+	//with the SOH packet still in the UART FIFO, this may be more than it has room for
+	while(sent < DIAG_PACKET_LENGTH + CCSDS_HEADER_FULL)
+		sent += XUartPs_Send(&Uart_PS, &(report_buff[sent]), DIAG_PACKET_LENGTH + CCSDS_HEADER_FULL - sent);
+
+	return CMD_SUCCESS;
+}
+
+#if DAQ_REPORT_TIMING
+/*
+ * Print the buffer statistics for the run which just ended so that builds with the
+ *  data caches on and off (DCACHE_ENABLE) can be compared on the bench.
+ * xil_printf() has no 64-bit support, times are printed in microseconds.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void ReportDAQTiming( void )
+{
+	unsigned int process_us = (unsigned int)(m_process_ticks / (COUNTS_PER_SECOND / 1000000));
+	unsigned int copy_us = (unsigned int)(m_copy_ticks_per_buffer / (COUNTS_PER_SECOND / 1000000));
+	unsigned int sd_us = (unsigned int)(m_sd_write_ticks / (COUNTS_PER_SECOND / 1000000));
+#if EVT_COMPACT_FORMAT && DATA_COMPRESS
+	unsigned int packed_bytes = m_compress_bytes;	//what the events were packed into before the compression
+#elif EVT_COMPACT_FORMAT
+	unsigned int packed_bytes = m_sd_bytes_written;
+#endif
+#if DAQ_EVENT_GEN && !AMP_CPU0_BUILD
+	unsigned int gen_us = (unsigned int)((m_gen_end - m_gen_start) / (COUNTS_PER_SECOND / 1000000));
+#endif
+#if EVT_ASYNC_WRITE
+	unsigned int async_us = (unsigned int)(m_async_latency_ticks / (COUNTS_PER_SECOND / 1000000));
+#endif
+
+	xil_printf("DAQ timing, dcache %d\n", CacheIsEnabled());
+	xil_printf("buffers %d, process %d us, %d us/buffer, copy %d us/buffer\n", m_buffers_processed, process_us, m_buffers_processed ? process_us / m_buffers_processed : 0, copy_us);
+	//the global timer runs at half the CPU clock
+	xil_printf("events %d, %d cycles/event, fixed point fallbacks %d\n", GetProcessedEvents(), GetProcessedEvents() ? (unsigned int)(m_process_ticks * 2 / GetProcessedEvents()) : 0, GetFixedPointFallbacks());
+	xil_printf("scan %d us/buffer, %d markers/buffer\n", m_buffers_processed ? (unsigned int)(GetPrescanTicks() / (COUNTS_PER_SECOND / 1000000)) / m_buffers_processed : 0, m_buffers_processed ? GetPrescanMarkers() / m_buffers_processed : 0);
+	if(GetProcessedEvents() != 0)
+		xil_printf("extract %d, compute %d, encode %d cycles/event\n", (unsigned int)(GetProcessPassTicks(PROCESS_PASS_EXTRACT) * 2 / GetProcessedEvents()), (unsigned int)(GetProcessPassTicks(PROCESS_PASS_COMPUTE) * 2 / GetProcessedEvents()), (unsigned int)(GetProcessPassTicks(PROCESS_PASS_ENCODE) * 2 / GetProcessedEvents()));
+#if EVT_COMPACT_FORMAT
+	//the packed bytes include the padding at the end of each cluster
+	if(packed_bytes != 0 && m_evt_record_bytes != 0)
+		xil_printf("EVT compact %d bytes from %d, ratio %d.%02d, encode %d cycles/event\n", packed_bytes, m_evt_record_bytes,
+				m_evt_record_bytes / packed_bytes, (unsigned int)((unsigned long long)m_evt_record_bytes * 100 / packed_bytes % 100),
+				(unsigned int)(m_evt_encode_ticks * 2 / (m_evt_record_bytes / sizeof(GENERAL_EVENT_TYPE))));
+#endif
+#if DATA_COMPRESS
+	if(m_sd_bytes_written != 0 && m_compress_bytes != 0)
+		xil_printf("EVT %s %d bytes to %d, ratio %d.%02d, %d cycles/byte, worst cluster %d cycles/byte\n", bcCodecName(EVT_COMPRESS_CODEC),
+				m_compress_bytes, m_sd_bytes_written, m_compress_bytes / m_sd_bytes_written, (unsigned int)((unsigned long long)m_compress_bytes * 100 / m_sd_bytes_written % 100),
+				(unsigned int)(m_compress_ticks * 2 / m_compress_bytes), m_compress_worst);
+#endif
+#if EVT_SET_PREALLOCATE
+	xil_printf("EVT sets %d preallocated, %d fragmented\n", m_evt_sets_allocated, m_evt_sets_fragmented);
+#endif
+#if EVT_ASYNC_WRITE
+	//the SD time below is then only what the writer was held up for, the card time is start to finish
+	if(m_async_writes != 0)
+		xil_printf("SD async %d writes, %d us/write start to finish, %d KiB/s card, %d us waiting\n", m_async_writes, async_us / m_async_writes,
+				async_us ? (unsigned int)(((unsigned long long)m_async_writes * EVT_DATA_BUFF_SIZE * 1000000 / 1024) / async_us) : 0,
+				(unsigned int)(m_async_wait_ticks / (COUNTS_PER_SECOND / 1000000)));
+#endif
+	xil_printf("SD %d bytes, %d us, %d KiB/s\n", m_sd_bytes_written, sd_us, sd_us ? (unsigned int)(((unsigned long long)m_sd_bytes_written * 1000000 / 1024) / sd_us) : 0);
+	SDMirrorReport();
+	LogFileReport();
+	//each CPS event used to be written and synced on its own from the processing
+	xil_printf("CPS %d events, %d dropped, %d flushes, %d us off the processing path\n", cpsGetBufferedEvents(), cpsGetDroppedEvents(), cpsGetFlushCount(), (unsigned int)(cpsGetFlushTicks() / (COUNTS_PER_SECOND / 1000000)));
+#if DAQ_EVENT_GEN && !AMP_CPU0_BUILD
+	//unpaced, the rate the events were taken at is the most the whole pipeline can take
+	xil_printf("event gen %d events, %d damaged, %d us, %d events/s\n", EventGenGetEvents(), EventGenGetDamaged(), gen_us,
+			gen_us ? (unsigned int)((unsigned long long)EventGenGetEvents() * 1000000 / gen_us) : 0);
+#endif
+#if DAQ_DMA_RING
+	//the ring takes the place of the raw queue
+	xil_printf("DMA ring high %d overruns %d\n", DMAGetRingHighWater(), DMAGetRingFullStalls());
+#endif
+	xil_printf("raw queue high %d stalls %d, evt queue high %d stalls %d\n", BlockQueueHighWater(GetDAQQueue(DAQ_QUEUE_RAW)), BlockQueueFullStalls(GetDAQQueue(DAQ_QUEUE_RAW)), BlockQueueHighWater(GetDAQQueue(DAQ_QUEUE_EVT)), BlockQueueFullStalls(GetDAQQueue(DAQ_QUEUE_EVT)));
+	return;
+}
+#endif
+
+#if !AMP_CPU0_BUILD
+/*
+ * Get the pipeline ready for a run: empty queues, the DMA ready to move buffers, and
+ *  the per-run statistics cleared.
+ * The EVT blocks go to the SD writer through m_evt_q on a single core, or straight into
+ *  the queue to CPU0 in the AMP build.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void StartPipeline( void )
+{
+#if DAQ_EVENT_GEN
+	EVENT_GEN_CONFIG_TYPE gen_config;
+
+#endif
+	BlockQueueInit(&m_raw_q, DMA_TARGET_ADDR, DMA_SLOT_SIZE, DMA_NUM_SLOTS);
+#if AMP_CPU1_BUILD
+	m_evt_q_ptr = &(AMPGetShared()->data_q);
+#else
+	BlockQueueInit(&m_evt_q, (unsigned int)m_evt_pool, EVT_DATA_BUFF_SIZE, DAQ_EVT_QUEUE_DEPTH);
+	m_evt_q_ptr = &m_evt_q;
+#endif
+	m_evt_block = NULL;
+	m_raw_q_stalled = 0;
+	ResetProcessStats();
+	ResetBaselines();
+	SetEVTsBufferAddress(NULL);
+	ResetEVTsIterator();
+	ClearBRAMBuffers();
+	MeasureCopyCost();
+	m_buffers_processed = 0;
+	m_process_ticks = 0;
+	m_dma_state = DMA_XFER_IDLE;
+#if DAQ_EVENT_GEN
+	//the same events every run, so runs with different builds can be compared
+	EventGenDefaultConfig(&gen_config);
+	EventGenInit(&gen_config, 1);
+	m_gen_first_time = EventGenGetTime();
+	XTime_GetTime(&m_gen_start);
+	m_gen_end = m_gen_start;
+#endif
+#if DAQ_DMA_RING
+	//post the whole descriptor ring, the FPGA is connected to it a buffer at a time
+	if(DMASGInit() != XST_SUCCESS)
+		xil_printf("14 DMA ring init DAQ\n");
+#endif
+	return;
+}
+
+/*
+ * First stage of the pipeline, non-blocking. Publishes the buffer the DMA has finished
+ *  with to the raw buffer queue and starts the next transfer into the next free slot,
+ *  so the next buffer lands while the others are waiting to be processed.
+ * When every slot is waiting to be processed the FPGA is left holding its data until
+ *  one frees up.
+ * In SG mode the descriptor ring is this stage's queue: the FPGA is handed over to it in
+ *  the same way, but a buffer only needs a free descriptor, and is released to the FPGA
+ *  as soon as the descriptor completes while the CPU picks it up from the ring later.
+ * With DAQ_EVENT_GEN the generator fills each free slot in place of the DMA.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void AcquireStage( void )
+{
+#if DAQ_EVENT_GEN
+	void *slot = NULL;
+#if DAQ_EVENT_GEN_PACED
+	XTime now;
+
+	//hold each buffer back until the FPGA would have filled the one before it
+	XTime_GetTime(&now);
+	if(now - m_gen_start < (XTime)(EventGenGetTime() - m_gen_first_time) * (COUNTS_PER_SECOND / 1000000) * 262144 / 1000)
+		return;
+#endif
+	slot = BlockQueueReserve(&m_raw_q);
+	if(slot == NULL)
+	{
+		if(m_raw_q_stalled == 0)
+		{
+			m_raw_q.full_stalls++;
+			m_raw_q_stalled = 1;
+		}
+		return;
+	}
+	EventGenFillBuffer((unsigned int *)slot);
+	//ParseStage() invalidates the slot as if the DMA had written it, so the CPU's writes go out first
+	CacheDMASendPrepare(slot, DATA_BUFFER_SIZE * 4);
+	BlockQueuePublish(&m_raw_q, BLOCK_RAW, DATA_BUFFER_SIZE * 4, 0);
+	m_raw_q_stalled = 0;
+#elif DAQ_DMA_RING
+	int valid_data = 0;			//goes high/low if there is valid data within the FPGA buffers
+
+	//the descriptor the buffer went into is taken back from the DMA here, as soon as it completes
+	m_dma_state = DMASGCheckTransfer();
+	if(m_dma_state != DMA_XFER_IDLE && m_dma_state != DMA_XFER_BUSY)
+	{
+		Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
+
+		ClearBRAMBuffers();	//tell the FPGA we are done with this buffer
+
+		if(m_dma_state != DMA_XFER_DONE)
+		{
+			//the DMA halts on an error, rebuild the ring; the buffers not yet processed are dropped
+			xil_printf("13 DMA error DAQ %x\n", DMAGetLastErrorBits());
+			if(DMASGInit() != XST_SUCCESS)
+				xil_printf("14 DMA ring init DAQ\n");
+		}
+		m_dma_state = DMA_XFER_IDLE;
+	}
+
+	if(m_dma_state == DMA_XFER_IDLE)
+	{
+		//bit set high (1) when there is at least one valid (full) buffer of data in the FPGA
+		valid_data = Xil_In32 (XPAR_AXI_GPIO_11_BASEADDR);
+		if(valid_data == 1 && DMASGStartTransfer() == XST_SUCCESS)
+		{
+			//init/start MUX to transfer data between integrator modules and the DMA
+			Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 1);
+			m_dma_state = DMA_XFER_BUSY;
+		}
+	}
+#else
+	int valid_data = 0;			//goes high/low if there is valid data within the FPGA buffers
+	void *slot = NULL;
+
+	//the interrupt handler tells us when the transfer is finished
+	m_dma_state = DMACheckTransfer();
+	if(m_dma_state != DMA_XFER_IDLE && m_dma_state != DMA_XFER_BUSY)
+	{
+		Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
+
+		ClearBRAMBuffers();
+
+		if(m_dma_state == DMA_XFER_DONE)
+			BlockQueuePublish(&m_raw_q, BLOCK_RAW, DATA_BUFFER_SIZE * 4, 0);
+		else
+		{
+			//the buffer is bad or incomplete, drop it (the slot is reused) and get the DMA running again
+			xil_printf("13 DMA error DAQ %x\n", DMAGetLastErrorBits());
+			DMAReset();
+		}
+		m_dma_state = DMA_XFER_IDLE;
+	}
+
+	//only start a new transfer when the DMA is not busy with the last one
+	if(m_dma_state == DMA_XFER_IDLE)
+	{
+		//check the FPGA to see if there is valid data in the buffers
+		//bit set high (1) when there is at least one valid (full) buffer of data in the FPGA
+		valid_data = Xil_In32 (XPAR_AXI_GPIO_11_BASEADDR);
+		if(valid_data == 1)
+		{
+			slot = BlockQueueReserve(&m_raw_q);
+			if(slot != NULL)
+			{
+				//init/start MUX to transfer data between integrator modules and the DMA
+				Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 1);
+				DMAStartTransfer((unsigned int)slot, DMA_TRANSFER_LENGTH);
+				m_dma_state = DMA_XFER_BUSY;
+				m_raw_q_stalled = 0;
+			}
+			else if(m_raw_q_stalled == 0)
+			{
+				m_raw_q.full_stalls++;	//count each time processing falls behind, not each poll
+				m_raw_q_stalled = 1;
+			}
+		}
+	}
+#endif
+	return;
+}
+
+/*
+ * Hand the EVT block being filled to the writer, with however many events are in it.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void PublishEVTBlock( void )
+{
+	if(m_evt_block == NULL)
+		return;
+	//an empty block is just left reserved for the next run
+	if(GetEVTsIterator() != 0)
+		BlockQueuePublish(m_evt_q_ptr, BLOCK_EVT, GetEVTsIterator() * sizeof(GENERAL_EVENT_TYPE), GetFirstEventTime());
+	SetEVTsBufferAddress(NULL);
+	m_evt_block = NULL;
+	return;
+}
+
+/*
+ * Second stage of the pipeline. Processes the oldest raw buffer right where the DMA put
+ *  it, writing the events straight into an EVT block. The block is published to the writer,
+ *  with the length of the events in it, once it might not have room for another buffer's
+ *  worth, so ProcessData() never runs out of room part way through a buffer.
+ * Nothing is processed while there is no free EVT block, the raw buffers wait instead.
+ *
+ * @param	None
+ *
+ * @return	1 if a buffer was processed, 0 if not
+ */
+static int ParseStage( void )
+{
+	unsigned int *process_buffer = NULL;	//a finished buffer waiting to be processed
+#if DAQ_DMA_RING
+	int buffer_state = DMA_XFER_BUSY;		//what the DMA made of the buffer
+#else
+	void *payload = NULL;
+#endif
+	XTime m_process_start;		//timing variable
+	XTime m_process_end;		//timing variable
+
+	if(m_evt_block == NULL)
+	{
+		m_evt_block = (GENERAL_EVENT_TYPE *)BlockQueueReserve(m_evt_q_ptr);
+		if(m_evt_block == NULL)
+			return 0;
+		SetEVTsBufferAddress(m_evt_block);
+		ResetEVTsIterator();	//only the events written are passed on, so there is no need to clear the block
+	}
+
+#if DAQ_DMA_RING
+	//pick up the oldest buffer the DMA has filled, the FPGA was released from it when it completed
+	buffer_state = DMASGGetBuffer(&process_buffer);
+	if(buffer_state == DMA_XFER_BUSY)
+		return 0;
+	if(buffer_state != DMA_XFER_DONE)
+	{
+		//a descriptor with an error has its buffer dropped, AcquireStage() restarts the DMA
+		DMASGReleaseBuffer();
+		return 0;
+	}
+#else
+	if(BlockQueuePeek(&m_raw_q, &payload) == NULL)
+		return 0;
+	process_buffer = (unsigned int *)payload;
+#endif
+
+	CacheDMARecvComplete(process_buffer, DATA_BUFFER_SIZE * 4);
+	XTime_GetTime(&m_process_start);
+	ProcessData( process_buffer );
+	XTime_GetTime(&m_process_end);
+	m_process_ticks += m_process_end - m_process_start;
+	m_buffers_processed++;
+#if DAQ_DMA_RING
+	DMASGReleaseBuffer();	//post it back to the DMA
+#else
+	BlockQueueRelease(&m_raw_q);	//the slot can take another transfer
+#endif
+
+	//hand the events over once another buffer might not fit
+	if(GetEVTsIterator() > EVENT_BUFFER_SIZE - VALID_BUFFER_SIZE)
+		PublishEVTBlock();
+	return 1;
+}
+
+/*
+ * Stop moving buffers at the end of a run. A transfer not yet finished is thrown away, the
+ *  buffers already in the raw queue, or filled in the descriptor ring, are still there to be
+ *  processed; see PendingBuffers(). The ring is reset by ResetBufferDMA() once they have been.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void StopBufferDMA( void )
+{
+#if DAQ_EVENT_GEN
+	XTime_GetTime(&m_gen_end);
+#endif
+#if DAQ_DMA_RING
+	//stop the FPGA feeding the ring, and take back the descriptors it had already filled
+	Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
+	DMASGCheckTransfer();
+	if(m_dma_state == DMA_XFER_BUSY)
+		ClearBRAMBuffers();
+	m_dma_state = DMA_XFER_IDLE;
+#else
+	//don't leave a transfer in flight when we leave DAQ, that buffer is thrown away
+	if(m_dma_state == DMA_XFER_BUSY)
+	{
+		if(DMAWaitTransfer() != DMA_XFER_DONE)
+			DMAReset();
+		Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
+		ClearBRAMBuffers();
+	}
+	m_dma_state = DMA_XFER_IDLE;
+#endif
+	return;
+}
+
+/*
+ * How many filled buffers are still waiting for ParseStage() once the DMA has been stopped.
+ *
+ * @param	None
+ *
+ * @return	The number of buffers
+ */
+static int PendingBuffers( void )
+{
+#if DAQ_DMA_RING
+	return DMASGGetFilledCount();
+#else
+	return BlockQueueCount(&m_raw_q);
+#endif
+}
+
+/*
+ * Reset the descriptor ring at the end of a run, after every filled buffer has been processed.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void ResetBufferDMA( void )
+{
+#if DAQ_DMA_RING
+	DMAReset();
+#endif
+	return;
+}
+#endif
+
+#if !AMP_CPU1_BUILD
+/*
+ * Pad the EVT file from the end of the headers out to DP_HEADER_SIZE, so the events start on
+ *  a cluster edge.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int PadEVTFileHeader( void )
+{
+	unsigned int pad_bytes = DP_HEADER_SIZE - f_tell(&m_EVT_file);
+	unsigned int bytes_written = 0;
+	FRESULT f_res = FR_OK;
+
+	f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, m_write_blank_space_buff, pad_bytes, &bytes_written);
+	if(f_res != FR_OK || bytes_written != pad_bytes)
+		return CMD_FAILURE;
+#if EVT_ASYNC_WRITE
+	//the DMA writes go around FatFs, so none of the file may be left in its buffer
+	if(f_sync(&m_EVT_file) != FR_OK)
+		return CMD_FAILURE;
+#endif
+	return CMD_SUCCESS;
+}
+
+#if EVT_ASYNC_WRITE
+/*
+ * How far into the EVT set file the events have got. The DMA writes go on ahead of FatFs's
+ *  file pointer, which is brought up to them by SettleEVTWrites().
+ */
+static DWORD EVTFileTell( void )
+{
+	if(m_evt_async_offset > f_tell(&m_EVT_file))
+		return m_evt_async_offset;
+	return f_tell(&m_EVT_file);
+}
+
+/*
+ * See whether the DMA write of the last cluster has finished.
+ *
+ * @param	(int) 1 to wait for it to finish, 0 to just look
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if the write failed
+ */
+static int PollEVTWrite( int wait )
+{
+	int result = CMD_SUCCESS;
+	XTime wait_start;
+	XTime wait_end;
+
+	if(m_evt_write_pending == 0)
+		return CMD_SUCCESS;
+	XTime_GetTime(&wait_start);
+	do
+		result = AsyncSDPoll();
+	while(wait == 1 && result == ASYNC_SD_BUSY);
+	if(result == ASYNC_SD_BUSY)
+		return CMD_SUCCESS;
+	XTime_GetTime(&wait_end);
+	if(wait == 1)
+		m_async_wait_ticks += wait_end - wait_start;
+	//another call on the card may have waited it out already, so this is when it was seen to finish
+	m_async_latency_ticks += wait_end - m_evt_write_started;
+	m_async_writes++;
+	m_evt_write_pending = 0;
+	if(result != CMD_SUCCESS)
+	{
+		xil_printf("7 error writing DAQ\n");
+		return CMD_FAILURE;
+	}
+	return CMD_SUCCESS;
+}
+
+/*
+ * Start the DMA write of the full cluster in m_evt_cluster to its place in the set file, and
+ *  fill the other block from here on. Waits only if the last write has not finished.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int StartEVTWrite( void )
+{
+	DWORD position = EVTFileTell();
+	int status = PollEVTWrite(1);
+
+	XTime_GetTime(&m_evt_write_started);
+	if(AsyncSDStart((const BYTE *)m_evt_cluster, m_evt_file_sector + position / _MAX_SS, EVT_DATA_BUFF_SIZE / _MAX_SS) != CMD_SUCCESS)
+		return CMD_FAILURE;
+	m_evt_write_pending = 1;
+	m_evt_async_offset = position + EVT_DATA_BUFF_SIZE;
+	m_evt_cluster = (m_evt_cluster == m_evt_write_blocks[0]) ? m_evt_write_blocks[1] : m_evt_write_blocks[0];
+	return status;
+}
+
+/*
+ * Wait for the DMA writes and bring FatFs's file pointer up to them, before FatFs writes to the
+ *  set file again.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int SettleEVTWrites( void )
+{
+	int status = PollEVTWrite(1);
+
+	if(m_evt_async_offset > f_tell(&m_EVT_file) && f_lseek(&m_EVT_file, m_evt_async_offset) != FR_OK)
+		status = CMD_FAILURE;
+	return status;
+}
+#endif
+
+#if SD_MIRROR
+/*
+ * Fill the next cluster in a mirror block, so the copy on the other card is written from the
+ *  same block as the EVT file. When every block is still waiting for the other card the spare
+ *  is filled instead; that cluster is copied into the ring if room has been made by the time
+ *  it is written, else the mirror gives up on the set file's copy.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void NextEVTBlock( void )
+{
+	m_evt_cluster = (GENERAL_EVENT_TYPE *)SDMirrorReserve();
+	if(m_evt_cluster == NULL)
+		m_evt_cluster = m_evt_spare_block;
+	return;
+}
+#endif
+
+/*
+ * Write the events collected in m_evt_cluster to the EVT file, a whole cluster except at the
+ *  end of the run. Rolls over to the next set file once the current one reaches 1 MiB, and
+ *  writes the secondary headers the first time through.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if rolling over to a new file went wrong
+ */
+static int WriteEVTCluster( void )
+{
+	int status = CMD_SUCCESS;
+	unsigned int bytes_written = 0;
+	unsigned int write_bytes = m_evt_cluster_bytes;
+	FRESULT f_res = FR_OK;
+	XTime m_sd_write_start;		//timing variable
+	XTime m_sd_write_end;		//timing variable
+
+	//check how much has been written and see if we need to change files, a preallocated file is already its full size
+#if EVT_ASYNC_WRITE
+	if(EVTFileTell() >= SIZE_1_MIB)
+	{
+		if(SettleEVTWrites() != CMD_SUCCESS)
+			status = CMD_FAILURE;
+#else
+	if(f_tell(&m_EVT_file) >= SIZE_1_MIB)
+	{
+#endif
+		//prepare and write in footer for file here
+		file_footer_to_write.digiTemp = GetDigiTemp();
+//		m_spacecraft_real_time = GetRealTimeParam();
+//		memcpy(&(file_footer_to_write.spacecraftRealTime[0]), &m_spacecraft_real_time, sizeof(m_spacecraft_real_time));
+//		m_digi_temp = GetDigiTemp();
+//		file_footer_to_write.digiTemp = (unsigned char)m_digi_temp;
+		f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
+		if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
+			status = CMD_FAILURE;
+#if EVT_SET_PREALLOCATE
+		//give back the clusters past the footer
+		if(f_truncate(&m_EVT_file) != FR_OK)
+			status = CMD_FAILURE;
+#endif
+		//then close the file, as we're done with it
+		SDMirrorClose(SD_MIRROR_EVT, &m_EVT_file);
+		//create the new file name (increment the set number)
+		daq_run_set_number++; file_header_to_write.SetNum = daq_run_set_number;
+		file_header_to_write.FileTypeAPID = 0x77;	//change back to EVTS
+		file_header_to_write.DataFormat = EVT_DATA_FORMAT;
+		bytes_written = snprintf(current_filename_EVT, 100, "evt_S%04d.bin", daq_run_set_number);
+		if(bytes_written == 0)
+			status = CMD_FAILURE;
+		f_res = OpenDAQFile(SD_MIRROR_EVT, &m_EVT_file, current_filename_EVT);
+		if(f_res == FR_OK)
+		{
+#if EVT_SET_PREALLOCATE
+			if(PreallocateEVTFile() != CMD_SUCCESS)
+				xil_printf("18 error allocating EVT DAQ\n");
+#endif
+			f_res = f_lseek(&m_EVT_file, 0);
+			if(f_res != FR_OK)
+				status = CMD_FAILURE;
+			//write file header
+			f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, &file_header_to_write, sizeof(file_header_to_write), &bytes_written);
+			if(f_res != FR_OK || bytes_written != sizeof(file_header_to_write))
+				status = CMD_FAILURE;
+			//write secondary header
+			f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
+			if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
+				status = CMD_FAILURE;
+			//write blank bytes up to Cluster edge (16384
+			if(PadEVTFileHeader() != CMD_SUCCESS)
+				status = CMD_FAILURE;
+		}
+		else
+			status = CMD_FAILURE;
+		//update any more data structures?
+	}
+
+	if(m_write_header == 1)
+	{
+		//get the first event and the real time
+		file_secondary_header_to_write.RealTime = GetRealTimeParam();
+		file_secondary_header_to_write.EventID1 = 0xFF;
+		file_secondary_header_to_write.EventID2 = 0xEE;
+		file_secondary_header_to_write.EventID3 = 0xDD;
+		file_secondary_header_to_write.EventID4 = 0xCC;
+		file_secondary_header_to_write.FirstEventTime = m_evt_first_event_time;
+		file_secondary_header_to_write.EventID5 = 0xCC;
+		file_secondary_header_to_write.EventID6 = 0xDD;
+		file_secondary_header_to_write.EventID7 = 0xEE;
+		file_secondary_header_to_write.EventID8 = 0xFF;
+		//write the secondary header into the EVT file
+		f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
+		if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
+		{
+			//TODO: handle error checking the write
+			xil_printf("10 error writing DAQ\n");
+		}
+#if EVT_SET_PREALLOCATE
+		//the first set file starts its events on a cluster edge, like the rest
+		if(PadEVTFileHeader() != CMD_SUCCESS)
+			xil_printf("10 error writing DAQ\n");
+#endif
+		//write the secondary header into the CPS file
+		f_res = f_lseek(&m_CPS_file, sizeof(file_header_to_write));	//want to move to the reserved space we allocated before the run
+		//error check if we want
+		f_res = SDMirrorWrite(SD_MIRROR_CPS, &m_CPS_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
+		if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
+		{
+			//TODO: handle error checking the write
+			xil_printf("10 error writing DAQ\n");
+		}
+		//forward the file pointer so we're at the top of the file again
+		f_res = f_lseek(&m_CPS_file, file_size(&m_CPS_file));
+
+		//also write the footer information that isn't going to change //this way we only do it once
+		file_footer_to_write.eventID1 = 0xFF;
+		file_footer_to_write.RealTime = GetRealTimeParam();
+		file_footer_to_write.eventID2 = 0xFF;
+		file_footer_to_write.eventID3 = 0xFF;
+		file_footer_to_write.eventID4 = 0x45;
+		file_footer_to_write.eventID5 = 0x4E;
+		file_footer_to_write.eventID6 = 0x44;
+		m_write_header = 0;	//turn off header writing
+	}
+
+#if DATA_COMPRESS
+	//compress the cluster as one block, the compressed blocks go into the file back to back
+	XTime_GetTime(&m_sd_write_start);
+	write_bytes = bcCompress(EVT_COMPRESS_CODEC, (unsigned char *)m_evt_cluster, m_evt_cluster_bytes, m_evt_packed, sizeof(m_evt_packed));
+	XTime_GetTime(&m_sd_write_end);
+	m_compress_ticks += m_sd_write_end - m_sd_write_start;
+	m_compress_bytes += m_evt_cluster_bytes;
+	if((m_sd_write_end - m_sd_write_start) * 2 / m_evt_cluster_bytes > m_compress_worst)
+		m_compress_worst = (unsigned int)((m_sd_write_end - m_sd_write_start) * 2 / m_evt_cluster_bytes);
+	XTime_GetTime(&m_sd_write_start);
+	f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, m_evt_packed, write_bytes, &bytes_written);
+#else
+	XTime_GetTime(&m_sd_write_start);
+#if EVT_ASYNC_WRITE
+	if(m_evt_file_sector != 0 && write_bytes == EVT_DATA_BUFF_SIZE && EVTFileTell() % _MAX_SS == 0)
+	{
+		//a whole cluster goes straight to its place in the set file and is left to the card
+		if(StartEVTWrite() != CMD_SUCCESS)
+			xil_printf("7 error writing DAQ\n");
+		XTime_GetTime(&m_sd_write_end);
+		m_sd_write_ticks += m_sd_write_end - m_sd_write_start;
+		m_sd_bytes_written += write_bytes;
+		m_evt_cluster_bytes = 0;
+		return status;
+	}
+	SettleEVTWrites();
+#endif
+	f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, m_evt_cluster, write_bytes, &bytes_written); //only the events, no padding
+#endif
+#if SD_MIRROR
+	NextEVTBlock();		//the mirror has the one just written now
+#endif
+	if(f_res != FR_OK || bytes_written != write_bytes)
+	{
+		//TODO: handle error checking the write here
+		//now we need to check to make sure that there is a file open, if we get specific return values from f_write, need to check to see if we can open a file
+		xil_printf("7 error writing DAQ\n");
+	}
+	m_buffers_written++;
+	if(f_res == FR_OK && m_buffers_written == 4)
+	{
+		f_res = SDMirrorSync(SD_MIRROR_EVT, &m_EVT_file);
+		if(f_res != FR_OK)
+		{
+			//TODO: error check
+			xil_printf("8 error syncing DAQ\n");
+		}
+		m_buffers_written = 0;	//reset
+	}
+	XTime_GetTime(&m_sd_write_end);
+	m_sd_write_ticks += m_sd_write_end - m_sd_write_start;
+	m_sd_bytes_written += bytes_written;
+	m_evt_cluster_bytes = 0;
+
+	return status;
+}
+
+/*
+ * Add a block of events to the EVT file. The events are collected until there is a whole
+ *  cluster of them, so the writes stay cluster sized however full the blocks are.
+ * With EVT_COMPACT_FORMAT the events are packed on the way in, and the end of each cluster
+ *  which will not take another record is padded out.
+ *
+ * @param	(GENERAL_EVENT_TYPE *) The events
+ * @param	(unsigned int) Number of bytes of events, up to EVT_DATA_BUFF_SIZE
+ * @param	(unsigned int) FPGA time of the first event of the run, for the secondary header
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE if rolling over to a new file went wrong
+ */
+static int WriteEVTBuffer( GENERAL_EVENT_TYPE * evts_array, unsigned int length, unsigned int first_event_time )
+{
+	int status = CMD_SUCCESS;
+	unsigned int bytes_to_copy = 0;
+#if EVT_COMPACT_FORMAT
+	unsigned int records = 0;
+	XTime encode_start;
+	XTime encode_end;
+#endif
+
+	if(evts_array == NULL)
+		return CMD_FAILURE;
+	m_evt_first_event_time = first_event_time;
+	m_evt_record_bytes += length;
+#if EVT_COMPACT_FORMAT
+	while(length != 0)
+	{
+		//pack as many records as fit in the rest of the cluster, a block never crosses into the next one
+		XTime_GetTime(&encode_start);
+		records = evtCompactEncode((unsigned char *)evts_array, length / sizeof(GENERAL_EVENT_TYPE), (unsigned char *)m_evt_cluster + m_evt_cluster_bytes, EVT_DATA_BUFF_SIZE - m_evt_cluster_bytes, &bytes_to_copy);
+		XTime_GetTime(&encode_end);
+		m_evt_encode_ticks += encode_end - encode_start;
+		m_evt_cluster_bytes += bytes_to_copy;
+		evts_array += records;
+		length -= records * sizeof(GENERAL_EVENT_TYPE);
+		if(length != 0)
+		{
+			memset((unsigned char *)m_evt_cluster + m_evt_cluster_bytes, EVT_COMPACT_PAD, EVT_DATA_BUFF_SIZE - m_evt_cluster_bytes);
+			m_evt_cluster_bytes = EVT_DATA_BUFF_SIZE;
+			if(WriteEVTCluster() == CMD_FAILURE)
+				status = CMD_FAILURE;
+		}
+	}
+#else
+	while(length != 0)
+	{
+		bytes_to_copy = EVT_DATA_BUFF_SIZE - m_evt_cluster_bytes;
+		if(bytes_to_copy > length)
+			bytes_to_copy = length;
+		memcpy((unsigned char *)m_evt_cluster + m_evt_cluster_bytes, evts_array, bytes_to_copy);
+		m_evt_cluster_bytes += bytes_to_copy;
+		evts_array += bytes_to_copy / sizeof(GENERAL_EVENT_TYPE);
+		length -= bytes_to_copy;
+		if(m_evt_cluster_bytes == EVT_DATA_BUFF_SIZE && WriteEVTCluster() == CMD_FAILURE)
+			status = CMD_FAILURE;
+	}
+#endif
+	return status;
+}
+
+/*
+ * Write whatever is left in the last, partly filled, cluster at the end of the run.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int FlushEVTCluster( void )
+{
+	if(m_evt_cluster_bytes == 0)
+		return CMD_SUCCESS;
+	return WriteEVTCluster();
+}
+
+/*
+ * Close out the data products at the end of a run. With EVT_ASYNC_WRITE the EVT writes have
+ *  already been settled, before the CPS flush.
+ *
+ * @param	None
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE
+ */
+static int WriteDAQFooters( void )
+{
+	int status = CMD_SUCCESS;
+	unsigned int bytes_written = 0;
+	FRESULT f_res = FR_OK;
+
+	file_footer_to_write.digiTemp = GetDigiTemp();
+	f_res = SDMirrorWrite(SD_MIRROR_EVT, &m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
+	if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
+		status = CMD_FAILURE;
+#if EVT_SET_PREALLOCATE
+	if(f_truncate(&m_EVT_file) != FR_OK)
+		status = CMD_FAILURE;
+#endif
+	f_res = SDMirrorWrite(SD_MIRROR_CPS, &m_CPS_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
+	if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
+		status = CMD_FAILURE;
+
+	return status;
+}
+#endif
+
+#if !AMP_MODE
+/*
+ * Last stage of the pipeline. Writes the oldest full EVT block to the SD card.
+ *
+ * @param	(int *) Set to CMD_FAILURE if rolling over to a new file went wrong
+ *
+ * @return	1 if a block was written, 0 if there was none
+ */
+static int WriteStage( int * status )
+{
+	void *payload = NULL;
+	BLOCK_DESC_TYPE *block = NULL;
+
+	block = BlockQueuePeek(&m_evt_q, &payload);
+	if(block == NULL)
+		return 0;
+	if(WriteEVTBuffer((GENERAL_EVENT_TYPE *)payload, block->length, block->aux) == CMD_FAILURE)
+		*status = CMD_FAILURE;
+	BlockQueueRelease(&m_evt_q);
+	return 1;
+}
+#endif
+
+#if AMP_CPU0_BUILD
+/*
+ * Write out everything CPU1 has handed over so far.
+ *
+ * @param	None
+ *
+ * @return	1 once CPU1 has sent the end of run block, 0 otherwise
+ */
+static int DrainAMPQueue( void )
+{
+	int run_ended = 0;
+	unsigned short * histo = NULL;
+	void * payload = NULL;
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+	BLOCK_DESC_TYPE * block = NULL;
+
+	while(run_ended == 0)
+	{
+		//CPS events first, anything CPU1 sent before the block we are about to look at is here already
+		while((block = BlockQueuePeek(&(shared->cps_q), &payload)) != NULL)
+		{
+			//CPU1 does not read the temperature sensors, fill it in here
+			((CPS_EVENT_STRUCT_TYPE *)payload)->modu_temp = (unsigned char)GetModuTemp();
+			cpsBufferEvent((CPS_EVENT_STRUCT_TYPE *)payload);	//written out by the CPS flush task
+			BlockQueueRelease(&(shared->cps_q));
+		}
+
+		block = BlockQueuePeek(&(shared->data_q), &payload);
+		if(block == NULL)
+			break;
+
+		switch(block->type)
+		{
+		case BLOCK_EVT:
+			if(WriteEVTBuffer((GENERAL_EVENT_TYPE *)payload, block->length, block->aux) == CMD_FAILURE)
+				xil_printf("16 error rolling over EVT DAQ\n");
+			break;
+		case BLOCK_2DH:
+			histo = Get2DHArrayAddress(block->aux);
+			if(histo != NULL && block->length == sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS)
+				memcpy(histo, payload, block->length);
+			break;
+		case BLOCK_END:
+			run_ended = 1;
+			break;
+		default:
+			break;
+		}
+		BlockQueueRelease(&(shared->data_q));
+	}
+
+	PutNeutronTotal(shared->neutron_total);
+	m_buffers_processed = shared->buffers_processed;
+	return run_ended;
+}
+#endif
+
+#if AMP_CPU1_BUILD
+/*
+ * The CPU1 side of DataAcquisition().
+ * Waits for CPU0 to start a run, then moves buffers out of the FPGA, processes them, and
+ *  hands the events to CPU0 until CPU0 stops the run. The 2DHs follow at the end of the
+ *  run, then a block to say nothing else is coming.
+ * CPU1 never touches the SD card, the UART, or the I2C bus.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void DataAcquisitionCPU1( void )
+{
+	int pmt_ID = 0;
+	unsigned int command = AMP_RUN_STOP;
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+
+	//wait for CPU0 to start a run
+	while(AMPCheckRunCommand(&command) == 0 || command != AMP_RUN_START)
+		;
+
+	LoadConfigBuffer((CONFIG_STRUCT_TYPE *)shared->config);
+	CPSInit();	//reset neutron counts for the run
+	StartPipeline();
+	while(1)
+	{
+		if(AMPCheckRunCommand(&command) == 1 && command == AMP_RUN_STOP)
+			break;
+
+		//the events are written straight into the queue to CPU0, if CPU0 falls behind the
+		// raw buffers back up, then the FPGA
+		AcquireStage();
+		if(ParseStage() == 1)
+		{
+			shared->neutron_total = GetNeutronTotal();
+			shared->buffers_processed = m_buffers_processed;
+			shared->dma_errors = DMAGetErrorCount();
+		}
+	}
+	StopBufferDMA();
+	//process what is already in DRAM, CPU0 keeps draining until it sees the end of run block
+	while(PendingBuffers() != 0)
+		ParseStage();
+	ResetBufferDMA();
+
+	//the last, partly filled, EVT block goes over with the events it has
+	PublishEVTBlock();
+	for(pmt_ID = 1; pmt_ID <= 4; pmt_ID++)
+		BlockQueueSend(&(shared->data_q), BLOCK_2DH, Get2DHArrayAddress(pmt_ID), sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS, pmt_ID);
+	BlockQueueSend(&(shared->data_q), BLOCK_END, NULL, 0, 0);
+
+	return;
+}
+#else
+/*
+ * DAQ tasks for the scheduler, see DataAcquisition().
+ */
+static int m_pipeline_idle = 0;	//whether the pipeline had nothing to do on this pass, for the mirror catch-up
+
+#if AMP_CPU0_BUILD
+static void AMPDrainTask( void * context )
+{
+#if EVT_ASYNC_WRITE
+	PollEVTWrite(0);
+#endif
+	DrainAMPQueue();
+	m_pipeline_idle = (BlockQueueCount(&(AMPGetShared()->data_q)) == 0);
+	return;
+}
+#else
+static int m_parsed = 0;	//whether the process task got anything done on this pass
+
+static void DMATask( void * context )
+{
+	AcquireStage();
+	return;
+}
+
+static void ProcessTask( void * context )
+{
+	m_parsed = ParseStage();
+	return;
+}
+
+//the SD write is the slow one, it waits until there is nothing to process or nowhere to put the events
+static void SDFlushTask( void * context )
+{
+#if EVT_ASYNC_WRITE
+	PollEVTWrite(0);	//the card programs the last cluster while the events are processed
+#endif
+	m_pipeline_idle = 0;
+	if(m_parsed == 0 || BlockQueueReserve(&m_evt_q) == NULL)
+		m_pipeline_idle = (WriteStage((int *)context) == 0 && m_parsed == 0);
+	return;
+}
+#endif
+
+#if SD_MIRROR
+//the copies on the other card are caught up in the time the pipeline leaves, see SDMirrorService()
+static void SDMirrorTask( void * context )
+{
+	SDMirrorService(m_pipeline_idle);
+	return;
+}
+#endif
+
+//the CPS events are written every CPS_FLUSH_PERIOD_US instead of once a second from the processing
+static void CPSFlushTask( void * context )
+{
+#if EVT_ASYNC_WRITE
+	AsyncSDWait();		//the disk layer does not know about the EVT write
+#endif
+	cpsFlushBuffer((FIL *)context);
+	return;
+}
+
+//the queue, DMA ring, and task counters go out every DIAG_PERIOD_US
+static void DiagTask( void * context )
+{
+	reportDAQDiag(*(XUartPs *)context);
+	reportSchedStats(*(XUartPs *)context);
+	return;
+}
+
+//released once, when the run time is up
+static void RunTimerTask( void * context )
+{
+	SchedStop(SCHED_STOP_TIMER);
+	return;
+}
+
 /* What it's all about.
  * The main event.
  * This is where we interact with the FPGA to receive data,
  *  then process and save it. We are reporting SOH and various SUCCESS/FAILURE packets along
  *  the way.
+ * In the AMP build, CPU1 does the interacting and processing (see DataAcquisitionCPU1())
+ *  and this loop just writes out what CPU1 hands over.
  *
  * @param	(XIicPs *) Pointer to Iic instance (for read temp while in DAQ)
  *
@@ -468,239 +1821,73 @@ int DataAcquisition( XIicPs * Iic, XUartPs Uart_PS, char * RecvBuffer, int time_
 	int status = CMD_SUCCESS;	//monitors the status of how we break out of DAQ
 	int status_SOH = CMD_SUCCESS;	//local status variable
 	int poll_val = 0;			//local polling status variable
-	int valid_data = 0;			//goes high/low if there is valid data within the FPGA buffers
-	int buff_num = 0;			//keep track of which buffer we are writing
-	int m_buffers_written = 0;	//keep track of how many buffers are written, but not synced
-	int array_index = 0;		//the index of our array which will hold data
-	int dram_addr;				//the address in the DRAM we are reading from
-	int dram_base = 0xA000000;	//where the buffer starts	//167,772,160
-	int dram_ceiling = 0xA004000;	//where it ends			//167,788,544
 	int m_run_time = time_out * 60;	//multiply minutes by 60 to get seconds
-	int m_write_header = 1;		//write a file header the first time we use a file
+#if AMP_CPU0_BUILD
 	XTime m_run_start;			//timing variable
 	XTime m_run_current_time;	//timing variable
-	XTime_GetTime(&m_run_start);//record the "start" time to base a time out on
-	char m_write_blank_space_buff[16384] = "";
-	unsigned int bytes_written = 0;
-	FRESULT f_res = FR_OK;
-	GENERAL_EVENT_TYPE * evts_array = NULL;
+	AMP_SHARED_TYPE * shared = AMPGetShared();
+#endif
 
 	memset(&m_write_blank_space_buff, 186, 16384);
+	m_write_header = 1;
+	m_buffers_written = 0;
+	m_evt_cluster_bytes = 0;
+#if SD_MIRROR
+	NextEVTBlock();
+#endif
+#if EVT_ASYNC_WRITE
+	m_evt_cluster = m_evt_write_blocks[0];
+	m_evt_write_pending = 0;
+	m_async_writes = 0;
+	m_async_latency_ticks = 0;
+	m_async_wait_ticks = 0;
+#endif
+	m_sd_write_ticks = 0;
+	m_sd_bytes_written = 0;
+	m_evt_record_bytes = 0;
+	m_evt_encode_ticks = 0;
+#if DATA_COMPRESS
+	m_compress_bytes = 0;
+	m_compress_ticks = 0;
+	m_compress_worst = 0;
+#endif
+#if AMP_CPU0_BUILD
+	//hand the run to CPU1 along with our config
+	memcpy(shared->config, GetConfigBuffer(), sizeof(CONFIG_STRUCT_TYPE));
+	if(AMPSendRunCommand(AMP_RUN_START) != CMD_SUCCESS)
+		xil_printf("15 CPU1 start DAQ\n");
+#else
+	StartPipeline();
+#endif
+	//the pipeline runs as scheduler tasks alongside SOH, temperatures, and the command poll
+	SchedResetStats();
+#if AMP_CPU0_BUILD
+	SchedAddTask(SCHED_TASK_SD_FLUSH, "DRAIN", AMPDrainTask, NULL, 0, 0);
+#else
+	m_parsed = 0;
+	SchedAddTask(SCHED_TASK_DMA, "DMA", DMATask, NULL, 0, 0);
+	SchedAddTask(SCHED_TASK_PROCESS, "PROCESS", ProcessTask, NULL, 0, 0);
+	SchedAddTask(SCHED_TASK_SD_FLUSH, "SD", SDFlushTask, &status, 0, 0);
+#endif
+	SchedAddTask(SCHED_TASK_CPS_FLUSH, "CPS", CPSFlushTask, &m_CPS_file, CPS_FLUSH_PERIOD_US, 0);
+#if SD_MIRROR
+	m_pipeline_idle = 0;
+	SchedAddTask(SCHED_TASK_SD_MIRROR, "MIRROR", SDMirrorTask, NULL, 0, 0);
+#endif
+	SchedAddTask(SCHED_TASK_DIAG, "DIAG", DiagTask, &Uart_PS, DIAG_PERIOD_US, 0);
+	//record the "start" time to base a time out on
+	SchedAddTask(SCHED_TASK_RUN_TIMER, "TIMER", RunTimerTask, NULL, (XTime)m_run_time * 1000000, 0);
 
-	ResetEVTsBuffer();
-	ResetEVTsIterator();
-	ClearBRAMBuffers();
 	while(done != 1)
 	{
-		//check the FPGA to see if there is valid data in the buffers
-		//bit set high (1) when there is at least one valid (full) buffer of data in the FPGA
-		valid_data = Xil_In32 (XPAR_AXI_GPIO_11_BASEADDR);
-		if(valid_data == 1)
-		{
-			//init/start MUX to transfer data between integrator modules and the DMA
-			Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 1);
-			Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x48, 0xa000000);
-			Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x58 , 65536);
-			usleep(54);
-			//TODO: need to check a shared variable within the interrupt handler and this function
-			// to see if the transfer is completed
-			//This check would replace the sleep statement.
-
-			Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
-
-			ClearBRAMBuffers();
-
-			Xil_DCacheInvalidateRange(0xa0000000, 65536);
-
-			array_index = 0;
-			dram_addr = dram_base;
-			switch(buff_num)
-			{
-			case 0:
-				while(dram_addr < dram_ceiling) //Does this need to be non-inclusive? Can we include the dram_ceiling? //TRYING THIS 2/26/19 GJS
-				{
-					data_array[array_index + DATA_BUFFER_SIZE * buff_num] = Xil_In32(dram_addr);
-					dram_addr += 4;
-					array_index++;
-				}
-				status_SOH = ProcessData( &data_array[DATA_BUFFER_SIZE * buff_num] );
-				buff_num++;
-				break;
-			case 1:
-				while(dram_addr < dram_ceiling)
-				{
-					data_array[array_index + DATA_BUFFER_SIZE * buff_num] = Xil_In32(dram_addr);
-					dram_addr += 4;
-					array_index++;
-				}
-				status_SOH = ProcessData( &data_array[DATA_BUFFER_SIZE * buff_num] );
-				buff_num++;
-				break;
-			case 2:
-				while(dram_addr < dram_ceiling)
-				{
-					data_array[array_index + DATA_BUFFER_SIZE * buff_num] = Xil_In32(dram_addr);
-					dram_addr += 4;
-					array_index++;
-				}
-				status_SOH = ProcessData( &data_array[DATA_BUFFER_SIZE * buff_num] );
-				buff_num++;
-				break;
-			case 3:
-				while(dram_addr < dram_ceiling)
-				{
-					data_array[array_index + DATA_BUFFER_SIZE * buff_num] = Xil_In32(dram_addr);
-					dram_addr += 4;
-					array_index++;
-				}
-				status_SOH = ProcessData( &data_array[DATA_BUFFER_SIZE * buff_num] );
-				buff_num = 0;
-
-				//check the file size and see if we need to change files
-				if(m_EVT_file.fsize >= SIZE_1_MIB)
-				{
-					//prepare and write in footer for file here
-					file_footer_to_write.digiTemp = GetDigiTemp();
-//					m_spacecraft_real_time = GetRealTimeParam();
-//					memcpy(&(file_footer_to_write.spacecraftRealTime[0]), &m_spacecraft_real_time, sizeof(m_spacecraft_real_time));
-//					m_digi_temp = GetDigiTemp();
-//					file_footer_to_write.digiTemp = (unsigned char)m_digi_temp;
-					f_res = f_write(&m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-					if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-						status = CMD_FAILURE;
-					//then close the file, as we're done with it
-					f_close(&m_EVT_file);
-					//create the new file name (increment the set number)
-					daq_run_set_number++; file_header_to_write.SetNum = daq_run_set_number;
-					file_header_to_write.FileTypeAPID = 0x77;	//change back to EVTS
-					bytes_written = snprintf(current_filename_EVT, 100, "evt_S%04d.bin", daq_run_set_number);
-					if(bytes_written == 0)
-						status = CMD_FAILURE;
-					f_res = f_open(&m_EVT_file, current_filename_EVT, FA_OPEN_ALWAYS|FA_READ|FA_WRITE);
-					if(f_res == FR_OK)
-					{
-						f_res = f_lseek(&m_EVT_file, 0);
-						if(f_res != FR_OK)
-							status = CMD_FAILURE;
-						//write file header
-						f_res = f_write(&m_EVT_file, &file_header_to_write, sizeof(file_header_to_write), &bytes_written);
-						if(f_res != FR_OK || bytes_written != sizeof(file_header_to_write))
-							status = CMD_FAILURE;
-						//write secondary header
-						f_res = f_write(&m_EVT_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
-						if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
-							status = CMD_FAILURE;
-						//write blank bytes up to Cluster edge (16384
-						f_res = f_write(&m_EVT_file, m_write_blank_space_buff, 16384 - file_size(&m_EVT_file), &bytes_written);
-						if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
-							status = CMD_FAILURE;
-					}
-					else
-						status = CMD_FAILURE;
-					//update any more data structures?
-				}
-
-				if(m_write_header == 1)
-				{
-					//get the first event and the real time
-					file_secondary_header_to_write.RealTime = GetRealTimeParam();
-					file_secondary_header_to_write.EventID1 = 0xFF;
-					file_secondary_header_to_write.EventID2 = 0xEE;
-					file_secondary_header_to_write.EventID3 = 0xDD;
-					file_secondary_header_to_write.EventID4 = 0xCC;
-					file_secondary_header_to_write.FirstEventTime = GetFirstEventTime();
-					file_secondary_header_to_write.EventID5 = 0xCC;
-					file_secondary_header_to_write.EventID6 = 0xDD;
-					file_secondary_header_to_write.EventID7 = 0xEE;
-					file_secondary_header_to_write.EventID8 = 0xFF;
-					//write the secondary header into the EVT file
-					f_res = f_write(&m_EVT_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
-					if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
-					{
-						//TODO: handle error checking the write
-						xil_printf("10 error writing DAQ\n");
-					}
-					//write the secondary header into the CPS file
-					f_res = f_lseek(&m_CPS_file, sizeof(file_header_to_write));	//want to move to the reserved space we allocated before the run
-					//error check if we want
-					f_res = f_write(&m_CPS_file, &file_secondary_header_to_write, sizeof(file_secondary_header_to_write), &bytes_written);
-					if(f_res != FR_OK || bytes_written != sizeof(file_secondary_header_to_write))
-					{
-						//TODO: handle error checking the write
-						xil_printf("10 error writing DAQ\n");
-					}
-					//forward the file pointer so we're at the top of the file again
-					f_res = f_lseek(&m_CPS_file, file_size(&m_CPS_file));
-
-					//also write the footer information that isn't going to change //this way we only do it once
-					file_footer_to_write.eventID1 = 0xFF;
-					file_footer_to_write.RealTime = GetRealTimeParam();
-					file_footer_to_write.eventID2 = 0xFF;
-					file_footer_to_write.eventID3 = 0xFF;
-					file_footer_to_write.eventID4 = 0x45;
-					file_footer_to_write.eventID5 = 0x4E;
-					file_footer_to_write.eventID6 = 0x44;
-					m_write_header = 0;	//turn off header writing
-				}
-
-				evts_array = GetEVTsBufferAddress();
-				//TODO: check that the evts_array address is not NULL
-				f_res = f_write(&m_EVT_file, evts_array, EVT_DATA_BUFF_SIZE, &bytes_written); //write the entire events buffer
-				if(f_res != FR_OK || bytes_written != EVT_DATA_BUFF_SIZE)
-				{
-					//TODO: handle error checking the write here
-					//now we need to check to make sure that there is a file open, if we get specific return values from f_write, need to check to see if we can open a file
-					xil_printf("7 error writing DAQ\n");
-				}
-				m_buffers_written++;
-				if(f_res == FR_OK && m_buffers_written == 4)
-				{
-					f_res = f_sync(&m_EVT_file);
-					if(f_res != FR_OK)
-					{
-						//TODO: error check
-						xil_printf("8 error syncing DAQ\n");
-					}
-					m_buffers_written = 0;	//reset
-				}
-
-				ResetEVTsBuffer();
-				ResetEVTsIterator();
-				break;
-			default:
-				//TODO: fill in the default behavior when we don't get the right buff_num
-				//maybe try and figure out what buffer this should be?
-				// could be worth trying to figure out what went wrong with buff_num and fix that
-				//otherwise maybe just throw out everything and start over (zero out most stuff)
-				// this could maybe get us back to a "good" state, or at least a known one?
-				break;
-			}
-			valid_data = 0;	//reset
-
-		}//END OF IF VALID DATA
-
-		//check to see if it is time to report SOH information, 1 Hz
-		CheckForSOH(Iic, Uart_PS);
-
-		//check timeout condition //calculate run time?
-		//TODO: check the time it takes to run this
-		XTime_GetTime(&m_run_current_time);
-		if(((m_run_current_time - m_run_start)/COUNTS_PER_SECOND) >= m_run_time)
+		poll_val = WaitForCommand();
+		switch(poll_val)
 		{
-			file_footer_to_write.digiTemp = GetDigiTemp();
-			f_res = f_write(&m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
-			f_res = f_write(&m_CPS_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
+		case SCHED_STOP_TIMER:
+			//check timeout condition
 			status = DAQ_TIME_OUT;
 			done = 1;
-		}
-
-		poll_val = ReadCommandType(RecvBuffer, &Uart_PS);
-		switch(poll_val)
-		{
+			break;
 		case -1:
 			//this is bad input or an error in input
 			//no real need for a case if we aren't handling it
@@ -712,25 +1899,11 @@ int DataAcquisition( XIicPs * Iic, XUartPs Uart_PS, char * RecvBuffer, int time_
 				reportFailure(Uart_PS);
 			break;
 		case BREAK_CMD:
-			file_footer_to_write.digiTemp = GetDigiTemp();
-			f_res = f_write(&m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
-			f_res = f_write(&m_CPS_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
 			status = DAQ_BREAK;
 			done = 1;
 			break;
 		case END_CMD:
 			file_footer_to_write.RealTime = GetRealTimeParam();
-			file_footer_to_write.digiTemp = GetDigiTemp();
-			f_res = f_write(&m_EVT_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
-			f_res = f_write(&m_CPS_file, &file_footer_to_write, sizeof(file_footer_to_write), &bytes_written);
-			if(f_res != FR_OK || bytes_written != sizeof(file_footer_to_write))
-				status = CMD_FAILURE;
 			status = DAQ_END;
 			done = 1;
 			break;
@@ -738,6 +1911,58 @@ int DataAcquisition( XIicPs * Iic, XUartPs Uart_PS, char * RecvBuffer, int time_
 			break;
 		}
 	}//END OF WHILE DONE != 1
+	SchedRemoveTask(SCHED_TASK_RUN_TIMER);
+	SchedRemoveTask(SCHED_TASK_DMA);
+	SchedRemoveTask(SCHED_TASK_PROCESS);
+	SchedRemoveTask(SCHED_TASK_SD_FLUSH);
+	SchedRemoveTask(SCHED_TASK_CPS_FLUSH);
+	SchedRemoveTask(SCHED_TASK_SD_MIRROR);
+	SchedRemoveTask(SCHED_TASK_DIAG);
+
+#if AMP_CPU0_BUILD
+	//stop CPU1 and write out whatever it had already processed, up to its end of run block
+	if(AMPSendRunCommand(AMP_RUN_STOP) != CMD_SUCCESS)
+		xil_printf("15 CPU1 stop DAQ\n");
+	XTime_GetTime(&m_run_start);
+	while(DrainAMPQueue() == 0)
+	{
+		XTime_GetTime(&m_run_current_time);
+		if((m_run_current_time - m_run_start) > (XTime)AMP_TIMEOUT_US * (COUNTS_PER_SECOND / 1000000))
+		{
+			xil_printf("15 CPU1 end DAQ\n");
+			break;
+		}
+	}
+#else
+	StopBufferDMA();
+	//process what is already in DRAM and write out every EVT block
+	while(PendingBuffers() != 0)
+	{
+		if(ParseStage() == 0)
+			WriteStage(&status);
+	}
+	ResetBufferDMA();
+	PublishEVTBlock();	//the last, partly filled, EVT block
+	while(WriteStage(&status) == 1)
+		;
+#endif
+	FlushEVTCluster();	//the events short of a whole cluster
+#if EVT_ASYNC_WRITE
+	//the last cluster may still be going to the card, and the CPS file is written through FatFs; PollEVTWrite() reports a failure
+	SettleEVTWrites();
+#endif
+
+	//the footers go in after the last of the events, CPS included, whichever way the run ended
+	if(cpsFlushBuffer(&m_CPS_file) != CMD_SUCCESS)
+		xil_printf("17 error writing CPS DAQ\n");
+	WriteDAQFooters();
+	SDMirrorSettle();	//the run is over, the ring is emptied before the 2DHs go through it
+	reportDAQDiag(Uart_PS);		//the counters for the whole run
+	reportSchedStats(Uart_PS);
+#if DAQ_REPORT_TIMING
+	ReportDAQTiming();
+	SchedReportStats();
+#endif
 
 	//here is where we should transfer the CPS, 2DH files?
 	status_SOH = Save2DHToSD( 1 );
@@ -755,8 +1980,10 @@ int DataAcquisition( XIicPs * Iic, XUartPs Uart_PS, char * RecvBuffer, int time_
 
 	//cleanup operations
 	//2DH files are closed by that module
-	f_close(&m_EVT_file);
-	f_close(&m_CPS_file);
+	SDMirrorClose(SD_MIRROR_EVT, &m_EVT_file);
+	SDMirrorClose(SD_MIRROR_CPS, &m_CPS_file);
+	SDMirrorSettle();
 
 	return status;
 }
+#endif
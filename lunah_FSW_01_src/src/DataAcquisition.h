@@ -23,6 +23,81 @@
 #include "lunah_utils.h"
 #include "SetInstrumentParam.h"
 #include "ReadCommandType.h"
+#include "AXIDmaControl.h"
+#include "CacheControl.h"
+#include "AMPControl.h"
+#include "BlockQueue.h"
+#include "EVTCompact.h"
+#include "BlockCompress.h"
+#include "EventGen.h"
+#include "AsyncSDWrite.h"
+
+//Set to 1 to print the buffer processing and SD write timing at the end of each DAQ run
+#ifndef DAQ_REPORT_TIMING
+#define DAQ_REPORT_TIMING	0
+#endif
+
+//Set to 1 to run the DAQ from the event generator instead of the FPGA, see EventGen.h
+//The buffers go through the same queues, processing and SD writes as the FPGA's would, so the
+// timing report gives what the whole pipeline can take
+#ifndef DAQ_EVENT_GEN
+#define DAQ_EVENT_GEN		0
+#endif
+//Set to 1 to hand the generated buffers over no faster than EVENT_GEN_RATE, as the FPGA would
+#ifndef DAQ_EVENT_GEN_PACED
+#define DAQ_EVENT_GEN_PACED	0
+#endif
+//The DMA descriptor ring is only used for buffers from the FPGA. This is not a flag of its own, it
+// follows from DMA_SG_MODE and DAQ_EVENT_GEN: an SG build has no simple mode transfers to fall back on
+#ifdef DAQ_DMA_RING
+#error "DAQ_DMA_RING is worked out from DMA_SG_MODE and DAQ_EVENT_GEN, set those instead"
+#endif
+#define DAQ_DMA_RING		(DMA_SG_MODE && !DAQ_EVENT_GEN)
+
+//Set to 1 to write the EVT files as compact blocks rather than 8 byte records, see EVTCompact.h
+#ifndef EVT_COMPACT_FORMAT
+#define EVT_COMPACT_FORMAT	0
+#endif
+
+//Set to 1 to give each EVT set file all of its clusters when it is created, so no write during
+// the run has to go through the FAT. The data then starts at DP_HEADER_SIZE in every set file,
+// the first included, and every write starts on a cluster edge. Only on a card formatted with
+// EVT_DATA_BUFF_SIZE clusters, see PreallocateEVTFile()
+#ifndef EVT_SET_PREALLOCATE
+#define EVT_SET_PREALLOCATE	0
+#endif
+//What a set file is given: it rolls over once it reaches SIZE_1_MIB, so room for one more cluster, packed or not, and the footer
+#define EVT_SET_FILE_SIZE	(SIZE_1_MIB + 2 * EVT_DATA_BUFF_SIZE)
+
+//Set to 1 to write the EVT clusters straight into the set file with the SD card DMA, see AsyncSDWrite.h,
+// and go on processing while the card programs them. The clusters alternate between two blocks, one being
+// filled while the other is written. A set file whose clusters did not come out in one run, or one on a
+// card which may be byte addressed, goes through FatFs
+#ifndef EVT_ASYNC_WRITE
+#define EVT_ASYNC_WRITE		0
+#endif
+#if EVT_ASYNC_WRITE && (!EVT_SET_PREALLOCATE || DATA_COMPRESS)
+#error "EVT_ASYNC_WRITE needs EVT_SET_PREALLOCATE and whole clusters, which DATA_COMPRESS does not write"
+#endif
+//The DMA writes go around FatFs, and so around the copy on the other card and the switch over to it
+#if EVT_ASYNC_WRITE && SD_MIRROR
+#error "EVT_ASYNC_WRITE does not go through SDMirrorWrite(), turn off SD_MIRROR"
+#endif
+
+//What goes in the DataFormat of the file headers, see DATA_FORMAT_*
+#define EVT_DATA_FORMAT		((EVT_COMPACT_FORMAT ? DATA_FORMAT_EVT_COMPACT : DATA_FORMAT_RAW) | (DATA_COMPRESS ? DATA_FORMAT_COMPRESSED : DATA_FORMAT_RAW))
+#define CPS_DATA_FORMAT		(DATA_COMPRESS ? DATA_FORMAT_COMPRESSED : DATA_FORMAT_RAW)
+
+//Queues between the DAQ pipeline stages, see GetDAQQueue()
+#define DAQ_QUEUE_RAW		0	//filled DMA slots waiting to be processed, DMA_NUM_SLOTS deep
+#define DAQ_QUEUE_EVT		1	//full EVT blocks waiting to be written to the SD card
+#define DAQ_EVT_QUEUE_DEPTH	4	//must be a power of 2
+
+//Diagnostic packet sent during DAQ, see reportDAQDiag()
+//The SOH layout is fixed by the ICD, so the pipeline's own counters go out in a packet of their own
+#define DIAG_PERIOD_US		10000000	//every 10 s, and once at the end of the run
+#define DIAG_NUM_FIELDS		10
+#define DIAG_PACKET_LENGTH	(DIAG_NUM_FIELDS * 5 + 4)	//each field is 4 bytes and a tab or newline, then the checksums
 
 //Interrupt Variables
 extern XScuGic InterruptController;		// Interrupt controller
@@ -41,6 +116,15 @@ FIL *GetCPSFilePointer( void );
 FIL *Get2DHFilePointer( void );
 int WriteRealTime( unsigned long long int real_time );
 void ClearBRAMBuffers( void );
+unsigned int GetDAQBuffersProcessed( void );
+XTime GetDAQProcessTicks( void );
+XTime GetDAQCopyTicksPerBuffer( void );
+XTime GetDAQCopyTicksSaved( void );
+XTime GetDAQSDWriteTicks( void );
+unsigned int GetDAQSDBytesWritten( void );
+BLOCK_QUEUE_TYPE * GetDAQQueue( int queue_ID );
+int reportDAQDiag( XUartPs Uart_PS );
 int DataAcquisition( XIicPs * Iic, XUartPs Uart_PS, char * RecvBuffer, int time_out );
+void DataAcquisitionCPU1( void );
 
 #endif /* SRC_DATAACQUISITION_H_ */
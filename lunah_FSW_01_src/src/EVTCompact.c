@@ -0,0 +1,231 @@
+/*
+ * EVTCompact.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "EVTCompact.h"
+
+#define EVT_TIME_MASK		0x03FFFFFF	//26 bit FPGA time
+#define EVT_TOTAL_MASK		0x0FFF		//12 bits of total events
+#define EVT_ESCAPE			0x01		//first byte of an escaped record
+
+/*
+ * Pull the time and total events out of a legacy data record.
+ */
+static unsigned int RecordTime( const unsigned char * record )
+{
+	return ((unsigned int)(record[4] & 0x03) << 24) | ((unsigned int)record[5] << 16) | ((unsigned int)record[6] << 8) | record[7];
+}
+
+static unsigned int RecordTotal( const unsigned char * record )
+{
+	return ((unsigned int)(record[1] & 0x3F) << 6) | (record[2] >> 2);
+}
+
+/*
+ * Write a varint, 7 bits a byte, low bits first.
+ *
+ * @return	Number of bytes written
+ */
+static unsigned int PutVarint( unsigned char * out, unsigned int value )
+{
+	unsigned int bytes = 0;
+
+	while(value >= 0x80)
+	{
+		out[bytes++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[bytes++] = (unsigned char)value;
+	return bytes;
+}
+
+/*
+ * Read a varint of up to 32 bits.
+ *
+ * @return	Number of bytes read, 0 if it ran past the end
+ */
+static unsigned int GetVarint( const unsigned char * in, unsigned int size, unsigned int * value )
+{
+	unsigned int bytes = 0;
+	unsigned int shift = 0;
+
+	*value = 0;
+	while(bytes < size && shift < 32)
+	{
+		*value |= (unsigned int)(in[bytes] & 0x7F) << shift;
+		if((in[bytes++] & 0x80) == 0)
+			return bytes;
+		shift += 7;
+	}
+	return 0;
+}
+
+/*
+ * Encode legacy EVT records into one compact block, as many as will fit.
+ * Every record is taken as it is, so expanding the block gives back the same bytes.
+ *
+ * @param	(const unsigned char *) The legacy records, EVT_RECORD_SIZE bytes each
+ * @param	(unsigned int) Number of records
+ * @param	(unsigned char *) Where to put the block
+ * @param	(unsigned int) Bytes of room for the block
+ * @param	(unsigned int *) Set to the number of bytes in the block, 0 if there was no room
+ *
+ * @return	Number of records in the block, the caller sends the rest in another block
+ */
+unsigned int evtCompactEncode( const unsigned char * records, unsigned int num_records, unsigned char * block, unsigned int block_size, unsigned int * block_bytes )
+{
+	unsigned int iter = 0;
+	unsigned int used = EVT_COMPACT_HEADER_SIZE;
+	unsigned int prev_time = 0;
+	unsigned int prev_total = 0;
+	unsigned int time = 0;
+	unsigned int total = 0;
+	unsigned int x_bin = 0;
+	unsigned int y_bin = 0;
+	unsigned int bins = 0;
+	const unsigned char * record = records;
+
+	*block_bytes = 0;
+	if(block_size < EVT_COMPACT_HEADER_SIZE + EVT_COMPACT_MAX_RECORD)
+		return 0;
+	if(block_size > EVT_COMPACT_HEADER_SIZE + EVT_COMPACT_MAX_BLOCK)
+		block_size = EVT_COMPACT_HEADER_SIZE + EVT_COMPACT_MAX_BLOCK;
+	if(num_records > EVT_COMPACT_MAX_BLOCK)
+		num_records = EVT_COMPACT_MAX_BLOCK;
+
+	//the base is the first event, so it goes in with deltas of 0
+	for(iter = 0; iter < num_records; iter++)
+	{
+		if(records[iter * EVT_RECORD_SIZE] == 0xFF)
+		{
+			prev_time = RecordTime(&records[iter * EVT_RECORD_SIZE]);
+			prev_total = RecordTotal(&records[iter * EVT_RECORD_SIZE]);
+			break;
+		}
+	}
+	block[6] = (unsigned char)prev_time;
+	block[7] = (unsigned char)(prev_time >> 8);
+	block[8] = (unsigned char)(prev_time >> 16);
+	block[9] = (unsigned char)(prev_time >> 24);
+	block[10] = (unsigned char)prev_total;
+	block[11] = (unsigned char)(prev_total >> 8);
+
+	for(iter = 0; iter < num_records && block_size - used >= EVT_COMPACT_MAX_RECORD; iter++, record += EVT_RECORD_SIZE)
+	{
+		x_bin = ((unsigned int)(record[2] & 0x03) << 8) | record[3];
+		y_bin = record[4] >> 2;
+		if(record[0] != 0xFF || x_bin >= 512 || y_bin >= 32)
+		{
+			block[used++] = EVT_ESCAPE;
+			memcpy(&block[used], record, EVT_RECORD_SIZE);
+			used += EVT_RECORD_SIZE;
+			if(record[0] == 0xFF)
+			{
+				prev_time = RecordTime(record);
+				prev_total = RecordTotal(record);
+			}
+			continue;
+		}
+
+		time = RecordTime(record);
+		total = RecordTotal(record);
+		used += PutVarint(&block[used], ((time - prev_time) & EVT_TIME_MASK) << 1);
+		used += PutVarint(&block[used], (total - prev_total) & EVT_TOTAL_MASK);
+		bins = ((unsigned int)(record[1] >> 6) << 14) | (x_bin << 5) | y_bin;
+		block[used++] = (unsigned char)bins;
+		block[used++] = (unsigned char)(bins >> 8);
+		prev_time = time;
+		prev_total = total;
+	}
+
+	block[0] = EVT_COMPACT_MARKER;
+	block[1] = EVT_COMPACT_VERSION;
+	block[2] = (unsigned char)iter;
+	block[3] = (unsigned char)(iter >> 8);
+	block[4] = (unsigned char)(used - EVT_COMPACT_HEADER_SIZE);
+	block[5] = (unsigned char)((used - EVT_COMPACT_HEADER_SIZE) >> 8);
+	*block_bytes = used;
+	return iter;
+}
+
+/*
+ * Expand one compact block back into the legacy EVT records.
+ *
+ * @param	(const unsigned char *) The block, starting at its header
+ * @param	(unsigned int) Bytes available from the start of the block
+ * @param	(unsigned char *) Where to put the records, EVT_RECORD_SIZE bytes each
+ * @param	(unsigned int) Room for this many records
+ * @param	(unsigned int *) Set to the number of records expanded
+ *
+ * @return	Number of bytes in the block, 0 if it is not a good block or the records do not fit
+ */
+unsigned int evtCompactExpand( const unsigned char * block, unsigned int block_size, unsigned char * records, unsigned int max_records, unsigned int * num_records )
+{
+	unsigned int iter = 0;
+	unsigned int used = EVT_COMPACT_HEADER_SIZE;
+	unsigned int count = 0;
+	unsigned int end = 0;
+	unsigned int bytes = 0;
+	unsigned int prev_time = 0;
+	unsigned int prev_total = 0;
+	unsigned int delta = 0;
+	unsigned int bins = 0;
+	unsigned char * record = records;
+
+	*num_records = 0;
+	if(block_size < EVT_COMPACT_HEADER_SIZE || block[0] != EVT_COMPACT_MARKER || block[1] != EVT_COMPACT_VERSION)
+		return 0;
+	count = block[2] | ((unsigned int)block[3] << 8);
+	end = EVT_COMPACT_HEADER_SIZE + (block[4] | ((unsigned int)block[5] << 8));
+	if(end > block_size || count > max_records)
+		return 0;
+	prev_time = block[6] | ((unsigned int)block[7] << 8) | ((unsigned int)block[8] << 16) | ((unsigned int)block[9] << 24);
+	prev_total = block[10] | ((unsigned int)block[11] << 8);
+
+	for(iter = 0; iter < count; iter++, record += EVT_RECORD_SIZE)
+	{
+		bytes = GetVarint(&block[used], end - used, &delta);
+		if(bytes == 0)
+			return 0;
+		used += bytes;
+		if(delta & 0x01)
+		{
+			if(delta != EVT_ESCAPE || end - used < EVT_RECORD_SIZE)
+				return 0;
+			memcpy(record, &block[used], EVT_RECORD_SIZE);
+			used += EVT_RECORD_SIZE;
+			if(record[0] == 0xFF)
+			{
+				prev_time = RecordTime(record);
+				prev_total = RecordTotal(record);
+			}
+			continue;
+		}
+		prev_time = (prev_time + (delta >> 1)) & EVT_TIME_MASK;
+
+		bytes = GetVarint(&block[used], end - used, &delta);
+		if(bytes == 0 || end - used - bytes < 2)
+			return 0;
+		used += bytes;
+		prev_total = (prev_total + delta) & EVT_TOTAL_MASK;
+		bins = block[used] | ((unsigned int)block[used + 1] << 8);
+		used += 2;
+
+		//same packing as EncodeEvents()
+		record[0] = 0xFF;
+		record[1] = (unsigned char)(((bins >> 14) << 6) | (prev_total >> 6));
+		record[2] = (unsigned char)((prev_total << 2) | ((bins >> 13) & 0x01));
+		record[3] = (unsigned char)(bins >> 5);
+		record[4] = (unsigned char)(((bins & 0x1F) << 2) | (prev_time >> 24));
+		record[5] = (unsigned char)(prev_time >> 16);
+		record[6] = (unsigned char)(prev_time >> 8);
+		record[7] = (unsigned char)prev_time;
+	}
+	if(used != end)
+		return 0;
+	*num_records = count;
+	return end;
+}
@@ -0,0 +1,56 @@
+/*
+ * EVTCompact.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Compact EVT stream format, see EVT_COMPACT_FORMAT.
+ * The legacy EVT record is 8 bytes: the 0xFF ID, the PMT, 12 bits of total events, the 10 bit
+ *  energy bin, the 6 bit PSD bin, and the full 26 bit FPGA time. Successive events are close
+ *  together in time and the total events only ever go up, so the compact stream carries these
+ *  as differences from the event before.
+ *
+ * The stream is a series of blocks, each block starts with a header:
+ *  byte 0		EVT_COMPACT_MARKER
+ *  byte 1		EVT_COMPACT_VERSION
+ *  bytes 2-3	number of records in the block
+ *  bytes 4-5	number of bytes in the block after the header
+ *  bytes 6-9	base FPGA time, the time of the first event in the block
+ *  bytes 10-11	base total events, the total of the first event in the block
+ *  all little endian. The time and total of each event are then taken from the one before it,
+ *  so any block may be expanded without the ones before it.
+ *
+ * Each event record after the header is:
+ *  varint		(time delta << 1), the delta is modulo 2^26 like the FPGA time
+ *  varint		total events delta, modulo 2^12
+ *  2 bytes		PMT (2) | energy bin (9) | PSD bin (5), little endian
+ *  The varints are 7 bits a byte, low bits first, the top bit set on every byte but the last.
+ * A record which does not fit this, the 0xDD false event or a bin out of range, is escaped:
+ *  the byte 0x01 (a delta of 0 with the escape bit) and then the 8 byte legacy record as is.
+ * No record is longer than the legacy one plus the escape byte, EVT_COMPACT_MAX_RECORD.
+ *
+ * Blocks never cross a cluster of the EVT file; the space left at the end of a cluster is
+ *  filled with EVT_COMPACT_PAD. The first byte after the file headers tells the formats apart:
+ *  0xFF/0xDD for the legacy records, EVT_COMPACT_MARKER for the compact blocks.
+ *
+ * There are no Xilinx headers in here so the same code builds into the ground tools.
+ */
+
+#ifndef SRC_EVTCOMPACT_H_
+#define SRC_EVTCOMPACT_H_
+
+#include <string.h>
+
+#define EVT_RECORD_SIZE				8		//bytes in a legacy EVT record
+#define EVT_COMPACT_MARKER			0xEC	//first byte of a block header
+#define EVT_COMPACT_VERSION			0x01
+#define EVT_COMPACT_HEADER_SIZE		12
+#define EVT_COMPACT_MAX_RECORD		(EVT_RECORD_SIZE + 1)	//an escaped record
+#define EVT_COMPACT_MAX_BLOCK		0xFFFF	//records or payload bytes in a block, what the header holds
+#define EVT_COMPACT_PAD				0x00	//fills out a cluster after the last block
+
+//function prototypes
+unsigned int evtCompactEncode( const unsigned char * records, unsigned int num_records, unsigned char * block, unsigned int block_size, unsigned int * block_bytes );
+unsigned int evtCompactExpand( const unsigned char * block, unsigned int block_size, unsigned char * records, unsigned int max_records, unsigned int * num_records );
+
+#endif /* SRC_EVTCOMPACT_H_ */
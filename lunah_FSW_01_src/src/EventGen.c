@@ -0,0 +1,318 @@
+/*
+ * EventGen.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "EventGen.h"
+
+#define GEN_TIME_FRACTION_BITS	16			//the FPGA time is kept in 1/65536 ticks so high rates still spread out
+#define GEN_TICKS_PER_SECOND	3814.697f	//FPGA time ticks a second, 1 / 262.144 us
+#define GEN_LONG_FRACTION		0.75f		//how much of the pulse is in the long integral
+#define GEN_PILEUP_LONG			0.5f		//how much of a piled up pulse lands in the long integral
+
+//The generator state for the run
+static EVENT_GEN_CONFIG_TYPE m_config;
+static unsigned int m_random;				//xorshift state, never 0
+static unsigned long long m_time;			//FPGA time of the last event, in 1/65536 ticks
+static float m_time_step;					//mean time between events, in 1/65536 ticks
+static unsigned int m_total_events;			//the FPGA counters
+static unsigned int m_event_number;
+static unsigned int m_pmt_total;			//sum of the PMT mix
+static unsigned int m_pileup_at;			//chances as a fraction of 2^32, see GenChance()
+static unsigned int m_corrupt_at;
+static unsigned int m_junk_at;
+static unsigned int m_neutron_at;
+static int m_bl_samples;					//integration times in samples, from the config at EventGenInit()
+static int m_si_samples;
+static int m_li_samples;
+static int m_fi_samples;
+static int m_false_event;					//the false event still has to go out
+static unsigned int m_events;				//records made since EventGenInit(), damaged ones included
+static unsigned int m_damaged;				//records damaged since EventGenInit()
+
+/*
+ * The settings the on-target test mode runs with, EVENT_GEN_RATE events a second.
+ */
+void EventGenDefaultConfig( EVENT_GEN_CONFIG_TYPE * config )
+{
+	int pmt = 0;
+
+	config->rate = EVENT_GEN_RATE;
+	for(pmt = 0; pmt < 4; pmt++)
+		config->pmt_mix[pmt] = 1;
+	config->baseline = 2000;
+	config->gamma_energy = 100000;
+	config->neutron_energy = 300000;
+	config->neutron_width = 30000;
+	config->neutron_fraction = 0.2f;
+	config->gamma_psd = 0.3f;
+	config->neutron_psd = 0.6f;
+	config->psd_width = 0.05f;
+	config->pileup = 0.01f;
+	config->corrupt = 0.001f;
+	config->junk = 0.001f;
+	return;
+}
+
+static unsigned int GenRandom( void )
+{
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return m_random;
+}
+
+//a uniform value in [0, 1)
+static float GenUniform( void )
+{
+	return (float)(GenRandom() >> 8) * (1.0f / 16777216.0f);
+}
+
+static unsigned int GenThreshold( float chance )
+{
+	if(chance <= 0.0f)
+		return 0;
+	if(chance >= 1.0f)
+		return 0xFFFFFFFF;
+	return (unsigned int)(chance * 4294967296.0f);
+}
+
+static int GenChance( unsigned int threshold )
+{
+	return GenRandom() < threshold;
+}
+
+/*
+ * An exponential with a mean of 1, -ln(u). log2(u) is the position of the top bit plus
+ *  a quadratic fit to log2(1 + f) for the bits under it, good to about 0.005.
+ */
+static float GenExponential( void )
+{
+	unsigned int word = GenRandom() | 1;
+	int top = 31 - __builtin_clz(word);
+	float fraction = (float)((word << (31 - top)) & 0x7FFFFFFF) * (1.0f / 2147483648.0f);
+	float log2_word = (float)top + fraction * (1.3466f - 0.3466f * fraction);
+
+	return (32.0f - log2_word) * 0.6931472f;
+}
+
+//a normal with a mean of 0 and a standard deviation of 1, near enough, from four uniforms
+static float GenNormal( void )
+{
+	return (GenUniform() + GenUniform() + GenUniform() + GenUniform() - 2.0f) * 1.7320508f;
+}
+
+static unsigned int GenPMT( void )
+{
+	unsigned int pick = m_pmt_total ? GenRandom() % m_pmt_total : 0;
+	int pmt = 0;
+
+	for(pmt = 0; pmt < 3; pmt++)
+	{
+		if(pick < m_config.pmt_mix[pmt])
+			break;
+		pick -= m_config.pmt_mix[pmt];
+	}
+	return 1u << pmt;
+}
+
+//the energy of a pulse and the PSD it should come out with
+static float GenPulse( float * psd )
+{
+	float energy = 0.0f;
+
+	if(GenChance(m_neutron_at))
+	{
+		energy = (float)m_config.neutron_energy + (float)m_config.neutron_width * GenNormal();
+		*psd = m_config.neutron_psd + m_config.psd_width * GenNormal();
+	}
+	else
+	{
+		energy = (float)m_config.gamma_energy * GenExponential();
+		*psd = m_config.gamma_psd + m_config.psd_width * GenNormal();
+	}
+	if(energy < 0.0f)
+		energy = 0.0f;
+	if(*psd < 0.0f)
+		*psd = 0.0f;
+	return energy;
+}
+
+/*
+ * Write the next event into record, EVT_EVENT_SIZE words.
+ * The short integral is picked so that short / (long - short) is the PSD, as ProcessData() works it out.
+ */
+static void GenEvent( unsigned int * record )
+{
+	float psd = 0.0f;
+	float extra_psd = 0.0f;
+	float full = GenPulse(&psd);
+	float extra = 0.0f;
+	float lng = full * GEN_LONG_FRACTION;
+	float shrt = lng * psd / (1.0f + psd);
+
+	m_time += (unsigned long long)(m_time_step * GenExponential());
+	m_total_events++;
+	m_event_number++;
+	if(GenChance(m_pileup_at))
+	{
+		//a second pulse after the short integral, it is counted but not sent on its own
+		extra = GenPulse(&extra_psd);
+		full += extra;
+		lng += extra * GEN_PILEUP_LONG;
+		m_total_events++;
+	}
+
+	record[0] = DATA_EVENT_MARKER;
+	record[1] = (unsigned int)(m_time >> GEN_TIME_FRACTION_BITS);
+	record[2] = m_total_events;
+	record[3] = (m_event_number << 4) | GenPMT();
+	record[4] = 16 * m_config.baseline * m_bl_samples + (GenRandom() & 0x0F);
+	record[5] = 16 * (m_config.baseline * m_si_samples + (unsigned int)shrt);
+	record[6] = 16 * (m_config.baseline * m_li_samples + (unsigned int)lng);
+	record[7] = 16 * (m_config.baseline * m_fi_samples + (unsigned int)full);
+	m_events++;
+	return;
+}
+
+//a word which is not a record marker
+static unsigned int GenJunk( void )
+{
+	unsigned int word = GenRandom();
+
+	if(word == DATA_EVENT_MARKER || word == FALSE_EVENT_MARKER)
+		word++;
+	return word;
+}
+
+/*
+ * Damage the event in record, one of EVENT_GEN_DAMAGE_*.
+ *
+ * @return	The words the record now takes up
+ */
+static unsigned int GenDamage( unsigned int * record )
+{
+	unsigned int word = 0;
+
+	m_damaged++;
+	switch(GenRandom() % EVENT_GEN_DAMAGE_KINDS)
+	{
+	case EVENT_GEN_DAMAGE_ORDER:
+		word = record[5];
+		record[5] = record[6];
+		record[6] = word;
+		break;
+	case EVENT_GEN_DAMAGE_TIME:
+		record[1] = 0;
+		break;
+	case EVENT_GEN_DAMAGE_SHORT:
+		return 1 + GenRandom() % (EVT_EVENT_SIZE - 1);
+	case EVENT_GEN_DAMAGE_MARKER:
+		record[0] = GenJunk();
+		break;
+	default:
+		break;
+	}
+	return EVT_EVENT_SIZE;
+}
+
+/*
+ * Start a new run of events, the next buffer begins with the false event.
+ *
+ * @param	(EVENT_GEN_CONFIG_TYPE *) What to generate
+ * @param	(unsigned int) Random seed, the same seed and config give the same events
+ *
+ * @return	None
+ */
+void EventGenInit( const EVENT_GEN_CONFIG_TYPE * config, unsigned int seed )
+{
+	int pmt = 0;
+
+	m_config = *config;
+	m_random = seed ? seed : 1;
+	m_time = 1ull << GEN_TIME_FRACTION_BITS;
+	m_time_step = m_config.rate ? GEN_TICKS_PER_SECOND * (float)(1 << GEN_TIME_FRACTION_BITS) / (float)m_config.rate : 0.0f;
+	m_total_events = 0;
+	m_event_number = 0;
+	m_pmt_total = 0;
+	for(pmt = 0; pmt < 4; pmt++)
+		m_pmt_total += m_config.pmt_mix[pmt];
+	m_pileup_at = GenThreshold(m_config.pileup);
+	m_corrupt_at = GenThreshold(m_config.corrupt);
+	m_junk_at = GenThreshold(m_config.junk);
+	m_neutron_at = GenThreshold(m_config.neutron_fraction);
+	m_bl_samples = GetBaselineInt();
+	m_si_samples = GetShortInt();
+	m_li_samples = GetLongInt();
+	m_fi_samples = GetFullInt();
+	m_false_event = 1;
+	m_events = 0;
+	m_damaged = 0;
+	return;
+}
+
+/*
+ * Fill a buffer of DATA_BUFFER_SIZE words the way the FPGA would, see EventGen.h.
+ * The record after the false event is never damaged, ProcessData() needs it to see the false event.
+ *
+ * @param	(unsigned int *) The buffer
+ *
+ * @return	The number of event records in the buffer, damaged ones included
+ */
+unsigned int EventGenFillBuffer( unsigned int * buffer )
+{
+	unsigned int iter = 0;
+	unsigned int junk = 0;
+	unsigned int events = 0;
+	int clean = 0;
+
+	if(m_false_event)
+	{
+		memset(buffer, 0, EVENT_GEN_FALSE_SIZE * sizeof(unsigned int));
+		buffer[0] = FALSE_EVENT_MARKER;
+		buffer[1] = FALSE_EVENT_MARKER;
+		buffer[2] = (unsigned int)(m_time >> GEN_TIME_FRACTION_BITS);
+		iter = EVENT_GEN_FALSE_SIZE;
+		m_false_event = 0;
+		clean = 1;
+	}
+
+	while(iter + EVT_EVENT_SIZE + EVENT_GEN_MAX_JUNK <= DATA_BUFFER_SIZE)
+	{
+		GenEvent(&buffer[iter]);
+		events++;
+		if(clean == 0 && GenChance(m_corrupt_at))
+			iter += GenDamage(&buffer[iter]);
+		else
+			iter += EVT_EVENT_SIZE;
+		if(clean == 0 && GenChance(m_junk_at))
+		{
+			for(junk = 1 + GenRandom() % EVENT_GEN_MAX_JUNK; junk > 0; junk--)
+				buffer[iter++] = GenJunk();
+		}
+		clean = 0;
+	}
+	while(iter < DATA_BUFFER_SIZE)
+		buffer[iter++] = EVENT_GEN_PAD_WORD;
+	return events;
+}
+
+/*
+ * The FPGA time of the last event made, for pacing the buffers in real time.
+ */
+unsigned int EventGenGetTime( void )
+{
+	return (unsigned int)(m_time >> GEN_TIME_FRACTION_BITS);
+}
+
+unsigned int EventGenGetEvents( void )
+{
+	return m_events;
+}
+
+unsigned int EventGenGetDamaged( void )
+{
+	return m_damaged;
+}
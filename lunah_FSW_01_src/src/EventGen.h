@@ -0,0 +1,73 @@
+/*
+ * EventGen.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Synthetic FPGA event stream, for stress testing the DAQ pipeline without a detector.
+ * Fills buffers in the format ProcessData() reads from the FPGA:
+ *  - a run starts with the false event: two FALSE_EVENT_MARKERs, the FPGA time, 6 words of 0
+ *  - each event is a DATA_EVENT_MARKER then 7 words, EVT_EVENT_SIZE in all: FPGA time,
+ *     total events, the event number << 4 | the PMT hit bit, and the baseline, short, long
+ *     and full integrals
+ *  - the end of the buffer which no whole record fits in is padded with EVENT_GEN_PAD_WORD
+ *
+ * The integrals are built so that ProcessData() gets back the energy and PSD which were drawn:
+ *  each is 16 * (baseline * samples + pulse), with the samples from the integration times
+ *  in the config when EventGenInit() is called. The energy is in the 2DH energy units.
+ * Gammas are an exponential continuum, neutrons a peak; each has its own PSD band.
+ *
+ * Damaged records, EVENT_GEN_CONFIG_TYPE corrupt, are one of: the integrals out of order,
+ *  the time gone back to 0, the record cut short by the next one, or the marker lost. Junk
+ *  words, which are never a marker, go between records. ProcessData() should drop all of these.
+ *
+ * The maths is done without libm, which the flight build does not link.
+ * The generator writes into whatever buffer it is given; the on-target test mode is
+ *  DAQ_EVENT_GEN in DataAcquisition.h, the host build is the replay harness.
+ */
+
+#ifndef SRC_EVENTGEN_H_
+#define SRC_EVENTGEN_H_
+
+#include "process_data.h"
+
+//Events a second EventGenDefaultConfig() asks for
+#ifndef EVENT_GEN_RATE
+#define EVENT_GEN_RATE				10000
+#endif
+
+#define EVENT_GEN_FALSE_SIZE		9	//words in the false event
+#define EVENT_GEN_MAX_JUNK			4	//most junk words put between two records
+#define EVENT_GEN_PAD_WORD			0
+
+#define EVENT_GEN_DAMAGE_ORDER		0	//the kinds of damaged record, see EventGenFillBuffer()
+#define EVENT_GEN_DAMAGE_TIME		1
+#define EVENT_GEN_DAMAGE_SHORT		2
+#define EVENT_GEN_DAMAGE_MARKER		3
+#define EVENT_GEN_DAMAGE_KINDS		4
+
+typedef struct {
+	unsigned int rate;				//events a second of FPGA time
+	unsigned int pmt_mix[4];		//how often each PMT is hit, relative to the others
+	unsigned int baseline;			//ADC counts per sample with no pulse
+	unsigned int gamma_energy;		//mean of the gamma continuum
+	unsigned int neutron_energy;	//centre of the neutron peak
+	unsigned int neutron_width;		//and its standard deviation
+	float neutron_fraction;			//fraction of the events which are neutrons
+	float gamma_psd;				//centre of the gamma PSD band
+	float neutron_psd;				//centre of the neutron PSD band
+	float psd_width;				//standard deviation of both bands
+	float pileup;					//fraction of events with a second pulse inside the integration window
+	float corrupt;					//fraction of records damaged
+	float junk;						//fraction of records followed by junk words
+} EVENT_GEN_CONFIG_TYPE;
+
+//function prototypes
+void EventGenDefaultConfig( EVENT_GEN_CONFIG_TYPE * config );
+void EventGenInit( const EVENT_GEN_CONFIG_TYPE * config, unsigned int seed );
+unsigned int EventGenFillBuffer( unsigned int * buffer );
+unsigned int EventGenGetTime( void );
+unsigned int EventGenGetEvents( void );
+unsigned int EventGenGetDamaged( void );
+
+#endif /* SRC_EVENTGEN_H_ */
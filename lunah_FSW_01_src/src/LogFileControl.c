@@ -16,6 +16,131 @@
 static char cLogFile0[] = "0:/MNSCMDLOG.txt";	//The name of the log file on SD card 0
 static char cLogFile1[] = "1:/MNSCMDLOG.txt";	//The name of the log file on SD card 1
 
+#if LOG_FILE_BUFFERED
+static FIL m_log_file[2];					//the log on each card, left open
+static int m_log_open[2];					//1 when m_log_file[] is open and its pointer is on the tail marker
+static char m_log_ring[LOG_RING_SIZE];		//commands waiting to be flushed
+static unsigned int m_log_waiting;			//bytes in m_log_ring
+static XTime m_log_oldest;					//when the first of them came in
+#endif
+//Command logging time, to compare the builds with LOG_FILE_BUFFERED on and off
+static unsigned int m_log_writes;			//LogFileWrite() calls
+static XTime m_log_write_ticks;				//in LogFileWrite(), which is on the command path
+static XTime m_log_write_max;
+static unsigned int m_log_flushes;
+static XTime m_log_flush_ticks;				//in LogFileFlush(), wherever it was called from
+
+#if LOG_FILE_BUFFERED
+/*
+ * Open the log on one card and leave the file pointer where the next flush goes:
+ *  on the tail marker if the log ends in one, otherwise at the end.
+ *
+ * @param	(integer) The card, 0 or 1
+ * @param	(int *) Set to 1 if the log ends part way through a line, which a flush cut off leaves; may be NULL
+ *
+ * @return	FR_OK, or the FatFs error; the log is left closed on an error
+ */
+static FRESULT OpenLogCard( int card, int * torn )
+{
+	FRESULT ffs_res;
+	char tail[LOG_TAIL_MARKER_SIZE];
+	unsigned int num_bytes_read = 0;
+	DWORD log_size = 0;
+
+	ffs_res = f_open(&m_log_file[card], card == 0 ? cLogFile0 : cLogFile1, FA_READ|FA_WRITE|FA_OPEN_ALWAYS);
+	if(ffs_res != FR_OK)
+		return ffs_res;
+	log_size = file_size(&m_log_file[card]);
+	if(log_size >= LOG_TAIL_MARKER_SIZE)
+	{
+		ffs_res = f_lseek(&m_log_file[card], log_size - LOG_TAIL_MARKER_SIZE);
+		if(ffs_res == FR_OK)
+			ffs_res = f_read(&m_log_file[card], tail, LOG_TAIL_MARKER_SIZE, &num_bytes_read);
+		if(ffs_res == FR_OK && num_bytes_read == LOG_TAIL_MARKER_SIZE && memcmp(tail, LOG_TAIL_MARKER, LOG_TAIL_MARKER_SIZE) == 0)
+			log_size -= LOG_TAIL_MARKER_SIZE;
+		else if(ffs_res == FR_OK && num_bytes_read == LOG_TAIL_MARKER_SIZE && tail[LOG_TAIL_MARKER_SIZE - 1] != '\n' && torn != NULL)
+			*torn = 1;
+	}
+	if(ffs_res == FR_OK)
+		ffs_res = f_lseek(&m_log_file[card], log_size);
+	if(ffs_res == FR_OK)
+		m_log_open[card] = 1;
+	else
+		f_close(&m_log_file[card]);
+	return ffs_res;
+}
+
+/*
+ * Append to the log on one card over its tail marker, put the marker back after what
+ *  was written, and sync. The file pointer is left on the new marker.
+ * A card which fails is closed and opened again at the next flush, what it was given is lost.
+ *
+ * @param	(integer) The card, 0 or 1
+ * @param	(char *) What to append
+ * @param	(unsigned int) Bytes to append
+ *
+ * @return	Command SUCCESS (0) or FAILURE (1)
+ */
+static int WriteLogCard( int card, const char * write_buff, unsigned int bytes_to_write )
+{
+	FRESULT ffs_res = FR_OK;
+	unsigned int num_bytes_written = 0;
+
+	if(m_log_open[card] == 0)
+		ffs_res = OpenLogCard(card, NULL);
+	if(ffs_res == FR_OK)
+		ffs_res = f_write(&m_log_file[card], write_buff, bytes_to_write, &num_bytes_written);
+	if(ffs_res == FR_OK && num_bytes_written != bytes_to_write)
+		ffs_res = FR_DENIED;	//the card is full
+	if(ffs_res == FR_OK)
+		ffs_res = f_write(&m_log_file[card], LOG_TAIL_MARKER, LOG_TAIL_MARKER_SIZE, &num_bytes_written);
+	if(ffs_res == FR_OK && num_bytes_written != LOG_TAIL_MARKER_SIZE)
+		ffs_res = FR_DENIED;
+	if(ffs_res == FR_OK)
+		ffs_res = f_sync(&m_log_file[card]);
+	if(ffs_res == FR_OK)
+		ffs_res = f_lseek(&m_log_file[card], f_tell(&m_log_file[card]) - LOG_TAIL_MARKER_SIZE);
+	if(ffs_res == FR_OK)
+		return CMD_SUCCESS;
+
+	xil_printf("20 SD%d log %d\n", card, ffs_res);
+	if(m_log_open[card] == 1)
+		f_close(&m_log_file[card]);
+	m_log_open[card] = 0;
+	return CMD_FAILURE;
+}
+
+/*
+ * Open the log on one card, creating it if it is not there, and record the power on.
+ *
+ * @param	(integer) The card, 0 or 1
+ *
+ * @return	Command SUCCESS (0) or FAILURE (1)
+ */
+static int InitLogCard( int card )
+{
+	FILINFO fno = {};	//SD card information object, zeroed so f_stat() has no long name buffer to fill
+	char log_file_write_buffer[LOG_FILE_BUFF_SIZE] = "";
+	unsigned int i_sprintf_ret = 0;
+	int first_power_on = 0;
+	int torn = 0;
+
+	// f_stat returns non-zero(true) if no file exists
+	if( f_stat( card == 0 ? cLogFile0 : cLogFile1, &fno) )
+		first_power_on = 1;
+	if(m_log_open[card] == 1)
+	{
+		f_close(&m_log_file[card]);	//the cards were mounted again
+		m_log_open[card] = 0;
+	}
+	if(OpenLogCard(card, &torn) != FR_OK)
+		return CMD_FAILURE;
+	//what a cut off flush left stays, the power on goes on a line of its own after it
+	i_sprintf_ret = snprintf(log_file_write_buffer, LOG_FILE_BUFF_SIZE, "%s%s\n", torn ? "\n" : "", first_power_on ? "FIRST POWER ON" : "POWER RESET");
+	return WriteLogCard(card, log_file_write_buffer, i_sprintf_ret);
+}
+#endif
+
 /*
  * Initialize the log file on SD0.
  *
@@ -28,6 +153,9 @@ static char cLogFile1[] = "1:/MNSCMDLOG.txt";	//The name of the log file on SD c
  */
 int InitLogFile0( void )
 {
+#if LOG_FILE_BUFFERED
+	return InitLogCard(0);
+#else
 	FIL logFile;
 	FRESULT ffs_res;
 	FILINFO fno;	//SD card information object
@@ -78,6 +206,7 @@ int InitLogFile0( void )
 	}
 
 	return status;
+#endif
 }
 
 /*
@@ -92,6 +221,9 @@ int InitLogFile0( void )
  */
 int InitLogFile1( void )
 {
+#if LOG_FILE_BUFFERED
+	return InitLogCard(1);
+#else
 	FIL logFile;
 	FRESULT ffs_res;
 	FILINFO fno;	//SD card information object
@@ -142,6 +274,7 @@ int InitLogFile1( void )
 	}
 
 	return status;
+#endif
 }
 
 /*
@@ -256,6 +389,8 @@ int MountSD1( FATFS * fs )
  *
  * This function takes a pointer to a char buffer and writes it
  *  into the log file.
+ * With LOG_FILE_BUFFERED the command only goes into the ring, LogFileTask() or
+ *  LogFileFlush() write it out later; if the ring is full it is flushed here first.
  *
  * @param	(char *)Pointer to a char buffer with the information to write
  * @param	(unsigned int)number of bytes to write into the log file
@@ -263,19 +398,35 @@ int MountSD1( FATFS * fs )
  */
 int LogFileWrite( char * write_buff, unsigned int bytes_to_write )
 {
+#if !LOG_FILE_BUFFERED
 	FIL logFile;		//the FAT file we want to work with
 	FRESULT ffs_res;	//FAT file system return type
+	unsigned int num_bytes_written = 0;
+#endif
 	char mynewline[2] = {'\n','\0'};
 	char last_command[50] = "";
 	int status = 0;
-	unsigned int num_bytes_written = 0;
+	XTime write_start = 0;
+	XTime write_end = 0;
 
+	XTime_GetTime(&write_start);
 	//need to append a newline '\n' to the end of the command to store it correctly
 	//write the contents of write_buff into a local buffer
 	strcat(last_command, write_buff);
 	//now append a newline on the end
 	strcat(last_command, mynewline);
+	if(bytes_to_write > sizeof(last_command))
+		bytes_to_write = sizeof(last_command);
 
+#if LOG_FILE_BUFFERED
+	status = CMD_SUCCESS;
+	if(m_log_waiting + bytes_to_write > LOG_RING_SIZE)
+		status = LogFileFlush();
+	if(m_log_waiting == 0)
+		m_log_oldest = write_start;
+	memcpy(&m_log_ring[m_log_waiting], last_command, bytes_to_write);
+	m_log_waiting += bytes_to_write;
+#else
 	/***** Write to log file on SD0 first *****/
 	//open with read/write access
 	ffs_res = f_open(&logFile, cLogFile0, FA_READ|FA_WRITE);
@@ -303,6 +454,84 @@ int LogFileWrite( char * write_buff, unsigned int bytes_to_write )
 		status = CMD_SUCCESS;
 	else
 		status = CMD_FAILURE;
+#endif
+
+	XTime_GetTime(&write_end);
+	m_log_writes++;
+	m_log_write_ticks += write_end - write_start;
+	if(write_end - write_start > m_log_write_max)
+		m_log_write_max = write_end - write_start;
+	return status;
+}
+
+/*
+ * Write the commands waiting in the ring to the log on both cards. Call this at the
+ *  points where the log should be whole on the cards: the end of a DAQ run, before
+ *  the log is sent down.
+ * Without LOG_FILE_BUFFERED every command is already on the cards.
+ *
+ * @param	None
+ *
+ * @return	Command SUCCESS (0), or FAILURE (1) if either card did not take them
+ */
+int LogFileFlush( void )
+{
+	int status = CMD_SUCCESS;
+#if LOG_FILE_BUFFERED
+	XTime flush_start = 0;
+	XTime flush_end = 0;
 
+	if(m_log_waiting == 0)
+		return CMD_SUCCESS;
+	XTime_GetTime(&flush_start);
+	AsyncSDWait();		//the flush may come during a DAQ run, while an EVT cluster is being written
+	if(WriteLogCard(0, m_log_ring, m_log_waiting) != CMD_SUCCESS)
+		status = CMD_FAILURE;
+	if(WriteLogCard(1, m_log_ring, m_log_waiting) != CMD_SUCCESS)
+		status = CMD_FAILURE;
+	m_log_waiting = 0;
+	XTime_GetTime(&flush_end);
+	m_log_flushes++;
+	m_log_flush_ticks += flush_end - flush_start;
+#endif
 	return status;
 }
+
+/*
+ * Scheduler task: flush the ring once LOG_FLUSH_BYTES are waiting, or the oldest command
+ *  has waited LOG_FLUSH_PERIOD_US.
+ *
+ * @param	(void *) Not used
+ */
+void LogFileTask( void * context )
+{
+#if LOG_FILE_BUFFERED
+	XTime now = 0;
+
+	if(m_log_waiting == 0)
+		return;
+	XTime_GetTime(&now);
+	if(m_log_waiting >= LOG_FLUSH_BYTES || now - m_log_oldest >= (XTime)LOG_FLUSH_PERIOD_US * (COUNTS_PER_SECOND / 1000000))
+		LogFileFlush();
+#endif
+	return;
+}
+
+/*
+ * Print the time command logging has taken since power on, what LogFileWrite() adds to
+ *  each command and what the flushes took, those LogFileWrite() had to do included.
+ * xil_printf() has no 64-bit support, times are printed in microseconds.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void LogFileReport( void )
+{
+	unsigned int write_us = (unsigned int)(m_log_write_ticks / (COUNTS_PER_SECOND / 1000000));
+
+	xil_printf("log buffered %d, %d commands, %d us/command, worst %d us, %d flushes, %d us flushing\n", LOG_FILE_BUFFERED,
+			m_log_writes, m_log_writes ? write_us / m_log_writes : 0, (unsigned int)(m_log_write_max / (COUNTS_PER_SECOND / 1000000)),
+			m_log_flushes, (unsigned int)(m_log_flush_ticks / (COUNTS_PER_SECOND / 1000000)));
+	return;
+}
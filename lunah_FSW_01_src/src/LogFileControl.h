@@ -9,9 +9,26 @@
 #define SRC_LOGFILECONTROL_H_
 
 #include <stdio.h>
+#include <string.h>
+#include <xtime_l.h>
 #include "ff.h"
 #include "xil_printf.h"
 #include "lunah_defines.h"
+#include "AsyncSDWrite.h"
+
+//Set to 1 to keep the log files open and gather the commands in RAM, see LogFileTask(), rather than
+// open, append to, and close the log on both cards for each command
+//After each flush the log ends in LOG_TAIL_MARKER, which the next flush writes over. What is on the
+// card is synced up to the marker, so a log which does not end in one was cut off part way through a flush
+#ifndef LOG_FILE_BUFFERED
+#define LOG_FILE_BUFFERED		0
+#endif
+
+#define LOG_RING_SIZE			1024					//bytes of commands which may wait for a flush
+#define LOG_FLUSH_BYTES			(LOG_RING_SIZE / 2)		//waiting bytes at which they are flushed
+#define LOG_FLUSH_PERIOD_US		10000000				//longest a command waits to be flushed
+#define LOG_TAIL_MARKER			"--LOG TAIL--\n"
+#define LOG_TAIL_MARKER_SIZE	(sizeof(LOG_TAIL_MARKER) - 1)
 
 int InitLogFile0( void );
 int InitLogFile1( void );
@@ -19,5 +36,8 @@ int MountSDCards( FATFS * fs );
 int MountSD0( FATFS * fs );
 int MountSD1( FATFS * fs );
 int LogFileWrite( char * write_buff, unsigned int bytes_to_write );
+int LogFileFlush( void );
+void LogFileTask( void * context );
+void LogFileReport( void );
 
 #endif /* SRC_LOGFILECONTROL_H_ */
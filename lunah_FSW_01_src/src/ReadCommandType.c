@@ -24,6 +24,7 @@ static int firstVal = 0;
 static int secondVal = 0;
 static int thirdVal = 0;
 static int fourthVal = 0;
+static int fifthVal = 0;
 static float ffirstVal = 0.0;
 static float fsecondVal = 0.0;
 static float fthirdVal = 0.0;
@@ -224,9 +225,11 @@ int ReadCommandType(char * RecvBuffer, XUartPs *Uart_PS) {
 				}
 				else if(!strcmp(commandBuffer, "TX"))
 				{
-					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d_%s", &detectorVal, m_filename_buff);
+					//file type, ID, run, and set number, then the packet to start from, which may be left off to send the whole file
+					fifthVal = 0;
+					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d_%d_%d_%d_%d_%d", &detectorVal, &firstVal, &secondVal, &thirdVal, &fourthVal, &fifthVal);
 
-					if(ret != 2)
+					if(ret != 5 && ret != 6)
 						commandNum = -1;
 					else
 						commandNum = TX_CMD;
@@ -256,16 +259,20 @@ int ReadCommandType(char * RecvBuffer, XUartPs *Uart_PS) {
 				}
 				else if(!strcmp(commandBuffer, "TXLOG"))
 				{
-					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d", &detectorVal);
-					if(ret != 1)
+					//the packet to start from may follow, see TX
+					firstVal = 0;
+					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d_%d", &detectorVal, &firstVal);
+					if(ret != 1 && ret != 2)
 						commandNum = -1;
 					else
 						commandNum = TXLOG_CMD;
 				}
 				else if(!strcmp(commandBuffer, "CONF"))
 				{
-					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d", &detectorVal);
-					if(ret != 1)
+					//the packet to start from may follow, see TX
+					firstVal = 0;
+					ret = sscanf(RecvBuffer + strlen(commandMNSBuf) + strlen(commandBuffer) + 2, " %d_%d", &detectorVal, &firstVal);
+					if(ret != 1 && ret != 2)
 						commandNum = -1;
 					else
 						commandNum = CONF_CMD;
@@ -415,10 +422,10 @@ int ReadCommandType(char * RecvBuffer, XUartPs *Uart_PS) {
 }
 
 /* Getter to access the parameters entered with a command */
-//This function accesses the firstVal-fourthVal integers which are set after
+//This function accesses the firstVal-fifthVal integers which are set after
 // a commanded function with parameters is read in.
 //
-// @param	param_num	This is a number (1-4) which is where in the parameter
+// @param	param_num	This is a number (1-5) which is where in the parameter
 // 						set the value appeared.
 //						eg. a full integration time is param_num = 4
 //
@@ -445,6 +452,10 @@ int GetIntParam( int param_num )
 		//get the first integer parameter
 		value = fourthVal;
 		break;
+	case 5:
+		//get the first integer parameter
+		value = fifthVal;
+		break;
 	default:
 		//if the param_num was weird
 		//set a ridiculous number that we can detect as an error
@@ -0,0 +1,618 @@
+/*
+ * SDMirror.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "SDMirror.h"
+
+#define SD_OP_OPEN		0	//create the copy, path holds where
+#define SD_OP_WRITE		1	//length bytes from block go to offset in the copy
+#define SD_OP_SYNC		2
+#define SD_OP_CLOSE		3
+
+typedef struct {
+	unsigned char type;			//SD_OP_*
+	unsigned char stream;		//SD_MIRROR_*
+	unsigned char card;			//the card the copy is on
+	unsigned char block;		//ring block holding the data, SD_OP_WRITE only
+	unsigned int gen;			//which of the stream's files this is for
+	DWORD offset;				//where the data goes in the file, SD_OP_WRITE only
+	unsigned int length;		//bytes of data, SD_OP_WRITE only
+	char path[SD_MIRROR_PATH_SIZE];	//SD_OP_OPEN only
+} SD_MIRROR_OP_TYPE;
+
+typedef struct {
+	int hot_card;				//the card the file is written to in the hot path
+	unsigned int gen;			//the file open on the stream, 0 for none yet
+	unsigned int drop_gen;		//the file whose copy has been given up, if any
+	DWORD missed;				//bytes the copy has been given which the hot file failed to take, see SDMirrorWrite()
+	FIL copy;					//the copy on the other card
+	unsigned int copy_gen;		//the file the copy is open for, 0 if not open
+	char copy_path[SD_MIRROR_PATH_SIZE];
+} SD_MIRROR_STREAM_TYPE;
+
+static SD_CARD_HEALTH_TYPE m_health[2];
+static SD_MIRROR_STREAM_TYPE m_streams[SD_MIRROR_STREAMS];
+static unsigned int m_gen;						//the last file generation handed out
+#if SD_MIRROR
+static unsigned int m_failovers;				//files switched over to their copy since boot
+static unsigned char m_pool[SD_MIRROR_BLOCKS][SD_MIRROR_BLOCK_SIZE] __attribute__((aligned(32)));	//the ring
+static int m_block_used[SD_MIRROR_BLOCKS];		//queued or reserved
+static int m_blocks_in_use;						//blocks queued or reserved
+static int m_reserved;							//the block handed out by SDMirrorReserve(), -1 for none
+static SD_MIRROR_OP_TYPE m_ops[SD_MIRROR_OPS];	//waiting for the catch-up, oldest at m_op_tail
+static unsigned int m_op_tail;
+static unsigned int m_op_count;
+static unsigned int m_lag_high_water;			//most blocks ever waiting for the catch-up
+static unsigned int m_copies_dropped;			//copies given up since boot
+static unsigned int m_copy_ops;					//operations done on the copies since boot
+static XTime m_catchup_ticks;					//total time spent on them
+#endif
+
+/*
+ * Reset the card health and the streams, once the cards are mounted at boot.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void SDMirrorInit( void )
+{
+	memset(m_health, 0, sizeof(m_health));
+	memset(m_streams, 0, sizeof(m_streams));
+	m_gen = 0;
+#if SD_MIRROR
+	m_failovers = 0;
+	memset(m_block_used, 0, sizeof(m_block_used));
+	m_blocks_in_use = 0;
+	m_reserved = -1;
+	m_op_tail = 0;
+	m_op_count = 0;
+	m_lag_high_water = 0;
+	m_copies_dropped = 0;
+	m_copy_ops = 0;
+	m_catchup_ticks = 0;
+#endif
+	return;
+}
+
+/*
+ * The card new files go on: SD0 unless it has been taken out of use and SD1 has not.
+ *
+ * @param	None
+ *
+ * @return	0 or 1, the drive number
+ */
+int SDMirrorGetActiveCard( void )
+{
+	if(m_health[0].failed && !m_health[1].failed)
+		return 1;
+	return 0;
+}
+
+SD_CARD_HEALTH_TYPE * SDMirrorGetHealth( int card )
+{
+	if(card < 0 || card > 1)
+		return NULL;
+	return &m_health[card];
+}
+
+/*
+ * Count the result of an operation on a card. Only the results which mean the card or the
+ *  link to it went wrong are errors; a full card or a missing file is not the card's fault.
+ * FR_INT_ERR is what FatFs gives for a file which has already had a disk error.
+ */
+static void CardResult( int card, FRESULT f_res )
+{
+	if(f_res == FR_OK)
+	{
+		m_health[card].writes++;
+		m_health[card].error_run = 0;
+		return;
+	}
+	if(f_res != FR_DISK_ERR && f_res != FR_NOT_READY && f_res != FR_INT_ERR)
+		return;
+	m_health[card].errors++;
+	m_health[card].error_run++;
+	if(m_health[card].failed == 0 && m_health[card].error_run >= SD_MIRROR_FAIL_LIMIT)
+	{
+		m_health[card].failed = 1;
+		xil_printf("19 SD%d failed\n", card);
+	}
+	return;
+}
+
+//open path on a card, making the folder it is in if that is not there yet
+static FRESULT OpenOnCard( FIL * fp, int card, const char * path, BYTE mode )
+{
+	char full_path[SD_MIRROR_PATH_SIZE + 2];
+	char * folder_end = NULL;
+	FRESULT f_res = FR_OK;
+
+	snprintf(full_path, sizeof(full_path), "%d:%s", card, path);
+	f_res = f_open(fp, full_path, mode);
+	folder_end = strrchr(full_path, '/');
+	if(f_res == FR_NO_PATH && folder_end != NULL && folder_end != &full_path[2])
+	{
+		*folder_end = '\0';
+		f_mkdir(full_path);
+		*folder_end = '/';
+		f_res = f_open(fp, full_path, mode);
+	}
+	return f_res;
+}
+
+#if SD_MIRROR
+//whether the writes to the stream's current file are still being queued for its copy
+static int MirrorOn( SD_MIRROR_STREAM_TYPE * s )
+{
+	return s->gen != 0 && s->drop_gen != s->gen && m_health[1 - s->hot_card].failed == 0;
+}
+
+//give up the copy of the stream's current file, the catch-up deletes what there is of it
+static void DropStream( SD_MIRROR_STREAM_TYPE * s )
+{
+	if(s->drop_gen == s->gen)
+		return;
+	s->drop_gen = s->gen;
+	m_copies_dropped++;
+	return;
+}
+
+static int TakeBlock( void )
+{
+	int block = 0;
+
+	for(block = 0; block < SD_MIRROR_BLOCKS; block++)
+	{
+		if(m_block_used[block] == 0)
+		{
+			m_block_used[block] = 1;
+			m_blocks_in_use++;
+			return block;
+		}
+	}
+	return -1;
+}
+
+static void FreeBlock( int block )
+{
+	m_block_used[block] = 0;
+	m_blocks_in_use--;
+	return;
+}
+
+//blocks waiting for the catch-up, the reserved one is not
+static int BlocksQueued( void )
+{
+	return m_blocks_in_use - (m_reserved >= 0 ? 1 : 0);
+}
+
+//the newest queued operation, NULL if there is none
+static SD_MIRROR_OP_TYPE * LastOp( void )
+{
+	if(m_op_count == 0)
+		return NULL;
+	return &m_ops[(m_op_tail + m_op_count - 1) % SD_MIRROR_OPS];
+}
+
+//queue an operation on the stream's copy, the copy is given up if the queue is full
+static SD_MIRROR_OP_TYPE * QueueOp( int stream, int type )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	SD_MIRROR_OP_TYPE * op = NULL;
+
+	if(m_op_count == SD_MIRROR_OPS)
+	{
+		DropStream(s);
+		return NULL;
+	}
+	op = &m_ops[(m_op_tail + m_op_count) % SD_MIRROR_OPS];
+	op->type = (unsigned char)type;
+	op->stream = (unsigned char)stream;
+	op->card = (unsigned char)(1 - s->hot_card);
+	op->gen = s->gen;
+	op->offset = 0;
+	op->length = 0;
+	m_op_count++;
+	return op;
+}
+
+/*
+ * Queue the data just written at offset in the hot file for the copy. The reserved block is
+ *  queued as it is; anything else is copied into the ring, onto the end of the last write if
+ *  that was to the same place in the same file and there is room.
+ */
+static void QueueWrite( int stream, const void * buff, DWORD offset, UINT length )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	SD_MIRROR_OP_TYPE * op = NULL;
+	const unsigned char * data = (const unsigned char *)buff;
+	unsigned int chunk = 0;
+	int block = 0;
+
+	if(MirrorOn(s) == 0)
+		return;
+	if(m_reserved >= 0 && buff == m_pool[m_reserved])
+	{
+		op = QueueOp(stream, SD_OP_WRITE);
+		if(op == NULL)
+			return;
+		op->block = (unsigned char)m_reserved;
+		op->offset = offset;
+		op->length = length;
+		m_reserved = -1;
+	}
+	while(op == NULL && length != 0)
+	{
+		op = LastOp();
+		if(op != NULL && op->type == SD_OP_WRITE && op->stream == stream && op->gen == s->gen
+				&& op->offset + op->length == offset && op->length < SD_MIRROR_BLOCK_SIZE)
+		{
+			chunk = SD_MIRROR_BLOCK_SIZE - op->length;
+		}
+		else
+		{
+			block = TakeBlock();
+			if(block < 0)
+			{
+				DropStream(s);
+				return;
+			}
+			op = QueueOp(stream, SD_OP_WRITE);
+			if(op == NULL)
+			{
+				FreeBlock(block);
+				return;
+			}
+			op->block = (unsigned char)block;
+			op->offset = offset;
+			chunk = SD_MIRROR_BLOCK_SIZE;
+		}
+		if(chunk > length)
+			chunk = length;
+		memcpy(&m_pool[op->block][op->length], data, chunk);
+		op->length += chunk;
+		data += chunk;
+		offset += chunk;
+		length -= chunk;
+		op = NULL;
+	}
+	if(BlocksQueued() > m_lag_high_water)
+		m_lag_high_water = BlocksQueued();
+	return;
+}
+
+//close and delete the copy which is open on the stream, if there is one
+static void DeleteCopy( SD_MIRROR_STREAM_TYPE * s, int card )
+{
+	char full_path[SD_MIRROR_PATH_SIZE + 2];
+
+	if(s->copy_gen == 0)
+		return;
+	f_close(&s->copy);
+	s->copy_gen = 0;
+	if(m_health[card].failed == 0)
+	{
+		snprintf(full_path, sizeof(full_path), "%d:%s", card, s->copy_path);
+		f_unlink(full_path);
+	}
+	return;
+}
+
+//delete the copy if it is one which has been given up
+static void CheckDropped( SD_MIRROR_STREAM_TYPE * s, int card )
+{
+	if(s->copy_gen != 0 && s->copy_gen == s->drop_gen)
+		DeleteCopy(s, card);
+	return;
+}
+
+/*
+ * Do the oldest queued operation on its copy. A copy which misses any of its data is given up.
+ */
+static void RunOp( void )
+{
+	SD_MIRROR_OP_TYPE * op = &m_ops[m_op_tail];
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[op->stream];
+	unsigned int bytes_written = 0;
+	int used_card = 1;
+	FRESULT f_res = FR_OK;
+	XTime op_start;
+	XTime op_end;
+
+	XTime_GetTime(&op_start);
+	if(m_health[op->card].failed)
+	{
+		//the copies on a card which is out of use are left as they are
+		s->copy_gen = 0;
+		used_card = 0;
+	}
+	else if(op->gen == s->drop_gen)
+		used_card = 0;
+	else if(op->type == SD_OP_OPEN)
+	{
+		if(s->copy_gen != 0)
+			f_close(&s->copy);	//the last copy's close was not queued
+		strcpy(s->copy_path, op->path);
+		f_res = OpenOnCard(&s->copy, op->card, op->path, FA_CREATE_ALWAYS | FA_WRITE | FA_READ);
+		s->copy_gen = (f_res == FR_OK) ? op->gen : 0;
+	}
+	else if(s->copy_gen != op->gen)
+		used_card = 0;			//the open failed, the copy was given up then
+	else if(op->type == SD_OP_WRITE)
+	{
+		if(f_tell(&s->copy) != op->offset)
+			f_res = f_lseek(&s->copy, op->offset);
+		if(f_res == FR_OK)
+			f_res = f_write(&s->copy, m_pool[op->block], op->length, &bytes_written);
+		if(f_res == FR_OK && bytes_written != op->length)
+			f_res = FR_DENIED;	//the card is full
+		if(f_res == FR_OK)
+			m_health[op->card].bytes += bytes_written;
+	}
+	else if(op->type == SD_OP_SYNC)
+		f_res = f_sync(&s->copy);
+	else
+	{
+		//a close which fails is left for DeleteCopy() below
+		f_res = f_close(&s->copy);
+		if(f_res == FR_OK)
+			s->copy_gen = 0;
+	}
+
+	if(used_card)
+	{
+		CardResult(op->card, f_res);
+		m_copy_ops++;
+	}
+	if(f_res != FR_OK)
+	{
+		//the copy has missed some of its data, the rest of its operations find it gone
+		if(s->gen == op->gen)
+			DropStream(s);
+		else
+			m_copies_dropped++;	//a file which is already closed on the hot card
+		DeleteCopy(s, op->card);
+	}
+	else
+		CheckDropped(s, op->card);
+	if(op->type == SD_OP_WRITE)
+		FreeBlock(op->block);
+	m_op_tail = (m_op_tail + 1) % SD_MIRROR_OPS;
+	m_op_count--;
+	XTime_GetTime(&op_end);
+	m_catchup_ticks += op_end - op_start;
+	return;
+}
+
+/*
+ * The hot card has been taken out of use part way through a file. Catch up the copy and
+ *  carry on from it in the hot file's place: the FIL is open on the other card, at resume.
+ *
+ * @return	FR_OK if the copy took over, else FR_DISK_ERR
+ */
+static FRESULT FailOver( int stream, FIL * hot, DWORD resume )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	FRESULT f_res = FR_OK;
+
+	if(MirrorOn(s) == 0)
+		return FR_DISK_ERR;
+	SDMirrorSettle();
+	if(s->copy_gen != s->gen || s->drop_gen == s->gen)
+		return FR_DISK_ERR;
+	*hot = s->copy;		//the FIL on the dead card is left open, there is nothing to close it on
+	s->copy_gen = 0;
+	s->missed = 0;
+	s->hot_card = 1 - s->hot_card;
+	m_failovers++;
+	xil_printf("19 SD%d takes over %s\n", s->hot_card, s->copy_path);
+	if(f_tell(hot) != resume)
+		f_res = f_lseek(hot, resume);
+	return f_res;
+}
+#endif
+
+/*
+ * Open a data product file on the active card, and queue the copy to be made on the other.
+ * If the open takes the card out of use, the file is opened on the other card instead.
+ *
+ * @param	(int) SD_MIRROR_*
+ * @param	(FIL *) The file to open, it is written through the SDMirror*() calls from here on
+ * @param	(const char *) Path with no drive, see SDMirror.h
+ * @param	(BYTE) f_open() mode
+ *
+ * @return	What f_open() returned
+ */
+FRESULT SDMirrorOpen( int stream, FIL * hot, const char * path, BYTE mode )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	FRESULT f_res = FR_OK;
+#if SD_MIRROR
+	SD_MIRROR_OP_TYPE * op = NULL;
+#endif
+
+	s->hot_card = SDMirrorGetActiveCard();
+	f_res = OpenOnCard(hot, s->hot_card, path, mode);
+	CardResult(s->hot_card, f_res);
+	if(f_res != FR_OK && s->hot_card != SDMirrorGetActiveCard())
+	{
+		s->hot_card = SDMirrorGetActiveCard();
+		f_res = OpenOnCard(hot, s->hot_card, path, mode);
+		CardResult(s->hot_card, f_res);
+	}
+	s->gen = ++m_gen;
+	s->missed = 0;
+	if(f_res != FR_OK)
+	{
+		s->drop_gen = s->gen;
+		return f_res;
+	}
+#if SD_MIRROR
+	if(MirrorOn(s) == 0)
+		return f_res;
+	if(strlen(path) >= SD_MIRROR_PATH_SIZE)
+	{
+		DropStream(s);
+		return f_res;
+	}
+	op = QueueOp(stream, SD_OP_OPEN);
+	if(op != NULL)
+		strcpy(op->path, path);
+#endif
+	return f_res;
+}
+
+/*
+ * f_write() to the hot file, and queue the data for the copy.
+ * If the write takes the hot card out of use, the copy is caught up and takes the file over,
+ *  with this write already in it.
+ *
+ * @param	(int) SD_MIRROR_*
+ * @param	(FIL *) The file, opened with SDMirrorOpen()
+ * @param	(const void *) The data, from the reserved block it is not copied
+ * @param	(UINT) Bytes to write
+ * @param	(UINT *) Bytes written
+ *
+ * @return	What f_write() returned, FR_OK if the copy took over
+ */
+FRESULT SDMirrorWrite( int stream, FIL * hot, const void * buff, UINT btw, UINT * bw )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	FRESULT f_res = FR_OK;
+#if SD_MIRROR
+	//a write which fails leaves the file pointer where it was; the copy goes on past it all the same
+	DWORD offset = f_tell(hot) + s->missed;
+
+	QueueWrite(stream, buff, offset, btw);
+#endif
+	f_res = f_write(hot, buff, btw, bw);
+	CardResult(s->hot_card, f_res);
+	if(f_res == FR_OK)
+		m_health[s->hot_card].bytes += *bw;
+#if SD_MIRROR
+	if(f_res != FR_OK)
+		s->missed += btw - *bw;
+	if(f_res != FR_OK && m_health[s->hot_card].failed)
+	{
+		f_res = FailOver(stream, hot, offset + btw);
+		if(f_res == FR_OK)
+			*bw = btw;
+	}
+#endif
+	return f_res;
+}
+
+/*
+ * f_sync() the hot file, and queue the same for the copy.
+ */
+FRESULT SDMirrorSync( int stream, FIL * hot )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	FRESULT f_res = FR_OK;
+#if SD_MIRROR
+	SD_MIRROR_OP_TYPE * op = LastOp();
+
+	//nothing written since the last sync was queued, one does for both
+	if(MirrorOn(s) && (op == NULL || op->type != SD_OP_SYNC || op->stream != stream || op->gen != s->gen))
+		QueueOp(stream, SD_OP_SYNC);
+#endif
+	f_res = f_sync(hot);
+	CardResult(s->hot_card, f_res);
+#if SD_MIRROR
+	if(f_res != FR_OK && m_health[s->hot_card].failed)
+		f_res = FailOver(stream, hot, f_tell(hot) + s->missed);
+#endif
+	return f_res;
+}
+
+/*
+ * f_close() the hot file, and queue the same for the copy.
+ */
+FRESULT SDMirrorClose( int stream, FIL * hot )
+{
+	SD_MIRROR_STREAM_TYPE * s = &m_streams[stream];
+	FRESULT f_res = FR_OK;
+
+#if SD_MIRROR
+	if(MirrorOn(s))
+		QueueOp(stream, SD_OP_CLOSE);
+#endif
+	f_res = f_close(hot);
+	CardResult(s->hot_card, f_res);
+	return f_res;
+}
+
+/*
+ * Hand out a ring block to fill, so that a write from it to SDMirrorWrite() goes to the copy
+ *  without being copied. The same block is handed out until it has been written; the caller
+ *  must not touch it after that.
+ *
+ * @param	None
+ *
+ * @return	The block, SD_MIRROR_BLOCK_SIZE bytes, or NULL if the ring is full (or SD_MIRROR is 0)
+ */
+void * SDMirrorReserve( void )
+{
+#if SD_MIRROR
+	if(m_reserved < 0)
+		m_reserved = TakeBlock();
+	if(m_reserved < 0)
+		return NULL;
+	return m_pool[m_reserved];
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Catch-up for the copies, run from the scheduler during a run.
+ * Does at most one queued operation, and only when the pipeline had nothing to do this pass
+ *  or SD_MIRROR_URGENT blocks are waiting.
+ *
+ * @param	(int) 1 if the pipeline had nothing to do this pass
+ *
+ * @return	None
+ */
+void SDMirrorService( int idle )
+{
+#if SD_MIRROR
+	if(m_op_count == 0)
+		return;
+	if(idle == 0 && BlocksQueued() < SD_MIRROR_URGENT)
+		return;
+	RunOp();
+#endif
+	return;
+}
+
+/*
+ * Catch the copies all the way up, when nothing else needs the time.
+ */
+void SDMirrorSettle( void )
+{
+#if SD_MIRROR
+	int stream = 0;
+
+	while(m_op_count != 0)
+		RunOp();
+	for(stream = 0; stream < SD_MIRROR_STREAMS; stream++)
+		CheckDropped(&m_streams[stream], 1 - m_streams[stream].hot_card);
+#endif
+	return;
+}
+
+void SDMirrorReport( void )
+{
+	int card = 0;
+
+	for(card = 0; card < 2; card++)
+		xil_printf("SD%d %d writes, %d KiB, %d errors%s\n", card, m_health[card].writes, m_health[card].bytes / 1024, m_health[card].errors, m_health[card].failed ? ", out of use" : "");
+#if SD_MIRROR
+	xil_printf("Mirror %d of %d blocks most behind, %d copies dropped, %d failovers, %d us on %d copy operations\n", m_lag_high_water, SD_MIRROR_BLOCKS, m_copies_dropped, m_failovers, (int)(m_catchup_ticks / (COUNTS_PER_SECOND / 1000000)), m_copy_ops);
+#endif
+	return;
+}
@@ -0,0 +1,79 @@
+/*
+ * SDMirror.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Writer for the data products (EVT, CPS, 2DH, config) which keeps a copy of each file on
+ *  the other SD card.
+ * The hot card is written as before, in the hot path. Each write is also queued, with the
+ *  offset it went to, in a ring of SD_MIRROR_BLOCKS cluster sized blocks; the copy is written
+ *  from the ring later by SDMirrorService(), so nothing is read back off the hot card. An EVT
+ *  cluster is filled in a ring block to begin with (see SDMirrorReserve()) and is not copied at all.
+ *
+ * The copy lags the hot file by at most the ring. The catch-up is throttled: one queued
+ *  operation a pass, and only when the pipeline had nothing to do unless the ring is half
+ *  full. When the ring or the operation queue is full the copy of that file is given up and
+ *  deleted, rather than the acquisition waiting on the other card; a copy on the other card
+ *  is either whole up to its last catch-up or not there.
+ *
+ * Each card has health counters. SD_MIRROR_FAIL_LIMIT card errors in a row take a card out
+ *  of use: a file open on it is switched over to its copy, which is caught up first, and new
+ *  files go to the other card from then on, see SDMirrorGetActiveCard(). With SD_MIRROR 0
+ *  nothing is copied, the files are opened and written straight through and only the move to
+ *  the other card for new files is left.
+ *
+ * The paths handed in have no drive, "/I0001_R0001/evt_S0000.bin"; the drive is the card.
+ */
+
+#ifndef SRC_SDMIRROR_H_
+#define SRC_SDMIRROR_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <xtime_l.h>
+#include "xil_printf.h"
+#include "ff.h"
+#include "lunah_defines.h"
+
+//Set to 1 to keep a copy of the data products on the other SD card
+#ifndef SD_MIRROR
+#define SD_MIRROR				0
+#endif
+
+#define SD_MIRROR_BLOCKS		8			//blocks in the ring, the most the copy may lag by
+#define SD_MIRROR_BLOCK_SIZE	EVT_DATA_BUFF_SIZE
+#define SD_MIRROR_OPS			32			//operations which may be queued for the copies
+#define SD_MIRROR_URGENT		(SD_MIRROR_BLOCKS / 2)	//blocks waiting at which the catch-up runs every pass
+#define SD_MIRROR_FAIL_LIMIT	3			//card errors in a row which take a card out of use
+#define SD_MIRROR_PATH_SIZE		32
+
+//Streams, each has one file open at a time
+#define SD_MIRROR_EVT			0
+#define SD_MIRROR_CPS			1
+#define SD_MIRROR_2DH			2
+#define SD_MIRROR_CFG			3
+#define SD_MIRROR_STREAMS		4
+
+typedef struct {
+	unsigned int writes;		//writes and syncs which went through
+	unsigned int bytes;			//bytes written
+	unsigned int errors;		//card errors, see CardResult()
+	unsigned int error_run;		//card errors since the last operation which went through
+	int failed;					//taken out of use, see SD_MIRROR_FAIL_LIMIT
+} SD_CARD_HEALTH_TYPE;
+
+//function prototypes
+void SDMirrorInit( void );
+int SDMirrorGetActiveCard( void );
+SD_CARD_HEALTH_TYPE * SDMirrorGetHealth( int card );
+FRESULT SDMirrorOpen( int stream, FIL * hot, const char * path, BYTE mode );
+FRESULT SDMirrorWrite( int stream, FIL * hot, const void * buff, UINT btw, UINT * bw );
+FRESULT SDMirrorSync( int stream, FIL * hot );
+FRESULT SDMirrorClose( int stream, FIL * hot );
+void * SDMirrorReserve( void );
+void SDMirrorService( int idle );
+void SDMirrorSettle( void );
+void SDMirrorReport( void );
+
+#endif /* SRC_SDMIRROR_H_ */
@@ -0,0 +1,261 @@
+/*
+ * Scheduler.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ */
+
+#include "Scheduler.h"
+
+#define SCHED_TICKS_PER_US	(COUNTS_PER_SECOND / 1000000)
+
+static SCHED_TASK_TYPE m_tasks[SCHED_MAX_TASKS];	//the task table
+static int m_stop_value = SCHED_RUNNING;			//set by SchedStop() to end the pass
+
+/*
+ * Empty the task table.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void SchedInit( void )
+{
+	memset(m_tasks, 0, sizeof(m_tasks));
+	m_stop_value = SCHED_RUNNING;
+	return;
+}
+
+/*
+ * Put a task in a slot, replacing whatever was there, and enable it.
+ * The first release is one period from now, or right away for a period of 0.
+ * The statistics for the slot start over.
+ *
+ * @param	(int) The slot, SCHED_TASK_*
+ * @param	(const char *) Name for the statistics report
+ * @param	(SCHED_TASK_FN) The task function
+ * @param	(void *) Context handed to the task function each time it runs
+ * @param	(XTime) Period in microseconds, 0 to run on every pass
+ * @param	(XTime) Deadline in microseconds after each release, 0 for none
+ *
+ * @return	CMD_SUCCESS/CMD_FAILURE for a bad slot or function
+ */
+int SchedAddTask( int id, const char * name, SCHED_TASK_FN run, void * context, XTime period_us, XTime deadline_us )
+{
+	XTime now;
+
+	if(id < 0 || id >= SCHED_MAX_TASKS || run == NULL)
+		return CMD_FAILURE;
+
+	XTime_GetTime(&now);
+	memset(&m_tasks[id], 0, sizeof(SCHED_TASK_TYPE));
+	m_tasks[id].name = name;
+	m_tasks[id].run = run;
+	m_tasks[id].context = context;
+	m_tasks[id].period = period_us * SCHED_TICKS_PER_US;
+	m_tasks[id].deadline = deadline_us * SCHED_TICKS_PER_US;
+	m_tasks[id].release = now + m_tasks[id].period;
+	m_tasks[id].enabled = 1;
+	return CMD_SUCCESS;
+}
+
+/*
+ * Empty a slot. The statistics stay until the next SchedResetStats() or SchedAddTask().
+ *
+ * @param	(int) The slot, SCHED_TASK_*
+ *
+ * @return	None
+ */
+void SchedRemoveTask( int id )
+{
+	if(id < 0 || id >= SCHED_MAX_TASKS)
+		return;
+	m_tasks[id].run = NULL;
+	m_tasks[id].enabled = 0;
+	return;
+}
+
+/*
+ * Turn a task on or off without losing its place in the table or its statistics.
+ * A task which is turned back on is released right away.
+ *
+ * @param	(int) The slot, SCHED_TASK_*
+ * @param	(int) 1 to run the task, 0 to skip it
+ *
+ * @return	None
+ */
+void SchedEnableTask( int id, int enabled )
+{
+	if(id < 0 || id >= SCHED_MAX_TASKS)
+		return;
+	if(enabled == 1 && m_tasks[id].enabled == 0)
+		XTime_GetTime(&(m_tasks[id].release));
+	m_tasks[id].enabled = enabled;
+	return;
+}
+
+/*
+ * Called by a task to end the pass it is running in. SchedRun()/SchedRunPass() return the value.
+ *
+ * @param	(int) The value to return, a command from ReadCommandType() or SCHED_STOP_*
+ *
+ * @return	None
+ */
+void SchedStop( int value )
+{
+	m_stop_value = value;
+	return;
+}
+
+/*
+ * Record one run of a task.
+ */
+static void SchedRecordRun( SCHED_TASK_TYPE * task, XTime start, XTime end )
+{
+	XTime ticks = end - start;
+	XTime us = ticks / SCHED_TICKS_PER_US;
+	int bin = 0;
+
+	while(us != 0 && bin < SCHED_HIST_BINS - 1)
+	{
+		us >>= 1;
+		bin++;
+	}
+	task->histogram[bin]++;
+	task->runs++;
+	task->total_ticks += ticks;
+	if(ticks > task->max_ticks)
+		task->max_ticks = ticks;
+	if(task->deadline != 0 && (start - task->release) > task->deadline)
+		task->late++;
+	return;
+}
+
+/*
+ * Run every enabled task which is due once, in slot order.
+ * The next release of a periodic task stays in phase with its first; if the task fell behind
+ *  by more than a period, the missed releases are skipped rather than run back to back.
+ *
+ * @param	None
+ *
+ * @return	The value a task gave SchedStop(), SCHED_RUNNING if none did
+ */
+int SchedRunPass( void )
+{
+	int id = 0;
+	XTime start;
+	XTime end;
+	SCHED_TASK_TYPE * task = NULL;
+
+	m_stop_value = SCHED_RUNNING;
+	for(id = 0; id < SCHED_MAX_TASKS; id++)
+	{
+		task = &m_tasks[id];
+		if(task->run == NULL || task->enabled == 0)
+			continue;
+		XTime_GetTime(&start);
+		if(start < task->release)
+			continue;
+
+		task->run(task->context);
+		XTime_GetTime(&end);
+		SchedRecordRun(task, start, end);
+
+		if(task->period == 0)
+			task->release = end;	//the deadline is then the longest gap between runs
+		else
+		{
+			while(task->release <= end)
+				task->release += task->period;
+		}
+
+		if(m_stop_value != SCHED_RUNNING)
+			break;
+	}
+	return m_stop_value;
+}
+
+/*
+ * Run passes over the task table until a task calls SchedStop().
+ *
+ * @param	None
+ *
+ * @return	The value the task gave SchedStop()
+ */
+int SchedRun( void )
+{
+	int value = SCHED_RUNNING;
+
+	while(value == SCHED_RUNNING)
+		value = SchedRunPass();
+	return value;
+}
+
+/*
+ * Getter function for a task slot, for its statistics.
+ *
+ * @param	(int) The slot, SCHED_TASK_*
+ *
+ * @return	(SCHED_TASK_TYPE *) The slot, NULL for a bad slot number
+ */
+SCHED_TASK_TYPE * SchedGetTask( int id )
+{
+	if(id < 0 || id >= SCHED_MAX_TASKS)
+		return NULL;
+	return &m_tasks[id];
+}
+
+/*
+ * Clear the statistics for every task, the tasks themselves are left alone.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void SchedResetStats( void )
+{
+	int id = 0;
+
+	for(id = 0; id < SCHED_MAX_TASKS; id++)
+	{
+		m_tasks[id].runs = 0;
+		m_tasks[id].late = 0;
+		m_tasks[id].total_ticks = 0;
+		m_tasks[id].max_ticks = 0;
+		memset(m_tasks[id].histogram, 0, sizeof(m_tasks[id].histogram));
+	}
+	return;
+}
+
+/*
+ * Print where the time went for each task which ran since the last reset, removed ones included:
+ *  the run and late counts, the average and longest execution time, and the non-empty
+ *  histogram bins as <upper bound us>:<count>.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+void SchedReportStats( void )
+{
+	int id = 0;
+	int bin = 0;
+	SCHED_TASK_TYPE * task = NULL;
+
+	for(id = 0; id < SCHED_MAX_TASKS; id++)
+	{
+		task = &m_tasks[id];
+		if(task->runs == 0)
+			continue;
+		xil_printf("%s runs %d late %d avg %d us max %d us\n", task->name, task->runs, task->late,
+				(unsigned int)(task->total_ticks / task->runs / SCHED_TICKS_PER_US),
+				(unsigned int)(task->max_ticks / SCHED_TICKS_PER_US));
+		for(bin = 0; bin < SCHED_HIST_BINS; bin++)
+		{
+			if(task->histogram[bin] != 0)
+				xil_printf(" %d:%d", 1 << bin, task->histogram[bin]);
+		}
+		xil_printf("\n");
+	}
+	return;
+}
@@ -0,0 +1,76 @@
+/*
+ * Scheduler.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Cooperative run-to-completion scheduler for the polling loops.
+ * Each task has a slot in a fixed table, a period, and a deadline. A pass over the table runs
+ *  every enabled task whose release time has come, in slot order, so the lower slots have the
+ *  higher priority. A task with a period of 0 is released on every pass.
+ * Nothing is pre-empted; a task which runs long makes the others late, which is what the
+ *  per-task late count and execution time histogram are there to show.
+ * Any task may end the current SchedRun() with SchedStop(), the command task does this
+ *  with each command it reads.
+ */
+
+#ifndef SRC_SCHEDULER_H_
+#define SRC_SCHEDULER_H_
+
+#include <string.h>
+#include <xtime_l.h>
+#include "xil_printf.h"
+#include "lunah_defines.h"
+
+//Task slots, lowest runs first in each pass
+#define SCHED_TASK_CMD			0	//poll the UART for a command
+#define SCHED_TASK_SOH			1	//SOH packet, 1 Hz
+#define SCHED_TASK_TEMP			2	//temperature sensors
+#define SCHED_TASK_RUN_TIMER	3	//DAQ run time out
+#define SCHED_TASK_DMA			4	//DAQ, move buffers out of the DMA
+#define SCHED_TASK_PROCESS		5	//DAQ, process the buffers into events
+#define SCHED_TASK_SD_FLUSH		6	//DAQ, write events to the SD card
+#define SCHED_TASK_CPS_FLUSH	7	//DAQ, write the buffered CPS events to the SD card
+#define SCHED_TASK_SD_MIRROR	8	//DAQ, catch up the copies on the other SD card
+#define SCHED_TASK_LOG			9	//write the buffered commands to the log files
+#define SCHED_TASK_DIAG			10	//DAQ, diagnostic packet
+#define SCHED_TASK_TX			11	//downlink, send the next packet of the file
+#define SCHED_MAX_TASKS			12
+
+#define SCHED_HIST_BINS			20	//bin 0 is < 1 us, bin n is [2^(n-1), 2^n) us, the last bin is everything longer
+
+//SchedRun()/SchedRunPass() return values which are not commands
+#define SCHED_RUNNING			999	//nothing stopped the pass, same as ReadCommandType() with no input
+#define SCHED_STOP_TIMER		1000	//a timer task ran out
+#define SCHED_STOP_DONE			1001	//a task has nothing left to do
+
+typedef void (*SCHED_TASK_FN)( void * context );
+
+typedef struct {
+	const char * name;
+	SCHED_TASK_FN run;			//NULL when the slot is empty
+	void * context;				//handed to run()
+	int enabled;
+	XTime period;				//ticks between releases, 0 = every pass
+	XTime deadline;				//ticks after its release the task must have started by, 0 = none
+	XTime release;				//when the task is next due
+	unsigned int runs;
+	unsigned int late;			//runs which started after their deadline
+	XTime total_ticks;
+	XTime max_ticks;
+	unsigned int histogram[SCHED_HIST_BINS];	//execution times, see SCHED_HIST_BINS
+} SCHED_TASK_TYPE;
+
+//function prototypes
+void SchedInit( void );
+int SchedAddTask( int id, const char * name, SCHED_TASK_FN run, void * context, XTime period_us, XTime deadline_us );
+void SchedRemoveTask( int id );
+void SchedEnableTask( int id, int enabled );
+void SchedStop( int value );
+int SchedRunPass( void );
+int SchedRun( void );
+SCHED_TASK_TYPE * SchedGetTask( int id );
+void SchedResetStats( void );
+void SchedReportStats( void );
+
+#endif /* SRC_SCHEDULER_H_ */
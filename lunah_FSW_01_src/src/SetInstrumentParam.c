@@ -8,9 +8,10 @@
  */
 
 #include "SetInstrumentParam.h"
+#include "process_data.h"
 
 //File-Scope Variables
-static char cConfigFile[] = "0:/MNSCONF.bin";
+static char cConfigFile[] = "0:/MNSCONF.bin";	//read from SD0, written through the mirror without the drive
 static CONFIG_STRUCT_TYPE ConfigBuff;
 static int m_trigger_threshold;
 static int m_baseline_integration_samples;
@@ -125,6 +126,35 @@ int GetFullInt( void )
 	return m_full_integration_samples;
 }
 
+/*
+ * Take on a copy of another core's configuration, without touching the FPGA or the SD card.
+ * In the AMP build CPU1 processes the data, but only CPU0 can read the config file, so
+ *  CPU0 passes its config over at the start of each run.
+ *
+ * @param	(CONFIG_STRUCT_TYPE *) The config to copy
+ *
+ * @return	None
+ */
+void LoadConfigBuffer( CONFIG_STRUCT_TYPE * config )
+{
+	ConfigBuff = *config;
+	m_baseline_integration_samples = (INTEG_TIME_START + ConfigBuff.IntegrationBaseline) / NS_TO_SAMPLES + 1;
+	m_short_integration_samples = (INTEG_TIME_START + ConfigBuff.IntegrationShort) / NS_TO_SAMPLES + 1;
+	m_long_integration_samples = (INTEG_TIME_START + ConfigBuff.IntegrationLong) / NS_TO_SAMPLES + 1;
+	m_full_integration_samples = (INTEG_TIME_START + ConfigBuff.IntegrationFull) / NS_TO_SAMPLES + 1;
+	SetEnergyScale(m_baseline_integration_samples);
+	cpsSetEnergyCal(ConfigBuff.ECalSlope, ConfigBuff.ECalIntercept);
+	cpsSetCut(1, 1, ConfigBuff.ScaleFactorEnergy_1_1, ConfigBuff.ScaleFactorPSD_1_1, ConfigBuff.OffsetEnergy_1_1, ConfigBuff.OffsetPSD_1_1);
+	cpsSetCut(1, 2, ConfigBuff.ScaleFactorEnergy_1_2, ConfigBuff.ScaleFactorPSD_1_2, ConfigBuff.OffsetEnergy_1_2, ConfigBuff.OffsetPSD_1_2);
+	cpsSetCut(2, 1, ConfigBuff.ScaleFactorEnergy_2_1, ConfigBuff.ScaleFactorPSD_2_1, ConfigBuff.OffsetEnergy_2_1, ConfigBuff.OffsetPSD_2_1);
+	cpsSetCut(2, 2, ConfigBuff.ScaleFactorEnergy_2_2, ConfigBuff.ScaleFactorPSD_2_2, ConfigBuff.OffsetEnergy_2_2, ConfigBuff.OffsetPSD_2_2);
+	cpsSetCut(3, 1, ConfigBuff.ScaleFactorEnergy_3_1, ConfigBuff.ScaleFactorPSD_3_1, ConfigBuff.OffsetEnergy_3_1, ConfigBuff.OffsetPSD_3_1);
+	cpsSetCut(3, 2, ConfigBuff.ScaleFactorEnergy_3_2, ConfigBuff.ScaleFactorPSD_3_2, ConfigBuff.OffsetEnergy_3_2, ConfigBuff.OffsetPSD_3_2);
+	cpsSetCut(4, 1, ConfigBuff.ScaleFactorEnergy_4_1, ConfigBuff.ScaleFactorPSD_4_1, ConfigBuff.OffsetEnergy_4_1, ConfigBuff.OffsetPSD_4_1);
+	cpsSetCut(4, 2, ConfigBuff.ScaleFactorEnergy_4_2, ConfigBuff.ScaleFactorPSD_4_2, ConfigBuff.OffsetEnergy_4_2, ConfigBuff.OffsetPSD_4_2);
+	return;
+}
+
 /* This function handles initializing the system with the values from the config file.
  * If no config file exists, one will be created using the default (hard coded) values
  *  available to the system.
@@ -157,10 +187,11 @@ int InitConfig( void )
 	else if(fres == FR_NO_FILE)// The config file does not exist, create it
 	{
 		CreateDefaultConfig();
-		fres = f_open(&ConfigFile, cConfigFile, FA_READ|FA_WRITE|FA_OPEN_ALWAYS);
+		fres = SDMirrorOpen(SD_MIRROR_CFG, &ConfigFile, &cConfigFile[2], FA_READ|FA_WRITE|FA_OPEN_ALWAYS);
 		if(fres == FR_OK)
-			fres = f_write(&ConfigFile, &ConfigBuff, ConfigSize, &NumBytesWr);
-		f_close(&ConfigFile);
+			fres = SDMirrorWrite(SD_MIRROR_CFG, &ConfigFile, &ConfigBuff, ConfigSize, &NumBytesWr);
+		SDMirrorClose(SD_MIRROR_CFG, &ConfigFile);
+		SDMirrorSettle();
 	}
 	else
 	{
@@ -191,13 +222,15 @@ int SaveConfig()
 	int ConfigSize = sizeof(ConfigBuff);
 
 	//we assume the config file exists already
-	F_RetVal = f_open(&ConfigFile, cConfigFile, FA_READ|FA_WRITE|FA_OPEN_ALWAYS);
+	//it goes on the active card, and the copy on the other is written before we return
+	F_RetVal = SDMirrorOpen(SD_MIRROR_CFG, &ConfigFile, &cConfigFile[2], FA_READ|FA_WRITE|FA_OPEN_ALWAYS);
 	if(F_RetVal == FR_OK)
 		F_RetVal = f_lseek(&ConfigFile, 0);
 	if(F_RetVal == FR_OK)
-		F_RetVal = f_write(&ConfigFile, &ConfigBuff, ConfigSize, &NumBytesWr);
+		F_RetVal = SDMirrorWrite(SD_MIRROR_CFG, &ConfigFile, &ConfigBuff, ConfigSize, &NumBytesWr);
 	//close regardless of the return value
-	F_RetVal = f_close(&ConfigFile);
+	F_RetVal = SDMirrorClose(SD_MIRROR_CFG, &ConfigFile);
+	SDMirrorSettle();
 
 	RetVal = (int)F_RetVal;
     return RetVal;
@@ -265,6 +298,7 @@ int SetEnergyCalParam(float Slope, float Intercept)
 			ConfigBuff.ECalSlope = Slope;
 			ConfigBuff.ECalIntercept = Intercept;
 			SaveConfig();
+			cpsSetEnergyCal(Slope, Intercept);	//the neutron cuts are in calibrated energy
 
 			status = CMD_SUCCESS;
 		}
@@ -281,16 +315,16 @@ int SetEnergyCalParam(float Slope, float Intercept)
  *  totals for the MNS_EVTS, MNS_CPS, and MNS_SOH data files.
  * These will be values to modify the elliptical cuts being placed on the events read in.
  * There are two ellipses by default, one at 1 sigma and one at 2 sigma, but the location in the E-P phase
- *  space can be modified by these parameters. This function allows the user to shift the centroid
- *  around (offsetE/P) in the E-P space or scale the size of the ellipses larger or smaller (scaleE/P).
+ *  space can be modified by these parameters. This function allows the user to place the centroid
+ *  (offsetE/P) in the E-P space and set the size of the ellipses (scaleE/P), see cpsSetCut().
  *
  * @param moduleID	Assigns the cut values to a specific CLYC module
  * 					Valid input range: 1 - 4
  * @param ellipseNum	Assigns the cut values to a specific ellipse for the module chosen
  * 						Valid input range: 1, 2
- * @param scaleE/scaleP	Scale the size of the ellipse being used to cut neutrons in the data
+ * @param scaleE/scaleP	Half widths of the ellipse being used to cut neutrons in the data, in 2DH bins
  * 						Valid input range: 0 - 25.5,
- * @param offsetE/offsetP	Move the centroid of the bounding ellipse around on the plot
+ * @param offsetE/offsetP	The centroid of the bounding ellipse on the plot, calibrated energy (see SetEnergyCalParam()) and PSD
  * 							Valid input range, E: 0 - 10 MeV (0-200,000 keV?)
  * 							Valid input range, P: 0 - 2
  * Latency: TBD
@@ -394,13 +428,17 @@ int SetNeutronCutGates(int moduleID, int ellipseNum, float scaleE, float scaleP,
 			status = CMD_FAILURE;
 			break;
 		}
+		break;
 	default: //bad value for the module ID, just use the defaults
 		//just leave the cuts, no change
 		status = CMD_FAILURE;
 		break;
 	}
 	if(status == CMD_SUCCESS)
+	{
 		SaveConfig();
+		cpsSetCut(moduleID, ellipseNum, scaleE, scaleP, offsetE, offsetP);	//compile the new cut for the event loop
+	}
 
 	return status;
 }
@@ -534,6 +572,7 @@ int SetIntegrationTime(int Baseline, int Short, int Long, int Full)
 							m_short_integration_samples = (INTEG_TIME_START + Short) / NS_TO_SAMPLES + 1;
 							m_long_integration_samples = (INTEG_TIME_START + Long) / NS_TO_SAMPLES + 1;
 							m_full_integration_samples = (INTEG_TIME_START + Full) / NS_TO_SAMPLES + 1;
+							SetEnergyScale(m_baseline_integration_samples);
 							status = CMD_SUCCESS;
 						}
 						else
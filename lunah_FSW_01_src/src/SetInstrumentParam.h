@@ -18,6 +18,7 @@
 #include "lunah_defines.h"
 #include "lunah_utils.h"
 #include "LI2C_Interface.h"
+#include "CPSDataProduct.h"
 
 /*
  * Mini-NS Configuration Parameter Structure
@@ -90,7 +91,7 @@ typedef struct{
 	unsigned char FileTypeAPID;
 	unsigned char TempCorrectionSetNum;
 	unsigned char EventIDFF;
-	//padding byte added by compiler
+	unsigned char DataFormat;	//DATA_FORMAT_* bits, this used to be the padding byte so older files have 0
 }DATA_FILE_HEADER_TYPE;
 
 typedef struct{
@@ -126,6 +127,7 @@ int GetBaselineInt( void );
 int GetShortInt( void );
 int GetLongInt( void );
 int GetFullInt( void );
+void LoadConfigBuffer( CONFIG_STRUCT_TYPE * config );
 int InitConfig( void );
 int SaveConfig( void );
 int SetTriggerThreshold(int iTrigThreshold);
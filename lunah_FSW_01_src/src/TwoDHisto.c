@@ -7,18 +7,28 @@
 
 #include "TwoDHisto.h"
 
-static int m_x_bin_number;
-static int m_y_bin_number;
-static unsigned int m_oor_left;
-static unsigned int m_oor_right;
-static unsigned int m_oor_below;
-static unsigned int m_oor_above;
-static unsigned int m_valid_multi_hit_event;
+static unsigned int m_x_bin_number;
+static unsigned int m_y_bin_number;
+static unsigned int m_oor_counts[TWODH_OOR_COUNTERS];	//TWODH_OOR_*
 static unsigned short m_2DH_pmt1[TWODH_X_BINS][TWODH_Y_BINS];
 static unsigned short m_2DH_pmt2[TWODH_X_BINS][TWODH_Y_BINS];
 static unsigned short m_2DH_pmt3[TWODH_X_BINS][TWODH_Y_BINS];
 static unsigned short m_2DH_pmt4[TWODH_X_BINS][TWODH_Y_BINS];
 
+//what to tally, by the range of the x and then the y bin: 0 under, 1 in range, 2 over
+static const unsigned char m_range_class[3][3] = {
+		{TWODH_OOR_BELOW, TWODH_OOR_LEFT, TWODH_OOR_ABOVE},
+		{TWODH_OOR_BELOW, TWODH_IN_RANGE, TWODH_OOR_ABOVE},
+		{TWODH_OOR_BELOW, TWODH_OOR_RIGHT, TWODH_OOR_ABOVE}
+};
+//the histogram for each PMT ID bit pattern, NULL for the multiple hits
+static unsigned short (* const m_2DH_by_pmt[16])[TWODH_Y_BINS] = {
+		[1] = m_2DH_pmt1,
+		[2] = m_2DH_pmt2,
+		[4] = m_2DH_pmt3,
+		[8] = m_2DH_pmt4
+};
+
 /*
  * Helper function to allow external functions to get the address of the 2DHs
  *
@@ -34,9 +44,9 @@ int Save2DHToSD( int pmt_ID )
 {
 	int status = CMD_FAILURE;
 	unsigned int numBytesWritten = 0;
-	unsigned int m_oor_values[5] = {m_oor_left, m_oor_right, m_oor_below, m_oor_above, m_valid_multi_hit_event};
 	char *filename_pointer;
 	char filename_buff[100] = "";
+	char path_buff[SD_MIRROR_PATH_SIZE] = "";
 	FIL save2DH;
 	FRESULT f_res = FR_OK;
 
@@ -53,6 +63,7 @@ int Save2DHToSD( int pmt_ID )
 			xil_printf("3 return filename pointer 2dh\n");
 		else
 			snprintf(filename_buff, sizeof(filename_buff), "%s", filename_pointer);
+		break;
 	case 2:
 		m_2DH_holder = &m_2DH_pmt2;
 		filename_pointer = GetFileName( DATA_TYPE_2DH_2 );
@@ -60,6 +71,7 @@ int Save2DHToSD( int pmt_ID )
 			xil_printf("4 return filename pointer 2dh\n");
 		else
 			snprintf(filename_buff, sizeof(filename_buff), "%s", filename_pointer);
+		break;
 	case 3:
 		m_2DH_holder = &m_2DH_pmt3;
 		filename_pointer = GetFileName( DATA_TYPE_2DH_3 );
@@ -67,6 +79,7 @@ int Save2DHToSD( int pmt_ID )
 			xil_printf("5 return filename pointer 2dh\n");
 		else
 			snprintf(filename_buff, sizeof(filename_buff), "%s", filename_pointer);
+		break;
 	case 4:
 		m_2DH_holder = &m_2DH_pmt4;
 		filename_pointer = GetFileName( DATA_TYPE_2DH_4 );
@@ -74,17 +87,20 @@ int Save2DHToSD( int pmt_ID )
 			xil_printf("6 return filename pointer 2dh\n");
 		else
 			snprintf(filename_buff, sizeof(filename_buff), "%s", filename_pointer);
-	default:
 		break;
+	default:
+		return CMD_FAILURE;	//no such histogram
 	}
 
-	f_res = f_open(&save2DH, filename_buff, FA_WRITE|FA_OPEN_ALWAYS);
+	//in the run folder, the mirror puts the drive on and keeps a copy on the other card
+	snprintf(path_buff, sizeof(path_buff), "%s/%s", &GetFolderName()[2], filename_buff);
+	f_res = SDMirrorOpen(SD_MIRROR_2DH, &save2DH, path_buff, FA_WRITE|FA_OPEN_ALWAYS);
 	if(f_res != FR_OK)
 	{
 		xil_printf("1 open file fail 2dh\n");
 		status = CMD_FAILURE;
 	}
-	f_res = f_write(&save2DH, m_2DH_holder, sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS, &numBytesWritten);	//TEST LINE
+	f_res = SDMirrorWrite(SD_MIRROR_2DH, &save2DH, m_2DH_holder, sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS, &numBytesWritten);	//TEST LINE
 	if(f_res != FR_OK || numBytesWritten != (sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS))
 	{
 		//TODO: handle error checking the write
@@ -95,8 +111,8 @@ int Save2DHToSD( int pmt_ID )
 		status = CMD_SUCCESS;
 
 	//write the out of range values in
-	f_res = f_write(&save2DH, m_oor_values, sizeof(unsigned int) * 5, &numBytesWritten);	//TEST LINE
-	if(f_res != FR_OK || numBytesWritten != (sizeof(unsigned int) * 5))
+	f_res = SDMirrorWrite(SD_MIRROR_2DH, &save2DH, m_oor_counts, sizeof(m_oor_counts), &numBytesWritten);	//TEST LINE
+	if(f_res != FR_OK || numBytesWritten != sizeof(m_oor_counts))
 	{
 		//TODO: handle error checking the write
 		xil_printf("3 error writing 2dh\n");
@@ -106,7 +122,7 @@ int Save2DHToSD( int pmt_ID )
 		status = CMD_SUCCESS;
 
 
-	f_close(&save2DH);
+	SDMirrorClose(SD_MIRROR_2DH, &save2DH);
 	return status;
 }
 
@@ -129,87 +145,108 @@ int Save2DHToSD( int pmt_ID )
  */
 int Tally2DH(double energy_value, double psd_value, unsigned int pmt_ID)
 {
-	int status = CMD_FAILURE;
 	int x_bin = 999;
 	int y_bin = 999;
 
-	//find the bin numbers
-	//this line is bothersome, as I want to floor the value, but then have to cast it anyway...
-	m_x_bin_number = (unsigned int)floor(energy_value / ((double)TWODH_ENERGY_MAX / (double)TWODH_X_BINS));
-	m_y_bin_number = (unsigned int)floor(psd_value / ((double)TWODH_PSD_MAX / (double)TWODH_Y_BINS));
-	x_bin = m_x_bin_number;
-	y_bin = m_y_bin_number;
-
-	if(0 <= m_x_bin_number && m_x_bin_number < TWODH_X_BINS)
-		m_x_bin_number &= 0x03FF;
-	else
-		m_x_bin_number = 0x0103;
+	Get2DHBins(energy_value, psd_value, &x_bin, &y_bin);
+	return Tally2DHBins(x_bin, y_bin, pmt_ID);
+}
 
-	if(0 <= m_y_bin_number && m_y_bin_number < TWODH_Y_BINS)
-		m_y_bin_number &= 0x3F;
-	else
-		m_y_bin_number = 0x1D;
+/*
+ * floor(value / width) as a bin number from 0 to limit, the way Get2DHBins() has always
+ *  worked it out, but with a multiply by the reciprocal of the width instead of the divide.
+ * The product is within a few ulps of the quotient, so they can only be in different bins
+ *  when the product is within that of a bin edge; closer than TWODH_BIN_EDGE_MARGIN, which is
+ *  much further than that, the divide is done as well. An event lands there about once in 10^9.
+ *
+ * @param	(double) The value
+ * @param	(double) The bin width
+ * @param	(double) 1 / the bin width
+ * @param	(int) The number of bins, anything above them is put in this one
+ *
+ * @return	The bin number
+ */
+static int ValueToBin( double value, double width, double scale, int limit )
+{
+	double bins = value * scale;
+	double frac = 0.0;
+	int bin = 0;
 
-	if(0 <= x_bin)
+	if(!(bins > 0.0))	//catches NaN as well
+		return 0;
+	if(bins >= (double)limit + 1.0)
+		return limit;
+	bin = (int)bins;
+	frac = bins - (double)bin;	//exact
+	if((bin != 0 && frac < TWODH_BIN_EDGE_MARGIN) || frac > 1.0 - TWODH_BIN_EDGE_MARGIN)
 	{
-		if(x_bin < TWODH_X_BINS)
-		{
-			if(0 <= y_bin)
-			{
-				if(y_bin < TWODH_Y_BINS)
-				{
-					//value is good
-					switch(pmt_ID)
-					{
-					case 1:
-						m_2DH_pmt1[m_x_bin_number][m_y_bin_number]++;
-						break;
-					case 2:
-						m_2DH_pmt2[m_x_bin_number][m_y_bin_number]++;
-						break;
-					case 4:
-						m_2DH_pmt3[m_x_bin_number][m_y_bin_number]++;
-						break;
-					case 8:
-						m_2DH_pmt4[m_x_bin_number][m_y_bin_number]++;
-						break;
-					default:
-						//don't record non-singleton hits in a 2DH
-						m_valid_multi_hit_event++;
-						break;
-					}
-				}
-				else
-					m_oor_above++;	//psd over, E good
-			}
-			else
-				m_oor_below++;	//psd under, E good
-		}
-		else
-		{
-			if(0 <= y_bin)
-			{
-				if(y_bin < TWODH_Y_BINS)
-					m_oor_right++;	//psd good, E over
-				else
-					m_oor_above++;	//psd over, E over
-			}
-			else
-				m_oor_below++;	//psd under, E over
-		}
+		bins = value / width;
+		if(!(bins > 0.0))
+			return 0;
+		bin = (int)bins;
 	}
-	else
+	if(bin >= limit)
+		return limit;
+	return bin;
+}
+
+/*
+ * Find the 2DH bin numbers for an energy and PSD value without tallying them.
+ * The value is clamped before it is converted, as a conversion out of range is undefined:
+ *  anything below bin 0 (or not a number) is put in bin 0, which is what the VFP conversion
+ *  on the target always did, and anything above the histogram is put in the bin just above it.
+ * The conversion truncates, which is the same as floor() for a value which is not negative,
+ *  so there is no need for floor() (or libm) here. See ValueToBin() for the divides.
+ *
+ * @param	The calculated energy of the event
+ * @param	The calculated PSD ratio of the event
+ * @param	(int *) Set to the energy (x) bin number, 0 to TWODH_X_BINS
+ * @param	(int *) Set to the PSD (y) bin number, 0 to TWODH_Y_BINS
+ *
+ * @return	None
+ */
+void Get2DHBins(double energy_value, double psd_value, int * x_bin, int * y_bin)
+{
+	*x_bin = ValueToBin(energy_value, TWODH_X_BIN_WIDTH, 1.0 / TWODH_X_BIN_WIDTH, TWODH_X_BINS);
+	*y_bin = ValueToBin(psd_value, TWODH_Y_BIN_WIDTH, 1.0 / TWODH_Y_BIN_WIDTH, TWODH_Y_BINS);
+	return;
+}
+
+/*
+ * Tally an event whose bin numbers are already known, see Tally2DH().
+ * Bin numbers outside of the histogram are counted as out of range. Each bin number is put
+ *  in a range class (under, in, over) with two compares, then m_range_class[][] gives either
+ *  the out of range counter or TWODH_IN_RANGE, so there is a single branch per event.
+ * The bin numbers for the EVTs are set here as well, see Get2DHArrayIndexX/Y().
+ *
+ * @param	(int) Energy (x) bin number
+ * @param	(int) PSD (y) bin number
+ * @param	The PMT ID from the event
+ *
+ * @return	SUCCESS/FAILURE
+ */
+int Tally2DHBins(int x_bin, int y_bin, unsigned int pmt_ID)
+{
+	int status = CMD_FAILURE;
+	unsigned int x_range = (x_bin >= 0) + (x_bin >= TWODH_X_BINS);
+	unsigned int y_range = (y_bin >= 0) + (y_bin >= TWODH_Y_BINS);
+	unsigned int range_class = m_range_class[x_range][y_range];
+	unsigned short (*m_2DH_holder)[TWODH_Y_BINS] = NULL;
+
+	m_x_bin_number = (x_range == 1) ? (unsigned int)x_bin : TWODH_X_OOR_CODE;
+	m_y_bin_number = (y_range == 1) ? (unsigned int)y_bin : TWODH_Y_OOR_CODE;
+
+	if(range_class == TWODH_IN_RANGE)
 	{
-		if(0 <= y_bin)
-		{
-			if(y_bin < TWODH_Y_BINS)
-				m_oor_left++;	//psd good, E under
-			else
-				m_oor_above++;	//psd over, E under
-		}
+		if(pmt_ID < 16)
+			m_2DH_holder = m_2DH_by_pmt[pmt_ID];
+		if(m_2DH_holder != NULL)
+			m_2DH_holder[x_bin][y_bin]++;
 		else
-			m_oor_below++;	//psd under, E under
+			m_oor_counts[TWODH_OOR_MULTI_HIT]++;	//don't record non-singleton hits in a 2DH
 	}
+	else
+		m_oor_counts[range_class]++;
 
 	//sorted the event into a 2dh or have tallied that it was over/under the binned region
 
@@ -217,7 +254,32 @@ int Tally2DH(double energy_value, double psd_value, unsigned int pmt_ID)
 }
 
 /*
- * Retrieves and double checks the X array index for the current event being processed.
+ * Getter function for the histogram of one PMT, so that it can be copied between cores.
+ * Each histogram is TWODH_X_BINS * TWODH_Y_BINS unsigned shorts.
+ *
+ * @param	(integer) PMT ID, 1-4
+ *
+ * @return	Pointer to the histogram, NULL if the PMT ID is not valid
+ */
+unsigned short * Get2DHArrayAddress( int pmt_ID )
+{
+	switch(pmt_ID)
+	{
+	case 1:
+		return &m_2DH_pmt1[0][0];
+	case 2:
+		return &m_2DH_pmt2[0][0];
+	case 3:
+		return &m_2DH_pmt3[0][0];
+	case 4:
+		return &m_2DH_pmt4[0][0];
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Retrieves the X array index for the current event being processed, set by Tally2DHBins().
  * This value will get reported by the EVTs data product.
  *
  * @param	None
@@ -226,16 +288,11 @@ int Tally2DH(double energy_value, double psd_value, unsigned int pmt_ID)
  */
 unsigned int Get2DHArrayIndexX( void )
 {
-	if(0 <= m_x_bin_number && m_x_bin_number < TWODH_X_BINS)
-		m_x_bin_number &= 0x03FF;
-	else
-		m_x_bin_number = 0x0103;
-
 	return m_x_bin_number;
 }
 
 /*
- * Retrieves and double checks the Y array index for the current event being processed.
+ * Retrieves the Y array index for the current event being processed, set by Tally2DHBins().
  * This value will get reported by the EVTs data product.
  *
  * @param	None
@@ -244,10 +301,5 @@ unsigned int Get2DHArrayIndexX( void )
  */
 unsigned int Get2DHArrayIndexY( void )
 {
-	if(0 <= m_y_bin_number && m_y_bin_number < TWODH_Y_BINS)
-		m_y_bin_number &= 0x3F;
-	else
-		m_y_bin_number = 0x1D;
-
 	return m_y_bin_number;
 }
@@ -10,14 +10,34 @@
 
 #include "xil_printf.h"
 #include "ff.h"
-#include <math.h>
 #include "lunah_defines.h"
 #include "DataAcquisition.h"
 
+//Out of range counters, saved after each 2DH in this order
+#define TWODH_OOR_LEFT		0	//E under, PSD good
+#define TWODH_OOR_RIGHT		1	//E over, PSD good
+#define TWODH_OOR_BELOW		2	//PSD under
+#define TWODH_OOR_ABOVE		3	//PSD over
+#define TWODH_OOR_MULTI_HIT	4	//in range, but more than one PMT
+#define TWODH_OOR_COUNTERS	5
+#define TWODH_IN_RANGE		TWODH_OOR_COUNTERS	//range class of an event which goes in the histogram
+
+//Bin numbers reported in the EVTs for an event outside of the 2DH
+#define TWODH_X_OOR_CODE	0x0103
+#define TWODH_Y_OOR_CODE	0x1D
+
+//Bin widths, and how close to a bin edge Get2DHBins() divides by them rather than multiplying
+#define TWODH_X_BIN_WIDTH		((double)TWODH_ENERGY_MAX / (double)TWODH_X_BINS)
+#define TWODH_Y_BIN_WIDTH		((double)TWODH_PSD_MAX / (double)TWODH_Y_BINS)
+#define TWODH_BIN_EDGE_MARGIN	1e-9	//in bins
+
 //function prototypes
 int Save2DHToSD( int pmt_ID );
 int Tally2DH(double energy_value, double psd_value, unsigned int pmt_ID);
+void Get2DHBins(double energy_value, double psd_value, int * x_bin, int * y_bin);
+int Tally2DHBins(int x_bin, int y_bin, unsigned int pmt_ID);
 unsigned int Get2DHArrayIndexX( void );
 unsigned int Get2DHArrayIndexY( void );
+unsigned short * Get2DHArrayAddress( int pmt_ID );
 
 #endif /* SRC_TWODHISTO_H_ */
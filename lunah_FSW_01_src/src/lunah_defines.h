@@ -48,6 +48,12 @@
 #define SIZE_1_MIB			1048576	//1 MiB, rather than 1 MB (1e6 bytes)
 #define DP_HEADER_SIZE		16384	//we put blank space past the header so we always write on a cluster boundary
 
+//DATA_FILE_HEADER_TYPE.DataFormat, how the data after the file headers is laid out
+#define DATA_FORMAT_RAW			0x00	//the records as they are
+#define DATA_FORMAT_EVT_COMPACT	0x01	//compact EVT blocks, see EVTCompact.h
+#define DATA_FORMAT_COMPRESSED	0x02	//compressed blocks, see BlockCompress.h
+#define DATA_FORMAT_PKT_SHIFT	4		//the data product packets carry it in the upper half of the secondary header byte
+
 
 // Command definitions
 #define DAQ_CMD			0
@@ -87,6 +93,8 @@
 #define APID_MNS_2DH	8
 #define APID_LOG_FILE	9
 #define APID_CONFIG		10
+#define APID_DIAG		11
+#define APID_SCHED		12
 
 //MNS GROUP FLAGS
 #define GF_FIRST_PACKET	0
@@ -19,6 +19,8 @@ static int digital_board_temp = 1;
 static int modu_board_temp = 25;
 static int iNeutronTotal = 50;
 static int check_temp_sensor = 0;
+static TX_PUMP_TYPE m_TX;		//the file being sent, see TransferSDFile()
+
 
 /*
  * Initalize LocalTimeStart at startup
@@ -84,39 +86,105 @@ int GetModuTemp( void )
 }
 
 /*
- *  CheckForSOH
- *      Check if time to send SOH and if it is send it.
+ * Housekeeping task: send the 1 Hz SOH packet.
+ *
+ * @param	(void *) HOUSEKEEPING_TYPE
  */
-int CheckForSOH(XIicPs * Iic, XUartPs Uart_PS)
+static void SOHTask( void * context )
 {
-//  int iNeutronTotal;
+	HOUSEKEEPING_TYPE * io = (HOUSEKEEPING_TYPE *)context;
 
 	XTime_GetTime(&LocalTimeCurrent);
-	if(((LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND) >= (LocalTime +  1))
-	{
-//		iNeutronTotal = GetNeutronTotal();
-		LocalTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND;
-		report_SOH(Iic, LocalTime, iNeutronTotal, Uart_PS, GETSTAT_CMD);	//use GETSTAT_CMD for heartbeat
-	}
-	return LocalTime;
+	LocalTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND;
+	report_SOH(io->Iic, LocalTime, iNeutronTotal, *(io->Uart_PS), GETSTAT_CMD);	//use GETSTAT_CMD for heartbeat
+	return;
 }
 
+/*
+ * Housekeeping task: read the next temperature sensor.
+ *
+ * @param	(void *) HOUSEKEEPING_TYPE
+ */
+static void TempTask( void * context )
+{
+	HOUSEKEEPING_TYPE * io = (HOUSEKEEPING_TYPE *)context;
 
+	SampleTemperature(io->Iic);
+	return;
+}
 
-//////////////////////////// Report SOH Function ////////////////////////////////
-//This function takes in the number of neutrons currently counted and the local time
-// and pushes the SOH data product to the bus over the UART
-int report_SOH(XIicPs * Iic, XTime local_time, int i_neutron_total, XUartPs Uart_PS, int packet_type)
+/*
+ * Housekeeping task: check the UART for a command. Anything ReadCommandType() finds,
+ *  including bad input, ends the scheduler pass so the caller can act on it.
+ *
+ * @param	(void *) HOUSEKEEPING_TYPE
+ */
+static void CommandTask( void * context )
+{
+	HOUSEKEEPING_TYPE * io = (HOUSEKEEPING_TYPE *)context;
+	int poll_val = 0;
+
+	poll_val = ReadCommandType(io->RecvBuffer, io->Uart_PS);
+	if(poll_val != SCHED_RUNNING)
+		SchedStop(poll_val);
+	return;
+}
+
+/*
+ * Put the SOH, temperature, and command tasks in the scheduler. These run during every loop
+ *  which calls SchedRun()/SchedRunPass(), so SOH keeps its 1 Hz cadence whatever else we are doing.
+ * With LOG_FILE_BUFFERED the log flush goes in as well.
+ * The command task starts out disabled, only the loops which act on commands turn it on
+ *  (see WaitForCommand()), so nobody else swallows a command.
+ *
+ * @param	(HOUSEKEEPING_TYPE *) The Iic, UART, and receive buffer to use, this must stay around
+ *
+ * @return	None
+ */
+void InitHousekeepingTasks( HOUSEKEEPING_TYPE * io )
+{
+	SchedAddTask(SCHED_TASK_CMD, "CMD", CommandTask, io, 0, CMD_DEADLINE_US);
+	SchedEnableTask(SCHED_TASK_CMD, 0);
+	SchedAddTask(SCHED_TASK_SOH, "SOH", SOHTask, io, SOH_PERIOD_US, SOH_DEADLINE_US);
+	SchedAddTask(SCHED_TASK_TEMP, "TEMP", TempTask, io, TEMP_PERIOD_US, TEMP_DEADLINE_US);
+#if LOG_FILE_BUFFERED
+	SchedAddTask(SCHED_TASK_LOG, "LOG", LogFileTask, NULL, 0, 0);
+#endif
+	return;
+}
+
+/*
+ * Run the scheduler with the command task on until it reads something from the UART,
+ *  or another task stops it.
+ *
+ * @param	None
+ *
+ * @return	The command from ReadCommandType(), or the value another task gave SchedStop()
+ */
+int WaitForCommand( void )
+{
+	int command = SCHED_RUNNING;
+
+	SchedEnableTask(SCHED_TASK_CMD, 1);
+	command = SchedRun();
+	SchedEnableTask(SCHED_TASK_CMD, 0);
+	return command;
+}
+
+/*
+ * Read the next temperature sensor in turn, the SOH and temperature packets report
+ *  whatever was read last.
+ *
+ * @param	(XIicPs *) Pointer to Iic instance
+ *
+ * @return	None
+ */
+void SampleTemperature( XIicPs * Iic )
 {
-	//Variables
-	unsigned char report_buff[100] = "";
 	unsigned char i2c_Send_Buffer[2] = {};
 	unsigned char i2c_Recv_Buffer[2] = {};
 	int a = 0;
 	int b = 0;
-	int status = 0;
-	int bytes_sent = 0;
-	unsigned int local_time_holder = 0;
 
 	i2c_Send_Buffer[0] = 0x0;
 	i2c_Send_Buffer[1] = 0x0;
@@ -124,65 +192,68 @@ int report_SOH(XIicPs * Iic, XTime local_time, int i_neutron_total, XUartPs Uart
 //	int IIC_SLAVE_ADDR3 = 0x48;	//Temp sensor on the analog board
 //	int IIC_SLAVE_ADDR5 = 0x4A;	//Extra Temp Sensor Board, on module near thermistor on TEC
 
+	XTime_GetTime(&LocalTimeCurrent);
 	switch(check_temp_sensor){
 	case 0:	//analog board
-		XTime_GetTime(&LocalTimeCurrent);
-		if(((LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND) >= (TempTime + 2))
-		{
-//			TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
-//			check_temp_sensor++;
-//			IicPsMasterSend(Iic, IIC_DEVICE_ID_0, i2c_Send_Buffer, i2c_Recv_Buffer, &IIC_SLAVE_ADDR3);
-//			IicPsMasterRecieve(Iic, i2c_Recv_Buffer, &IIC_SLAVE_ADDR3);
-//			a = i2c_Recv_Buffer[0]<< 5;
-//			b = a | i2c_Recv_Buffer[1] >> 3;
-//			if(i2c_Recv_Buffer[0] >= 128)
-//			{
-//				b = (b - 8192) / 16;
-//			}
-//			else
-//			{
-//				b = b / 16;
-//			}
-			b = 23;
-			analog_board_temp = b;
-		}
+//		TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
+//		check_temp_sensor++;
+//		IicPsMasterSend(Iic, IIC_DEVICE_ID_0, i2c_Send_Buffer, i2c_Recv_Buffer, &IIC_SLAVE_ADDR3);
+//		IicPsMasterRecieve(Iic, i2c_Recv_Buffer, &IIC_SLAVE_ADDR3);
+//		a = i2c_Recv_Buffer[0]<< 5;
+//		b = a | i2c_Recv_Buffer[1] >> 3;
+//		if(i2c_Recv_Buffer[0] >= 128)
+//		{
+//			b = (b - 8192) / 16;
+//		}
+//		else
+//		{
+//			b = b / 16;
+//		}
+		b = 23;
+		analog_board_temp = b;
 		break;
 	case 1:	//digital board
-		XTime_GetTime(&LocalTimeCurrent);
-		if(((LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND) >= (TempTime + 2))
+		TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
+		check_temp_sensor++;
+
+		IicPsMasterSend(Iic, IIC_DEVICE_ID_1, i2c_Send_Buffer, i2c_Recv_Buffer, &IIC_SLAVE_ADDR2);
+		IicPsMasterRecieve(Iic, i2c_Recv_Buffer, &IIC_SLAVE_ADDR2);
+		a = i2c_Recv_Buffer[0]<< 5;
+		b = a | i2c_Recv_Buffer[1] >> 3;
+		if(i2c_Recv_Buffer[0] >= 128)
 		{
-			TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
-			check_temp_sensor++;
-
-			IicPsMasterSend(Iic, IIC_DEVICE_ID_1, i2c_Send_Buffer, i2c_Recv_Buffer, &IIC_SLAVE_ADDR2);
-			IicPsMasterRecieve(Iic, i2c_Recv_Buffer, &IIC_SLAVE_ADDR2);
-			a = i2c_Recv_Buffer[0]<< 5;
-			b = a | i2c_Recv_Buffer[1] >> 3;
-			if(i2c_Recv_Buffer[0] >= 128)
-			{
-				b = (b - 8192) / 16;
-			}
-			else
-			{
-				b = b / 16;
-			}
-			digital_board_temp = b;
+			b = (b - 8192) / 16;
 		}
-		break;
-	case 2:	//module sensor
-		XTime_GetTime(&LocalTimeCurrent);
-		if(((LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND) >= (TempTime + 2))
+		else
 		{
-			TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
-			check_temp_sensor = 0;
-			modu_board_temp += 1;
+			b = b / 16;
 		}
+		digital_board_temp = b;
+		break;
+	case 2:	//module sensor
+		TempTime = (LocalTimeCurrent - LocalTimeStart)/COUNTS_PER_SECOND; //temp time is reset
+		check_temp_sensor = 0;
+		modu_board_temp += 1;
 		break;
 	default:
-		status = CMD_FAILURE;
+		check_temp_sensor = 0;
 		break;
 	}
+	return;
+}
+
+//////////////////////////// Report SOH Function ////////////////////////////////
+//This function takes in the number of neutrons currently counted and the local time
+// and pushes the SOH data product to the bus over the UART
+int report_SOH(XIicPs * Iic, XTime local_time, int i_neutron_total, XUartPs Uart_PS, int packet_type)
+{
+	//Variables
+	unsigned char report_buff[100] = "";
+	int status = 0;
+	int bytes_sent = 0;
+	unsigned int local_time_holder = 0;
 
+	//the temperatures are whatever the TEMP task read last, see SampleTemperature()
 	//to replace the printf statement, we need to sort the integer temps into the array so they have fixed widths
 	// and since we're already using a char array, we'll sort the ints into chars
 	//do this for anlg, digi, and modu, then take that out of the cases below
@@ -246,6 +317,64 @@ int report_SOH(XIicPs * Iic, XTime local_time, int i_neutron_total, XUartPs Uart
 	return status;
 }
 
+/*
+ * Put one fixed field of a packet in, 4 bytes big-endian followed by a tab, as report_SOH() does.
+ *  The caller puts a newline over the tab of the last field.
+ *
+ * @param	(unsigned char *) The packet
+ * @param	(integer) Where the field goes
+ * @param	(unsigned int) The value
+ *
+ * @return	Where the next field goes
+ */
+int PutPacketField( unsigned char * packet, int index, unsigned int value )
+{
+	packet[index] = (unsigned char)(value >> 24);
+	packet[index + 1] = (unsigned char)(value >> 16);
+	packet[index + 2] = (unsigned char)(value >> 8);
+	packet[index + 3] = (unsigned char)(value);
+	packet[index + 4] = TAB_CHAR_CODE;
+	return index + 5;
+}
+
+/*
+ * Send the scheduler statistics packet (APID_SCHED): for each task slot in turn, the runs,
+ *  the runs which started after their deadline, and the longest run in microseconds, since the
+ *  statistics were last reset. An empty slot has all three 0.
+ * This goes out during and at the end of each DAQ run and at the end of each downlink, so the
+ *  timing can be watched without a DAQ_REPORT_TIMING build.
+ *
+ * @param	(XUartPs) UART instance to send on
+ *
+ * @return	CMD_SUCCESS
+ */
+int reportSchedStats( XUartPs Uart_PS )
+{
+	unsigned char report_buff[SCHED_PACKET_LENGTH + CCSDS_HEADER_FULL] = "";
+	int index = CCSDS_HEADER_FULL;
+	int id = 0;
+	int sent = 0;
+	SCHED_TASK_TYPE * task = NULL;
+
+	for(id = 0; id < SCHED_MAX_TASKS; id++)
+	{
+		task = SchedGetTask(id);
+		index = PutPacketField(report_buff, index, task->runs);
+		index = PutPacketField(report_buff, index, task->late);
+		index = PutPacketField(report_buff, index, (unsigned int)(task->max_ticks / (COUNTS_PER_SECOND / 1000000)));
+	}
+	report_buff[index - 1] = NEWLINE_CHAR_CODE;
+
+	PutCCSDSHeader(report_buff, APID_SCHED, GF_UNSEG_PACKET, 1, SCHED_PACKET_LENGTH);
+	CalculateChecksums(report_buff);
+
+	//more than the UART FIFO holds
+	while(sent < SCHED_PACKET_LENGTH + CCSDS_HEADER_FULL)
+		sent += XUartPs_Send(&Uart_PS, &(report_buff[sent]), SCHED_PACKET_LENGTH + CCSDS_HEADER_FULL - sent);
+
+	return CMD_SUCCESS;
+}
+
 /*
  * Put the appropriate CCSDS header values into the output packet.
  *
@@ -306,6 +435,12 @@ void PutCCSDSHeader(unsigned char * SOH_buff, int packet_type, int group_flags,
 	case APID_CONFIG:
 		SOH_buff[5] = 0xAA;	//APID for SOH
 		break;
+	case APID_DIAG:
+		SOH_buff[5] = 0xBB;	//APID for the DAQ diagnostics, see reportDAQDiag()
+		break;
+	case APID_SCHED:
+		SOH_buff[5] = 0xCC;	//APID for the scheduler statistics, see reportSchedStats()
+		break;
 	default:
 		SOH_buff[5] = 0x22; //default to SOH just in case?
 		break;
@@ -490,6 +625,117 @@ void CalculateChecksums(unsigned char * packet_array)
     return;
 }
 
+/*
+ * Make the next packet of the file being sent in its packet_array. The RMD header which is the
+ *  same in every packet was put in by TransferSDFile().
+ *
+ * @param	(TX_PUMP_TYPE *) The transfer
+ *
+ * @return	None, tx->status is 2 if the file could not be read
+ */
+static void TXMakePacket( TX_PUMP_TYPE * tx )
+{
+	int bytes_to_read = 0;				//number of bytes to read from data file to put into packet data bytes
+	int data_end = 0;					//where the data bytes read in end
+	unsigned int bytes_read = 0;
+	FRESULT f_res = FR_OK;
+
+	//assume we've read all the way through the data file header, 16384 bytes
+	if(tx->size_left >= DATA_BYTES_EVT)	//replace with file_TX_data_bytes_size
+	{
+		bytes_to_read = DATA_BYTES_EVT;	//replace with file_TX_data_bytes_size
+		if(tx->sequence_count == 0)
+			tx->group_flags = 1;	//first packet
+		else
+			tx->group_flags = 0;	//intermediate packet
+	}
+	else
+	{
+		bytes_to_read = tx->size_left;
+		if(tx->sequence_count == 0)
+			tx->group_flags = 3;	//unsegmented packet
+		else
+			tx->group_flags = 2;	//last packet
+	}
+
+	PutCCSDSHeader(tx->packet_array, tx->apid, tx->group_flags, tx->sequence_count, PKT_SIZE_EVT);	//replace with file_TX_packet_size
+	//flag packed or compressed data so the ground knows to expand it, see DATA_FORMAT_*
+	tx->packet_array[CCSDS_HEADER_PRIM] |= (unsigned char)(tx->data_format << DATA_FORMAT_PKT_SHIFT);
+	//read in the data bytes
+	f_res = f_read(&(tx->file), &(tx->packet_array[CCSDS_HEADER_PRIM + PKT_HEADER_EVT]), bytes_to_read, &bytes_read);	//replace PKT with file_TX_packet_size
+	if(f_res != FR_OK)
+		tx->status = 2;
+	else
+		tx->size_left -= bytes_to_read;
+	//add padding bytes up to the checksums, if necessary
+	data_end = CCSDS_HEADER_PRIM + PKT_HEADER_EVT + bytes_read;
+	if(data_end < PKT_SIZE_EVT + CCSDS_HEADER_FULL - CHECKSUM_SIZE)
+		memset(&(tx->packet_array[data_end]), 0x77, PKT_SIZE_EVT + CCSDS_HEADER_FULL - CHECKSUM_SIZE - data_end);
+	//calculate the checksums for the packet
+	CalculateChecksums(tx->packet_array);
+
+	tx->packet_size = PKT_SIZE_EVT + CCSDS_HEADER_FULL;	//the full packet size in bytes //replace with file_TX_packet_size += header_full
+	tx->sent = 0;
+	return;
+}
+
+/*
+ * Downlink task: hand the UART as much of the packet being sent as it will take, and make the
+ *  next packet once it has all of this one. A run takes no longer than filling the UART FIFO
+ *  or reading one packet's worth of the file, so the other tasks stay on time.
+ * Stops the scheduler with SCHED_STOP_DONE once the last packet has gone, or the file could
+ *  not be read.
+ *
+ * @param	(void *) TX_PUMP_TYPE
+ */
+static void TXPumpTask( void * context )
+{
+	TX_PUMP_TYPE * tx = (TX_PUMP_TYPE *)context;
+
+	if(tx->packet_size == 0)
+	{
+		TXMakePacket(tx);
+		if(tx->status != 0)
+		{
+			SchedStop(SCHED_STOP_DONE);
+			return;
+		}
+	}
+
+	tx->sent += XUartPs_Send(&(tx->Uart_PS), &(tx->packet_array[tx->sent]), tx->packet_size - tx->sent);
+	if(tx->sent < tx->packet_size)
+		return;
+
+	//check if there are multiple packets/files to send (EVT)
+	switch(tx->group_flags)
+	{
+	case 0:	//intermediate packet
+		/* Falls through to case 1 */
+	case 1:	//first packet
+		tx->sequence_count++;
+		tx->packet_size = 0;
+		//erase the parts of the packet which are unique so they don't get put into the next packet, up to its end
+		memset(&(tx->packet_array[6]), '\0', 2);	//reset group flags, sequence count
+		memset(&(tx->packet_array[10]), '\0', 1);	//reset secondary header (reset request bits)
+		if(tx->file_type == DATA_TYPE_EVT || tx->file_type == DATA_TYPE_WAV || tx->file_type == DATA_TYPE_CPS)
+			memset(&(tx->packet_array[81]), '\0', PKT_SIZE_EVT + CCSDS_HEADER_FULL - 81);
+		else if(tx->file_type == DATA_TYPE_2DH_1 || tx->file_type == DATA_TYPE_2DH_2 || tx->file_type == DATA_TYPE_2DH_3 || tx->file_type == DATA_TYPE_2DH_4 )
+			memset(&(tx->packet_array[85]), '\0', PKT_SIZE_EVT + CCSDS_HEADER_FULL - 85);
+		else if(tx->file_type == DATA_TYPE_LOG)
+			memset(&(tx->packet_array[11]), '\0', PKT_SIZE_EVT + CCSDS_HEADER_FULL - 11);
+		//no need to erase the config file
+		break;
+	case 2:	//current packet was last packet
+		/* Falls through to case 3 */
+	case 3:	//current packet was unsegmented
+		/* Falls through to default */
+	default:
+		SchedStop(SCHED_STOP_DONE);
+		break;
+	}
+	return;
+}
+
 /*
  * Transfers any one file that is on the SD card. Will return command FAILURE if the file does not exist.
  *
@@ -505,6 +751,9 @@ void CalculateChecksums(unsigned char * packet_array)
  * @param	(int)set_num_low	The set number to TX, if multiple files are requested by the user, the
  * 								 calling function will call this function multiple times with a different
  * 								 set number each time.
+ * @param	(int)first_packet	The packet sequence number to start from, 0 sends the whole file. A transfer
+ * 								 which was cut off may be resumed, or one lost packet sent again, without
+ * 								 going back over the rest of the file.
  *
  * NOTES: For this function, the file type is the important parameter because it tells the function how to
  * 			interpret the parameters which are given.
@@ -513,24 +762,21 @@ void CalculateChecksums(unsigned char * packet_array)
  * 		: For EVT, the set numbers give a way to selectively transfer one or more set files at a time. If the
  * 			set_num_high value is 0, then just one set file will be TX'd. Otherwise, each set file from set low
  * 			to set high will be sent. There will be a checks on the user input, but no SOH in between the files.
+ * 		: The data bytes are sent as they are in the file. If the file was written compact or compressed
+ * 			(DATA_FILE_HEADER_TYPE.DataFormat) the format bits are in the upper half of the secondary header
+ * 			byte of each packet, and each compressed block in the data may be expanded on its own.
+ * 		: The packets are sent by the downlink task (TXPumpTask()) while this runs the scheduler, so SOH goes on
+ * 			and a BREAK ends the transfer. The scheduler statistics packet goes out at the end.
  */
-int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_num, int run_num, int set_num )
+int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_num, int run_num, int set_num, int first_packet )
 {
-	int status = 0;			//0=good, 1=file DNE, 2+=other problem
+	int status = 0;			//0=good, 1=file DNE, 2=other problem, 3=cut off by a BREAK
 	int poll_val = 0;		//local polling status variable
-	int sent = 0;			//bytes sent by UART
-	int bytes_sent = 0;
 	unsigned short s_holder = 0;
 	float f_holder = 0;
 	int file_TX_size = 0;				//tracks number of bytes left to TX in the file TOTAL
-	int file_TX_packet_size = 0;		//number of bytes to send //number of bytes in a packet total
-	int file_TX_data_bytes_size = 0;	//size of the data bytes for that type of data product packet
-	int file_TX_packet_header_size = 0;	//size of the packet header bytes minus the CCSDS primary header (10 bytes)
-	int file_TX_add_padding = 0;		//flag to add padding bytes to an outgoing packet
-	int file_TX_group_flags = 0;
 	int file_TX_sequence_count = 0;
 	int m_loop_var = 1;					//0 = false; 1 = true
-	int bytes_to_read = 0;				//number of bytes to read from data file to put into packet data bytes
 	unsigned int bytes_written;
 	unsigned int bytes_read = 0;
 	char *ptr_file_TX_filename;
@@ -539,19 +785,19 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 	char file_TX_folder[100] = "";
 	char file_TX_filename[100] = "";
 	char file_TX_path[100] = "";
-	unsigned char packet_array[2040] = "";
 	DATA_FILE_HEADER_TYPE data_file_header = {};
 	DATA_FILE_SECONDARY_HEADER_TYPE data_file_2ndy_header = {};
 	CONFIG_STRUCT_TYPE config_file_header = {};
-	FIL TXFile;				//file object
 	FILINFO fno;			//file info structure
 	FRESULT f_res = FR_OK;	//SD card status variable type
 
 	//find the folder/file that was requested
 	if(file_type == DATA_TYPE_LOG)
 	{
+		//the commands still in RAM go down with the rest
+		LogFileFlush();
 		//just on the root directory
-		bytes_written = snprintf(file_TX_folder, 100, "0:");
+		bytes_written = snprintf(file_TX_folder, 100, "%d:", SDMirrorGetActiveCard());
 		if(bytes_written == 0 || bytes_written != ROOT_DIR_NAME_SIZE)
 			status = 1;
 		ptr_file_TX_filename = log_file;
@@ -559,15 +805,15 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 	else if(file_type == DATA_TYPE_CFG)
 	{
 		//just on the root directory
-		bytes_written = snprintf(file_TX_folder, 100, "0:");
+		bytes_written = snprintf(file_TX_folder, 100, "%d:", SDMirrorGetActiveCard());
 		if(bytes_written == 0 || bytes_written != ROOT_DIR_NAME_SIZE)
 			status = 1;
 		ptr_file_TX_filename = config_file;
 	}
 	else
 	{
-		//construct the folder
-		bytes_written = snprintf(file_TX_folder, 100, "0:/I%04d_R%04d", id_num, run_num);
+		//construct the folder, on SD1 once SD0 is out of use, which has the copies if SD_MIRROR is on
+		bytes_written = snprintf(file_TX_folder, 100, "%d:/I%04d_R%04d", SDMirrorGetActiveCard(), id_num, run_num);
 		if(bytes_written == 0 || bytes_written != ROOT_DIR_NAME_SIZE + FOLDER_NAME_SIZE)
 			status = 1;
 		//construct the file name
@@ -634,7 +880,7 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 	if(status == 0)
 	{
 		//can just do an open on the dir:/folder/file.bin if we want, that way we don't have to use chdir or anything
-		f_res = f_open(&TXFile, file_TX_path, FA_READ);	//the files exists, so just open it //only do fa-read so that we don't open a new file
+		f_res = f_open(&(m_TX.file), file_TX_path, FA_READ);	//the files exists, so just open it //only do fa-read so that we don't open a new file
 		if(f_res != FR_OK)
 		{
 			if(f_res == FR_NO_PATH)
@@ -646,10 +892,10 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 	//read in important information (file size, header, first event, real time, etc.)
 	if(status == 0)
 	{
-		file_TX_size = file_size(&TXFile);
+		file_TX_size = file_size(&(m_TX.file));
 		if(file_type != DATA_TYPE_LOG && file_type != DATA_TYPE_CFG)	//EVT, CPS, 2DH, WAV files
 		{
-			f_res = f_read(&TXFile, &data_file_header, sizeof(data_file_header), &bytes_read);	//read in 188 bytes, up to the real time
+			f_res = f_read(&(m_TX.file), &data_file_header, sizeof(data_file_header), &bytes_read);	//read in 188 bytes, up to the real time
 			if(f_res != FR_OK || bytes_read != sizeof(data_file_header))
 				status = 2;
 			else
@@ -657,7 +903,7 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 
 			if(file_type == DATA_TYPE_EVT || file_type == DATA_TYPE_WAV || file_type == DATA_TYPE_CPS) //2DH files don't have this
 			{
-				f_res = f_read(&TXFile, &data_file_2ndy_header, sizeof(data_file_2ndy_header), &bytes_read);	//read in the real times
+				f_res = f_read(&(m_TX.file), &data_file_2ndy_header, sizeof(data_file_2ndy_header), &bytes_read);	//read in the real times
 				if(f_res != FR_OK)
 				{
 					//TODO: can do a check that the eventID bytes are correct here so we know that it's a good read?
@@ -669,7 +915,7 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 			}
 			if(file_type == DATA_TYPE_EVT)
 			{
-				f_res = f_lseek(&TXFile, DP_HEADER_SIZE);
+				f_res = f_lseek(&(m_TX.file), DP_HEADER_SIZE);
 				if(f_res != FR_OK)
 					status = 2;
 				else
@@ -678,7 +924,7 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 		}
 		else if(file_type == DATA_TYPE_CFG)	//the config file is just one config header
 		{
-			f_res = f_read(&TXFile, &config_file_header, sizeof(config_file_header), &bytes_read);
+			f_res = f_read(&(m_TX.file), &config_file_header, sizeof(config_file_header), &bytes_read);
 			if(f_res != FR_OK || bytes_read != sizeof(config_file_header))
 				status = 2;
 			else
@@ -686,157 +932,99 @@ int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_nu
 		}
 		//no header information in the log file //need to assign the
 	}
+	//skip to the packet asked for, every packet before it carries DATA_BYTES_EVT of the file
+	if(status == 0 && first_packet != 0)
+	{
+		if(first_packet < 0 || first_packet > file_TX_size / DATA_BYTES_EVT)	//replace with file_TX_data_bytes_size
+			status = 2;
+		else
+		{
+			f_res = f_lseek(&(m_TX.file), f_tell(&(m_TX.file)) + (DWORD)first_packet * DATA_BYTES_EVT);
+			if(f_res != FR_OK)
+				status = 2;
+			else
+			{
+				file_TX_size -= first_packet * DATA_BYTES_EVT;
+				file_TX_sequence_count = first_packet;
+			}
+		}
+	}
 
 	//compile the RMD data header (different based on file type)
 	if(status == 0)
 	{
+		memset(m_TX.packet_array, '\0', sizeof(m_TX.packet_array));
 		//for EVT file type
 		//fill in the RMD header	//these are shared header values for CPS, 2DH, EVT, WAV, CFG //only LOG doesn't have this
-		f_holder = data_file_header.configBuff.ScaleFactorEnergy_1_1;	memcpy(&(packet_array[11]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.ScaleFactorEnergy_1_2;	memcpy(&(packet_array[15]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.ScaleFactorPSD_1_1;		memcpy(&(packet_array[19]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.ScaleFactorPSD_1_2;		memcpy(&(packet_array[23]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.OffsetEnergy_1_1;		memcpy(&(packet_array[27]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.OffsetEnergy_1_2;		memcpy(&(packet_array[31]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.OffsetPSD_1_1;			memcpy(&(packet_array[35]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.OffsetPSD_1_2;			memcpy(&(packet_array[39]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.ECalSlope;				memcpy(&(packet_array[43]), &f_holder, sizeof(float));
-		f_holder = data_file_header.configBuff.ECalIntercept;			memcpy(&(packet_array[47]), &f_holder, sizeof(float));
-		s_holder = (unsigned short)data_file_header.configBuff.TriggerThreshold;	memcpy(&(packet_array[51]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.IntegrationBaseline;	memcpy(&(packet_array[53]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.IntegrationShort;	memcpy(&(packet_array[55]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.IntegrationLong;		memcpy(&(packet_array[57]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.IntegrationFull;		memcpy(&(packet_array[59]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[0];	memcpy(&(packet_array[61]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[1];	memcpy(&(packet_array[63]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[2];	memcpy(&(packet_array[65]), &s_holder, sizeof(s_holder));
-		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[3];	memcpy(&(packet_array[67]), &s_holder, sizeof(s_holder));
+		f_holder = data_file_header.configBuff.ScaleFactorEnergy_1_1;	memcpy(&(m_TX.packet_array[11]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.ScaleFactorEnergy_1_2;	memcpy(&(m_TX.packet_array[15]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.ScaleFactorPSD_1_1;		memcpy(&(m_TX.packet_array[19]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.ScaleFactorPSD_1_2;		memcpy(&(m_TX.packet_array[23]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.OffsetEnergy_1_1;		memcpy(&(m_TX.packet_array[27]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.OffsetEnergy_1_2;		memcpy(&(m_TX.packet_array[31]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.OffsetPSD_1_1;			memcpy(&(m_TX.packet_array[35]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.OffsetPSD_1_2;			memcpy(&(m_TX.packet_array[39]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.ECalSlope;				memcpy(&(m_TX.packet_array[43]), &f_holder, sizeof(float));
+		f_holder = data_file_header.configBuff.ECalIntercept;			memcpy(&(m_TX.packet_array[47]), &f_holder, sizeof(float));
+		s_holder = (unsigned short)data_file_header.configBuff.TriggerThreshold;	memcpy(&(m_TX.packet_array[51]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.IntegrationBaseline;	memcpy(&(m_TX.packet_array[53]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.IntegrationShort;	memcpy(&(m_TX.packet_array[55]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.IntegrationLong;		memcpy(&(m_TX.packet_array[57]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.IntegrationFull;		memcpy(&(m_TX.packet_array[59]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[0];	memcpy(&(m_TX.packet_array[61]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[1];	memcpy(&(m_TX.packet_array[63]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[2];	memcpy(&(m_TX.packet_array[65]), &s_holder, sizeof(s_holder));
+		s_holder = (unsigned short)data_file_header.configBuff.HighVoltageValue[3];	memcpy(&(m_TX.packet_array[67]), &s_holder, sizeof(s_holder));
 
 		if(file_type == DATA_TYPE_EVT || file_type == DATA_TYPE_WAV || file_type == DATA_TYPE_CPS)
 		{
-			memcpy(&(packet_array[69]), &data_file_2ndy_header.RealTime, sizeof(data_file_2ndy_header.RealTime));
-			memcpy(&(packet_array[77]), &data_file_2ndy_header.FirstEventTime, sizeof(data_file_2ndy_header.FirstEventTime));
+			memcpy(&(m_TX.packet_array[69]), &data_file_2ndy_header.RealTime, sizeof(data_file_2ndy_header.RealTime));
+			memcpy(&(m_TX.packet_array[77]), &data_file_2ndy_header.FirstEventTime, sizeof(data_file_2ndy_header.FirstEventTime));
 		}
 	}
-	if(status != 0)
-		m_loop_var = 0;	//don't loop, just exit
-	//loop here to compile the packets, all above stuff is necessary once and stays the same in each packet
-	//This loop compiles the remaining parts of the packet and sends it
-	// then repeats until there is no more data
-	while(m_loop_var == 1)
+	//the packets go out from the downlink task, one pass at a time, so the SOH and the command poll
+	// carry on between them and a BREAK stops the transfer part way through a packet if need be
+	if(status == 0)
 	{
-		//here is where I'll get data product specific
-		switch(file_type)
-		{
-		case DATA_TYPE_EVT:
-			//what do we need to specify to make things correct for one data product or another?
-			file_TX_data_bytes_size = DATA_BYTES_EVT;
-			file_TX_packet_size = PKT_SIZE_EVT;
-			file_TX_packet_header_size = PKT_HEADER_EVT;
-			break;
-		case DATA_TYPE_CPS:
-
-			break;
-		default:
-			//how did we get here if the file type is wrong?
-			break;
-		}
-		//assume we've read all the way through the data file header, 16384 bytes
-		if(file_TX_size >= DATA_BYTES_EVT)	//replace with file_TX_data_bytes_size
-		{
-			bytes_to_read = DATA_BYTES_EVT;	//replace with file_TX_data_bytes_size
-			file_TX_add_padding = 0;
-			if(file_TX_sequence_count == 0)
-				file_TX_group_flags = 1;	//first packet
-			else
-				file_TX_group_flags = 0;	//intermediate packet
-		}
-		else
-		{
-			bytes_to_read = file_TX_size;
-			file_TX_add_padding = 1;
-			if(file_TX_sequence_count == 0)
-				file_TX_group_flags = 3;	//unsegmented packet
-			else
-				file_TX_group_flags = 2;	//last packet
-		}
-
-		PutCCSDSHeader(packet_array, data_file_header.FileTypeAPID, file_TX_group_flags, file_TX_sequence_count, PKT_SIZE_EVT);	//replace with file_TX_packet_size
-		//read in the data bytes
-		f_res = f_read(&TXFile, &(packet_array[CCSDS_HEADER_PRIM + PKT_HEADER_EVT]), bytes_to_read, &bytes_read);	//replace PKT with file_TX_packet_size
-		if(f_res != FR_OK)
-			status = 2;
-		else
-			file_TX_size -= bytes_to_read;
-		//add padding bytes, if necessary
-		if(file_TX_add_padding == 1)
-		{
-			memset(&(packet_array[CCSDS_HEADER_PRIM + PKT_HEADER_EVT + bytes_read]), 0x77, PKT_SIZE_EVT + CCSDS_HEADER_FULL - CHECKSUM_SIZE);	//replace PKT with file_TX_packet_size
-			file_TX_add_padding = 0;	//reset
-		}
-		//calculate the checksums for the packet
-		CalculateChecksums(packet_array);
-
-		//send the packet
-		sent = 0;
-		bytes_sent = 0;
-		file_TX_packet_size = PKT_SIZE_EVT + CCSDS_HEADER_FULL;	//the full packet size in bytes //replace with file_TX_packet_size += header_full
-		while(sent < file_TX_packet_size)
+		m_TX.Uart_PS = Uart_PS;
+		m_TX.file_type = file_type;
+		m_TX.apid = data_file_header.FileTypeAPID;
+		m_TX.data_format = data_file_header.DataFormat;
+		m_TX.size_left = file_TX_size;
+		m_TX.sequence_count = file_TX_sequence_count;
+		m_TX.group_flags = 0;
+		m_TX.packet_size = 0;
+		m_TX.sent = 0;
+		m_TX.status = 0;
+		SchedResetStats();
+		SchedAddTask(SCHED_TASK_TX, "TX", TXPumpTask, &m_TX, 0, 0);
+		while(m_loop_var == 1)
 		{
-			bytes_sent = XUartPs_Send(&Uart_PS, &(packet_array[sent]), file_TX_packet_size - sent);
-			sent += bytes_sent;
-		}
-
-		//check if there are multiple packets/files to send (EVT)
-		switch(file_TX_group_flags)
-		{
-		case 0:	//intermediate packet
-			/* Falls through to case 1 */
-		case 1:	//first packet
-			m_loop_var = 1;
-			file_TX_sequence_count++;
-			//erase the parts of the packet which are unique so they don't get put into the next packet
-			memset(&(packet_array[6]), '\0', 2);	//reset group flags, sequence count
-			memset(&(packet_array[10]), '\0', 1);	//reset secondary header (reset request bits)
-			if(file_type == DATA_TYPE_EVT || file_type == DATA_TYPE_WAV || file_type == DATA_TYPE_CPS)
-				memset(&(packet_array[81]), '\0', file_TX_packet_size - CCSDS_HEADER_PRIM - PKT_HEADER_EVT);
-			else if(file_type == DATA_TYPE_2DH_1 || file_type == DATA_TYPE_2DH_2 || file_type == DATA_TYPE_2DH_3 || file_type == DATA_TYPE_2DH_4 )
-				memset(&(packet_array[85]), '\0', file_TX_packet_size - CCSDS_HEADER_PRIM - PKT_HEADER_2DH);
-			else if(file_type == DATA_TYPE_LOG)
-				memset(&(packet_array[11]), '\0', file_TX_packet_size- CCSDS_HEADER_PRIM);
-			//no need to erase the config file
-			break;
-		case 2:	//current packet was last packet
-			/* Falls through to case 3 */
-		case 3:	//current packet was unsegmented
-			m_loop_var = 0;
-			break;
-		default:
-			//TODO: error check bad group flags, for now just be done, don't loop back
-			m_loop_var = 0;
-			status = 2;
-			break;
-		}
-
-		//check for user interaction (break, too many bytes)
-		poll_val = ReadCommandType(RecvBuffer, &Uart_PS);
-		switch(poll_val)
-		{
-		case -1:
-			//this is bad input or an error in input
-			//should handle this separately from default
-			break;
-		case BREAK_CMD:
-			m_loop_var = 0;	//done looping
-			status = DAQ_BREAK;
-			break;
-		default:
-			break;
+			poll_val = WaitForCommand();
+			switch(poll_val)
+			{
+			case SCHED_STOP_DONE:
+				m_loop_var = 0;
+				status = m_TX.status;
+				break;
+			case -1:
+				//this is bad input or an error in input
+				//should handle this separately from default
+				break;
+			case BREAK_CMD:
+				//the ground has every packet before m_TX.sequence_count, first_packet picks up from there
+				m_loop_var = 0;
+				status = 3;
+				break;
+			default:
+				break;
+			}
 		}
+		SchedRemoveTask(SCHED_TASK_TX);
+		reportSchedStats(Uart_PS);
+	}
 
-	}//END OF WHILE(m_loop_var == 1)
-
-	f_close(&TXFile);
+	f_close(&(m_TX.file));
 
 	return status;
 }
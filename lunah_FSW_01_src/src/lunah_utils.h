@@ -15,11 +15,45 @@
 #include "ReadCommandType.h"	//gives access to last command strings
 #include "lunah_defines.h"
 #include "LI2C_Interface.h"		//talk to I2C devices (temperature sensors)
+#include "Scheduler.h"
+#include "SDMirror.h"
+#include "LogFileControl.h"
 
 #define TAB_CHAR_CODE			9
 #define NEWLINE_CHAR_CODE		10
 #define SOH_PACKET_LENGTH		29
 #define TEMP_PACKET_LENGTH		19
+#define SCHED_PACKET_LENGTH		(SCHED_MAX_TASKS * 3 * 5 + 4)	//runs, late runs, and longest run for each task slot, see reportSchedStats()
+
+//Housekeeping task timing, see InitHousekeepingTasks()
+#define SOH_PERIOD_US			1000000		//1 Hz
+#define SOH_DEADLINE_US			50000
+#define TEMP_PERIOD_US			2000000		//one sensor each time
+#define TEMP_DEADLINE_US		1000000
+#define CMD_DEADLINE_US			5000		//the UART FIFO holds 64 bytes
+
+//What the housekeeping tasks need to talk to the bus and the sensors
+typedef struct {
+	XIicPs * Iic;
+	XUartPs * Uart_PS;
+	char * RecvBuffer;
+} HOUSEKEEPING_TYPE;
+
+//A file being sent, one packet at a time by the downlink task, see TransferSDFile()
+typedef struct {
+	XUartPs Uart_PS;
+	FIL file;
+	int file_type;
+	int apid;
+	int data_format;			//DATA_FILE_HEADER_TYPE.DataFormat, goes in each packet
+	int size_left;				//bytes of the file not yet put in a packet
+	int sequence_count;
+	int group_flags;			//of the packet in packet_array
+	int packet_size;			//bytes in packet_array, 0 when the next packet is to be made
+	int sent;					//bytes of packet_array the UART has taken
+	int status;					//0 = good, 2 = the file could not be read
+	unsigned char packet_array[2040];
+} TX_PUMP_TYPE;
 
 // prototypes
 void InitStartTime( void );
@@ -31,12 +65,16 @@ int IncNeutronTotal(int increment);
 int GetDigiTemp( void );
 int GetAnlgTemp( void );
 int GetModuTemp( void );
-int CheckForSOH(XIicPs * Iic, XUartPs Uart_PS);
+void InitHousekeepingTasks( HOUSEKEEPING_TYPE * io );
+int WaitForCommand( void );
+void SampleTemperature( XIicPs * Iic );
 int report_SOH(XIicPs * Iic, XTime local_time, int i_neutron_total, XUartPs Uart_PS, int packet_type);
+int PutPacketField( unsigned char * packet, int index, unsigned int value );
+int reportSchedStats( XUartPs Uart_PS );
 void PutCCSDSHeader(unsigned char * SOH_buff, int packet_type, int group_flags, int sequence_count, int length);
 int reportSuccess(XUartPs Uart_PS, int report_filename);
 int reportFailure(XUartPs Uart_PS);
 void CalculateChecksums(unsigned char * packet_array);
-int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_num, int run_num,  int set_num );
+int TransferSDFile( XUartPs Uart_PS, char * RecvBuffer, int file_type, int id_num, int run_num,  int set_num, int first_packet );
 
 #endif /* SRC_LUNAH_UTILS_H_ */
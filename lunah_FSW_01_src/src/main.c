@@ -38,15 +38,43 @@
  * Added a compiler option "m" to allow us to include math.h to be linked in so we
  *  may use the floor() function. If this can be worked around, I think we should. - GJS
  *
+ * 10-17-2026
+ * The 2DH bins no longer use floor(), so math.h and "m" are gone again.
+ *
  */
 
 #include "main.h"
 
+#if AMP_CPU1_BUILD
+/*
+ * CPU1 only runs the acquisition pipeline, everything else belongs to CPU0.
+ * See AMPControl.h.
+ */
+int main()
+{
+	int status = 0;			//local status variable for reporting SUCCESS/FAILURE
+
+	CacheInit();			// L1/L2 data caches on or off, see CacheControl.h
+	AMPSharedInit();		// Map the memory shared with CPU0
+	InitializeAXIDma();		// Initialize the AXI DMA Transfer Interface
+
+	status = InitializeInterruptSystem(XPAR_PS7_SCUGIC_0_DEVICE_ID);
+	if(status != XST_SUCCESS)
+		AMPGetShared()->dma_errors = 0xFFFFFFFF;	//there is no UART here, let CPU0 see it
+
+	AMPGetShared()->magic = AMP_MAGIC;	//tell CPU0 we are listening
+	while(1)
+		DataAcquisitionCPU1();
+
+	return 0;
+}
+#else
 int main()
 {
 	int status = 0;			//local status variable for reporting SUCCESS/FAILURE
 
 	int valid_data = 0;		//local test variable for WF
+	int dma_state = DMA_XFER_IDLE;
 	int array_index = 0;
 	int dram_addr = 0;
 	int dram_base = 0xA000000;
@@ -59,8 +87,10 @@ int main()
 
 	init_platform();		//Maybe we dropped out important init functions?
 	ps7_post_config();
-	Xil_DCacheDisable();	// Disable the L1/L2 data caches
+	CacheInit();			// L1/L2 data caches on or off, see CacheControl.h
+#if !AMP_CPU0_BUILD
 	InitializeAXIDma();		// Initialize the AXI DMA Transfer Interface
+#endif
 
 	status = InitializeInterruptSystem(XPAR_PS7_SCUGIC_0_DEVICE_ID);
 	if(status != XST_SUCCESS)
@@ -68,6 +98,11 @@ int main()
 		xil_printf("Interrupt system initialization error\n");
 
 	}
+#if AMP_CPU0_BUILD
+	status = AMPStartCPU1();	// CPU1 runs the DMA and processing
+	if(status != CMD_SUCCESS)
+		xil_printf("CPU1 did not start\n");
+#endif
 	// *********** Setup the Hardware Reset GPIO ****************//
 	// GPIO/TEC Test Variables
 	XGpioPs Gpio;
@@ -141,6 +176,7 @@ int main()
 	int sd_status = 0;
 
 	sd_status = MountSDCards( fatfs );
+	SDMirrorInit();		//both cards start out in use, SD0 as the active one
 	if(sd_status == CMD_SUCCESS)	//correct mounting
 	{
 		sd_status = InitLogFile0();	//create log file on SD0
@@ -199,22 +235,27 @@ int main()
 	int	menusel = 99999;		//case select variable for polling
 	FIL *cpsDataFile;
 	FIL *evtDataFile;
+
+	// *********** Start the Housekeeping Tasks ****************//
+	//SOH, temperatures, and the command poll run from the scheduler in every loop below
+	HOUSEKEEPING_TYPE housekeeping = { &Iic, &Uart_PS, RecvBuffer };
+	SchedInit();
+	InitHousekeepingTasks(&housekeeping);
+
 	// ******************* APPLICATION LOOP *******************//
 
 	//This loop will continue forever and the program won't leave it
-	//This loop checks for input from the user, then checks to see if it's time to report SOH
+	//This loop runs the scheduler until there is input from the user, the SOH goes out at 1 Hz meanwhile
 	//If input is received, then it reads the input for correctness
 	// if input is a valid MNS command, the system processes the command and reacts
 	// if not, then the system rejects the command and issues a failure packet
-	//After checking for input, the clock is checked to see if it is time to report SOH
-	//When it is time, reports a full CCSDS SOH packet
 
 	while(1){	//OUTER LEVEL 3 TESTING LOOP
 		while(1){
 			//resetting this value every time is (potentially) critical
 			//resetting this ensures we don't re-use a command a second time (erroneously)
 			menusel = 99999;
-			menusel = ReadCommandType(RecvBuffer, &Uart_PS);	//Check for user input
+			menusel = WaitForCommand();	//Check for user input, runs the housekeeping tasks until we get some
 
 			if ( menusel >= -1 && menusel <= 15 )	//let all input in, including errors, so we can report them
 			{
@@ -224,8 +265,6 @@ int main()
 					LogFileWrite( GetLastCommand(), GetLastCommandSize() );
 				break;	//leave the inner loop and execute the commanded function
 			}
-			//check to see if it is time to report SOH information, 1 Hz
-			CheckForSOH(&Iic, Uart_PS);
 		}//END TEMP ASU TESTING LOOP
 
 		//MAIN MENU OF FUNCTIONS
@@ -275,11 +314,11 @@ int main()
 					if(status == CMD_SUCCESS)
 						break;
 				}
-				CheckForSOH(&Iic, Uart_PS);
+				SchedRunPass();
 			}
 			while(done != 1)
 			{
-				status = ReadCommandType(RecvBuffer, &Uart_PS);	//Check for user input
+				status = WaitForCommand();	//Check for user input
 				//see if we got anything meaningful //we'll accept any valid command
 				if ( status >= -1 && status <= 23 )
 				{
@@ -339,8 +378,6 @@ int main()
 						break;
 					}
 				}
-				//check to see if it is time to report SOH information, 1 Hz
-				CheckForSOH(&Iic, Uart_PS);
 			}//END OF WHILE DONE != 0
 
 			cpsDataFile = GetCPSFilePointer();	//check the FIL pointers created by DAQ are closed safely
@@ -356,6 +393,8 @@ int main()
 			{
 				//TODO: handle change directory fail
 			}
+			//the run is over, put the commands given during it on the cards
+			LogFileFlush();
 			//data acquisition has been completed, wrap up anything not handled by the DAQ function
 			//turn off the active components //TODO: add this to the Flow Diagram so people know that it's off
 			Xil_Out32(XPAR_AXI_GPIO_18_BASEADDR, 0);	//disable capture module
@@ -364,6 +403,12 @@ int main()
 
 			break;
 		case WF_CMD:
+#if DMA_SG_MODE || AMP_CPU0_BUILD
+			//waveform capture uses a direct register mode transfer, which the SG build of the DMA does not have
+			//in the AMP build the DMA belongs to CPU1
+			reportFailure(Uart_PS);
+			break;
+#endif
 			Xil_Out32(XPAR_AXI_GPIO_18_BASEADDR, 1);	//enable capture module
 			//set processed data mode
 			if(GetIntParam(1) == 0)
@@ -395,18 +440,22 @@ int main()
 				{
 					//init/start MUX to transfer data between integrator modules and the DMA
 					Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 1);
-					Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x48, 0xa000000);
-					Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x58 , 65536);
-					usleep(54);
-					//TODO: need to check a shared variable within the interrupt handler and this function
-					// to see if the transfer is completed
-					//This check would replace the sleep statement.
+					DMAStartTransfer(DMA_TARGET_ADDR, DMA_TRANSFER_LENGTH);
+					//wait for the interrupt handler to report the transfer, bounded by DMA_TIMEOUT_US
+					dma_state = DMAWaitTransfer();
 
 					Xil_Out32 (XPAR_AXI_GPIO_15_BASEADDR, 0);
 
 					ClearBRAMBuffers();
+					if(dma_state != DMA_XFER_DONE)
+					{
+						//drop this buffer and get the DMA running again
+						DMAReset();
+						SchedRunPass();
+						continue;
+					}
 
-					Xil_DCacheInvalidateRange(0xa0000000, 65536);
+					CacheDMARecvComplete(DMA_TARGET_ADDR, DATA_BUFFER_SIZE * 4);
 
 					array_index = 0;
 					dram_addr = dram_base;
@@ -424,8 +473,8 @@ int main()
 						xil_printf("3 write fail WF\n");
 				}
 
-				//check for input
-				CheckForSOH(&Iic, Uart_PS);
+				//keep the SOH going
+				SchedRunPass();
 				if(numWFs > GetIntParam(2))
 					done = 1;
 			}
@@ -462,7 +511,10 @@ int main()
 			break;
 		case TX_CMD:
 			//transfer any file on the SD card
-//			status = TransferSDFile( Uart_PS, TX_CMD );
+			//intParam1 = file type, DATA_TYPE_*
+			//intParam2-4 = ID, run, and set number
+			//intParam5 = the packet to start from, to resume a transfer which was cut off
+			status = TransferSDFile( Uart_PS, RecvBuffer, GetIntParam(1), GetIntParam(2), GetIntParam(3), GetIntParam(4), GetIntParam(5) );
 			if(status == 0)
 				reportSuccess(Uart_PS, 0);
 			else
@@ -483,7 +535,7 @@ int main()
 			// 0 = data product file
 			// 1 = Log File
 			// 2 = Config file
-//			status = TransferSDFile( Uart_PS, TXLOG_CMD );
+			status = TransferSDFile( Uart_PS, RecvBuffer, DATA_TYPE_LOG, 0, 0, 0, GetIntParam(1) );
 			if(status == 0)
 				reportSuccess(Uart_PS, 0);
 			else
@@ -495,7 +547,7 @@ int main()
 			// 0 = data product file
 			// 1 = Log File
 			// 2 = Config file
-//			status = TransferSDFile( Uart_PS, CONF_CMD );
+			status = TransferSDFile( Uart_PS, RecvBuffer, DATA_TYPE_CFG, 0, 0, 0, GetIntParam(1) );
 			if(status == 0)
 				reportSuccess(Uart_PS, 0);
 			else
@@ -564,27 +616,20 @@ int main()
 			break;
 		}//END OF SWITCH/CASE (MAIN MENU OF FUNCTIONS)
 
-		//check to see if it is time to report SOH information, 1 Hz
+		//run anything which came due while the command was being handled
 		//this may help with functions which take too long during their own loops
-		CheckForSOH(&Iic, Uart_PS);
+		SchedRunPass();
 	}//END OF OUTER LEVEL 2 TESTING LOOP
 
     return 0;
 }
+#endif
 
 //////////////////////////// InitializeAXIDma////////////////////////////////
 // Sets up the AXI DMA
 int InitializeAXIDma(void) {
-	u32 tmpVal_0 = 0;
-
-	tmpVal_0 = Xil_In32(XPAR_AXI_DMA_0_BASEADDR + 0x30);
-
-	tmpVal_0 = tmpVal_0 | 0x1001; //<allow DMA to produce interrupts> 0 0 <run/stop>
-
-	Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x30, tmpVal_0);
-	Xil_In32(XPAR_AXI_DMA_0_BASEADDR + 0x30);
-
-	tmpVal_0 = Xil_In32(XPAR_AXI_DMA_0_BASEADDR + 0x30);
+	//<allow DMA to produce IOC and error interrupts> 0 0 <run/stop>
+	DMAInit();
 
 	return 0;
 }
@@ -612,6 +657,13 @@ int InitializeInterruptSystem(u16 deviceID) {
 
 	}
 
+#if AMP_CPU0_BUILD
+	//the DMA interrupt is routed to CPU1
+	return XST_SUCCESS;
+#elif AMP_CPU1_BUILD
+	XScuGic_InterruptMaptoCpu(&InterruptController, XPAR_CPU_ID, XPAR_FABRIC_AXI_DMA_0_S2MM_INTROUT_INTR);
+#endif
+
 	Status = XScuGic_Connect (&InterruptController,
 			XPAR_FABRIC_AXI_DMA_0_S2MM_INTROUT_INTR,
 			(Xil_ExceptionHandler) InterruptHandler, NULL);
@@ -637,15 +689,11 @@ int InitializeInterruptSystem(u16 deviceID) {
  *
  *  We have the DMA in Direct Register Mode with Interrupt on Complete enabled.
  *  This means that an interrupt is generated on the completion of a transfer.
- *  The interrupt handler writes to the DMA status register to clear the
+ *  The interrupt handler writes to the DMA status register to clear the interrupt,
+ *  then publishes the completion (and any error bits) for the acquisition loops.
  */
 void InterruptHandler (void ) {
-	u32 tmpValue = 0;
-	tmpValue = Xil_In32(XPAR_AXI_DMA_0_BASEADDR + 0x34);	//Read the DMA status register
-	tmpValue |= 0x1000;							//bit 12 is write-to-clear, this acknowledges the interrupt generated by IOC
-	Xil_Out32 (XPAR_AXI_DMA_0_BASEADDR + 0x34, tmpValue);	//write to the DMA status register
-
-
+	DMACompletionISR();
 }
 //////////////////////////// Interrupt Handler////////////////////////////////
 
@@ -35,6 +35,10 @@
 #include "LogFileControl.h"
 #include "DataAcquisition.h"
 #include "LNumDigits.h"
+#include "AXIDmaControl.h"
+#include "CacheControl.h"
+#include "AMPControl.h"
+#include "Scheduler.h"
 
 //Global Interrupt Control Variables
 //These need to be global for interrupts to be handled appropriately within the system
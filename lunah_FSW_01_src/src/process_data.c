@@ -10,10 +10,24 @@
 //File Scope Variables and Buffers
 static int evt_iter;										//event buffer iterator
 static const GENERAL_EVENT_TYPE evtEmptyStruct;				//use this to reset the holder struct each iteration
-static GENERAL_EVENT_TYPE event_buffer[EVENT_BUFFER_SIZE];	//buffer to store events //2048 * 8 bytes = 16384 bytes
+static GENERAL_EVENT_TYPE m_event_buffer[EVENT_BUFFER_SIZE];	//buffer to store events //2048 * 8 bytes = 16384 bytes
+static GENERAL_EVENT_TYPE *event_buffer = m_event_buffer;	//where the events are going, may be pointed at a queued block instead
 static unsigned int m_neutron_counts;						//total neutron counts
 static unsigned int m_event_number;							//event number holder
 static unsigned int m_first_event_time_FPGA;				//the first event time which needs to be written into every data product header
+static int m_bl_samples;									//integration times in samples, read once per buffer
+static int m_si_samples;
+static int m_li_samples;
+static int m_fi_samples;
+static unsigned int m_events_total;							//events binned since ResetProcessStats()
+static unsigned int m_fixed_point_fallbacks;				//events too close to a bin edge for the integers, binned in double precision
+static unsigned short m_event_index[EVENT_INDEX_SIZE];		//offsets of the record markers in the buffer being processed
+static XTime m_prescan_ticks;								//time spent building the index since ResetProcessStats()
+static XTime m_pass_ticks[PROCESS_PASSES];					//time spent in each batch pass since ResetProcessStats()
+static EVENT_BATCH_TYPE m_batch;							//the events from the buffer being processed
+static BASELINE_RING_TYPE m_baselines[PROCESS_BASELINE_RINGS];	//running baseline for each PMT, kept for the whole run
+static float m_energy_scale[PROCESS_BASELINE_DEPTH + 1];	//1 / (16 * baseline samples * n) for the fixed point energy
+static unsigned int m_prescan_markers;						//markers found since ResetProcessStats()
 
 /*
  * Helper function to allow external functions to grab the EVTs buffer and write it to SD
@@ -24,9 +38,23 @@ GENERAL_EVENT_TYPE * GetEVTsBufferAddress( void )
 }
 
 
+/*
+ * Point the events at another buffer of EVENT_BUFFER_SIZE events, ie. a block from the DAQ
+ *  queue, so that they are written in place instead of being copied out later.
+ * Passing NULL goes back to the internal buffer.
+ */
+void SetEVTsBufferAddress( GENERAL_EVENT_TYPE * buffer )
+{
+	if(buffer == NULL)
+		event_buffer = m_event_buffer;
+	else
+		event_buffer = buffer;
+	return;
+}
+
 void ResetEVTsBuffer( void )
 {
-	memset(event_buffer, '\0', sizeof(event_buffer));
+	memset(event_buffer, '\0', sizeof(GENERAL_EVENT_TYPE) * EVENT_BUFFER_SIZE);
 	return;
 }
 
@@ -36,86 +64,382 @@ void ResetEVTsIterator( void )
 	return;
 }
 
+/*
+ * Number of events in the events buffer so far, the rest of the buffer holds nothing useful.
+ */
+int GetEVTsIterator( void )
+{
+	return evt_iter;
+}
+
 
 unsigned int GetFirstEventTime( void )
 {
 	return m_first_event_time_FPGA;
 }
 
+/*
+ * Statistics for the timing report, cleared at the start of each run.
+ */
+void ResetProcessStats( void )
+{
+	m_events_total = 0;
+	m_fixed_point_fallbacks = 0;
+	m_prescan_ticks = 0;
+	m_prescan_markers = 0;
+	memset(m_pass_ticks, 0, sizeof(m_pass_ticks));
+	return;
+}
 
 /*
- * This function will be called after we read in a buffer of valid data from the FPGA.
- *  Here is where the data stream from the FPGA is scanned for events and each event
- *  is processed to pull the PSD and energy information out. We identify it the event
- *  is within the current 1 second CPS interval, as well as bin the events into a
- *  2-D histogram which is reported at the end of a run.
+ * Empty the running baselines, at the start of each run.
+ */
+void ResetBaselines( void )
+{
+	memset(m_baselines, 0, sizeof(m_baselines));
+	return;
+}
+
+/*
+ * Add the baseline of an event to the running baseline of its PMT, dropping the oldest one
+ *  once the ring is full. The sum is kept as it goes, so this costs the same for any depth.
  *
- * @param	A pointer to the data buffer
+ * @param	(unsigned int) The PMT ID bits from the event
+ * @param	(unsigned int) The raw baseline of the event
  *
- * @return	SUCCESS/FAILURE
+ * @return	(BASELINE_RING_TYPE *) The ring, for its sum and count
  */
-int ProcessData( unsigned int * data_raw )
+static BASELINE_RING_TYPE * AddBaseline( unsigned int pmt_ID, unsigned int bl_raw )
+{
+	BASELINE_RING_TYPE * ring = NULL;
+
+	switch(pmt_ID)
+	{
+	case 1:
+		ring = &m_baselines[0];
+		break;
+	case 2:
+		ring = &m_baselines[1];
+		break;
+	case 4:
+		ring = &m_baselines[2];
+		break;
+	case 8:
+		ring = &m_baselines[3];
+		break;
+	default:
+		ring = &m_baselines[4];	//multiple hits
+		break;
+	}
+
+	if(ring->count == PROCESS_BASELINE_DEPTH)
+		ring->sum -= ring->samples[ring->next];
+	else
+		ring->count++;
+	ring->samples[ring->next] = bl_raw;
+	ring->sum += bl_raw;
+	ring->next++;
+	if(ring->next == PROCESS_BASELINE_DEPTH)
+		ring->next = 0;
+	return ring;
+}
+
+XTime GetProcessPassTicks( int pass )
+{
+	if(pass < 0 || pass >= PROCESS_PASSES)
+		return 0;
+	return m_pass_ticks[pass];
+}
+
+XTime GetPrescanTicks( void )
+{
+	return m_prescan_ticks;
+}
+
+unsigned int GetPrescanMarkers( void )
+{
+	return m_prescan_markers;
+}
+
+unsigned int GetProcessedEvents( void )
+{
+	return m_events_total;
+}
+
+unsigned int GetFixedPointFallbacks( void )
+{
+	return m_fixed_point_fallbacks;
+}
+
+/*
+ * Work out the reciprocals for the fixed point energy, whenever the baseline integration
+ *  time is set, so that ProcessData() does no divides of its own.
+ *
+ * @param	(int) The baseline integration time in samples
+ *
+ * @return	None
+ */
+void SetEnergyScale( int bl_samples )
 {
-	bool valid_event = FALSE;
 	int iter = 0;
-	int m_ret = 0;	//for 2DH tallies
-	int m_events_processed = 0;
-	unsigned int m_x_bin_number = 0;
-	unsigned int m_y_bin_number = 0;
-	unsigned int m_invalid_events = 0;
-	unsigned int num_bytes_written = 0;
-	unsigned int m_total_events_holder = 0;
-	unsigned int m_pmt_ID_holder = 0;
-	unsigned int m_FPGA_time_holder = 0;
-	unsigned int m_bad_event = 0;
-	double m_baseline_int = 0.0;
-	double m_short_int = 0.0;
-	double m_long_int = 0.0;
-	double m_full_int = 0.0;
-	double bl_avg = 0.0;
-	double bl1 = 0.0;
-	double bl2 = 0.0;
-	double bl3 = 0.0;
-	double bl4 = 0.0;
+
+	m_energy_scale[0] = 0.0f;
+	for(iter = 1; iter <= PROCESS_BASELINE_DEPTH; iter++)
+		m_energy_scale[iter] = 1.0f / (16.0f * (float)bl_samples * (float)iter);
+	return;
+}
+
+/*
+ * Find every word in the buffer which could start a record, either marker, in one pass.
+ * Only the words a record can start on are looked at, the same limit ProcessData() has always had.
+ * Each word is compared and stored without a branch, the count only moves on when the word
+ *  was a marker, so the loop costs the same however the markers fall.
+ *
+ * @param	(unsigned int *) The raw buffer, DATA_BUFFER_SIZE words
+ * @param	(unsigned short *) Filled in with the offsets of the markers, EVENT_INDEX_SIZE long
+ *
+ * @return	The number of markers found
+ */
+static int PrescanBuffer( const unsigned int * data_raw, unsigned short * index )
+{
+	int iter = 0;
+	int count = 0;
+	int limit = DATA_BUFFER_SIZE - EVT_EVENT_SIZE + 1;	//no record starts above this
+	unsigned int word = 0;
+
+	for(iter = 0; iter < limit; iter++)
+	{
+		word = data_raw[iter];
+		index[count] = iter;
+		count += (word == DATA_EVENT_MARKER) | (word == FALSE_EVENT_MARKER);
+	}
+	return count;
+}
+
+/*
+ * Work out the energy and PSD of one event in double precision.
+ * The baseline is the average of the last PROCESS_BASELINE_DEPTH from the same PMT, this
+ *  event's included, or of as many as there have been so far this run.
+ *
+ * @param	(unsigned int) The short integral
+ * @param	(unsigned int) The long integral
+ * @param	(unsigned int) The full integral
+ * @param	(BASELINE_RING_TYPE *) The running baseline, with this event's in it
+ * @param	(double *) Set to the energy
+ * @param	(double *) Set to the PSD ratio
+ *
+ * @return	1 if the PSD was good, 0 if it was set to the highest good bin instead
+ */
+static int DoubleEnergyPSD( unsigned int short_raw, unsigned int long_raw, unsigned int full_raw, const BASELINE_RING_TYPE * baseline, double * energy, double * psd )
+{
+	double bl_avg = (double)baseline->sum / (16.0 * (double)m_bl_samples * (double)baseline->count);
 	double si = 0.0;
 	double li = 0.0;
 	double fi = 0.0;
-	double psd = 0.0;
-	double energy = 0.0;
-	FRESULT f_res = FR_OK;
-	GENERAL_EVENT_TYPE event_holder = evtEmptyStruct;
 
-//	unsigned int val1 = 0;	//TEST
-//	unsigned int val2 = 0;	//TEST
-//	unsigned int val3 = 0;	//TEST
-//	unsigned int val4 = 0;	//TEST
+	si = ((double)short_raw) / (16.0) - (bl_avg * (double)m_si_samples);
+	li = ((double)long_raw) / (16.0) - (bl_avg * (double)m_li_samples);
+	fi = ((double)full_raw) / (16.0) - (bl_avg * (double)m_fi_samples);
+	*energy = fi;
 
-	//get the integration times
-	m_baseline_int = (double)GetBaselineInt();
-	m_short_int = (double)GetShortInt();
-	m_long_int = (double)GetLongInt();
-	m_full_int = (double)GetFullInt();
+	//li, si must be positive, li greater than si (ensures positive psd values and li != si)
+	if( li > 0 && si > 0 && li > si) //TODO: how much should we test here? //si != 0, li > si, si > 0 ?
+	{
+		*psd = si / (li - si);
+		return 1;
+	}
+	//TODO: PSD value not good
+	*psd = 1.999;	//set to highest good bin
+	return 0;
+}
 
-	FIL *cpsDataFile = GetCPSFilePointer();
-	if (cpsDataFile == NULL)
+#if PROCESS_FIXED_POINT
+/*
+ * floor(num / den) for num >= 0, den > 0, when only the answers below limit matter.
+ * A binary search on multiplies, so there is no 64-bit division.
+ *
+ * @return	floor(num / den), or limit if that is limit or more
+ */
+static int FixedPointBin( long long num, long long den, int limit )
+{
+	int lo = 0;
+	int hi = limit;
+	int mid = 0;
+
+	if(num >= (long long)limit * den)
+		return limit;
+	while(hi - lo > 1)	//lo * den <= num < hi * den
 	{
-		//TODO: handle error with pointer
-		xil_printf("error getting FIL pointer 6\n");
+		mid = (lo + hi) / 2;
+		if((long long)mid * den <= num)
+			lo = mid;
+		else
+			hi = mid;
 	}
+	return lo;
+}
+
+/*
+ * How far num / den is from the nearest bin edge that matters, in units of 1 / den, where
+ *  bin = FixedPointBin(num, den, limit). The edges are 1 to limit; the one at 0 is left out
+ *  as anything below it goes to bin 0 either way.
+ */
+static long long FixedPointEdgeDistance( long long num, long long den, int bin, int limit )
+{
+	long long rem = num - (long long)bin * den;	//0 <= rem < den below limit
+
+	if(bin >= limit)
+		return rem;
+	if(bin == 0 || den - rem < rem)
+		return den - rem;
+	return rem;
+}
+
+/*
+ * Work out the 2DH bins of one event in integers. This is the same sum as DoubleEnergyPSD(),
+ *  but with everything kept over the common denominator 16 * baseline samples * number of
+ *  baselines averaged, so it is exact; the largest numerator is under 2^61.
+ * The bins are always the ones the double precision path gives. The doubles are within
+ *  2^-51 of the largest term in the sums, and the two divides in Get2DHBins() add 2^-52 each,
+ *  so when the exact answer is further than that (with a factor of 4 to spare) from a bin
+ *  edge, and from where the PSD test changes, both round to the same bin. The few events
+ *  closer than that are worked out by DoubleEnergyPSD() instead, see GetFixedPointFallbacks().
+ *
+ * @param	(unsigned int) The short integral
+ * @param	(unsigned int) The long integral
+ * @param	(unsigned int) The full integral
+ * @param	(BASELINE_RING_TYPE *) The running baseline, with this event's in it
+ * @param	(int *) Set to the energy bin, TWODH_X_BINS if it is above the histogram
+ * @param	(int *) Set to the PSD bin, TWODH_Y_BINS if it is above the histogram
+ * @param	(float *) Set to the energy, for the neutron cuts
+ * @param	(float *) Set to the PSD ratio numerator
+ * @param	(float *) Set to the PSD ratio denominator, 0 if the PSD was no good
+ *
+ * @return	1 if the PSD was good, 0 if it was put in the highest good bin instead
+ */
+static int FixedPointBins( unsigned int short_raw, unsigned int long_raw, unsigned int full_raw, const BASELINE_RING_TYPE * baseline, int * x_bin, int * y_bin, float * energy, float * psd_num, float * psd_den )
+{
+	long long n_bl = baseline->count;	//number of baselines averaged
+	long long bl_sum = baseline->sum;
+	long long si = 0;
+	long long li = 0;
+	long long fi = 0;
+	long long raw_max = full_raw;
+	long long samples_max = m_fi_samples;
+	long long err = 0;					//how far the doubles can be from si, li and fi, in the same units
+	long long den = 0;
+	int psd_good = 0;
+	int fallback = 0;					//1 if the event is too close to an edge for the integers
+	double energy_check = 0.0;
+	double psd_check = 0.0;
 
-	while(iter < DATA_BUFFER_SIZE)
+	si = (long long)short_raw * m_bl_samples * n_bl - bl_sum * m_si_samples;
+	li = (long long)long_raw * m_bl_samples * n_bl - bl_sum * m_li_samples;
+	fi = (long long)full_raw * m_bl_samples * n_bl - bl_sum * m_fi_samples;
+	*energy = (float)fi * m_energy_scale[n_bl];
+
+	if(short_raw > raw_max)
+		raw_max = short_raw;
+	if(long_raw > raw_max)
+		raw_max = long_raw;
+	if(m_si_samples > samples_max)
+		samples_max = m_si_samples;
+	if(m_li_samples > samples_max)
+		samples_max = m_li_samples;
+	err = raw_max * m_bl_samples * n_bl;
+	if(bl_sum * samples_max > err)
+		err = bl_sum * samples_max;
+	err = (err >> 49) + 1;
+
+	//energy bin = floor(fi / (TWODH_ENERGY_MAX / TWODH_X_BINS)), a negative energy goes to bin 0
+	den = 16 * m_bl_samples * n_bl * (long long)TWODH_ENERGY_MAX;
+	if(fi < 0)
+		*x_bin = 0;
+	else
 	{
-		event_holder = evtEmptyStruct;	//reset event structure
+		*x_bin = FixedPointBin(fi * TWODH_X_BINS, den, TWODH_X_BINS);
+		if(FixedPointEdgeDistance(fi * TWODH_X_BINS, den, *x_bin, TWODH_X_BINS) <= err * TWODH_X_BINS + (((TWODH_X_BINS + 1) * den) >> 49) + 1)
+			fallback = 1;
+	}
 
-//		val1 = data_raw[iter];	//TEST
-//		val2 = data_raw[iter+1];	//TEST
-//		val3 = data_raw[iter+8];	//TEST
-//		val4 = data_raw[iter+9];	//TEST
+	//PSD bin = floor(si / (li - si) / (TWODH_PSD_MAX / TWODH_Y_BINS)), the denominators cancel
+	//the PSD test has to come out the same as it does on the doubles
+	if((si < 0 ? -si : si) <= 64 * err || (li < 0 ? -li : li) <= 64 * err || (li < si ? si - li : li - si) <= 64 * err)
+		fallback = 1;
+	else if(li > 0 && si > 0 && li > si)
+	{
+		den = (li - si) * (long long)TWODH_PSD_MAX;
+		*y_bin = FixedPointBin(si * TWODH_Y_BINS, den, TWODH_Y_BINS);
+		if(FixedPointEdgeDistance(si * TWODH_Y_BINS, den, *y_bin, TWODH_Y_BINS) <= 6 * err * TWODH_Y_BINS + (((TWODH_Y_BINS + 1) * den) >> 49) + 1)
+			fallback = 1;
+		psd_good = 1;
+	}
+	else
+		*y_bin = TWODH_Y_BINS - 1;	//a PSD of 1.999, the highest good bin
+
+	if(fallback)
+	{
+		m_fixed_point_fallbacks++;
+		psd_good = DoubleEnergyPSD(short_raw, long_raw, full_raw, baseline, &energy_check, &psd_check);
+		Get2DHBins(energy_check, psd_check, x_bin, y_bin);
+		*energy = (float)energy_check;
+		*psd_num = (float)psd_check;
+		*psd_den = (float)psd_good;
+	}
+	else if(psd_good)
+	{
+		*psd_num = (float)si;
+		*psd_den = (float)(li - si);
+	}
+	else
+	{
+		*psd_num = 0.0f;
+		*psd_den = 0.0f;
+	}
+	return psd_good;
+}
+#endif
+
+
+/*
+ * First pass of ProcessData(): find and check each record, in order.
+ * The false events are written out here, they are just a time stamp. The data events are
+ *  checked, the CPS interval is moved on (which the next event's check depends on), and
+ *  each good one is copied into the batch along with the slot its EVT record goes in.
+ *
+ * @param	(unsigned int *) The raw buffer
+ * @param	(int) Number of markers in m_event_index
+ *
+ * @return	None
+ */
+static void ExtractEvents( unsigned int * data_raw, int index_count )
+{
+	bool valid_event = FALSE;
+	int iter = 0;
+	int index_iter = 0;		//next entry in the marker index
+	int m_events_processed = 0;
+	unsigned int m_invalid_events = 0;
+	unsigned int n = 0;
+	unsigned int interval_time = 0;
+	GENERAL_EVENT_TYPE event_holder = evtEmptyStruct;
+
+	m_batch.count = 0;
+	m_batch.cps_count = 0;
+	while(index_iter < index_count)
+	{
+		//skip the markers inside the record we just decoded, then go straight to the next one
+		if(m_event_index[index_iter] < iter)
+		{
+			index_iter++;
+			continue;
+		}
+		iter = m_event_index[index_iter++];
+		event_holder = evtEmptyStruct;	//reset event structure
 
 		switch(data_raw[iter])
 		{
-		case 111111: //this is the data event case
-			while(data_raw[iter+1] == 111111 && iter < (DATA_BUFFER_SIZE - EVT_EVENT_SIZE))//handles any number of 111111's in succession
+		case DATA_EVENT_MARKER: //this is the data event case
+			while(data_raw[iter+1] == DATA_EVENT_MARKER && iter < (DATA_BUFFER_SIZE - EVT_EVENT_SIZE))//handles any number of 111111's in succession
 			{
 				iter++;
 			}
@@ -130,96 +454,28 @@ int ProcessData( unsigned int * data_raw )
 						if((data_raw[iter+4] < data_raw[iter+5]) && (data_raw[iter+5] < data_raw[iter+6]) && (data_raw[iter+6] < data_raw[iter+7]))
 						{
 							valid_event = TRUE;
+							interval_time = cpsGetCurrentTime();
 							if(cpsCheckTime(data_raw[iter+1]) == TRUE)
 							{
-								f_res = f_write(cpsDataFile, (char *)cpsGetEvent(), CPS_EVENT_SIZE, &num_bytes_written);
-								if(f_res != FR_OK || num_bytes_written != CPS_EVENT_SIZE)
-								{
-									//TODO:handle error with writing
-									xil_printf("error writing 4\n");
-								}
-								f_res = f_sync(cpsDataFile);
-								if(f_res != FR_OK || num_bytes_written != CPS_EVENT_SIZE)
-								{
-									//TODO:handle error with writing
-									xil_printf("error writing 5\n");
-								}
+								//the CPS event goes out once the events before this one are counted, see EncodeEvents()
+								m_batch.cps_at[m_batch.cps_count] = m_batch.count;
+								m_batch.cps_time[m_batch.cps_count] = interval_time;
+								m_batch.cps_count++;
 							}
 
-							event_holder.field0 = 0xFF;	//event ID is 0xFF
-							m_pmt_ID_holder = data_raw[iter+3] & 0x0F;
-							switch(m_pmt_ID_holder)
-							{
-							case 1:
-								event_holder.field1 |= 0x00; //PMT 0
-								break;
-							case 2:
-								event_holder.field1 |= 0x40; //PMT 1
-								break;
-							case 4:
-								event_holder.field1 |= 0x80; //PMT 2
-								break;
-							case 8:
-								event_holder.field1 |= 0xC0; //PMT 3
-								break;
-							default:
-								//invalid event
-								//TODO: Handle bad/multiple hit IDs
-								//with only 2 bits, we have no way to report this...
-								//maybe take a bit or two from the Event ID?
-								event_holder.field1 |= 0x00; //PMT 0 for now
-								break;
-							}
-							m_total_events_holder = data_raw[iter+2] & 0xFFF;	//mask the upper bits we don't care about
-							event_holder.field1 |= (unsigned char)(m_total_events_holder >> 6);
-							event_holder.field2 |= (unsigned char)(m_total_events_holder << 2);
-
-							si = 0.0;	li = 0.0;	fi = 0.0;	psd = 0.0;	energy = 0.0;
-							bl4 = bl3; bl3 = bl2; bl2 = bl1;
-							bl1 = (double)data_raw[iter+4] / (16.0 * m_baseline_int);
-							if(bl4 == 0.0)
-								bl_avg = bl1;
-							else
-								bl_avg = (bl4 + bl3 + bl2 + bl1) / 4.0;
-							si = ((double)data_raw[iter+5]) / (16.0) - (bl_avg * m_short_int);
-							li = ((double)data_raw[iter+6]) / (16.0) - (bl_avg * m_long_int);
-							fi = ((double)data_raw[iter+7]) / (16.0) - (bl_avg * m_full_int);
-							energy = fi;
-
-							//li, si must be positive, li greater than si (ensures positive psd values and li != si)
-							if( li > 0 && si > 0 && li > si) //TODO: how much should we test here? //si != 0, li > si, si > 0 ?
-								psd = si / (li - si);
-							else
-							{
-								//TODO: PSD value not good
-								psd = 1.999;	//set to highest good bin
-								m_bad_event++;
-							}
-
-							//add the energy and PSD tallies to the correct histogram
-							m_ret = Tally2DH(energy, psd, m_pmt_ID_holder);
-							if(m_ret == CMD_FAILURE)
-							{
-								//handle error in tallying the event into the 2DH
-								//TODO: identify what can go wrong and handle a bad tally
-							}
-							m_x_bin_number = Get2DHArrayIndexX();
-							m_y_bin_number = Get2DHArrayIndexY();
-							event_holder.field2 |= (unsigned char)((m_x_bin_number >> 8) & 0x03);
-							event_holder.field3 |= (unsigned char)(m_x_bin_number);
-							event_holder.field4 |= (unsigned char)(m_y_bin_number << 2);
-							m_FPGA_time_holder = data_raw[iter+1] & 0x03FFFFFF;	//mask the upper bits so we don't overwrite anything
-							event_holder.field4 |= (unsigned char)((m_FPGA_time_holder >> 24) & 0x03);
-							event_holder.field5 = (unsigned char)(m_FPGA_time_holder >> 16);
-							event_holder.field6 = (unsigned char)(m_FPGA_time_holder >> 8);
-							event_holder.field7 = (unsigned char)(m_FPGA_time_holder);
-							event_buffer[evt_iter] = event_holder;
-							evt_iter++;
+							n = m_batch.count;
+							m_batch.slot[n] = evt_iter;
+							m_batch.time[n] = data_raw[iter+1];
+							m_batch.total_events[n] = data_raw[iter+2];
+							m_batch.pmt_ID[n] = data_raw[iter+3] & 0x0F;
+							m_batch.baseline[n] = data_raw[iter+4];
+							m_batch.short_int[n] = data_raw[iter+5];
+							m_batch.long_int[n] = data_raw[iter+6];
+							m_batch.full_int[n] = data_raw[iter+7];
+							m_batch.count++;
+							evt_iter++;		//the record is packed in later, see EncodeEvents()
 							iter += 8;
 							m_events_processed++;
-
-//							CPSUpdateTallies(energy, psd);
-							IncNeutronTotal(1);	//increment the neutron total by 1? TODO: check the return here and make sure it has increased?
 						}
 						else
 							valid_event = FALSE;
@@ -233,13 +489,13 @@ int ProcessData( unsigned int * data_raw )
 			else
 				valid_event = FALSE;
 			break;
-		case 2147594759:	//this is a false event
+		case FALSE_EVENT_MARKER:	//this is a false event
 			if(iter >= DATA_BUFFER_SIZE - 9 )	//meant to protect from writing above array indices...
 			{
 				iter++;
 				break;
 			}
-			if( data_raw[iter + 1] == 2147594759 && data_raw[iter + 9] == 111111)
+			if( data_raw[iter + 1] == FALSE_EVENT_MARKER && data_raw[iter + 9] == DATA_EVENT_MARKER)
 			{
 				cpsSetFirstEventTime(data_raw[iter + 2]);
 				m_first_event_time_FPGA = data_raw[iter + 2];
@@ -289,6 +545,216 @@ int ProcessData( unsigned int * data_raw )
 		//TODO: fully error check the buffering here
 		//2-15, anything else?
 	}//END OF WHILE
+	return;
+}
+
+/*
+ * Second pass of ProcessData(): the energy and PSD bins and the neutron cuts for every event
+ *  in the batch.
+ * The only thing carried from one event to the next is the running baseline of each PMT,
+ *  which also carries on from the last buffer, so this is a straight loop over the arrays.
+ *
+ * @param	None
+ *
+ * @return	The number of events whose PSD was no good
+ */
+static unsigned int ComputeEventBins( void )
+{
+	unsigned int n = 0;
+	unsigned int m_bad_event = 0;
+	int psd_good = 0;		//1 if the PSD of the event was good
+	BASELINE_RING_TYPE * baseline = NULL;
+#if PROCESS_FIXED_POINT
+	int m_x_bin = 0;
+	int m_y_bin = 0;
+	float energy_cut = 0.0f;
+	float psd_num = 0.0f;
+	float psd_den = 0.0f;
+#endif
+#if !PROCESS_FIXED_POINT
+	int m_x_check = 0;
+	int m_y_check = 0;
+	double psd = 0.0;
+	double energy = 0.0;
+#endif
+
+	for(n = 0; n < m_batch.count; n++)
+	{
+		baseline = AddBaseline(m_batch.pmt_ID[n], m_batch.baseline[n]);
+#if PROCESS_FIXED_POINT
+		psd_good = FixedPointBins(m_batch.short_int[n], m_batch.long_int[n], m_batch.full_int[n], baseline, &m_x_bin, &m_y_bin, &energy_cut, &psd_num, &psd_den);
+		if(psd_good == 0)
+			m_bad_event++;
+		m_batch.x_bin[n] = m_x_bin;
+		m_batch.y_bin[n] = m_y_bin;
+		m_batch.cuts[n] = cpsCutEvent(energy_cut, psd_num, psd_den, m_batch.pmt_ID[n]);
+#else
+		psd_good = DoubleEnergyPSD(m_batch.short_int[n], m_batch.long_int[n], m_batch.full_int[n], baseline, &energy, &psd);
+		if(psd_good == 0)
+			m_bad_event++;
+		Get2DHBins(energy, psd, &m_x_check, &m_y_check);
+		m_batch.x_bin[n] = m_x_check;
+		m_batch.y_bin[n] = m_y_check;
+		m_batch.cuts[n] = cpsCutEvent((float)energy, (float)psd, (float)psd_good, m_batch.pmt_ID[n]);
+#endif
+	}
+	return m_bad_event;
+}
+
+/*
+ * Send out the CPS event for a 1 second interval which has ended.
+ *
+ * @param	(unsigned int) The FPGA time the interval started at
+ *
+ * @return	None
+ */
+static void SendCPSEvent( unsigned int interval_time )
+{
+#if AMP_CPU1_BUILD
+	//CPU0 owns the SD card, hand the event over to be written
+	BlockQueueSend(&(AMPGetShared()->cps_q), BLOCK_CPS, cpsGetEvent(interval_time), CPS_EVENT_SIZE, 0);
+#else
+	//held in RAM until the writer flushes it, see cpsFlushBuffer()
+	cpsBufferEvent(cpsGetEvent(interval_time));
+#endif
+	return;
+}
+
+/*
+ * Last pass of ProcessData(): tally the batch into the 2DHs and the CPS counters and pack
+ *  each event into its 8 byte EVT record, in the slot ExtractEvents() kept for it.
+ * The CPS counters are only good for the interval they are in, so this goes in event order
+ *  and each interval which ended in the buffer is sent out as the events reach it.
+ *
+ * @param	None
+ *
+ * @return	None
+ */
+static void EncodeEvents( void )
+{
+	int m_ret = 0;	//for 2DH tallies
+	unsigned int n = 0;
+	unsigned int cps_iter = 0;	//next interval to end
+	unsigned int m_x_bin_number = 0;
+	unsigned int m_y_bin_number = 0;
+	unsigned int m_total_events_holder = 0;
+	unsigned int m_FPGA_time_holder = 0;
+	GENERAL_EVENT_TYPE event_holder = evtEmptyStruct;
+
+	for(n = 0; n < m_batch.count; n++)
+	{
+		while(cps_iter < m_batch.cps_count && m_batch.cps_at[cps_iter] <= n)
+		{
+			SendCPSEvent(m_batch.cps_time[cps_iter]);
+			cps_iter++;
+		}
+		CPSUpdateTallies(m_batch.cuts[n]);
+
+		//add the energy and PSD tallies to the correct histogram
+		m_ret = Tally2DHBins(m_batch.x_bin[n], m_batch.y_bin[n], m_batch.pmt_ID[n]);
+		if(m_ret == CMD_FAILURE)
+		{
+			//handle error in tallying the event into the 2DH
+			//TODO: identify what can go wrong and handle a bad tally
+		}
+		m_x_bin_number = Get2DHArrayIndexX();
+		m_y_bin_number = Get2DHArrayIndexY();
+
+		event_holder = evtEmptyStruct;	//reset event structure
+		event_holder.field0 = 0xFF;	//event ID is 0xFF
+		switch(m_batch.pmt_ID[n])
+		{
+		case 1:
+			event_holder.field1 |= 0x00; //PMT 0
+			break;
+		case 2:
+			event_holder.field1 |= 0x40; //PMT 1
+			break;
+		case 4:
+			event_holder.field1 |= 0x80; //PMT 2
+			break;
+		case 8:
+			event_holder.field1 |= 0xC0; //PMT 3
+			break;
+		default:
+			//invalid event
+			//TODO: Handle bad/multiple hit IDs
+			//with only 2 bits, we have no way to report this...
+			//maybe take a bit or two from the Event ID?
+			event_holder.field1 |= 0x00; //PMT 0 for now
+			break;
+		}
+		m_total_events_holder = m_batch.total_events[n] & 0xFFF;	//mask the upper bits we don't care about
+		event_holder.field1 |= (unsigned char)(m_total_events_holder >> 6);
+		event_holder.field2 |= (unsigned char)(m_total_events_holder << 2);
+		event_holder.field2 |= (unsigned char)((m_x_bin_number >> 8) & 0x03);
+		event_holder.field3 |= (unsigned char)(m_x_bin_number);
+		event_holder.field4 |= (unsigned char)(m_y_bin_number << 2);
+		m_FPGA_time_holder = m_batch.time[n] & 0x03FFFFFF;	//mask the upper bits so we don't overwrite anything
+		event_holder.field4 |= (unsigned char)((m_FPGA_time_holder >> 24) & 0x03);
+		event_holder.field5 = (unsigned char)(m_FPGA_time_holder >> 16);
+		event_holder.field6 = (unsigned char)(m_FPGA_time_holder >> 8);
+		event_holder.field7 = (unsigned char)(m_FPGA_time_holder);
+		event_buffer[m_batch.slot[n]] = event_holder;
+	}
+	//intervals which ended after the last good event
+	while(cps_iter < m_batch.cps_count)
+	{
+		SendCPSEvent(m_batch.cps_time[cps_iter]);
+		cps_iter++;
+	}
+	IncNeutronTotal(m_batch.count);	//increment the neutron total by the events in this buffer
+	m_events_total += m_batch.count;
+	return;
+}
+
+/*
+ * This function will be called after we read in a buffer of valid data from the FPGA.
+ *  Here is where the data stream from the FPGA is scanned for events and each event
+ *  is processed to pull the PSD and energy information out. We identify it the event
+ *  is within the current 1 second CPS interval, as well as bin the events into a
+ *  2-D histogram which is reported at the end of a run.
+ * The buffer goes through in passes over the whole batch of events rather than one event
+ *  at a time: find the record markers (PrescanBuffer()), pull out and check the events
+ *  (ExtractEvents()), work out their bins (ComputeEventBins()), then tally and pack them
+ *  (EncodeEvents()). The events are held in arrays (see EVENT_BATCH_TYPE) in between.
+ *
+ * @param	A pointer to the data buffer
+ *
+ * @return	SUCCESS/FAILURE
+ */
+int ProcessData( unsigned int * data_raw )
+{
+	int index_count = 0;	//number of markers in the buffer
+	XTime m_pass_start;
+	XTime m_pass_end;
+
+	//get the integration times
+	m_bl_samples = GetBaselineInt();
+	m_si_samples = GetShortInt();
+	m_li_samples = GetLongInt();
+	m_fi_samples = GetFullInt();
+
+	XTime_GetTime(&m_pass_start);
+	index_count = PrescanBuffer(data_raw, m_event_index);
+	XTime_GetTime(&m_pass_end);
+	m_prescan_ticks += m_pass_end - m_pass_start;
+	m_prescan_markers += index_count;
+
+	m_pass_start = m_pass_end;
+	ExtractEvents(data_raw, index_count);
+	XTime_GetTime(&m_pass_end);
+	m_pass_ticks[PROCESS_PASS_EXTRACT] += m_pass_end - m_pass_start;
+
+	m_pass_start = m_pass_end;
+	ComputeEventBins();
+	XTime_GetTime(&m_pass_end);
+	m_pass_ticks[PROCESS_PASS_COMPUTE] += m_pass_end - m_pass_start;
+
+	m_pass_start = m_pass_end;
+	EncodeEvents();
+	XTime_GetTime(&m_pass_end);
+	m_pass_ticks[PROCESS_PASS_ENCODE] += m_pass_end - m_pass_start;
 
 	//TODO: give this return value a meaning
 	return 0;
@@ -16,6 +16,28 @@
 #include "SetInstrumentParam.h"
 #include "CPSDataProduct.h"
 #include "TwoDHisto.h"
+#include "AMPControl.h"
+
+//Set to 1 to work out the energy and PSD bins in integers. The bins are the same, but on the host the
+// binary searches and the events sent back to the doubles cost more than the doubles do (see binstest),
+// so it stays off until the cycles per event on the A9 show otherwise
+#ifndef PROCESS_FIXED_POINT
+#define PROCESS_FIXED_POINT			0
+#endif
+
+//Number of baselines averaged for each PMT, 4 to 64
+#ifndef PROCESS_BASELINE_DEPTH
+#define PROCESS_BASELINE_DEPTH		4
+#endif
+#if PROCESS_BASELINE_DEPTH < 4 || PROCESS_BASELINE_DEPTH > 64
+#error "PROCESS_BASELINE_DEPTH must be 4 to 64"
+#endif
+#define PROCESS_BASELINE_RINGS		5	//one for each PMT, then one for the multiple hits
+
+//Words which start a record in the raw FPGA buffer
+#define DATA_EVENT_MARKER			111111		//an event, the 7 words after it are the event
+#define FALSE_EVENT_MARKER			2147594759u	//two of these start the false event with the first event time
+#define EVENT_INDEX_SIZE			(DATA_BUFFER_SIZE - EVT_EVENT_SIZE + 2)	//every word a record can start on, plus one
 
 typedef struct {
 	unsigned char field0;
@@ -28,11 +50,54 @@ typedef struct {
 	unsigned char field7;
 }GENERAL_EVENT_TYPE;
 
+//The last PROCESS_BASELINE_DEPTH raw baselines of one PMT and their sum
+typedef struct {
+	unsigned int samples[PROCESS_BASELINE_DEPTH];
+	unsigned long long sum;
+	unsigned int count;				//samples in the ring, up to PROCESS_BASELINE_DEPTH
+	unsigned int next;				//the sample to replace next
+} BASELINE_RING_TYPE;
+
+//ProcessData() passes, see GetProcessPassTicks()
+#define PROCESS_PASS_EXTRACT		0	//find and check the events
+#define PROCESS_PASS_COMPUTE		1	//energy and PSD bins
+#define PROCESS_PASS_ENCODE			2	//2DH tallies and EVT records
+#define PROCESS_PASSES				3
+
+//One buffer's worth of good data events, one array per field
+typedef struct {
+	unsigned int count;
+	unsigned short slot[VALID_BUFFER_SIZE];			//where the EVT record goes in the events buffer
+	unsigned char pmt_ID[VALID_BUFFER_SIZE];
+	unsigned int time[VALID_BUFFER_SIZE];			//FPGA time
+	unsigned int total_events[VALID_BUFFER_SIZE];
+	unsigned int baseline[VALID_BUFFER_SIZE];		//raw integrals
+	unsigned int short_int[VALID_BUFFER_SIZE];
+	unsigned int long_int[VALID_BUFFER_SIZE];
+	unsigned int full_int[VALID_BUFFER_SIZE];
+	short x_bin[VALID_BUFFER_SIZE];					//energy bin
+	short y_bin[VALID_BUFFER_SIZE];					//PSD bin
+	unsigned char cuts[VALID_BUFFER_SIZE];			//CPS_CUT_* bits
+	unsigned int cps_count;							//1 second intervals which ended in this buffer
+	unsigned short cps_at[VALID_BUFFER_SIZE];		//the first event after the end of each interval
+	unsigned int cps_time[VALID_BUFFER_SIZE];		//FPGA time each interval started at
+} EVENT_BATCH_TYPE;
+
 //function prototypes
 GENERAL_EVENT_TYPE * GetEVTsBufferAddress( void );
+void SetEVTsBufferAddress( GENERAL_EVENT_TYPE * buffer );
 void ResetEVTsBuffer( void );
 void ResetEVTsIterator( void );
+int GetEVTsIterator( void );
 unsigned int GetFirstEventTime( void );
 int ProcessData( unsigned int * data_raw );
+void ResetProcessStats( void );
+void ResetBaselines( void );
+unsigned int GetProcessedEvents( void );
+unsigned int GetFixedPointFallbacks( void );
+void SetEnergyScale( int bl_samples );
+XTime GetPrescanTicks( void );
+XTime GetProcessPassTicks( int pass );
+unsigned int GetPrescanMarkers( void );
 
 #endif /* SRC_PROCESS_DATA_H_ */
@@ -0,0 +1,340 @@
+/*
+ * binmaptest.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host test and benchmark for the 2DH bin mapping in TwoDHisto.c, Get2DHBins() and
+ *  Tally2DHBins(), against the floor() and if-ladder Tally2DH() they replaced. The flight
+ *  file is included as it is, so its counters and histograms can be looked at.
+ *
+ *  binmaptest [-s stride] [-n events]
+ *		-s		every stride'th float, as a bit pattern, goes through Get2DHBins(), default 4099;
+ *				 1 tries all 2^32 of them
+ *		-n		how many events the benchmark times, default 10000000
+ *
+ * The reference is the old code, with the conversion to unsigned done as the VFP does it
+ *  on the board: a negative value or NaN gives 0, and a value too big for 32 bits gives
+ *  0xFFFFFFFF. The bins it gives are only compared where they are in the histogram or not
+ *  far off it; Get2DHBins() now clamps the rest to TWODH_X_BINS and TWODH_Y_BINS.
+ *
+ * The checks:
+ *  floats		each float (stride as above) as the energy and as the PSD
+ *  edges		every bin edge, and the doubles just either side of it
+ *  tally		every x and y bin from well under to well over the histogram, for each PMT
+ *				 ID bit pattern, with the counters, histograms and EVT bin codes compared
+ *				 after each event
+ * The benchmark bins and tallies the same made up events both ways; the cycles are counted
+ *  at the Cortex-A9 clock from the host time, as in replay.
+ * Exits with 1 if any check failed.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -o binmaptest binmaptest.c hal_shim.c ../lunah_FSW_01_src/src/process_data.c
+ *		../lunah_FSW_01_src/src/CPSDataProduct.c ../lunah_FSW_01_src/src/SetInstrumentParam.c
+ *		../lunah_FSW_01_src/src/BlockCompress.c ../lunah_FSW_01_src/src/EventGen.c
+ *		../lunah_FSW_01_src/src/SDMirror.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "TwoDHisto.c"
+#include "hal_shim.h"
+
+#define CYCLES_PER_TICK		(XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ / COUNTS_PER_SECOND)
+#define TALLY_MARGIN		300		//bins either side of the histogram the tally check goes to
+
+static int m_ref_x_bin_number;
+static int m_ref_y_bin_number;
+static unsigned int m_ref_oor_counts[TWODH_OOR_COUNTERS];
+static unsigned short m_ref_2DH[4][TWODH_X_BINS][TWODH_Y_BINS];
+static unsigned long m_checks;
+static unsigned long m_failures;
+
+/*
+ * The conversion to unsigned int as the VFP does it.
+ */
+static unsigned int VfpToUnsigned( double value )
+{
+	if(!(value > 0.0))
+		return 0;
+	if(value >= 4294967296.0)
+		return 0xFFFFFFFFu;
+	return (unsigned int)value;
+}
+
+/*
+ * The old bins, before they were put in range.
+ */
+static void RefBins( double energy_value, double psd_value, int * x_bin, int * y_bin )
+{
+	*x_bin = (int)VfpToUnsigned(floor(energy_value / ((double)TWODH_ENERGY_MAX / (double)TWODH_X_BINS)));
+	*y_bin = (int)VfpToUnsigned(floor(psd_value / ((double)TWODH_PSD_MAX / (double)TWODH_Y_BINS)));
+	return;
+}
+
+/*
+ * The old Tally2DH() from the bins on, with Get2DHArrayIndexX/Y().
+ */
+static void RefTally( int x_bin, int y_bin, unsigned int pmt_ID )
+{
+	m_ref_x_bin_number = (0 <= x_bin && x_bin < TWODH_X_BINS) ? (x_bin & 0x03FF) : 0x0103;
+	m_ref_y_bin_number = (0 <= y_bin && y_bin < TWODH_Y_BINS) ? (y_bin & 0x3F) : 0x1D;
+
+	if(0 <= x_bin)
+	{
+		if(x_bin < TWODH_X_BINS)
+		{
+			if(0 <= y_bin)
+			{
+				if(y_bin < TWODH_Y_BINS)
+				{
+					switch(pmt_ID)
+					{
+					case 1:
+						m_ref_2DH[0][x_bin][y_bin]++;
+						break;
+					case 2:
+						m_ref_2DH[1][x_bin][y_bin]++;
+						break;
+					case 4:
+						m_ref_2DH[2][x_bin][y_bin]++;
+						break;
+					case 8:
+						m_ref_2DH[3][x_bin][y_bin]++;
+						break;
+					default:
+						m_ref_oor_counts[TWODH_OOR_MULTI_HIT]++;
+						break;
+					}
+				}
+				else
+					m_ref_oor_counts[TWODH_OOR_ABOVE]++;
+			}
+			else
+				m_ref_oor_counts[TWODH_OOR_BELOW]++;
+		}
+		else
+		{
+			if(0 <= y_bin)
+			{
+				if(y_bin < TWODH_Y_BINS)
+					m_ref_oor_counts[TWODH_OOR_RIGHT]++;
+				else
+					m_ref_oor_counts[TWODH_OOR_ABOVE]++;
+			}
+			else
+				m_ref_oor_counts[TWODH_OOR_BELOW]++;
+		}
+	}
+	else
+	{
+		if(0 <= y_bin)
+		{
+			if(y_bin < TWODH_Y_BINS)
+				m_ref_oor_counts[TWODH_OOR_LEFT]++;
+			else
+				m_ref_oor_counts[TWODH_OOR_ABOVE]++;
+		}
+		else
+			m_ref_oor_counts[TWODH_OOR_BELOW]++;
+	}
+	return;
+}
+
+static void Check( int ok, const char * what, double value )
+{
+	m_checks++;
+	if(!ok && m_failures++ < 10)
+		printf("FAIL: %s, %.17g\n", what, value);
+	return;
+}
+
+/*
+ * The new bin is the old one where the old one is in the histogram, or off the same end.
+ */
+static int SameBin( int bin, int ref_bin, int bins )
+{
+	if(ref_bin < 0 || ref_bin >= bins)	//0xFFFFFFFF as an int is -1, off the top
+		return bin == bins;
+	return bin == ref_bin;
+}
+
+static void CheckValue( double value )
+{
+	int x_bin = 0;
+	int y_bin = 0;
+	int x_ref = 0;
+	int y_ref = 0;
+
+	Get2DHBins(value, value, &x_bin, &y_bin);
+	RefBins(value, value, &x_ref, &y_ref);
+	Check(SameBin(x_bin, x_ref, TWODH_X_BINS), "energy bin", value);
+	Check(SameBin(y_bin, y_ref, TWODH_Y_BINS), "PSD bin", value);
+	return;
+}
+
+static void CheckFloats( unsigned long long stride )
+{
+	unsigned long long bits = 0;
+	unsigned int word = 0;
+	float value = 0.0f;
+
+	for(bits = 0; bits <= 0xFFFFFFFFull; bits += stride)
+	{
+		word = (unsigned int)bits;
+		memcpy(&value, &word, sizeof(value));
+		CheckValue((double)value);
+	}
+	return;
+}
+
+static void CheckEdges( void )
+{
+	int bin = 0;
+	double edge = 0.0;
+
+	for(bin = 0; bin <= TWODH_X_BINS + 1; bin++)
+	{
+		edge = (double)bin * ((double)TWODH_ENERGY_MAX / (double)TWODH_X_BINS);
+		CheckValue(nextafter(edge, -INFINITY));
+		CheckValue(edge);
+		CheckValue(nextafter(edge, INFINITY));
+	}
+	for(bin = 0; bin <= TWODH_Y_BINS + 1; bin++)
+	{
+		edge = (double)bin * ((double)TWODH_PSD_MAX / (double)TWODH_Y_BINS);
+		CheckValue(nextafter(edge, -INFINITY));
+		CheckValue(edge);
+		CheckValue(nextafter(edge, INFINITY));
+	}
+	CheckValue(NAN);
+	CheckValue(-INFINITY);
+	CheckValue(INFINITY);
+	CheckValue(-1e300);
+	CheckValue(1e300);
+	return;
+}
+
+static void CheckTally( void )
+{
+	int x_bin = 0;
+	int y_bin = 0;
+	unsigned int pmt_ID = 0;
+	int pmt = 0;
+
+	for(pmt_ID = 0; pmt_ID < 17; pmt_ID++)
+	{
+		for(x_bin = -TALLY_MARGIN; x_bin < TWODH_X_BINS + TALLY_MARGIN; x_bin++)
+		{
+			for(y_bin = -TALLY_MARGIN; y_bin < TWODH_Y_BINS + TALLY_MARGIN; y_bin++)
+			{
+				Tally2DHBins(x_bin, y_bin, pmt_ID);
+				RefTally(x_bin, y_bin, pmt_ID);
+				Check(Get2DHArrayIndexX() == (unsigned int)m_ref_x_bin_number && Get2DHArrayIndexY() == (unsigned int)m_ref_y_bin_number, "EVT bin codes", x_bin * 1000.0 + y_bin);
+			}
+		}
+		Check(memcmp(m_oor_counts, m_ref_oor_counts, sizeof(m_oor_counts)) == 0, "out of range counters, PMT ID", pmt_ID);
+		for(pmt = 1; pmt <= 4; pmt++)
+			Check(memcmp(Get2DHArrayAddress(pmt), m_ref_2DH[pmt - 1], sizeof(m_ref_2DH[0])) == 0, "histogram, PMT ID", pmt_ID);
+	}
+	return;
+}
+
+/*
+ * Time the old and new mapping on the same events, spread over the histogram and a little
+ *  beyond it, each from one of the four PMTs or a multiple hit.
+ */
+static void Benchmark( unsigned long events )
+{
+	static const unsigned int pmt_IDs[8] = { 1, 2, 4, 8, 1, 2, 4, 3 };
+	double * energy = malloc(events * sizeof(double));
+	double * psd = malloc(events * sizeof(double));
+	unsigned char * pmt = malloc(events);
+	unsigned long iter = 0;
+	unsigned int codes = 0;
+	int x_bin = 0;
+	int y_bin = 0;
+	XTime start;
+	XTime new_ticks;
+	XTime ref_ticks;
+
+	if(energy == NULL || psd == NULL || pmt == NULL)
+	{
+		printf("no memory for %lu events\n", events);
+		m_failures++;
+		return;
+	}
+	srand(1);
+	for(iter = 0; iter < events; iter++)
+	{
+		energy[iter] = (double)rand() / RAND_MAX * 1.1 * TWODH_ENERGY_MAX - 0.05 * TWODH_ENERGY_MAX;
+		psd[iter] = (double)rand() / RAND_MAX * 1.1 * TWODH_PSD_MAX - 0.05 * TWODH_PSD_MAX;
+		pmt[iter] = pmt_IDs[rand() % 8];
+	}
+
+	XTime_GetTime(&start);
+	for(iter = 0; iter < events; iter++)
+	{
+		Get2DHBins(energy[iter], psd[iter], &x_bin, &y_bin);
+		Tally2DHBins(x_bin, y_bin, pmt[iter]);
+		codes += Get2DHArrayIndexX() + Get2DHArrayIndexY();
+	}
+	XTime_GetTime(&new_ticks);
+	new_ticks -= start;
+
+	XTime_GetTime(&start);
+	for(iter = 0; iter < events; iter++)
+	{
+		RefBins(energy[iter], psd[iter], &x_bin, &y_bin);
+		RefTally(x_bin, y_bin, pmt[iter]);
+		codes -= m_ref_x_bin_number + m_ref_y_bin_number;
+	}
+	XTime_GetTime(&ref_ticks);
+	ref_ticks -= start;
+
+	Check(codes == 0, "benchmark EVT bin codes", 0);
+	Check(memcmp(m_oor_counts, m_ref_oor_counts, sizeof(m_oor_counts)) == 0, "benchmark out of range counters", 0);
+	printf("benchmark, %lu events: Get2DHBins() + Tally2DHBins() %.1f ns/event %.1f cycles/event, floor() and if-ladder %.1f ns/event %.1f cycles/event\n",
+			events, (double)new_ticks * 1e9 / COUNTS_PER_SECOND / events, (double)new_ticks * CYCLES_PER_TICK / events,
+			(double)ref_ticks * 1e9 / COUNTS_PER_SECOND / events, (double)ref_ticks * CYCLES_PER_TICK / events);
+	free(energy);
+	free(psd);
+	free(pmt);
+	return;
+}
+
+int main( int argc, char * argv[] )
+{
+	unsigned long long stride = 4099;
+	unsigned long events = 10000000;
+	int arg = 1;
+
+	for(arg = 1; arg < argc; arg++)
+	{
+		if(strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+			stride = strtoull(argv[++arg], NULL, 0);
+		else if(strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+			events = strtoul(argv[++arg], NULL, 0);
+		else
+		{
+			printf("usage: binmaptest [-s stride] [-n events]\n");
+			return 1;
+		}
+	}
+	if(stride == 0 || events == 0)
+	{
+		printf("the stride and events must be more than 0\n");
+		return 1;
+	}
+
+	CheckFloats(stride);
+	CheckEdges();
+	CheckTally();
+	printf("%lu checks, %lu failed\n", m_checks, m_failures);
+	Benchmark(events);
+
+	printf("binmaptest: %s\n", m_failures ? "FAILED" : "passed");
+	return m_failures ? 1 : 0;
+}
@@ -0,0 +1,344 @@
+/*
+ * binstest.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host test that the fixed point 2DH bins in process_data.c are the same as the double
+ *  precision ones, event for event, and a comparison of what each costs. The flight file is
+ *  included as it is, so its static functions can be called.
+ *
+ *  binstest [-c MNSCONF.bin] [-g buffers] [-n events] [raw buffers ...]
+ *		raw buffers		captured FPGA buffers, as for replay
+ *		-c				the config file to use, otherwise the default config
+ *		-g				how many buffers to make with the event generator, default 200,
+ *						 as well as any raw buffers given
+ *		-n				how many made up events go through the sweep, default 2000000
+ *
+ * Each buffer goes through ProcessData() as in a run. Its events are then binned again from
+ *  the baselines as they were before the buffer, once by FixedPointBins() and once by
+ *  DoubleEnergyPSD() and Get2DHBins(), each over the whole batch with its own timing.
+ * The sweep then makes up events the buffers would rarely have: integrals and baselines from
+ *  anywhere in their range, with any integration times and any number of baselines averaged,
+ *  and events put exactly on an energy or a PSD bin edge, where the doubles could round
+ *  either way. These are checked the same way but not timed.
+ * The cycles are counted at the Cortex-A9 clock from the host time, as in replay, so they
+ *  compare the two paths rather than say what the board takes.
+ * Exits with 1 if any event was binned differently.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -DPROCESS_FIXED_POINT=1 -o binstest binstest.c hal_shim.c ../lunah_FSW_01_src/src/TwoDHisto.c
+ *		../lunah_FSW_01_src/src/CPSDataProduct.c ../lunah_FSW_01_src/src/SetInstrumentParam.c
+ *		../lunah_FSW_01_src/src/BlockCompress.c ../lunah_FSW_01_src/src/EventGen.c
+ *		../lunah_FSW_01_src/src/SDMirror.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "process_data.c"
+#include "EventGen.h"
+#include "hal_shim.h"
+
+#if !PROCESS_FIXED_POINT
+#error "binstest compares the fixed point bins, build it with PROCESS_FIXED_POINT"
+#endif
+
+#define RAW_BUFFER_BYTES	(DATA_BUFFER_SIZE * 4)
+#define CYCLES_PER_TICK		(XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ / COUNTS_PER_SECOND)
+
+static unsigned int m_raw_buffer[DATA_BUFFER_SIZE];
+static int m_x_fixed[VALID_BUFFER_SIZE];
+static int m_y_fixed[VALID_BUFFER_SIZE];
+static int m_good_fixed[VALID_BUFFER_SIZE];
+static int m_x_double[VALID_BUFFER_SIZE];
+static int m_y_double[VALID_BUFFER_SIZE];
+static int m_good_double[VALID_BUFFER_SIZE];
+static XTime m_fixed_ticks;				//time spent in each path over the buffers
+static XTime m_double_ticks;
+static unsigned long m_buffer_events;	//events from the buffers
+static unsigned long m_buffer_fallbacks;	//of those, the ones FixedPointBins() left to the doubles
+static unsigned long m_sweep_events;	//made up events
+static unsigned long m_failures;
+
+static unsigned char * ReadFile( const char * name, long * size )
+{
+	FILE * file = fopen(name, "rb");
+	unsigned char * data = NULL;
+
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	data = malloc(*size + 1);
+	if(data != NULL && fread(data, 1, *size, file) != (size_t)*size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+static int LoadConfig( const char * name )
+{
+	long size = 0;
+	unsigned char * data = NULL;
+
+	CreateDefaultConfig();
+	if(name == NULL)
+	{
+		LoadConfigBuffer(GetConfigBuffer());
+		return CMD_SUCCESS;
+	}
+	data = ReadFile(name, &size);
+	if(data == NULL || size != sizeof(CONFIG_STRUCT_TYPE))
+	{
+		printf("%s is not a config file, it should be %u bytes\n", name, (unsigned int)sizeof(CONFIG_STRUCT_TYPE));
+		free(data);
+		return CMD_FAILURE;
+	}
+	LoadConfigBuffer((CONFIG_STRUCT_TYPE *)data);
+	free(data);
+	return CMD_SUCCESS;
+}
+
+/*
+ * 32 random bits, rand() only promises 15.
+ */
+static unsigned int Random32( void )
+{
+	return ((unsigned int)rand() << 30) ^ ((unsigned int)rand() << 15) ^ (unsigned int)rand();
+}
+
+/*
+ * Bin one event both ways and check they agree.
+ */
+static void CheckEvent( unsigned int short_raw, unsigned int long_raw, unsigned int full_raw, const BASELINE_RING_TYPE * ring )
+{
+	int x_fixed = 0;
+	int y_fixed = 0;
+	int x_double = 0;
+	int y_double = 0;
+	int good_fixed = 0;
+	int good_double = 0;
+	float energy = 0.0f;
+	float psd_num = 0.0f;
+	float psd_den = 0.0f;
+	double energy_double = 0.0;
+	double psd_double = 0.0;
+
+	good_fixed = FixedPointBins(short_raw, long_raw, full_raw, ring, &x_fixed, &y_fixed, &energy, &psd_num, &psd_den);
+	good_double = DoubleEnergyPSD(short_raw, long_raw, full_raw, ring, &energy_double, &psd_double);
+	Get2DHBins(energy_double, psd_double, &x_double, &y_double);
+	m_sweep_events++;
+	if(x_fixed != x_double || y_fixed != y_double || good_fixed != good_double)
+	{
+		if(m_failures++ < 10)
+			printf("FAIL: short %u long %u full %u, baseline sum %llu of %u, samples %d/%d/%d/%d: fixed %d,%d,%d double %d,%d,%d\n",
+					short_raw, long_raw, full_raw, ring->sum, ring->count, m_bl_samples, m_si_samples, m_li_samples, m_fi_samples,
+					x_fixed, y_fixed, good_fixed, x_double, y_double, good_double);
+	}
+	return;
+}
+
+/*
+ * Process the buffer in m_raw_buffer, then bin its events again both ways from the
+ *  baselines it started with.
+ */
+static void TestBuffer( void )
+{
+	BASELINE_RING_TYPE before[PROCESS_BASELINE_RINGS];
+	BASELINE_RING_TYPE after[PROCESS_BASELINE_RINGS];
+	BASELINE_RING_TYPE * baseline = NULL;
+	XTime start;
+	XTime end;
+	unsigned int n = 0;
+	unsigned int fallbacks = 0;
+	float energy = 0.0f;
+	float psd_num = 0.0f;
+	float psd_den = 0.0f;
+	double energy_double = 0.0;
+	double psd_double = 0.0;
+
+	memcpy(before, m_baselines, sizeof(before));
+	ProcessData(m_raw_buffer);
+	ResetEVTsIterator();
+	memcpy(after, m_baselines, sizeof(after));
+
+	memcpy(m_baselines, before, sizeof(before));
+	fallbacks = GetFixedPointFallbacks();
+	XTime_GetTime(&start);
+	for(n = 0; n < m_batch.count; n++)
+	{
+		baseline = AddBaseline(m_batch.pmt_ID[n], m_batch.baseline[n]);
+		m_good_fixed[n] = FixedPointBins(m_batch.short_int[n], m_batch.long_int[n], m_batch.full_int[n], baseline, &m_x_fixed[n], &m_y_fixed[n], &energy, &psd_num, &psd_den);
+	}
+	XTime_GetTime(&end);
+	m_fixed_ticks += end - start;
+	m_buffer_fallbacks += GetFixedPointFallbacks() - fallbacks;
+
+	memcpy(m_baselines, before, sizeof(before));
+	XTime_GetTime(&start);
+	for(n = 0; n < m_batch.count; n++)
+	{
+		baseline = AddBaseline(m_batch.pmt_ID[n], m_batch.baseline[n]);
+		m_good_double[n] = DoubleEnergyPSD(m_batch.short_int[n], m_batch.long_int[n], m_batch.full_int[n], baseline, &energy_double, &psd_double);
+		Get2DHBins(energy_double, psd_double, &m_x_double[n], &m_y_double[n]);
+	}
+	XTime_GetTime(&end);
+	m_double_ticks += end - start;
+
+	for(n = 0; n < m_batch.count; n++)
+	{
+		if(m_x_double[n] != m_x_fixed[n] || m_y_double[n] != m_y_fixed[n] || m_good_double[n] != m_good_fixed[n]
+				|| m_batch.x_bin[n] != m_x_fixed[n] || m_batch.y_bin[n] != m_y_fixed[n])
+		{
+			if(m_failures++ < 10)
+				printf("FAIL: buffer event %lu: fixed %d,%d,%d double %d,%d,%d ProcessData() %d,%d\n", m_buffer_events + n,
+						m_x_fixed[n], m_y_fixed[n], m_good_fixed[n], m_x_double[n], m_y_double[n], m_good_double[n], m_batch.x_bin[n], m_batch.y_bin[n]);
+		}
+	}
+	m_buffer_events += m_batch.count;
+	memcpy(m_baselines, after, sizeof(after));
+	return;
+}
+
+/*
+ * Integration times from anywhere in their range, with the energy scale to match.
+ */
+static void RandomSamples( void )
+{
+	m_bl_samples = 1 + rand() % 512;
+	m_si_samples = 1 + rand() % 512;
+	m_li_samples = m_si_samples + rand() % 512;
+	m_fi_samples = m_li_samples + rand() % 512;
+	SetEnergyScale(m_bl_samples);
+	return;
+}
+
+/*
+ * Made up events, a third from anywhere, a third on an energy bin edge and a third on a
+ *  PSD bin edge. The edge events have one baseline, a multiple of the baseline samples, so
+ *  the sums come out exactly on the edge; the one either side of it is checked as well.
+ */
+static void Sweep( unsigned long events )
+{
+	BASELINE_RING_TYPE ring;
+	unsigned long iter = 0;
+	unsigned long long bl = 0;
+	unsigned long long value = 0;
+	unsigned long long t = 0;
+	unsigned int k = 0;
+	int offset = 0;
+
+	srand(1);
+	for(iter = 0; m_sweep_events < events; iter++)
+	{
+		if(iter % 1000 == 0)
+			RandomSamples();
+
+		memset(&ring, 0, sizeof(ring));
+		ring.count = 1 + rand() % PROCESS_BASELINE_DEPTH;
+		for(k = 0; k < ring.count; k++)
+			ring.sum += Random32() >> (rand() % 32);
+		CheckEvent(Random32() >> (rand() % 32), Random32() >> (rand() % 32), Random32() >> (rand() % 32), &ring);
+
+		//energy edge: full * bl - baseline * fi = j * 16 * bl * 50000, the edge of bin 13 * j
+		memset(&ring, 0, sizeof(ring));
+		ring.count = 1;
+		bl = (unsigned long long)(rand() % 1000) * m_bl_samples;
+		ring.sum = bl;
+		value = (unsigned long long)(1 + rand() % 21) * 800000 + bl / m_bl_samples * m_fi_samples;
+		for(offset = -1; offset <= 1; offset++)
+			CheckEvent(Random32() >> (rand() % 32), Random32() >> (rand() % 32), (unsigned int)(value + offset), &ring);
+
+		//PSD edge: 15 * si = k * (li - si), the edge of bin k, with si = k * t and li = (15 + k) * t
+		k = 1 + rand() % TWODH_Y_BINS;
+		t = 1 + Random32() % (0xFFFFFFFFu / 3 / (15 + k) / 1000);
+		bl = (unsigned long long)(rand() % 1000) * m_bl_samples;
+		ring.sum = bl;
+		for(offset = -1; offset <= 1; offset++)
+			CheckEvent((unsigned int)(k * t + bl / m_bl_samples * m_si_samples + offset),
+					(unsigned int)((15 + k) * t + bl / m_bl_samples * m_li_samples),
+					Random32() >> (rand() % 32), &ring);
+	}
+	return;
+}
+
+int main( int argc, char * argv[] )
+{
+	int arg = 1;
+	int file = 0;
+	long size = 0;
+	long pos = 0;
+	unsigned long gen_buffers = 200;
+	unsigned long sweep_events = 2000000;
+	unsigned long iter = 0;
+	unsigned int fallbacks = 0;
+	const char * config_name = NULL;
+	unsigned char * data = NULL;
+	EVENT_GEN_CONFIG_TYPE gen_config;
+
+	for(arg = 1; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-c") == 0)
+			config_name = argv[arg + 1];
+		else if(strcmp(argv[arg], "-g") == 0)
+			gen_buffers = strtoul(argv[arg + 1], NULL, 0);
+		else if(strcmp(argv[arg], "-n") == 0)
+			sweep_events = strtoul(argv[arg + 1], NULL, 0);
+		else
+			break;
+	}
+	if(arg < argc && argv[arg][0] == '-')
+	{
+		printf("usage: binstest [-c MNSCONF.bin] [-g buffers] [-n events] [raw buffers ...]\n");
+		return 1;
+	}
+
+	ShimSetFileDir(".");
+	if(LoadConfig(config_name) != CMD_SUCCESS)
+		return 1;
+	CPSInit();
+	ResetProcessStats();
+	ResetBaselines();
+	SetEVTsBufferAddress(NULL);
+	ResetEVTsIterator();
+
+	EventGenDefaultConfig(&gen_config);
+	EventGenInit(&gen_config, 1);
+	for(iter = 0; iter < gen_buffers; iter++)
+	{
+		EventGenFillBuffer(m_raw_buffer);
+		TestBuffer();
+	}
+	for(file = arg; file < argc; file++)
+	{
+		data = ReadFile(argv[file], &size);
+		if(data == NULL)
+		{
+			printf("can't read %s\n", argv[file]);
+			return 1;
+		}
+		for(pos = 0; pos + RAW_BUFFER_BYTES <= size; pos += RAW_BUFFER_BYTES)
+		{
+			memcpy(m_raw_buffer, &data[pos], RAW_BUFFER_BYTES);
+			TestBuffer();
+		}
+		free(data);
+	}
+	printf("buffers: %lu events, %lu fell back to the doubles\n", m_buffer_events, m_buffer_fallbacks);
+	printf(" fixed point %.1f ns/event, %.1f cycles/event\n", m_buffer_events ? (double)m_fixed_ticks * 1e9 / COUNTS_PER_SECOND / m_buffer_events : 0.0,
+			m_buffer_events ? (double)m_fixed_ticks * CYCLES_PER_TICK / m_buffer_events : 0.0);
+	printf(" double      %.1f ns/event, %.1f cycles/event\n", m_buffer_events ? (double)m_double_ticks * 1e9 / COUNTS_PER_SECOND / m_buffer_events : 0.0,
+			m_buffer_events ? (double)m_double_ticks * CYCLES_PER_TICK / m_buffer_events : 0.0);
+
+	fallbacks = GetFixedPointFallbacks();
+	Sweep(sweep_events);
+	printf("sweep: %lu events, %u fell back to the doubles\n", m_sweep_events, GetFixedPointFallbacks() - fallbacks);
+
+	printf("binstest: %lu differed, %s\n", m_failures, m_failures ? "FAILED" : "passed");
+	return m_failures ? 1 : 0;
+}
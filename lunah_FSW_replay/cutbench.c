@@ -0,0 +1,227 @@
+/*
+ * cutbench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host benchmark for the CPS neutron cuts in CPSDataProduct.c at 100,000 events a second.
+ *
+ *  cutbench [-o out dir] [-n seconds]
+ *		-o		where the config file goes, default the current directory
+ *		-n		how many seconds of events to cut, default 10
+ *
+ * The cuts are set the way the ground sets them, with SetEnergyCalParam() and
+ *  SetNeutronCutGates(): the 1 sigma and 2 sigma ellipses around the neutron peak of the
+ *  event generator's default config, in calibrated energy. The events are drawn from the same
+ *  peak and the gamma continuum, with some multiple PMT hits and some bad PSDs, and each one
+ *  goes through cpsCutEvent() and CPSUpdateTallies() as in ProcessData(). Only that loop is timed.
+ * The bits are then checked against the ellipses worked out in double from the gates, and
+ *  the neutrons inside each ellipse against the fraction a 2D gaussian puts there.
+ * The cycles are counted at the Cortex-A9 clock from the host time, as in replay, so they
+ *  compare builds rather than say what the board takes.
+ * Exits with 1 if a check fails.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -o cutbench cutbench.c hal_shim.c ../lunah_FSW_01_src/src/process_data.c
+ *		../lunah_FSW_01_src/src/TwoDHisto.c ../lunah_FSW_01_src/src/CPSDataProduct.c
+ *		../lunah_FSW_01_src/src/SetInstrumentParam.c ../lunah_FSW_01_src/src/BlockCompress.c
+ *		../lunah_FSW_01_src/src/EventGen.c ../lunah_FSW_01_src/src/SDMirror.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "process_data.h"
+#include "EventGen.h"
+#include "hal_shim.h"
+
+#define CYCLES_PER_TICK		(XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ / COUNTS_PER_SECOND)
+#define CUT_RATE			100000		//events a second
+#define CUT_ECAL_SLOPE		0.01f		//keV per energy unit, so the gates are in calibrated energy
+#define CUT_ECAL_INTERCEPT	20.0f
+#define CUT_MULTI_HIT		50			//1 in this many events hits two PMTs
+#define CUT_BAD_PSD			100			//1 in this many has no good PSD
+#define CUT_EDGE			1e-4		//events this close to an edge may go either way in float
+#define CUT_TOLERANCE		0.01		//the neutron fractions may be off by this much
+
+static float m_energy[CUT_RATE];
+static float m_psd_num[CUT_RATE];
+static float m_psd_den[CUT_RATE];
+static unsigned int m_pmt_ID[CUT_RATE];
+static unsigned char m_neutron[CUT_RATE];
+static unsigned int m_random = 1;
+
+static double Uniform( void )
+{
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return ((double)m_random + 0.5) / 4294967296.0;
+}
+
+static double Gaussian( void )
+{
+	return sqrt(-2.0 * log(Uniform())) * cos(2.0 * M_PI * Uniform());
+}
+
+/*
+ * Draw a second of events from the generator's config, outside the timing.
+ */
+static void DrawEvents( const EVENT_GEN_CONFIG_TYPE * config )
+{
+	int n = 0;
+	double psd = 0.0;
+
+	for(n = 0; n < CUT_RATE; n++)
+	{
+		m_neutron[n] = Uniform() < config->neutron_fraction;
+		if(m_neutron[n])
+		{
+			m_energy[n] = (float)(config->neutron_energy + config->neutron_width * Gaussian());
+			psd = config->neutron_psd + config->psd_width * Gaussian();
+		}
+		else
+		{
+			m_energy[n] = (float)(-log(Uniform()) * config->gamma_energy);
+			psd = config->gamma_psd + config->psd_width * Gaussian();
+		}
+		m_pmt_ID[n] = 1u << (m_random & 3);
+		if(n % CUT_MULTI_HIT == 0)
+			m_pmt_ID[n] |= 1u << ((m_random + 1) & 3);
+		m_psd_den[n] = (n % CUT_BAD_PSD == 1) ? 0.0f : m_energy[n];
+		m_psd_num[n] = (float)psd * m_psd_den[n];
+	}
+	return;
+}
+
+/*
+ * Where an event is against an ellipse worked out in double from its gates, 1 on the edge.
+ */
+static double EllipseRadius( const EVENT_GEN_CONFIG_TYPE * config, int ellipse, int n )
+{
+	double e_axis = (ellipse + 1) * (double)config->neutron_width;
+	double psd_axis = (ellipse + 1) * (double)config->psd_width;
+	double u = (m_energy[n] - (double)config->neutron_energy) / e_axis;
+	double v = ((double)m_psd_num[n] / m_psd_den[n] - config->neutron_psd) / psd_axis;
+
+	return u * u + v * v;
+}
+
+int main( int argc, char * argv[] )
+{
+	EVENT_GEN_CONFIG_TYPE config;
+	const char * out_dir = ".";
+	int seconds = 10;
+	int second = 0;
+	int module = 0;
+	int ellipse = 0;
+	int n = 0;
+	int iter = 0;
+	unsigned int cut_bits = 0;
+	unsigned int mismatches = 0;
+	unsigned long neutrons = 0;
+	unsigned long inside[CPS_CUT_ELLIPSES] = {0};
+	unsigned long tallies[4] = {0};
+	double radius = 0.0;
+	double fraction = 0.0;
+	double expected = 0.0;
+	double cycles = 0.0;
+	int failures = 0;
+	XTime start;
+	XTime end;
+	XTime cut_ticks = 0;
+
+	for(iter = 1; iter + 1 < argc; iter += 2)
+	{
+		if(strcmp(argv[iter], "-o") == 0)
+			out_dir = argv[iter + 1];
+		else if(strcmp(argv[iter], "-n") == 0)
+			seconds = atoi(argv[iter + 1]);
+		else
+			break;
+	}
+	if(iter != argc || seconds <= 0)
+	{
+		printf("usage: cutbench [-o out dir] [-n seconds]\n");
+		return 1;
+	}
+
+	ShimSetFileDir(out_dir);
+	CreateDefaultConfig();
+	LoadConfigBuffer(GetConfigBuffer());
+	EventGenDefaultConfig(&config);
+	if(SetEnergyCalParam(CUT_ECAL_SLOPE, CUT_ECAL_INTERCEPT) != CMD_SUCCESS)
+	{
+		printf("FAIL: SetEnergyCalParam()\n");
+		return 1;
+	}
+	for(module = 1; module <= CPS_CUT_MODULES; module++)
+	{
+		for(ellipse = 1; ellipse <= CPS_CUT_ELLIPSES; ellipse++)
+		{
+			if(SetNeutronCutGates(module, ellipse, ellipse * config.neutron_width / CPS_CUT_E_UNIT,
+					ellipse * config.psd_width / CPS_CUT_PSD_UNIT,
+					CUT_ECAL_SLOPE * config.neutron_energy + CUT_ECAL_INTERCEPT, config.neutron_psd) != CMD_SUCCESS)
+			{
+				printf("FAIL: SetNeutronCutGates(%d, %d)\n", module, ellipse);
+				return 1;
+			}
+		}
+	}
+
+	for(second = 0; second < seconds; second++)
+	{
+		DrawEvents(&config);
+
+		XTime_GetTime(&start);
+		for(n = 0; n < CUT_RATE; n++)
+			CPSUpdateTallies(cpsCutEvent(m_energy[n], m_psd_num[n], m_psd_den[n], m_pmt_ID[n]));
+		XTime_GetTime(&end);
+		cut_ticks += end - start;
+
+		for(n = 0; n < CUT_RATE; n++)
+		{
+			cut_bits = cpsCutEvent(m_energy[n], m_psd_num[n], m_psd_den[n], m_pmt_ID[n]);
+			for(iter = 0; iter < 4; iter++)
+				tallies[iter] += (cut_bits >> iter) & 1;
+			if((m_pmt_ID[n] & (m_pmt_ID[n] - 1)) != 0 || m_psd_den[n] == 0.0f)
+			{
+				if(cut_bits & (CPS_CUT_ELLIPSE_1 | CPS_CUT_ELLIPSE_2))
+					mismatches++;
+				continue;
+			}
+			neutrons += m_neutron[n];
+			for(ellipse = 0; ellipse < CPS_CUT_ELLIPSES; ellipse++)
+			{
+				radius = EllipseRadius(&config, ellipse, n);
+				if(((cut_bits & (CPS_CUT_ELLIPSE_1 << ellipse)) != 0) != (radius <= 1.0) && fabs(radius - 1.0) > CUT_EDGE)
+					mismatches++;
+				if(m_neutron[n] && (cut_bits & (CPS_CUT_ELLIPSE_1 << ellipse)))
+					inside[ellipse]++;
+			}
+		}
+	}
+
+	cycles = (double)cut_ticks * CYCLES_PER_TICK / ((double)seconds * CUT_RATE);
+	printf("%d x %d events: cpsCutEvent() + CPSUpdateTallies() %.1f ns/event %.1f cycles/event, %.2f%% of a CPU at %d events/s\n",
+			seconds, CUT_RATE, (double)cut_ticks * 1e9 / COUNTS_PER_SECOND / ((double)seconds * CUT_RATE), cycles,
+			cycles * CUT_RATE * 100.0 / XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ, CUT_RATE);
+	printf("tallies: over threshold %lu, no PSD %lu, ellipse 1 %lu, ellipse 2 %lu, %u differ from the gates\n",
+			tallies[0], tallies[1], tallies[2], tallies[3], mismatches);
+	if(mismatches != 0)
+		failures++;
+	for(ellipse = 0; ellipse < CPS_CUT_ELLIPSES; ellipse++)
+	{
+		//a 2D gaussian has 1 - exp(-k^2 / 2) of itself inside its k sigma ellipse
+		expected = 1.0 - exp(-(ellipse + 1) * (ellipse + 1) / 2.0);
+		fraction = neutrons ? (double)inside[ellipse] / neutrons : 0.0;
+		printf("ellipse %d: %.4f of the neutrons inside, %.4f expected\n", ellipse + 1, fraction, expected);
+		if(fabs(fraction - expected) > CUT_TOLERANCE)
+			failures++;
+	}
+
+	printf("cutbench: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * dmatest.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host test for the DMA completion tracking in AXIDmaControl.c. The flight file is built
+ *  as it is with DMA_BASEADDR pointed at a simulated S2MM register block, which behaves
+ *  the way PG021 describes the parts we use:
+ *  - writing the length starts a transfer, the test says when and how it finishes
+ *  - the IOC and error interrupt bits in the status register are write-to-clear
+ *  - the soft reset bit clears the control and status registers
+ *  - the interrupt is taken the moment the status register has an interrupt bit set
+ *     while the control register has the interrupt enabled, as it would be on the board
+ *  and the global timer only moves when the test moves it.
+ *
+ *  dmatest [-n transfers]
+ *		-n		how many transfers the random run makes, default 100000
+ *
+ * The fixed cases check the done, error and time out paths, and a transfer which had
+ *  timed out finishing at each point of the DMAReset() that abandons it. The random run
+ *  then mixes all of these and checks every result against what the simulated DMA did.
+ * Throughout, the handler's sequence number must never go backwards.
+ * Exits with 1 if any check failed.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -o dmatest dmatest.c -Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xil_types.h"
+
+#define SIM_NUM_REGS	(0x60 / 4)		//up to and including the S2MM length register
+
+static u32 m_sim_regs[SIM_NUM_REGS];	//the register block the flight code is pointed at
+
+#define DMA_BASEADDR	((UINTPTR)m_sim_regs)
+#include "AXIDmaControl.c"
+
+#define SIM_REG(offset)	m_sim_regs[(offset) / 4]
+#define SIM_ERR_INTERNAL	0x00000010	//DMAIntErr in the status register
+
+static XTime m_sim_time;				//the global timer
+static int m_sim_in_isr;				//1 while the handler is running, it is not re-entered
+static int m_sim_busy;					//1 from the length write until the transfer finishes
+static int m_sim_late_cr_write;			//finish the transfer in flight just before this control register write, 0 for never
+static int m_sim_cr_writes;				//control register writes since the count was cleared
+static unsigned int m_last_done_seq;	//what m_done_seq was last time it was looked at
+static int m_checks;
+static int m_failures;
+
+static void Check( int ok, const char * what )
+{
+	m_checks++;
+	if(!ok)
+	{
+		m_failures++;
+		printf("FAIL: %s\n", what);
+	}
+	if(m_done_seq < m_last_done_seq)
+	{
+		m_failures++;
+		printf("FAIL: sequence number went back from %u to %u (%s)\n", m_last_done_seq, m_done_seq, what);
+	}
+	m_last_done_seq = m_done_seq;
+	return;
+}
+
+/*
+ * The interrupt line, taken straight away if it is up.
+ */
+static void SimInterrupt( void )
+{
+	if(m_sim_in_isr)
+		return;
+	if((SIM_REG(DMA_S2MM_SR_OFFSET) & (DMA_SR_IRQ_IOC | DMA_SR_IRQ_ERR)) && (SIM_REG(DMA_S2MM_CR_OFFSET) & DMA_CR_IRQ_ENABLE))
+	{
+		m_sim_in_isr = 1;
+		DMACompletionISR();
+		m_sim_in_isr = 0;
+	}
+	return;
+}
+
+/*
+ * The transfer in flight finishes, with the error bits given or none.
+ */
+static void SimFinish( u32 err_bits )
+{
+	if(!m_sim_busy)
+		return;
+	m_sim_busy = 0;
+	SIM_REG(DMA_S2MM_SR_OFFSET) |= err_bits ? (err_bits | DMA_SR_IRQ_ERR | DMA_SR_HALTED) : DMA_SR_IRQ_IOC;
+	SimInterrupt();
+	return;
+}
+
+u32 Xil_In32( UINTPTR Addr )
+{
+	return m_sim_regs[(Addr - DMA_BASEADDR) / 4];
+}
+
+void Xil_Out32( UINTPTR Addr, u32 Value )
+{
+	u32 offset = Addr - DMA_BASEADDR;
+
+	switch(offset)
+	{
+	case DMA_S2MM_CR_OFFSET:
+		m_sim_cr_writes++;
+		if(m_sim_cr_writes == m_sim_late_cr_write)
+			SimFinish(0);
+		if(Value & DMA_CR_RESET)
+		{
+			SIM_REG(DMA_S2MM_CR_OFFSET) = 0;
+			SIM_REG(DMA_S2MM_SR_OFFSET) = DMA_SR_HALTED;
+			m_sim_busy = 0;
+		}
+		else
+		{
+			SIM_REG(DMA_S2MM_CR_OFFSET) = Value;
+			if(Value & DMA_CR_RUNSTOP)
+				SIM_REG(DMA_S2MM_SR_OFFSET) &= ~DMA_SR_HALTED;
+		}
+		break;
+	case DMA_S2MM_SR_OFFSET:
+		SIM_REG(DMA_S2MM_SR_OFFSET) &= ~(Value & (DMA_SR_IRQ_IOC | DMA_SR_IRQ_ERR));
+		break;
+	case DMA_S2MM_LENGTH_OFFSET:
+		SIM_REG(DMA_S2MM_LENGTH_OFFSET) = Value;
+		m_sim_busy = 1;
+		break;
+	default:
+		m_sim_regs[offset / 4] = Value;
+		break;
+	}
+	SimInterrupt();
+	return;
+}
+
+void XTime_GetTime( XTime *Xtime_Global )
+{
+	*Xtime_Global = m_sim_time;
+	return;
+}
+
+static void SimTimeOut( void )
+{
+	m_sim_time += (XTime)DMA_TIMEOUT_US * COUNTS_PER_SECOND / 1000000;
+	return;
+}
+
+/*
+ * A transfer times out, then finishes just before the nth control register write of the
+ *  DMAReset() which abandons it. The next transfer must only be done once it finishes itself.
+ */
+static void LateFinishCase( int cr_write )
+{
+	char what[80];
+
+	DMAStartTransfer(DMA_SLOT_ADDR(0), DMA_TRANSFER_LENGTH);
+	SimTimeOut();
+	Check(DMACheckTransfer() == DMA_XFER_TIMEOUT, "late finish: transfer times out");
+	m_sim_cr_writes = 0;
+	m_sim_late_cr_write = cr_write;
+	DMAReset();
+	m_sim_late_cr_write = 0;
+
+	DMAStartTransfer(DMA_SLOT_ADDR(1), DMA_TRANSFER_LENGTH);
+	snprintf(what, sizeof(what), "late finish at reset write %d: next transfer busy", cr_write);
+	Check(DMACheckTransfer() == DMA_XFER_BUSY, what);
+	SimFinish(0);
+	snprintf(what, sizeof(what), "late finish at reset write %d: next transfer done", cr_write);
+	Check(DMACheckTransfer() == DMA_XFER_DONE, what);
+	return;
+}
+
+/*
+ * Transfers which finish, fail, time out, or time out and finish late during the reset,
+ *  at random.
+ */
+static void RandomRun( int transfers )
+{
+	int iter = 0;
+	int state = 0;
+	int expect = 0;
+	int failures = m_failures;
+
+	srand(1);
+	for(iter = 0; iter < transfers && m_failures - failures < 10; iter++)
+	{
+		DMAStartTransfer(DMA_SLOT_ADDR(iter % DMA_NUM_SLOTS), DMA_TRANSFER_LENGTH);
+		Check(DMACheckTransfer() == DMA_XFER_BUSY, "random: busy after start");
+		switch(rand() % 4)
+		{
+		case 0:
+		case 1:
+			SimFinish(0);
+			expect = DMA_XFER_DONE;
+			break;
+		case 2:
+			SimFinish(SIM_ERR_INTERNAL);
+			expect = DMA_XFER_ERROR;
+			break;
+		default:
+			SimTimeOut();
+			expect = DMA_XFER_TIMEOUT;
+			break;
+		}
+		state = DMACheckTransfer();
+		Check(state == expect, "random: the result the DMA gave");
+		Check(DMACheckTransfer() == DMA_XFER_IDLE, "random: idle once checked");
+		if(state != DMA_XFER_DONE)
+		{
+			m_sim_cr_writes = 0;
+			m_sim_late_cr_write = (state == DMA_XFER_TIMEOUT) ? rand() % 4 : 0;
+			DMAReset();
+			m_sim_late_cr_write = 0;
+		}
+	}
+	return;
+}
+
+int main( int argc, char * argv[] )
+{
+	int transfers = 100000;
+	int iter = 0;
+
+	for(iter = 1; iter < argc; iter++)
+	{
+		if(strcmp(argv[iter], "-n") == 0 && iter + 1 < argc)
+			transfers = atoi(argv[++iter]);
+		else
+		{
+			printf("usage: dmatest [-n transfers]\n");
+			return 1;
+		}
+	}
+
+	SIM_REG(DMA_S2MM_SR_OFFSET) = DMA_SR_HALTED;
+	DMAInit();
+	Check(DMACheckTransfer() == DMA_XFER_IDLE, "idle after init");
+
+	DMAStartTransfer(DMA_SLOT_ADDR(0), DMA_TRANSFER_LENGTH);
+	Check(DMACheckTransfer() == DMA_XFER_BUSY, "done: busy after start");
+	SimFinish(0);
+	Check(DMACheckTransfer() == DMA_XFER_DONE, "done: done after the interrupt");
+	Check(DMACheckTransfer() == DMA_XFER_IDLE, "done: idle once checked");
+
+	DMAStartTransfer(DMA_SLOT_ADDR(1), DMA_TRANSFER_LENGTH);
+	SimFinish(SIM_ERR_INTERNAL);
+	Check(DMACheckTransfer() == DMA_XFER_ERROR, "error: error after the interrupt");
+	Check(DMAGetLastErrorBits() == SIM_ERR_INTERNAL, "error: error bits kept");
+	Check(DMAGetErrorCount() == 1, "error: counted");
+	DMAReset();
+	Check((SIM_REG(DMA_S2MM_CR_OFFSET) & (DMA_CR_IRQ_ENABLE | DMA_CR_RUNSTOP)) == (DMA_CR_IRQ_ENABLE | DMA_CR_RUNSTOP), "error: running again after reset");
+
+	DMAStartTransfer(DMA_SLOT_ADDR(2), DMA_TRANSFER_LENGTH);
+	m_sim_time += (XTime)DMA_TIMEOUT_US * COUNTS_PER_SECOND / 1000000 - 1;
+	Check(DMACheckTransfer() == DMA_XFER_BUSY, "time out: busy just inside the time out");
+	m_sim_time++;
+	Check(DMACheckTransfer() == DMA_XFER_TIMEOUT, "time out: timed out");
+	Check(DMAGetTimeoutCount() == 1, "time out: counted");
+	DMAReset();
+
+	//the interrupt mask, the reset itself, and the restart in DMAInit()
+	for(iter = 1; iter <= 3; iter++)
+		LateFinishCase(iter);
+
+	RandomRun(transfers);
+
+	printf("dmatest: %d checks, %d failed, %u interrupts taken\n", m_checks, m_failures, m_done_seq);
+	return m_failures ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * hal_shim.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host stand-ins for what process_data.c, TwoDHisto.c, CPSDataProduct.c and
+ *  SetInstrumentParam.c use from the BSP and from the rest of the flight software:
+ *  - the register accesses (shim/xil_io.h), kept in a table so a write reads back
+ *  - xil_printf(), to stdout
+ *  - XTime, the host monotonic clock counted at COUNTS_PER_SECOND like the global timer,
+ *     so tick counts and the cycles worked out from them read the same as on the board
+ *  - FatFs, each file on the "0:" volume is a file of the same name in the directory
+ *     given to ShimSetFileDir()
+ *  - the lunah_utils.c, DataAcquisition.c and I2C functions these files call
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "xil_io.h"
+#include "xtime_l.h"
+#include "LI2C_Interface.h"
+#include "ff.h"
+#include "lunah_defines.h"
+#include "lunah_utils.h"
+
+#define SHIM_NUM_REGS		64		//registers the harness can hold, far more than these files touch
+#define SHIM_PATH_SIZE		512
+
+typedef struct {
+	UINTPTR addr;
+	u32 value;
+} SHIM_REG_TYPE;
+
+static SHIM_REG_TYPE m_regs[SHIM_NUM_REGS];		//registers written so far
+static int m_num_regs;
+static char m_file_dir[SHIM_PATH_SIZE] = ".";	//where the "0:" volume is
+static int m_neutron_total;
+static char m_file_name[SHIM_PATH_SIZE];		//GetFileName() hands back a pointer to this
+
+/*
+ * Register accesses, see shim/xil_io.h.
+ */
+u32 Xil_In32( UINTPTR Addr )
+{
+	int iter = 0;
+
+	for(iter = 0; iter < m_num_regs; iter++)
+	{
+		if(m_regs[iter].addr == Addr)
+			return m_regs[iter].value;
+	}
+	return 0;
+}
+
+void Xil_Out32( UINTPTR Addr, u32 Value )
+{
+	int iter = 0;
+
+	for(iter = 0; iter < m_num_regs; iter++)
+	{
+		if(m_regs[iter].addr == Addr)
+			break;
+	}
+	if(iter == m_num_regs)
+	{
+		if(m_num_regs == SHIM_NUM_REGS)
+			return;
+		m_num_regs++;
+	}
+	m_regs[iter].addr = Addr;
+	m_regs[iter].value = Value;
+	return;
+}
+
+u16 Xil_EndianSwap16( u16 Data )
+{
+	return (u16)((Data << 8) | (Data >> 8));
+}
+
+u32 Xil_EndianSwap32( u32 Data )
+{
+	return (Data << 24) | ((Data << 8) & 0x00FF0000) | ((Data >> 8) & 0x0000FF00) | (Data >> 24);
+}
+
+void xil_printf( const char8 *ctrl1, ... )
+{
+	va_list args;
+
+	va_start(args, ctrl1);
+	vprintf(ctrl1, args);
+	va_end(args);
+	return;
+}
+
+void XTime_GetTime( XTime *Xtime_Global )
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	*Xtime_Global = (XTime)now.tv_sec * COUNTS_PER_SECOND + (XTime)now.tv_nsec * COUNTS_PER_SECOND / 1000000000u;
+	return;
+}
+
+/*
+ * The files live in a directory on the host, "0:/name" and "0:name" are both dir/name.
+ * A path too long for the host buffer is refused rather than cut short, which could open
+ *  some other file.
+ */
+void ShimSetFileDir( const char * dir )
+{
+	snprintf(m_file_dir, sizeof(m_file_dir), "%s", dir);
+	return;
+}
+
+static FRESULT ShimPath( const TCHAR * path, char * host_path, int size )
+{
+	int len = 0;
+
+	if(strncmp(path, "0:", 2) == 0)
+		path += 2;
+	while(*path == '/')
+		path++;
+	len = snprintf(host_path, size, "%s/%s", m_file_dir, path);
+	if(len < 0 || len >= size)
+		return FR_INVALID_NAME;
+	return FR_OK;
+}
+
+/*
+ * The host FILE is kept in the fs member, nothing else in these files looks at it.
+ */
+static FILE * ShimFile( FIL * fp )
+{
+	if(fp == NULL)
+		return NULL;
+	return (FILE *)fp->fs;
+}
+
+FRESULT f_open( FIL* fp, const TCHAR* path, BYTE mode )
+{
+	char host_path[SHIM_PATH_SIZE];
+	FILE * file = NULL;
+	int exists = 0;
+
+	memset(fp, 0, sizeof(FIL));
+	if(ShimPath(path, host_path, sizeof(host_path)) != FR_OK)
+		return FR_INVALID_NAME;
+	file = fopen(host_path, "rb");
+	if(file != NULL)
+	{
+		exists = 1;
+		fclose(file);
+		file = NULL;
+	}
+
+	if(mode & FA_CREATE_NEW)
+	{
+		if(exists)
+			return FR_EXIST;
+		file = fopen(host_path, "w+b");
+	}
+	else if(mode & FA_CREATE_ALWAYS)
+		file = fopen(host_path, "w+b");
+	else if(exists)
+		file = fopen(host_path, (mode & FA_WRITE) ? "r+b" : "rb");
+	else if(mode & FA_OPEN_ALWAYS)
+		file = fopen(host_path, "w+b");
+	else
+		return FR_NO_FILE;
+	if(file == NULL)
+		return FR_DENIED;
+
+	fseek(file, 0, SEEK_END);
+	fp->fsize = ftell(file);
+	rewind(file);
+	fp->fptr = 0;
+	fp->flag = mode;
+	fp->fs = (FATFS *)file;
+	return FR_OK;
+}
+
+FRESULT f_close( FIL* fp )
+{
+	FILE * file = ShimFile(fp);
+
+	if(file == NULL)
+		return FR_INVALID_OBJECT;
+	fclose(file);
+	fp->fs = NULL;
+	return FR_OK;
+}
+
+FRESULT f_read( FIL* fp, void* buff, UINT btr, UINT* br )
+{
+	FILE * file = ShimFile(fp);
+
+	*br = 0;
+	if(file == NULL)
+		return FR_INVALID_OBJECT;
+	if(!(fp->flag & FA_READ))
+		return FR_DENIED;
+	*br = fread(buff, 1, btr, file);
+	fp->fptr += *br;
+	return ferror(file) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write( FIL* fp, const void* buff, UINT btw, UINT* bw )
+{
+	FILE * file = ShimFile(fp);
+
+	*bw = 0;
+	if(file == NULL)
+		return FR_INVALID_OBJECT;
+	if(!(fp->flag & FA_WRITE))
+		return FR_DENIED;
+	*bw = fwrite(buff, 1, btw, file);
+	fp->fptr += *bw;
+	if(fp->fptr > fp->fsize)
+		fp->fsize = fp->fptr;
+	return *bw == btw ? FR_OK : FR_DISK_ERR;
+}
+
+/*
+ * Like FatFs, seeking past the end of a file open for writing makes it that long,
+ *  and past the end of a read only one stops at the end.
+ */
+FRESULT f_lseek( FIL* fp, DWORD ofs )
+{
+	FILE * file = ShimFile(fp);
+
+	if(file == NULL)
+		return FR_INVALID_OBJECT;
+	if(ofs > fp->fsize)
+	{
+		if(fp->flag & FA_WRITE)
+		{
+			fseek(file, 0, SEEK_END);
+			while(fp->fsize < ofs && fputc(0, file) != EOF)
+				fp->fsize++;
+			if(fp->fsize != ofs)
+				return FR_DISK_ERR;
+		}
+		else
+			ofs = fp->fsize;
+	}
+	if(fseek(file, ofs, SEEK_SET) != 0)
+		return FR_DISK_ERR;
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+FRESULT f_mkdir( const TCHAR* path )
+{
+	char host_path[SHIM_PATH_SIZE];
+
+	if(ShimPath(path, host_path, sizeof(host_path)) != FR_OK)
+		return FR_INVALID_NAME;
+	return mkdir(host_path, 0777) == 0 ? FR_OK : FR_EXIST;
+}
+
+FRESULT f_sync( FIL* fp )
+{
+	FILE * file = ShimFile(fp);
+
+	if(file == NULL)
+		return FR_INVALID_OBJECT;
+	return fflush(file) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+/*
+ * lunah_utils.c
+ */
+int GetNeutronTotal( void )
+{
+	return m_neutron_total;
+}
+
+int IncNeutronTotal( int increment )
+{
+	m_neutron_total += increment;
+	return m_neutron_total;
+}
+
+int GetModuTemp( void )
+{
+	return 25;	//C, a room temperature module
+}
+
+char * GetFileName( int file_type )
+{
+	snprintf(m_file_name, sizeof(m_file_name), "replay_%d.bin", file_type);
+	return m_file_name;
+}
+
+/*
+ * DataAcquisition.c
+ * There is no run folder, the files go in the top of the volume.
+ */
+char * GetFolderName( void )
+{
+	return "0:";
+}
+
+/*
+ * There is no I2C bus, SetHighVoltage() is told the write failed.
+ */
+int IicPsMasterSend( XIicPs * Iic, u16 device_id, u8 * send_buffer, u8 * rcv_buffer, int * i2c_ptr )
+{
+	return XST_FAILURE;
+}
@@ -0,0 +1,17 @@
+/*
+ * hal_shim.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * What the replay harness needs from the host stand-ins for the BSP and the rest of the
+ *  flight software, see hal_shim.c.
+ */
+
+#ifndef HAL_SHIM_H_
+#define HAL_SHIM_H_
+
+//function prototypes
+void ShimSetFileDir( const char * dir );
+
+#endif /* HAL_SHIM_H_ */
@@ -0,0 +1,201 @@
+/*
+ * queuetest.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host test for BlockQueue.c with a producer and a consumer on their own threads, the way
+ *  CPU1 and CPU0 share data_q and cps_q in the AMP build. The flight file is built as it is,
+ *  with the barriers from shim/xpseudo_asm.h.
+ *
+ *  queuetest [-n blocks]
+ *		-n		how many blocks go through each queue, default 2000000
+ *
+ * The producer fills each block with a pattern made from its number, and publishes it with
+ *  a length and aux worked out the same way, half the time in place with Reserve/Publish
+ *  and half with Send. The consumer checks every block comes out once, in order, with its
+ *  own payload, length and aux, then releases it. Both sides carry on at their own pace, so
+ *  the queue runs full and empty over and over. Each side gives up the CPU while it waits,
+ *  so the test also runs on a single core host.
+ * This is done for each depth the queue takes, each time starting the head and tail just
+ *  short of where the indices wrap, so the blocks go around the ring many times and across
+ *  the 32-bit wrap of the indices as well.
+ * Exits with 1 if any check failed.
+ *
+ * The pool address is an unsigned int on the board, so the pools are mapped in the low 4 GiB.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -pthread -o queuetest queuetest.c ../lunah_FSW_01_src/src/BlockQueue.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "BlockQueue.h"
+
+#define TEST_BLOCK_SIZE		256
+#define TEST_START_INDEX	0xFFFFFF00u	//head and tail start here, so the indices wrap during the run
+
+typedef struct {
+	BLOCK_QUEUE_TYPE * queue;
+	unsigned int blocks;		//how many go through
+	unsigned int errors;		//found by the consumer
+	unsigned int received;
+} TEST_RUN_TYPE;
+
+static unsigned int TestLength( unsigned int n )
+{
+	return 1 + (n * 2654435761u) % TEST_BLOCK_SIZE;
+}
+
+static unsigned char TestByte( unsigned int n, unsigned int index )
+{
+	return (unsigned char)(n * 31 + index * 7 + (n >> 8));
+}
+
+static void * Producer( void * arg )
+{
+	TEST_RUN_TYPE * run = (TEST_RUN_TYPE *)arg;
+	unsigned char data[TEST_BLOCK_SIZE];
+	unsigned char * payload = NULL;
+	unsigned int n = 0;
+	unsigned int iter = 0;
+	unsigned int length = 0;
+
+	for(n = 0; n < run->blocks; n++)
+	{
+		length = TestLength(n);
+		//wait for room here rather than in BlockQueueSend(), which spins without giving up the CPU
+		while(BlockQueueReserve(run->queue) == NULL)
+			sched_yield();
+		if(n & 1)
+		{
+			for(iter = 0; iter < length; iter++)
+				data[iter] = TestByte(n, iter);
+			BlockQueueSend(run->queue, BLOCK_EVT, data, length, n);
+		}
+		else
+		{
+			payload = (unsigned char *)BlockQueueReserve(run->queue);
+			for(iter = 0; iter < length; iter++)
+				payload[iter] = TestByte(n, iter);
+			BlockQueuePublish(run->queue, BLOCK_EVT, length, n);
+		}
+	}
+	BlockQueueSend(run->queue, BLOCK_END, NULL, 0, 0);
+	return NULL;
+}
+
+static void * Consumer( void * arg )
+{
+	TEST_RUN_TYPE * run = (TEST_RUN_TYPE *)arg;
+	BLOCK_DESC_TYPE * desc = NULL;
+	void * payload = NULL;
+	unsigned char * bytes = NULL;
+	unsigned int n = 0;
+	unsigned int iter = 0;
+
+	while(1)
+	{
+		desc = BlockQueuePeek(run->queue, &payload);
+		if(desc == NULL)
+		{
+			sched_yield();
+			continue;
+		}
+		if(desc->type == BLOCK_END)
+		{
+			BlockQueueRelease(run->queue);
+			break;
+		}
+		bytes = (unsigned char *)payload;
+		if(desc->seq != TEST_START_INDEX + n || desc->aux != n || desc->length != TestLength(n))
+		{
+			if(run->errors++ < 10)
+				printf("FAIL: block %u came out as seq %u aux %u length %u\n", n, desc->seq - TEST_START_INDEX, desc->aux, desc->length);
+		}
+		else
+		{
+			for(iter = 0; iter < desc->length; iter++)
+			{
+				if(bytes[iter] != TestByte(n, iter))
+				{
+					if(run->errors++ < 10)
+						printf("FAIL: block %u byte %u is %u not %u\n", n, iter, bytes[iter], TestByte(n, iter));
+					break;
+				}
+			}
+		}
+		BlockQueueRelease(run->queue);
+		n++;
+	}
+	run->received = n;
+	return NULL;
+}
+
+int main( int argc, char * argv[] )
+{
+	BLOCK_QUEUE_TYPE queue;
+	TEST_RUN_TYPE run;
+	pthread_t producer;
+	pthread_t consumer;
+	unsigned char * pool = NULL;
+	unsigned int blocks = 2000000;
+	unsigned int depth = 0;
+	int failures = 0;
+	int iter = 0;
+
+	for(iter = 1; iter < argc; iter++)
+	{
+		if(strcmp(argv[iter], "-n") == 0 && iter + 1 < argc)
+			blocks = (unsigned int)atoi(argv[++iter]);
+		else
+		{
+			printf("usage: queuetest [-n blocks]\n");
+			return 1;
+		}
+	}
+
+	pool = mmap(NULL, BLOCK_QUEUE_MAX_DEPTH * TEST_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if(pool == MAP_FAILED)
+	{
+		printf("no pool in the low 4 GiB\n");
+		return 1;
+	}
+
+	for(depth = 1; depth <= BLOCK_QUEUE_MAX_DEPTH; depth *= 2)
+	{
+		BlockQueueInit(&queue, (unsigned int)(unsigned long)pool, TEST_BLOCK_SIZE, depth);
+		queue.head = TEST_START_INDEX;
+		queue.tail = TEST_START_INDEX;
+		memset(&run, 0, sizeof(run));
+		run.queue = &queue;
+		run.blocks = blocks;
+
+		pthread_create(&consumer, NULL, Consumer, &run);
+		pthread_create(&producer, NULL, Producer, &run);
+		pthread_join(producer, NULL);
+		pthread_join(consumer, NULL);
+
+		if(run.received != blocks)
+		{
+			printf("FAIL: depth %u, %u of %u blocks came out\n", depth, run.received, blocks);
+			run.errors++;
+		}
+		if(BlockQueueCount(&queue) != 0 || BlockQueueHighWater(&queue) > depth)
+		{
+			printf("FAIL: depth %u, %u left over, high water %u\n", depth, BlockQueueCount(&queue), BlockQueueHighWater(&queue));
+			run.errors++;
+		}
+		printf("depth %2u: %u blocks, %u errors, high water %u\n", depth, run.received, run.errors, BlockQueueHighWater(&queue));
+		failures += run.errors;
+	}
+
+	printf("queuetest: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
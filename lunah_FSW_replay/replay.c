@@ -0,0 +1,390 @@
+/*
+ * replay.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host replay harness for the event processing. Runs captured FPGA buffers through the
+ *  flight ProcessData() as fast as it will go, then reports the throughput and what came out,
+ *  so a change to the processing can be timed and checked before it goes near the board.
+ *
+ *  replay [-c MNSCONF.bin] [-o out dir] <raw buffers> [raw buffers ...]
+ *  replay [-c MNSCONF.bin] [-o out dir] -g <buffers> [-s name=value ...]
+ *		raw buffers		the 16 KiB buffers the DMA takes from the FPGA (DATA_BUFFER_SIZE words,
+ *						 little endian) one after another, as many as there are
+ *		-c				the config file to use, otherwise the default config
+ *		-o				where the output files go, default the current directory
+ *		-g				make this many buffers with the event generator instead, see EventGen.h;
+ *						 -s changes a setting from EventGenDefaultConfig(), the names are those in
+ *						 EVENT_GEN_CONFIG_TYPE, pmt_mix is given as a,b,c,d, and seed picks the
+ *						 random seed. The buffers are made outside the timing.
+ *
+ * The flight process_data.c, TwoDHisto.c, CPSDataProduct.c and SetInstrumentParam.c are
+ *  built as they are against the BSP headers, with hal_shim.c in place of the hardware
+ *  and the rest of the flight software. The EVT records are handed on the same way as in
+ *  ParseStage(): once another buffer might not fit they are written out and the buffer
+ *  starts again. The CPS events are written every CPS_FLUSH_PERIOD_US of data, one event
+ *  being a second of it. Only ProcessData() is timed.
+ *
+ * Output, in the out dir:
+ *  replay_evt.bin		the EVT records, no file headers
+ *  replay_cps.bin		the CPS events, no file headers
+ *  replay_2dh_N.bin	the 2DH for PMT N
+ * The report ends with a hash of each output, two builds which process the same way give
+ *  the same hashes.
+ *
+ * The cycles are counted at the Cortex-A9 clock from the host time, so they say how a change
+ *  moved the processing time, not what the board takes.
+ *
+ * Build with the Makefile here (make, or make check to run the tests as well), or by hand:
+ *  gcc -O2 -o replay replay.c hal_shim.c ../lunah_FSW_01_src/src/process_data.c
+ *		../lunah_FSW_01_src/src/TwoDHisto.c ../lunah_FSW_01_src/src/CPSDataProduct.c
+ *		../lunah_FSW_01_src/src/SetInstrumentParam.c ../lunah_FSW_01_src/src/BlockCompress.c
+ *		../lunah_FSW_01_src/src/EventGen.c ../lunah_FSW_01_src/src/SDMirror.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include -lm
+ *  with -D for any of the flight flags, eg. -DPROCESS_FIXED_POINT=1 to time the fixed point path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "process_data.h"
+#include "EventGen.h"
+#include "hal_shim.h"
+
+#define RAW_BUFFER_BYTES	(DATA_BUFFER_SIZE * 4)
+#define CYCLES_PER_TICK		(XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ / COUNTS_PER_SECOND)
+
+static unsigned int m_raw_buffer[DATA_BUFFER_SIZE];		//the DMA slot, each buffer is copied in before it is processed
+static FIL m_evt_file;
+static FIL m_cps_file;
+static unsigned long m_evt_records;						//EVT records written
+static unsigned int m_cps_flushed;						//CPS events buffered at the last cluster check
+static unsigned long m_buffers;							//buffers processed
+static XTime m_process_ticks;							//time spent in ProcessData()
+
+/*
+ * Read a whole file into memory.
+ */
+static unsigned char * ReadFile( const char * name, long * size )
+{
+	FILE * file = fopen(name, "rb");
+	unsigned char * data = NULL;
+
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	data = malloc(*size + 1);
+	if(data != NULL && fread(data, 1, *size, file) != (size_t)*size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+/*
+ * FNV-1a, to tell whether two runs gave the same output.
+ */
+static unsigned int Hash( unsigned int hash, const unsigned char * data, unsigned long size )
+{
+	unsigned long iter = 0;
+
+	for(iter = 0; iter < size; iter++)
+		hash = (hash ^ data[iter]) * 16777619u;
+	return hash;
+}
+
+static unsigned int HashFile( const char * dir, const char * name, long * size )
+{
+	char path[512];
+	unsigned char * data = NULL;
+	unsigned int hash = 2166136261u;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	*size = 0;
+	data = ReadFile(path, size);
+	if(data == NULL)
+		return 0;
+	hash = Hash(hash, data, *size);
+	free(data);
+	return hash;
+}
+
+/*
+ * Write the EVT records so far and start the buffer again, as PublishEVTBlock() does.
+ */
+static int FlushEVTs( void )
+{
+	unsigned int num_bytes = GetEVTsIterator() * sizeof(GENERAL_EVENT_TYPE);
+	unsigned int num_bytes_written = 0;
+
+	if(num_bytes != 0)
+	{
+		if(f_write(&m_evt_file, GetEVTsBufferAddress(), num_bytes, &num_bytes_written) != FR_OK || num_bytes_written != num_bytes)
+		{
+			printf("error writing the EVT file\n");
+			return CMD_FAILURE;
+		}
+		m_evt_records += GetEVTsIterator();
+	}
+	ResetEVTsIterator();
+	return CMD_SUCCESS;
+}
+
+static int Save2DH( int pmt_ID )
+{
+	char name[32];
+	FIL file;
+	unsigned int num_bytes = sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS;
+	unsigned int num_bytes_written = 0;
+	FRESULT f_res = FR_OK;
+
+	snprintf(name, sizeof(name), "0:/replay_2dh_%d.bin", pmt_ID);
+	f_res = f_open(&file, name, FA_WRITE|FA_CREATE_ALWAYS);
+	if(f_res == FR_OK)
+		f_res = f_write(&file, Get2DHArrayAddress(pmt_ID), num_bytes, &num_bytes_written);
+	f_close(&file);
+	return (f_res == FR_OK && num_bytes_written == num_bytes) ? CMD_SUCCESS : CMD_FAILURE;
+}
+
+static int LoadConfig( const char * name )
+{
+	long size = 0;
+	unsigned char * data = NULL;
+
+	CreateDefaultConfig();
+	if(name == NULL)
+	{
+		LoadConfigBuffer(GetConfigBuffer());
+		return CMD_SUCCESS;
+	}
+	data = ReadFile(name, &size);
+	if(data == NULL || size != sizeof(CONFIG_STRUCT_TYPE))
+	{
+		printf("%s is not a config file, it should be %u bytes\n", name, (unsigned int)sizeof(CONFIG_STRUCT_TYPE));
+		free(data);
+		return CMD_FAILURE;
+	}
+	LoadConfigBuffer((CONFIG_STRUCT_TYPE *)data);
+	free(data);
+	return CMD_SUCCESS;
+}
+
+/*
+ * Change one generator setting, given as name=value.
+ */
+static int SetGenParam( EVENT_GEN_CONFIG_TYPE * config, unsigned int * seed, const char * param )
+{
+	const char * value = strchr(param, '=');
+	int name_length = value ? (int)(value - param) : 0;
+
+	if(value == NULL)
+		return CMD_FAILURE;
+	value++;
+#define GEN_PARAM(name)	(name_length == (int)strlen(name) && strncmp(param, name, name_length) == 0)
+	if(GEN_PARAM("rate"))
+		config->rate = strtoul(value, NULL, 0);
+	else if(GEN_PARAM("pmt_mix"))
+	{
+		if(sscanf(value, "%u,%u,%u,%u", &config->pmt_mix[0], &config->pmt_mix[1], &config->pmt_mix[2], &config->pmt_mix[3]) != 4)
+			return CMD_FAILURE;
+	}
+	else if(GEN_PARAM("baseline"))
+		config->baseline = strtoul(value, NULL, 0);
+	else if(GEN_PARAM("gamma_energy"))
+		config->gamma_energy = strtoul(value, NULL, 0);
+	else if(GEN_PARAM("neutron_energy"))
+		config->neutron_energy = strtoul(value, NULL, 0);
+	else if(GEN_PARAM("neutron_width"))
+		config->neutron_width = strtoul(value, NULL, 0);
+	else if(GEN_PARAM("neutron_fraction"))
+		config->neutron_fraction = strtof(value, NULL);
+	else if(GEN_PARAM("gamma_psd"))
+		config->gamma_psd = strtof(value, NULL);
+	else if(GEN_PARAM("neutron_psd"))
+		config->neutron_psd = strtof(value, NULL);
+	else if(GEN_PARAM("psd_width"))
+		config->psd_width = strtof(value, NULL);
+	else if(GEN_PARAM("pileup"))
+		config->pileup = strtof(value, NULL);
+	else if(GEN_PARAM("corrupt"))
+		config->corrupt = strtof(value, NULL);
+	else if(GEN_PARAM("junk"))
+		config->junk = strtof(value, NULL);
+	else if(GEN_PARAM("seed"))
+		*seed = strtoul(value, NULL, 0);
+	else
+		return CMD_FAILURE;
+#undef GEN_PARAM
+	return CMD_SUCCESS;
+}
+
+/*
+ * Process the buffer in m_raw_buffer and pass the events on, see ParseStage().
+ */
+static int ReplayBuffer( void )
+{
+	XTime process_start;
+	XTime process_end;
+
+	XTime_GetTime(&process_start);
+	ProcessData(m_raw_buffer);
+	XTime_GetTime(&process_end);
+	m_process_ticks += process_end - process_start;
+	m_buffers++;
+
+	if(GetEVTsIterator() > EVENT_BUFFER_SIZE - VALID_BUFFER_SIZE && FlushEVTs() != CMD_SUCCESS)
+		return CMD_FAILURE;
+	if(cpsGetBufferedEvents() - m_cps_flushed >= CPS_FLUSH_PERIOD_US / 1000000)
+	{
+		cpsFlushBuffer(&m_cps_file);
+		m_cps_flushed = cpsGetBufferedEvents();
+	}
+	return CMD_SUCCESS;
+}
+
+static void Report( const char * out_dir )
+{
+	int pmt_ID = 0;
+	int bin = 0;
+	unsigned long events = GetProcessedEvents();
+	unsigned long counts = 0;
+	unsigned short * histo = NULL;
+	double seconds = (double)m_process_ticks / COUNTS_PER_SECOND;
+	double cycles = (double)m_process_ticks * CYCLES_PER_TICK;
+	long size = 0;
+	unsigned int hash = 0;
+	static const char * pass_names[PROCESS_PASSES] = { "extract", "compute", "encode" };
+
+	printf("%lu buffers, %lu events, %u markers\n", m_buffers, events, GetPrescanMarkers());
+	printf("ProcessData %.3f s, %.0f events/s, %.1f ns/event, %.1f cycles/event, %.0f cycles/buffer\n", seconds,
+			seconds > 0 ? events / seconds : 0.0, events ? seconds * 1e9 / events : 0.0,
+			events ? cycles / events : 0.0, m_buffers ? cycles / m_buffers : 0.0);
+	printf(" prescan %.1f cycles/event", events ? (double)GetPrescanTicks() * CYCLES_PER_TICK / events : 0.0);
+	for(pmt_ID = 0; pmt_ID < PROCESS_PASSES; pmt_ID++)
+		printf(", %s %.1f", pass_names[pmt_ID], events ? (double)GetProcessPassTicks(pmt_ID) * CYCLES_PER_TICK / events : 0.0);
+	printf("\n");
+	printf("neutron total %d, fixed point fallbacks %u\n", GetNeutronTotal(), GetFixedPointFallbacks());
+
+	hash = HashFile(out_dir, "replay_evt.bin", &size);
+	printf("EVT %lu records, %ld bytes, hash %08x\n", m_evt_records, size, hash);
+	hash = HashFile(out_dir, "replay_cps.bin", &size);
+	printf("CPS %u events, %u dropped, %ld bytes, hash %08x\n", cpsGetBufferedEvents(), cpsGetDroppedEvents(), size, hash);
+	for(pmt_ID = 1; pmt_ID <= 4; pmt_ID++)
+	{
+		histo = Get2DHArrayAddress(pmt_ID);
+		counts = 0;
+		for(bin = 0; bin < TWODH_X_BINS * TWODH_Y_BINS; bin++)
+			counts += histo[bin];
+		printf("2DH %d %lu counts, hash %08x\n", pmt_ID, counts, Hash(2166136261u, (unsigned char *)histo, sizeof(unsigned short) * TWODH_X_BINS * TWODH_Y_BINS));
+	}
+	return;
+}
+
+int main( int argc, char **argv )
+{
+	int arg = 1;
+	int file = 0;
+	long size = 0;
+	long pos = 0;
+	unsigned long gen_buffers = 0;
+	unsigned long iter = 0;
+	unsigned int seed = 1;
+	const char * config_name = NULL;
+	const char * out_dir = ".";
+	unsigned char * data = NULL;
+	EVENT_GEN_CONFIG_TYPE gen_config;
+
+	EventGenDefaultConfig(&gen_config);
+	for(arg = 1; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-c") == 0)
+			config_name = argv[arg + 1];
+		else if(strcmp(argv[arg], "-o") == 0)
+			out_dir = argv[arg + 1];
+		else if(strcmp(argv[arg], "-g") == 0)
+			gen_buffers = strtoul(argv[arg + 1], NULL, 0);
+		else if(strcmp(argv[arg], "-s") == 0)
+		{
+			if(SetGenParam(&gen_config, &seed, argv[arg + 1]) != CMD_SUCCESS)
+			{
+				printf("unknown generator setting %s\n", argv[arg + 1]);
+				return 1;
+			}
+		}
+		else
+			break;
+	}
+	if((gen_buffers == 0 && arg >= argc) || (gen_buffers != 0 && arg < argc))
+	{
+		printf("usage: replay [-c MNSCONF.bin] [-o out dir] <raw buffers> [raw buffers ...]\n"
+				"       replay [-c MNSCONF.bin] [-o out dir] -g <buffers> [-s name=value ...]\n");
+		return 1;
+	}
+
+	ShimSetFileDir(out_dir);
+	if(LoadConfig(config_name) != CMD_SUCCESS)
+		return 1;
+	if(f_open(&m_evt_file, "0:/replay_evt.bin", FA_WRITE|FA_CREATE_ALWAYS) != FR_OK
+			|| f_open(&m_cps_file, "0:/replay_cps.bin", FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+	{
+		printf("can't write the output files in %s\n", out_dir);
+		return 1;
+	}
+
+	//as at the start of a run, see StartPipeline()
+	CPSInit();
+	ResetProcessStats();
+	ResetBaselines();
+	SetEVTsBufferAddress(NULL);
+	ResetEVTsIterator();
+
+	if(gen_buffers != 0)
+	{
+		EventGenInit(&gen_config, seed);
+		for(iter = 0; iter < gen_buffers; iter++)
+		{
+			EventGenFillBuffer(m_raw_buffer);
+			if(ReplayBuffer() != CMD_SUCCESS)
+				return 1;
+		}
+	}
+	for(file = arg; file < argc; file++)
+	{
+		data = ReadFile(argv[file], &size);
+		if(data == NULL)
+		{
+			printf("can't read %s\n", argv[file]);
+			return 1;
+		}
+		if(size % RAW_BUFFER_BYTES != 0)
+			printf("%s: the last %ld bytes are not a whole buffer and are left out\n", argv[file], size % RAW_BUFFER_BYTES);
+		for(pos = 0; pos + RAW_BUFFER_BYTES <= size; pos += RAW_BUFFER_BYTES)
+		{
+			memcpy(m_raw_buffer, &data[pos], RAW_BUFFER_BYTES);
+			if(ReplayBuffer() != CMD_SUCCESS)
+				return 1;
+		}
+		free(data);
+	}
+
+	//the end of the run, see DataAcquisition()
+	FlushEVTs();
+	cpsFlushBuffer(&m_cps_file);
+	f_close(&m_evt_file);
+	f_close(&m_cps_file);
+	for(file = 1; file <= 4; file++)
+	{
+		if(Save2DH(file) != CMD_SUCCESS)
+			printf("can't write the 2DH %d file\n", file);
+	}
+
+	if(gen_buffers != 0)
+		printf("generated %u events, %u damaged, %.3f s of FPGA time\n", EventGenGetEvents(), EventGenGetDamaged(), EventGenGetTime() * 0.000262144);
+	Report(out_dir);
+	return 0;
+}
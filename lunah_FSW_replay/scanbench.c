@@ -0,0 +1,145 @@
+/*
+ * scanbench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host benchmark for PrescanBuffer() in process_data.c, on dense and sparse buffers. The
+ *  flight file is included as it is, so its static functions can be called.
+ *
+ *  scanbench [-n passes]
+ *		-n		how many times each buffer is scanned, default 20000
+ *
+ * The buffers, DATA_BUFFER_SIZE words each:
+ *  dense	back to back records from the event generator, a marker every EVT_EVENT_SIZE words
+ *  junk	the same with up to EVENT_GEN_MAX_JUNK junk words after every record
+ *  sparse	a dozen records, then padding to the end, as a buffer taken at a low rate
+ *  empty	all padding
+ * Each is scanned by PrescanBuffer() and by a word at a time loop which branches on each
+ *  marker, as ProcessData() used to find them, and the two indexes are checked against
+ *  each other.
+ * The cycles are counted at the Cortex-A9 clock from the host time, as in replay, so they
+ *  compare the two scans rather than say what the board takes.
+ * Exits with 1 if the indexes differ.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -o scanbench scanbench.c hal_shim.c ../lunah_FSW_01_src/src/TwoDHisto.c
+ *		../lunah_FSW_01_src/src/CPSDataProduct.c ../lunah_FSW_01_src/src/SetInstrumentParam.c
+ *		../lunah_FSW_01_src/src/BlockCompress.c ../lunah_FSW_01_src/src/EventGen.c
+ *		../lunah_FSW_01_src/src/SDMirror.c
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "process_data.c"
+#include "EventGen.h"
+#include "hal_shim.h"
+
+#define CYCLES_PER_TICK		(XPAR_CPU_CORTEXA9_CORE_CLOCK_FREQ_HZ / COUNTS_PER_SECOND)
+#define SCAN_BUFFERS		4
+#define SPARSE_RECORDS		12		//records kept at the start of the sparse buffer
+
+static unsigned int m_buffers[SCAN_BUFFERS][DATA_BUFFER_SIZE];
+static const char * m_buffer_names[SCAN_BUFFERS] = { "dense", "junk", "sparse", "empty" };
+static unsigned short m_index_check[EVENT_INDEX_SIZE];
+
+/*
+ * Find the markers a word at a time with a branch on each, the reference for PrescanBuffer().
+ */
+static int BranchScan( const unsigned int * data_raw, unsigned short * index )
+{
+	int iter = 0;
+	int count = 0;
+	int limit = DATA_BUFFER_SIZE - EVT_EVENT_SIZE + 1;
+
+	for(iter = 0; iter < limit; iter++)
+	{
+		if(data_raw[iter] == DATA_EVENT_MARKER || data_raw[iter] == FALSE_EVENT_MARKER)
+			index[count++] = iter;
+	}
+	return count;
+}
+
+static void MakeBuffers( void )
+{
+	EVENT_GEN_CONFIG_TYPE config;
+	int iter = 0;
+
+	EventGenDefaultConfig(&config);
+	config.junk = 0.0f;
+	config.corrupt = 0.0f;
+	EventGenInit(&config, 1);
+	EventGenFillBuffer(m_buffers[0]);	//the first has the false event
+	EventGenFillBuffer(m_buffers[0]);
+
+	config.junk = 1.0f;
+	EventGenInit(&config, 2);
+	EventGenFillBuffer(m_buffers[1]);
+	EventGenFillBuffer(m_buffers[1]);
+
+	for(iter = 0; iter < DATA_BUFFER_SIZE; iter++)
+	{
+		m_buffers[2][iter] = (iter < SPARSE_RECORDS * EVT_EVENT_SIZE) ? m_buffers[0][iter] : EVENT_GEN_PAD_WORD;
+		m_buffers[3][iter] = EVENT_GEN_PAD_WORD;
+	}
+	return;
+}
+
+int main( int argc, char * argv[] )
+{
+	int passes = 20000;
+	int buffer = 0;
+	int pass = 0;
+	int count = 0;
+	int count_check = 0;
+	int failures = 0;
+	unsigned long total = 0;
+	XTime start;
+	XTime prescan_ticks;
+	XTime branch_ticks;
+
+	if(argc == 3 && strcmp(argv[1], "-n") == 0)
+		passes = atoi(argv[2]);
+	else if(argc != 1)
+	{
+		printf("usage: scanbench [-n passes]\n");
+		return 1;
+	}
+
+	ShimSetFileDir(".");
+	CreateDefaultConfig();
+	LoadConfigBuffer(GetConfigBuffer());
+	MakeBuffers();
+
+	for(buffer = 0; buffer < SCAN_BUFFERS; buffer++)
+	{
+		count = PrescanBuffer(m_buffers[buffer], m_event_index);
+		count_check = BranchScan(m_buffers[buffer], m_index_check);
+		if(count != count_check || memcmp(m_event_index, m_index_check, count * sizeof(unsigned short)) != 0)
+		{
+			printf("FAIL: %s buffer, %d markers from PrescanBuffer(), %d from the reference\n", m_buffer_names[buffer], count, count_check);
+			failures++;
+		}
+
+		XTime_GetTime(&start);
+		for(pass = 0; pass < passes; pass++)
+			total += PrescanBuffer(m_buffers[buffer], m_event_index);
+		XTime_GetTime(&prescan_ticks);
+		prescan_ticks -= start;
+
+		XTime_GetTime(&start);
+		for(pass = 0; pass < passes; pass++)
+			total += BranchScan(m_buffers[buffer], m_index_check);
+		XTime_GetTime(&branch_ticks);
+		branch_ticks -= start;
+
+		printf("%-6s %4d markers: PrescanBuffer() %7.0f cycles/buffer %6.2f us, branch on marker %7.0f cycles/buffer %6.2f us\n",
+				m_buffer_names[buffer], count,
+				(double)prescan_ticks * CYCLES_PER_TICK / passes, (double)prescan_ticks * 1e6 / COUNTS_PER_SECOND / passes,
+				(double)branch_ticks * CYCLES_PER_TICK / passes, (double)branch_ticks * 1e6 / COUNTS_PER_SECOND / passes);
+	}
+
+	printf("scanbench: %lu markers in all, %s\n", total, failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,442 @@
+/*
+ * sdasyncbench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host benchmark and test for AsyncSDWrite.c, the EVT cluster writes which are left to the
+ *  card (EVT_ASYNC_WRITE). The flight file is built as it is, on a simulated SD host
+ *  controller in place of the registers.
+ *
+ *  sdasyncbench [-n clusters] [-b bus MB/s] [-p program us]
+ *		-n		how many clusters are written for each line of the report, default 200
+ *		-b		how fast the data goes over the SD bus, default 12.5, a 4 bit bus at 25 MHz
+ *		-p		how long the card stays busy programming after the last block, default 250
+ *
+ * The simulated controller takes the registers AsyncSDStart() writes, checks the command is
+ *  the ADMA2 CMD25 XSdPs_WritePolled() sends, and answers the command at once. The data is
+ *  copied out of the buffers, through the descriptor table, only when the transfer complete
+ *  bit goes up: that is SIM_CMD_US, then the bytes at the bus rate, then the program time
+ *  after the command, in host time. A buffer changed before then shows up in the card image.
+ *
+ * Each line writes the clusters with a fixed amount of processing before each one, the time
+ *  the pipeline takes to fill the next cluster:
+ *  polled	the write is waited for as soon as it is started, as f_write() does
+ *  async	the write is left to the card and only waited for before the next one starts,
+ *			with the two blocks taking turns, as WriteEVTCluster() does
+ * The report gives the time from starting each write to its transfer complete, what that is
+ *  in KiB/s, how long the writer was held up for each cluster, and the clusters per second
+ *  through the whole loop. Times are host times against the simulated card, so they say how
+ *  much of the card time is taken off the writer, not what the board takes.
+ *
+ * Then the failures are checked: a card which may be byte addressed, the block size not set,
+ *  the command lines busy, and a data error, which must be reported once, to the next poll.
+ * Exits with 1 if a check fails or a cluster did not reach the image as it was written.
+ *
+ * Build with the Makefile, or:
+ *  gcc -O2 -o sdasyncbench sdasyncbench.c ../lunah_FSW_01_src/src/AsyncSDWrite.c -include shim/xil_io.h
+ *		-Ishim -I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include
+ *  The shim xil_io.h is forced in first, as xsdps_hw.h would otherwise pick up the BSP's own
+ *  from beside it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "AsyncSDWrite.h"
+
+#define SIM_BASE			XPAR_XSDPS_0_BASEADDR
+#define SIM_CMD_US			10.0		//the command and its response
+#define SIM_SECTORS_HC		0x1000000	//an 8 GiB card
+#define SIM_SECTORS_SC		0x400000	//a 2 GiB card, which may be byte addressed
+#define BENCH_CLUSTER		16384		//EVT_DATA_BUFF_SIZE
+#define BENCH_SECTORS		(BENCH_CLUSTER / XSDPS_BLK_SIZE_512_MASK)
+#define BENCH_FIRST_SECTOR	0x8000		//where the clusters go on the card
+#define BENCH_MAX_CLUSTERS	1000
+#define BENCH_PROCESS_RUNS	4
+
+static const double m_process_us[BENCH_PROCESS_RUNS] = { 0.0, 500.0, 1000.0, 2000.0 };
+
+//the simulated controller
+static u16 m_blk_size;
+static u16 m_blk_cnt;
+static u32 m_argument;
+static u32 m_present_state;
+static u16 m_norm_status;
+static u16 m_err_status;
+static u32 m_adma_address;
+static int m_busy;								//a transfer is going
+static double m_done_us;						//when it ends
+static double m_started_us;
+static XSdPs_Adma2Descriptor m_taken[ASYNC_SD_DESCRIPTORS + 1];	//the descriptors of the transfer, as the controller read them
+static int m_fail_next;							//end the next transfer in a data CRC error
+static double m_bus_bytes_per_us = 12.5;
+static double m_program_us = 250.0;
+static DWORD m_sector_count = SIM_SECTORS_HC;
+
+//what the bench counts
+static unsigned int m_transfers;
+static double m_transfer_us;					//total time from each command to its transfer complete
+static unsigned char m_image[BENCH_MAX_CLUSTERS][BENCH_CLUSTER];	//the card from BENCH_FIRST_SECTOR
+static unsigned char m_blocks[2][BENCH_CLUSTER] __attribute__((aligned(32)));
+
+static double Now( void )
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/*
+ * The controller only has the low half of an address. The descriptor table and the buffers
+ *  are statics, so they share the top half with the simulator's own.
+ */
+static void * SimPointer( u32 address )
+{
+	return (void *)(((uintptr_t)m_image & ~(uintptr_t)0xFFFFFFFFu) | address);
+}
+
+/*
+ * Take a command written to the transfer mode register. Only the ADMA2 CMD25 is expected.
+ */
+static void SimCommand( u32 value )
+{
+	u32 command = value >> 16;
+	u32 mode = value & 0xFFFF;
+	u32 flags = XSDPS_TM_AUTO_CMD12_EN_MASK | XSDPS_TM_BLK_CNT_EN_MASK | XSDPS_TM_MUL_SIN_BLK_SEL_MASK | XSDPS_TM_DMA_EN_MASK;
+	XSdPs_Adma2Descriptor * table = (XSdPs_Adma2Descriptor *)SimPointer(m_adma_address);
+	u32 bytes = 0;
+	int desc = 0;
+
+	if((m_present_state & (XSDPS_PSR_INHIBIT_CMD_MASK | XSDPS_PSR_INHIBIT_DAT_MASK)) != 0
+			|| command != (((u32)CMD25 | RESP_R1 | (u32)XSDPS_DAT_PRESENT_SEL_MASK) & 0x3FFFU) || mode != flags)
+	{
+		m_err_status |= XSDPS_INTR_ERR_CT_MASK;
+		return;
+	}
+	//the descriptors have to cover the blocks exactly and end
+	for(desc = 0; desc <= ASYNC_SD_DESCRIPTORS; desc++)
+	{
+		m_taken[desc] = table[desc];
+		bytes += table[desc].Length ? table[desc].Length : XSDPS_DESC_MAX_LENGTH;
+		if((table[desc].Attribute & XSDPS_DESC_VALID) == 0 || (table[desc].Attribute & XSDPS_DESC_END) != 0)
+			break;
+	}
+	if(desc > ASYNC_SD_DESCRIPTORS || (table[desc].Attribute & XSDPS_DESC_VALID) == 0 || bytes != (u32)m_blk_cnt * m_blk_size
+			|| m_argument < BENCH_FIRST_SECTOR || (m_argument - BENCH_FIRST_SECTOR) * XSDPS_BLK_SIZE_512_MASK + bytes > sizeof(m_image))
+	{
+		m_err_status |= XSDPS_INTR_ERR_ADMA_MASK;
+		return;
+	}
+	m_norm_status |= XSDPS_INTR_CC_MASK;
+	m_present_state |= XSDPS_PSR_INHIBIT_DAT_MASK | XSDPS_PSR_WR_ACTIVE_MASK;
+	m_started_us = Now();
+	m_done_us = m_started_us + SIM_CMD_US + bytes / m_bus_bytes_per_us + m_program_us;
+	m_busy = 1;
+	return;
+}
+
+/*
+ * End the transfer once its time is up: the data goes onto the card from the buffers as they
+ *  are now, and transfer complete, or the error, goes up.
+ */
+static void SimUpdate( void )
+{
+	unsigned char * card = NULL;
+	int desc = 0;
+	u32 length = 0;
+
+	if(m_busy == 0 || Now() < m_done_us)
+		return;
+	card = &m_image[0][0] + (m_argument - BENCH_FIRST_SECTOR) * XSDPS_BLK_SIZE_512_MASK;
+	for(desc = 0; m_fail_next == 0; desc++)
+	{
+		length = m_taken[desc].Length ? m_taken[desc].Length : XSDPS_DESC_MAX_LENGTH;
+		memcpy(card, SimPointer(m_taken[desc].Address), length);
+		card += length;
+		if((m_taken[desc].Attribute & XSDPS_DESC_END) != 0)
+			break;
+	}
+	if(m_fail_next)
+		m_err_status |= XSDPS_INTR_ERR_DCRC_MASK;
+	else
+		m_norm_status |= XSDPS_INTR_TC_MASK;
+	m_fail_next = 0;
+	m_present_state &= ~(XSDPS_PSR_INHIBIT_DAT_MASK | XSDPS_PSR_WR_ACTIVE_MASK);
+	m_transfers++;
+	m_transfer_us += m_done_us - m_started_us;
+	m_busy = 0;
+	return;
+}
+
+/*
+ * The register accesses, see shim/xil_io.h; the 8 and 16 bit ones come here with their own address.
+ */
+u32 Xil_In32( UINTPTR Addr )
+{
+	SimUpdate();
+	switch(Addr - SIM_BASE)
+	{
+	case XSDPS_BLK_SIZE_OFFSET:
+		return m_blk_size | ((u32)m_blk_cnt << 16);
+	case XSDPS_BLK_CNT_OFFSET:
+		return m_blk_cnt;
+	case XSDPS_PRES_STATE_OFFSET:
+		return m_present_state | XSDPS_PSR_CARD_INSRT_MASK;
+	case XSDPS_NORM_INTR_STS_OFFSET:
+		return m_norm_status | (m_err_status ? XSDPS_INTR_ERR_MASK : 0);
+	case XSDPS_ERR_INTR_STS_OFFSET:
+		return m_err_status;
+	default:
+		return 0;
+	}
+}
+
+void Xil_Out32( UINTPTR Addr, u32 Value )
+{
+	switch(Addr - SIM_BASE)
+	{
+	case XSDPS_BLK_SIZE_OFFSET:
+		m_blk_size = (u16)Value;
+		break;
+	case XSDPS_BLK_CNT_OFFSET:
+		m_blk_cnt = (u16)Value;
+		break;
+	case XSDPS_ARGMT_OFFSET:
+		m_argument = Value;
+		break;
+	case XSDPS_XFER_MODE_OFFSET:
+		SimCommand(Value);
+		break;
+	case XSDPS_NORM_INTR_STS_OFFSET:
+		m_norm_status &= ~(u16)Value;
+		break;
+	case XSDPS_ERR_INTR_STS_OFFSET:
+		m_err_status &= ~(u16)Value;
+		break;
+	case XSDPS_ADMA_SAR_OFFSET:
+		m_adma_address = Value;
+		break;
+	default:
+		break;
+	}
+	return;
+}
+
+/*
+ * What AsyncSDWrite.c needs from the BSP and the disk layer.
+ */
+XSdPs_Config * XSdPs_LookupConfig( u16 DeviceId )
+{
+	static XSdPs_Config config;
+
+	if(DeviceId != 0)
+		return NULL;
+	config.BaseAddress = SIM_BASE;
+	config.CardDetect = 1;
+	config.IsCacheCoherent = 0;
+	return &config;
+}
+
+DRESULT disk_ioctl( BYTE pdrv, BYTE cmd, void * buff )
+{
+	if(pdrv != 0 || cmd != GET_SECTOR_COUNT)
+		return RES_PARERR;
+	*(DWORD *)buff = m_sector_count;
+	return RES_OK;
+}
+
+void Xil_DCacheFlushRange( INTPTR adr, u32 len )
+{
+	return;
+}
+
+/*
+ * Fill a cluster with what only it has, then take the rest of the processing time.
+ */
+static void ProcessCluster( unsigned char * block, int cluster, double process_us )
+{
+	double start = Now();
+	int iter = 0;
+
+	for(iter = 0; iter < BENCH_CLUSTER; iter += sizeof(int))
+		*(int *)&block[iter] = cluster * BENCH_CLUSTER + iter;
+	while(Now() - start < process_us)
+		;
+	return;
+}
+
+/*
+ * Write the clusters one way, see the top of the file.
+ *
+ * @return	How many clusters failed to write or did not reach the image as they were written
+ */
+static int RunWrites( int async, int clusters, double process_us )
+{
+	unsigned char * block = NULL;
+	unsigned char expect[BENCH_CLUSTER];
+	double start = 0.0;
+	double held = 0.0;
+	double held_us = 0.0;
+	double loop_us = 0.0;
+	int cluster = 0;
+	int failures = 0;
+
+	memset(m_image, 0, sizeof(m_image));
+	m_transfers = 0;
+	m_transfer_us = 0.0;
+	start = Now();
+	for(cluster = 0; cluster < clusters; cluster++)
+	{
+		block = m_blocks[async ? cluster % 2 : 0];
+		ProcessCluster(block, cluster, process_us);
+		held = Now();
+		if(async)
+		{
+			while(AsyncSDPoll() == ASYNC_SD_BUSY)
+				;
+		}
+		if(AsyncSDStart(block, BENCH_FIRST_SECTOR + cluster * BENCH_SECTORS, BENCH_SECTORS) != CMD_SUCCESS)
+			failures++;
+		if(!async)
+		{
+			AsyncSDWait();
+			if(AsyncSDPoll() != CMD_SUCCESS)
+				failures++;
+		}
+		held_us += Now() - held;
+	}
+	AsyncSDWait();
+	if(AsyncSDPoll() != CMD_SUCCESS)
+		failures++;
+	loop_us = Now() - start;
+
+	for(cluster = 0; cluster < clusters; cluster++)
+	{
+		ProcessCluster(expect, cluster, 0.0);
+		if(memcmp(m_image[cluster], expect, BENCH_CLUSTER) != 0)
+			failures++;
+	}
+	printf("%-6s process %4.0f us: %4.0f us/write start to finish, %5.0f KiB/s card, writer held up %4.0f us/cluster, %4.0f clusters/s%s\n",
+			async ? "async" : "polled", process_us, m_transfers ? m_transfer_us / m_transfers : 0.0,
+			m_transfer_us > 0.0 ? m_transfers * (BENCH_CLUSTER / 1024.0) * 1e6 / m_transfer_us : 0.0,
+			held_us / clusters, clusters * 1e6 / loop_us, failures ? ", FAILED" : "");
+	return failures;
+}
+
+/*
+ * The ways a write should fail, and be seen to.
+ *
+ * @return	How many checks failed
+ */
+static int CheckFailures( void )
+{
+	int failures = 0;
+
+	m_sector_count = SIM_SECTORS_SC;
+	if(AsyncSDInit(0) != CMD_FAILURE || AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, BENCH_SECTORS) != CMD_FAILURE)
+	{
+		printf("FAIL: a card which may be byte addressed was taken\n");
+		failures++;
+	}
+	m_sector_count = SIM_SECTORS_HC;
+	if(AsyncSDInit(1) != CMD_FAILURE || AsyncSDInit(0) != CMD_SUCCESS)
+	{
+		printf("FAIL: AsyncSDInit()\n");
+		failures++;
+	}
+
+	m_blk_size = 0;
+	if(AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, BENCH_SECTORS) != CMD_FAILURE)
+	{
+		printf("FAIL: started with the block size not set\n");
+		failures++;
+	}
+	m_blk_size = XSDPS_BLK_SIZE_512_MASK;
+
+	m_present_state |= XSDPS_PSR_INHIBIT_CMD_MASK;
+	if(AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, BENCH_SECTORS) != CMD_FAILURE || AsyncSDPoll() != CMD_SUCCESS)
+	{
+		printf("FAIL: started with the command line busy\n");
+		failures++;
+	}
+	m_present_state &= ~XSDPS_PSR_INHIBIT_CMD_MASK;
+
+	if(AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, ASYNC_SD_MAX_SECTORS + 1) != CMD_FAILURE)
+	{
+		printf("FAIL: started a write too big for the descriptors\n");
+		failures++;
+	}
+
+	//waited out by someone else, then reported to the poll, once
+	m_fail_next = 1;
+	if(AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, BENCH_SECTORS) != CMD_SUCCESS)
+		failures++;
+	AsyncSDWait();
+	if(AsyncSDPoll() != CMD_FAILURE || AsyncSDPoll() != CMD_SUCCESS)
+	{
+		printf("FAIL: the data error was not reported once\n");
+		failures++;
+	}
+	//and the next write goes through
+	if(AsyncSDStart(m_blocks[0], BENCH_FIRST_SECTOR, ASYNC_SD_MAX_SECTORS) != CMD_SUCCESS)
+		failures++;
+	AsyncSDWait();
+	if(AsyncSDPoll() != CMD_SUCCESS || m_err_status != 0)
+	{
+		printf("FAIL: the write after the data error\n");
+		failures++;
+	}
+	return failures;
+}
+
+int main( int argc, char * argv[] )
+{
+	int clusters = 200;
+	int iter = 0;
+	int failures = 0;
+
+	for(iter = 1; iter + 1 < argc; iter += 2)
+	{
+		if(strcmp(argv[iter], "-n") == 0)
+			clusters = atoi(argv[iter + 1]);
+		else if(strcmp(argv[iter], "-b") == 0)
+			m_bus_bytes_per_us = atof(argv[iter + 1]);
+		else if(strcmp(argv[iter], "-p") == 0)
+			m_program_us = atof(argv[iter + 1]);
+		else
+			break;
+	}
+	if(iter != argc || clusters <= 0 || clusters > BENCH_MAX_CLUSTERS || m_bus_bytes_per_us <= 0.0 || m_program_us < 0.0)
+	{
+		printf("usage: sdasyncbench [-n clusters, up to %d] [-b bus MB/s] [-p program us]\n", BENCH_MAX_CLUSTERS);
+		return 1;
+	}
+	if(SimPointer((u32)(uintptr_t)m_blocks[1]) != m_blocks[1])
+	{
+		printf("FAIL: the statics are not all in one 4 GiB\n");
+		return 1;
+	}
+
+	//as the disk layer leaves the controller once the card has been written through FatFs
+	m_blk_size = XSDPS_BLK_SIZE_512_MASK;
+	if(AsyncSDInit(0) != CMD_SUCCESS)
+	{
+		printf("FAIL: AsyncSDInit()\n");
+		return 1;
+	}
+	printf("%d clusters of %d bytes for each, bus %.1f MB/s, card busy %.0f us after the data\n",
+			clusters, BENCH_CLUSTER, m_bus_bytes_per_us, m_program_us);
+	for(iter = 0; iter < BENCH_PROCESS_RUNS; iter++)
+	{
+		failures += RunWrites(0, clusters, m_process_us[iter]);
+		failures += RunWrites(1, clusters, m_process_us[iter]);
+	}
+	failures += CheckFailures();
+
+	printf("sdasyncbench: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * seekbench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host benchmark for the seek TransferSDFile() does to start a transfer part way through a
+ *  file, when a transfer is resumed or one packet sent again. The flight FatFs from the BSP
+ *  is built as it is, on a FAT image in a host file in place of the SD card, and each file
+ *  is started at its first, middle and last packet over and over. The BSP's FatFs has no
+ *  fast seek (_USE_FASTSEEK), so f_lseek() follows the FAT chain from the top of the file,
+ *  and this shows what that costs.
+ *
+ *  seekbench [-i image] [-m MiB] [-a cluster bytes] [-n seeks]
+ *		-i		the image file, made new each run, default seekbench.img
+ *		-m		size of each EVT file, default 8 MiB; the image is made big enough for
+ *				 three of them
+ *		-a		cluster size the image is formatted with, default 4096; the smaller the
+ *				 clusters, the longer the chain to follow
+ *		-n		how many times each seek is timed, default 1000
+ *
+ * Two set files go on the image: one written on its own, so its clusters are one run, and
+ *  one written a cluster at a time in step with a second file, so every other cluster
+ *  belongs to something else. Each seek is to the packet asked for, then the packet is read.
+ * The report gives the sectors read from the image and the host time for each seek, to the
+ *  first, middle and last packet. The sector reads are what the SD card would see; the time
+ *  says how the work grows with the position, not what the board takes.
+ *
+ * Build:
+ *  gcc -O2 -o seekbench seekbench.c ../standalone_bsp_0/ps7_cortexa9_0/libsrc/xilffs_v3_7/src/ff.c
+ *		../standalone_bsp_0/ps7_cortexa9_0/libsrc/xilffs_v3_7/src/ccsbcs.c
+ *		-I../lunah_FSW_01_src/src -I../standalone_bsp_0/ps7_cortexa9_0/include
+ *  ccsbcs.c is there for the long file names the BSP turns on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ff.h"
+#include "diskio.h"
+#include "lunah_defines.h"
+
+#define SECTOR_BYTES		512
+#define IMAGE_SPARE_MIB		8			//room on the image past the set files and the filler
+
+static FILE * m_image;
+static unsigned int m_image_sectors;
+static unsigned long long m_sectors_read;	//sectors read from the image since the count was cleared
+
+/*
+ * The disk under FatFs: the image file, one sector being SECTOR_BYTES of it.
+ */
+DSTATUS disk_initialize( BYTE pdrv )
+{
+	return m_image ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status( BYTE pdrv )
+{
+	return m_image ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read( BYTE pdrv, BYTE * buff, DWORD sector, UINT count )
+{
+	if(sector + count > m_image_sectors || fseek(m_image, (long)sector * SECTOR_BYTES, SEEK_SET) != 0)
+		return RES_PARERR;
+	if(fread(buff, SECTOR_BYTES, count, m_image) != count)
+		return RES_ERROR;
+	m_sectors_read += count;
+	return RES_OK;
+}
+
+DRESULT disk_write( BYTE pdrv, const BYTE * buff, DWORD sector, UINT count )
+{
+	if(sector + count > m_image_sectors || fseek(m_image, (long)sector * SECTOR_BYTES, SEEK_SET) != 0)
+		return RES_PARERR;
+	if(fwrite(buff, SECTOR_BYTES, count, m_image) != count)
+		return RES_ERROR;
+	return RES_OK;
+}
+
+DRESULT disk_ioctl( BYTE pdrv, BYTE cmd, void * buff )
+{
+	switch(cmd)
+	{
+	case CTRL_SYNC:
+		fflush(m_image);
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = m_image_sectors;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = SECTOR_BYTES;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+DWORD get_fattime( void )
+{
+	return ((DWORD)(2026 - 1980) << 25) | (10 << 21) | (17 << 16);
+}
+
+static double NowNs( void )
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+/*
+ * Make a new, formatted image and mount it.
+ */
+static int MakeImage( const char * path, FATFS * fs, unsigned int image_mib, UINT cluster_bytes )
+{
+	static BYTE zero[SECTOR_BYTES];
+	unsigned int sector = 0;
+
+	m_image = fopen(path, "w+b");
+	if(m_image == NULL)
+		return 1;
+	m_image_sectors = image_mib * (1024 * 1024 / SECTOR_BYTES);
+	for(sector = 0; sector < m_image_sectors; sector++)
+		fwrite(zero, SECTOR_BYTES, 1, m_image);
+	if(f_mount(fs, "", 1) != FR_NO_FILESYSTEM && f_mount(fs, "", 1) != FR_OK)
+		return 1;
+	if(f_mkfs("", 1, cluster_bytes) != FR_OK)
+		return 1;
+	return f_mount(fs, "", 1) != FR_OK;
+}
+
+/*
+ * Write the set files: the header cluster then the data, each byte the low bits of its offset.
+ * With a filler file, it takes a cluster after each cluster of the set file.
+ */
+static int WriteSetFile( const char * name, const char * filler_name, unsigned int file_bytes, UINT cluster_bytes )
+{
+	static BYTE chunk[65536];
+	FIL file;
+	FIL filler;
+	UINT written = 0;
+	unsigned int offset = 0;
+	unsigned int iter = 0;
+	int res = FR_OK;
+
+	if(f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return 1;
+	if(filler_name != NULL && f_open(&filler, filler_name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return 1;
+	for(offset = 0; offset < file_bytes && res == FR_OK; offset += cluster_bytes)
+	{
+		for(iter = 0; iter < cluster_bytes; iter++)
+			chunk[iter] = (BYTE)(offset + iter);
+		res = f_write(&file, chunk, cluster_bytes, &written);
+		if(res == FR_OK && filler_name != NULL)
+			res = f_write(&filler, chunk, cluster_bytes, &written);
+	}
+	f_close(&file);
+	if(filler_name != NULL)
+		f_close(&filler);
+	return res != FR_OK;
+}
+
+/*
+ * Time the seek to a packet and the read of it, from a file which has just been read at the top.
+ *
+ * @return	The average ns per seek, the sectors read per seek through *sectors
+ */
+static double TimeSeek( FIL * file, int packet, int seeks, double * sectors )
+{
+	static BYTE data[DATA_BYTES_EVT];
+	DWORD offset = DP_HEADER_SIZE + (DWORD)packet * DATA_BYTES_EVT;
+	UINT bytes_read = 0;
+	double total_ns = 0.0;
+	double start = 0.0;
+	unsigned long long start_sectors = 0;
+	unsigned long long total_sectors = 0;
+	int iter = 0;
+
+	for(iter = 0; iter < seeks; iter++)
+	{
+		//back to the top first, as a transfer starts from the header
+		f_lseek(file, 0);
+		f_read(file, data, 1, &bytes_read);
+		start_sectors = m_sectors_read;
+		start = NowNs();
+		if(f_lseek(file, offset) != FR_OK || f_read(file, data, DATA_BYTES_EVT, &bytes_read) != FR_OK)
+		{
+			printf("seek to packet %d failed\n", packet);
+			exit(1);
+		}
+		total_ns += NowNs() - start;
+		total_sectors += m_sectors_read - start_sectors;
+		if(bytes_read != 0 && data[0] != (BYTE)offset)
+		{
+			printf("packet %d read back wrong\n", packet);
+			exit(1);
+		}
+	}
+	*sectors = (double)total_sectors / seeks;
+	return total_ns / seeks;
+}
+
+static void BenchFile( const char * name, int seeks )
+{
+	FIL file;
+	int packets = 0;
+	int which = 0;
+	int packet = 0;
+	double seek_ns = 0.0;
+	double seek_sectors = 0.0;
+	const char * where[3] = {"first", "middle", "last"};
+
+	if(f_open(&file, name, FA_READ) != FR_OK)
+	{
+		printf("can't open %s\n", name);
+		exit(1);
+	}
+	packets = (file_size(&file) - DP_HEADER_SIZE) / DATA_BYTES_EVT + 1;
+	printf("%s: %u bytes, %d packets\n", name, (unsigned int)file_size(&file), packets);
+
+	for(which = 0; which < 3; which++)
+	{
+		packet = which == 0 ? 0 : which == 1 ? packets / 2 : packets - 1;
+		seek_ns = TimeSeek(&file, packet, seeks, &seek_sectors);
+		printf("  %-6s packet %5d: %8.0f ns %6.1f sectors\n", where[which], packet, seek_ns, seek_sectors);
+	}
+	f_close(&file);
+	return;
+}
+
+int main( int argc, char * argv[] )
+{
+	FATFS fs;
+	const char * image = "seekbench.img";
+	unsigned int file_mib = 8;
+	UINT cluster_bytes = 4096;
+	int seeks = 1000;
+	int arg = 0;
+
+	for(arg = 1; arg < argc; arg++)
+	{
+		if(strcmp(argv[arg], "-i") == 0 && arg + 1 < argc)
+			image = argv[++arg];
+		else if(strcmp(argv[arg], "-m") == 0 && arg + 1 < argc)
+			file_mib = (unsigned int)atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-a") == 0 && arg + 1 < argc)
+			cluster_bytes = (UINT)atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+			seeks = atoi(argv[++arg]);
+		else
+		{
+			printf("usage: seekbench [-i image] [-m MiB] [-a cluster bytes] [-n seeks]\n");
+			return 1;
+		}
+	}
+	if(file_mib == 0 || file_mib > 1024 || seeks <= 0)
+	{
+		printf("file size or seeks out of range\n");
+		return 1;
+	}
+
+	//the two set files and the filler
+	if(MakeImage(image, &fs, file_mib * 3 + IMAGE_SPARE_MIB, cluster_bytes) != 0)
+	{
+		printf("can't make the image %s\n", image);
+		return 1;
+	}
+	printf("image %s, %d MiB, FAT%d, %u byte clusters, %d seeks each\n", image, file_mib * 3 + IMAGE_SPARE_MIB, fs.fs_type == FS_FAT32 ? 32 : fs.fs_type == FS_FAT16 ? 16 : 12,
+			(unsigned int)fs.csize * SECTOR_BYTES, seeks);
+	if(WriteSetFile("evt_S0000.bin", NULL, file_mib * 1024 * 1024, cluster_bytes) != 0
+			|| WriteSetFile("evt_S0001.bin", "filler.bin", file_mib * 1024 * 1024, cluster_bytes) != 0)
+	{
+		printf("can't write the set files\n");
+		return 1;
+	}
+
+	BenchFile("evt_S0000.bin", seeks);
+	BenchFile("evt_S0001.bin", seeks);
+
+	f_mount(NULL, "", 0);
+	fclose(m_image);
+	return 0;
+}
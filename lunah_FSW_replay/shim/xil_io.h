@@ -0,0 +1,40 @@
+/*
+ * xil_io.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host stand-in for the BSP xil_io.h, found first on the replay harness include path.
+ * The register accesses go to a table in hal_shim.c instead of the bus; a register reads
+ *  back whatever was last written to it, or 0.
+ */
+
+#ifndef XIL_IO_H
+#define XIL_IO_H
+
+#include "xil_types.h"
+#include "xil_printf.h"
+
+#define SYNCHRONIZE_IO
+#define INST_SYNC
+#define DATA_SYNC
+#define INLINE inline
+
+//function prototypes, see hal_shim.c
+u32 Xil_In32( UINTPTR Addr );
+void Xil_Out32( UINTPTR Addr, u32 Value );
+u16 Xil_EndianSwap16( u16 Data );
+u32 Xil_EndianSwap32( u32 Data );
+
+#define Xil_In8(Addr)			((u8)Xil_In32(Addr))
+#define Xil_In16(Addr)			((u16)Xil_In32(Addr))
+#define Xil_Out8(Addr, Value)	Xil_Out32((Addr), (u8)(Value))
+#define Xil_Out16(Addr, Value)	Xil_Out32((Addr), (u16)(Value))
+#define Xil_In32LE				Xil_In32
+#define Xil_Out32LE				Xil_Out32
+#define Xil_Htons				Xil_EndianSwap16
+#define Xil_Htonl				Xil_EndianSwap32
+#define Xil_Ntohs				Xil_EndianSwap16
+#define Xil_Ntohl				Xil_EndianSwap32
+
+#endif /* XIL_IO_H */
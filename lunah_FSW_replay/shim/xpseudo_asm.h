@@ -0,0 +1,19 @@
+/*
+ * xpseudo_asm.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: IRDLab
+ *
+ * Host stand-in for the BSP xpseudo_asm.h, found first on the replay harness include path.
+ * Only the barriers are here, as full fences for the compiler and the host CPU, so code
+ *  which orders its memory accesses with them (ie. BlockQueue.c) does so on the host too.
+ */
+
+#ifndef XPSEUDO_ASM_H
+#define XPSEUDO_ASM_H
+
+#define isb()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define dsb()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define dmb()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif /* XPSEUDO_ASM_H */